@@ -0,0 +1,176 @@
+#include "pch.h"
+#include "Metrics.h"
+#include "ActivationCache.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace
+{
+	struct ConfigEntry
+	{
+		std::vector<ULONGLONG> stamp;
+		std::shared_ptr<const VCamConfigSnapshot> snapshot;
+	};
+
+	using MediaTypeKey = std::tuple<UINT, UINT, UINT, UINT>;
+
+	std::mutex g_cacheLock;
+	std::map<UINT, ConfigEntry> g_configs;
+	std::map<MediaTypeKey, wil::com_ptr_nothrow<IMFMediaType>> g_mediaTypes;
+	std::map<DWORD, wil::com_ptr_nothrow<IMFSensorProfileCollection>> g_profiles;
+
+	ULONGLONG GetLastWriteTime(HKEY key)
+	{
+		FILETIME lastWrite{};
+		if (RegQueryInfoKeyW(key, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &lastWrite) != ERROR_SUCCESS)
+		{
+			return 0;
+		}
+		return (static_cast<ULONGLONG>(lastWrite.dwHighDateTime) << 32) | lastWrite.dwLowDateTime;
+	}
+
+	// Last write times of the config key and of the StreamN subkeys the loader would read: a
+	// key's time changes when one of its values is written, not when a subkey's values are.
+	std::vector<ULONGLONG> ReadConfigStamp(const std::wstring& configPath, UINT maxStreams)
+	{
+		std::vector<ULONGLONG> stamp;
+		wil::unique_hkey key;
+		if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, configPath.c_str(), 0, KEY_READ, &key) != ERROR_SUCCESS)
+		{
+			return stamp;
+		}
+
+		stamp.push_back(GetLastWriteTime(key.get()));
+		for (UINT i = 1; i < maxStreams; i++)
+		{
+			wil::unique_hkey streamKey;
+			if (RegOpenKeyExW(key.get(), std::format(L"Stream{}", i).c_str(), 0, KEY_READ, &streamKey) != ERROR_SUCCESS)
+			{
+				break;
+			}
+			stamp.push_back(GetLastWriteTime(streamKey.get()));
+		}
+		return stamp;
+	}
+
+	HRESULT CreateNV12Type(const VCamPipelineConfig& config, IMFMediaType** type)
+	{
+		wil::com_ptr_nothrow<IMFMediaType> nv12Type;
+		RETURN_IF_FAILED(MFCreateMediaType(&nv12Type));
+		nv12Type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+		nv12Type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
+		nv12Type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+		nv12Type->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE);
+		MFSetAttributeSize(nv12Type.get(), MF_MT_FRAME_SIZE, config.width, config.height);
+		nv12Type->SetUINT32(MF_MT_DEFAULT_STRIDE, config.width);
+		MFSetAttributeRatio(nv12Type.get(), MF_MT_FRAME_RATE, config.fpsNumerator, config.fpsDenominator);
+
+		auto bitrate = static_cast<uint32_t>((static_cast<double>(config.width) * config.height * 3.0 / 2.0) * 8.0 * config.fpsNumerator / config.fpsDenominator);
+		nv12Type->SetUINT32(MF_MT_AVG_BITRATE, bitrate);
+		MFSetAttributeRatio(nv12Type.get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+		*type = nv12Type.detach();
+		return S_OK;
+	}
+
+	HRESULT CreateSensorProfiles(DWORD streamCount, IMFSensorProfileCollection** result)
+	{
+		wil::com_ptr_nothrow<IMFSensorProfileCollection> collection;
+		RETURN_IF_FAILED(MFCreateSensorProfileCollection(&collection));
+
+		wil::com_ptr_nothrow<IMFSensorProfile> profile;
+		RETURN_IF_FAILED(MFCreateSensorProfile(KSCAMERAPROFILE_Legacy, 0, nullptr, &profile));
+		for (DWORD streamId = 0; streamId < streamCount; streamId++)
+		{
+			RETURN_IF_FAILED(profile->AddProfileFilter(streamId, L"((RES==;FRT<=30,1;SUT==))"));
+		}
+		RETURN_IF_FAILED(collection->AddProfile(profile.get()));
+
+		RETURN_IF_FAILED(MFCreateSensorProfile(KSCAMERAPROFILE_HighFrameRate, 0, nullptr, &profile));
+		for (DWORD streamId = 0; streamId < streamCount; streamId++)
+		{
+			RETURN_IF_FAILED(profile->AddProfileFilter(streamId, L"((RES==;FRT>=60,1;SUT==))"));
+		}
+		RETURN_IF_FAILED(collection->AddProfile(profile.get()));
+		*result = collection.detach();
+		return S_OK;
+	}
+}
+
+std::shared_ptr<const VCamConfigSnapshot> ActivationCacheGetConfig(UINT camera, const std::wstring& configPath, UINT maxStreams, const VCamConfigLoader& load)
+{
+	auto stamp = ReadConfigStamp(configPath, maxStreams);
+	{
+		std::lock_guard<std::mutex> lock(g_cacheLock);
+		const auto it = g_configs.find(camera);
+		if (it != g_configs.end() && it->second.stamp == stamp)
+		{
+			MetricsGet("activation.confighits")->Add(1);
+			return it->second.snapshot;
+		}
+	}
+
+	// Loaded outside the lock; concurrent activations may both load, the last one is kept.
+	auto snapshot = std::make_shared<VCamConfigSnapshot>();
+	load(snapshot.get());
+	MetricsGet("activation.configloads")->Add(1);
+
+	std::lock_guard<std::mutex> lock(g_cacheLock);
+	g_configs[camera] = { std::move(stamp), snapshot };
+	return snapshot;
+}
+
+HRESULT ActivationCacheCreateMediaType(const VCamPipelineConfig& config, IMFMediaType** type)
+{
+	RETURN_HR_IF_NULL(E_POINTER, type);
+	*type = nullptr;
+
+	const MediaTypeKey key{ config.width, config.height, config.fpsNumerator, config.fpsDenominator };
+	wil::com_ptr_nothrow<IMFMediaType> cached;
+	{
+		std::lock_guard<std::mutex> lock(g_cacheLock);
+		const auto it = g_mediaTypes.find(key);
+		if (it != g_mediaTypes.end())
+		{
+			cached = it->second;
+		}
+	}
+
+	if (!cached)
+	{
+		RETURN_IF_FAILED(CreateNV12Type(config, &cached));
+		std::lock_guard<std::mutex> lock(g_cacheLock);
+		g_mediaTypes.emplace(key, cached);
+	}
+
+	// Each descriptor gets its own copy: clients may change the types they are handed.
+	wil::com_ptr_nothrow<IMFMediaType> copy;
+	RETURN_IF_FAILED(MFCreateMediaType(&copy));
+	RETURN_IF_FAILED(cached->CopyAllItems(copy.get()));
+	*type = copy.detach();
+	return S_OK;
+}
+
+HRESULT ActivationCacheGetSensorProfiles(DWORD streamCount, IMFSensorProfileCollection** collection)
+{
+	RETURN_HR_IF_NULL(E_POINTER, collection);
+	*collection = nullptr;
+
+	std::lock_guard<std::mutex> lock(g_cacheLock);
+	auto& cached = g_profiles[streamCount];
+	if (!cached)
+	{
+		RETURN_IF_FAILED(CreateSensorProfiles(streamCount, &cached));
+	}
+	cached.copy_to(collection);
+	return S_OK;
+}
+
+void ActivationCacheClear()
+{
+	std::lock_guard<std::mutex> lock(g_cacheLock);
+	g_configs.clear();
+	g_mediaTypes.clear();
+	g_profiles.clear();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "GstPipelineSource.h"
+
+// Process-wide caches for MediaSource::Initialize. FrameServer creates and shuts down several
+// sources while a client opens the camera; each reuses what the previous one built instead of
+// reading the registry and rebuilding media types and sensor profiles again.
+struct VCamConfigSnapshot
+{
+	VCamPipelineConfig pipeline;
+	std::vector<VCamPipelineConfig> streams;
+};
+
+using VCamConfigLoader = std::function<void(VCamConfigSnapshot* snapshot)>;
+
+// The cached snapshot of the camera's config, or a new one from load when the config key or
+// one of its StreamN subkeys has been written since it was taken.
+std::shared_ptr<const VCamConfigSnapshot> ActivationCacheGetConfig(UINT camera, const std::wstring& configPath, UINT maxStreams, const VCamConfigLoader& load);
+
+// A new NV12 media type for the stream config, copied from a cached template.
+HRESULT ActivationCacheCreateMediaType(const VCamPipelineConfig& config, IMFMediaType** type);
+
+// The sensor profile collection for a source with streamCount streams. It is shared between
+// sources and must not be modified.
+HRESULT ActivationCacheGetSensorProfiles(DWORD streamCount, IMFSensorProfileCollection** collection);
+
+// Releases the cached objects, from DllCanUnloadNow.
+void ActivationCacheClear();
@@ -4,21 +4,37 @@
 #include "EnumNames.h"
 #include "MediaStream.h"
 #include "MediaSource.h"
+#include "Cameras.h"
+#include "Metrics.h"
 #include "Activator.h"
 
-HRESULT Activator::Initialize()
+HRESULT Activator::Initialize(UINT camera)
 {
+	WINTRACE(L"Activator::Initialize camera:%u", camera);
+	LARGE_INTEGER start{};
+	QueryPerformanceCounter(&start);
+
 	_source = winrt::make_self<MediaSource>();
 	RETURN_IF_FAILED(SetUINT32(MF_VIRTUALCAMERA_PROVIDE_ASSOCIATED_CAMERA_SOURCES, 1));
-	RETURN_IF_FAILED(SetGUID(MFT_TRANSFORM_CLSID_Attribute, CLSID_VCam));
-	RETURN_IF_FAILED(_source->Initialize(this));
+	RETURN_IF_FAILED(SetGUID(MFT_TRANSFORM_CLSID_Attribute, VCamCameraClsid(camera)));
+	RETURN_IF_FAILED(_source->Initialize(this, camera));
+
+	LARGE_INTEGER end{};
+	LARGE_INTEGER frequency{};
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+	const auto elapsedUs = (end.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart;
+	MetricsGet("activation.count")->Add(1);
+	MetricsGet("activation.lastus")->Set(elapsedUs);
+	MetricsGet("activation.maxus")->Max(elapsedUs);
+	WINTRACE(L"Activator::Initialize camera:%u took %lld us", camera, elapsedUs);
 	return S_OK;
 }
 
 // IMFActivate
 STDMETHODIMP Activator::ActivateObject(REFIID riid, void** ppv)
 {
-	WINTRACE(L"Activator::ActivateObject '%s'", GUID_ToStringW(riid).c_str());
+	WINTRACE(L"Activator::ActivateObject '%s'", GUID_ToName(riid).c_str());
 	RETURN_HR_IF_NULL(E_POINTER, ppv);
 	*ppv = nullptr;
 
@@ -32,7 +48,8 @@ STDMETHODIMP Activator::ActivateObject(REFIID riid, void** ppv)
 			WINTRACE(L"Activator::ActivateObject client process '%s'", name.c_str());
 		}
 	}
-	RETURN_IF_FAILED_MSG(_source->QueryInterface(riid, ppv), "Activator::ActivateObject failed on IID %s", GUID_ToStringW(riid).c_str());
+	RETURN_IF_FAILED_MSG(_source->QueryInterface(riid, ppv), "Activator::ActivateObject failed on IID %s", GUID_ToName(riid).c_str());
+	_source->Prewarm();
 	return S_OK;
 }
 
@@ -17,7 +17,7 @@ public:
 		SetBaseAttributesTraceName(L"ActivatorAtts");
 	}
 
-	HRESULT Initialize();
+	HRESULT Initialize(UINT camera);
 
 private:
 #if _DEBUG
@@ -31,7 +31,7 @@ private:
 			return S_OK;
 		}
 
-		RETURN_HR_MSG(E_NOINTERFACE, "Activator QueryInterface failed on IID %s", GUID_ToStringW(id).c_str());
+		RETURN_HR_MSG(E_NOINTERFACE, "Activator QueryInterface failed on IID %s", GUID_ToName(id).c_str());
 	}
 #endif
 
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary trace file (C:\gstvcam_trace.bin) written when the DLL is built with VCAM_BINARY_TRACE.
+// Call sites record only their format string id, a QPC timestamp and the raw arguments;
+// tools/decode_binary_trace.py rebuilds the text offline. Plain C types only.
+//
+// The file is a sequence of little-endian records, each starting with VCamTraceRecordHeader
+// (size includes the header). Several processes may append to the same file, so every write
+// starts with a BATCH record naming the process the following records belong to; SESSION
+// carries the clock of a process and SITE the format strings, both before any EVENT using them.
+
+#define VCAM_TRACE_RECORD_SESSION 1u
+#define VCAM_TRACE_RECORD_BATCH 2u
+#define VCAM_TRACE_RECORD_SITE 3u
+#define VCAM_TRACE_RECORD_EVENT 4u
+#define VCAM_TRACE_RECORD_DROPPED 5u
+
+// EVENT arguments: a tag byte followed by its payload.
+#define VCAM_TRACE_ARG_INT64 1u   // int64_t, sign-extended
+#define VCAM_TRACE_ARG_UINT64 2u  // uint64_t, zero-extended
+#define VCAM_TRACE_ARG_DOUBLE 3u  // double
+#define VCAM_TRACE_ARG_POINTER 4u // uint64_t
+#define VCAM_TRACE_ARG_STRING 5u  // uint16_t byte count + that many bytes of narrow (ANSI/UTF-8) text
+#define VCAM_TRACE_ARG_WSTRING 6u // uint16_t byte count + that many bytes of UTF-16LE text
+
+#pragma pack(push, 1)
+typedef struct VCamTraceRecordHeader
+{
+	uint16_t type;
+	uint16_t size;
+} VCamTraceRecordHeader;
+
+typedef struct VCamTraceSessionRecord
+{
+	VCamTraceRecordHeader header;
+	uint32_t processId;
+	uint64_t qpcFrequency;
+	// QPC value and UTC FILETIME taken together when the session was opened.
+	uint64_t qpcBase;
+	uint64_t fileTimeBase;
+} VCamTraceSessionRecord;
+
+typedef struct VCamTraceBatchRecord
+{
+	VCamTraceRecordHeader header;
+	uint32_t processId;
+} VCamTraceBatchRecord;
+
+// Followed by the printf-style format string in UTF-8, without terminator.
+typedef struct VCamTraceSiteRecord
+{
+	VCamTraceRecordHeader header;
+	uint32_t siteId;
+} VCamTraceSiteRecord;
+
+// Followed by the encoded arguments.
+typedef struct VCamTraceEventRecord
+{
+	VCamTraceRecordHeader header;
+	uint32_t siteId;
+	uint32_t threadId;
+	uint64_t qpc;
+} VCamTraceEventRecord;
+
+typedef struct VCamTraceDroppedRecord
+{
+	VCamTraceRecordHeader header;
+	uint64_t count;
+} VCamTraceDroppedRecord;
+#pragma pack(pop)
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Second-order phase-locked loop over a stream of event timestamps (100ns units).
+// It estimates the period and phase of a nominally periodic event source, tolerates
+// skipped events (e.g. frames dropped by latest-only handoff) and predicts the next event.
+// It is deterministic and not thread-safe; callers serialize access. Header-only with standard
+// types so the tests build it on any host.
+class CadenceEstimator
+{
+public:
+	void Reset(int64_t nominalPeriod)
+	{
+		_nominalPeriod = nominalPeriod > 0 ? static_cast<double>(nominalPeriod) : 333333.0;
+		_period = _nominalPeriod;
+		_phase = 0.0;
+		_jitter = 0.0;
+		_lastEventTime = 0;
+		_events = 0;
+	}
+
+	void OnEvent(int64_t time)
+	{
+		const auto t = static_cast<double>(time);
+		if (!_events || t - _phase > _period * MaxGapPeriods || t < _phase)
+		{
+			// (Re)acquire: keep the period estimate, restart phase and lock counting.
+			_phase = t;
+			_lastEventTime = time;
+			_jitter = 0.0;
+			_events = 1;
+			return;
+		}
+
+		// Account for skipped events by snapping to the nearest predicted cycle.
+		const auto cycles = (std::max)(1.0, std::round((t - _phase) / _period));
+		const auto predicted = _phase + cycles * _period;
+		const auto error = t - predicted;
+
+		_phase = predicted + error * PhaseGain;
+		_period += (error / cycles) * PeriodGain;
+		_period = std::clamp(_period, _nominalPeriod * 0.5, _nominalPeriod * 2.0);
+		_jitter += (std::abs(error) - _jitter) * JitterGain;
+		_lastEventTime = time;
+		_events++;
+	}
+
+	bool IsLocked() const { return _events >= LockEvents && _jitter < _period * 0.25; }
+	int64_t GetPeriod() const { return static_cast<int64_t>(_period); }
+	int64_t GetJitter() const { return static_cast<int64_t>(_jitter); }
+	int64_t GetLastEventTime() const { return _lastEventTime; }
+
+	int64_t PredictNext(int64_t now) const
+	{
+		if (!_events)
+		{
+			return 0;
+		}
+
+		const auto t = static_cast<double>(now);
+		auto next = _phase + _period;
+		if (next < t)
+		{
+			next += std::ceil((t - next) / _period) * _period;
+		}
+		return static_cast<int64_t>(next);
+	}
+
+private:
+	// Loop gains: phase converges in ~8 events, period in ~64, which rides out scheduler jitter.
+	static constexpr double PhaseGain = 1.0 / 8.0;
+	static constexpr double PeriodGain = 1.0 / 64.0;
+	static constexpr double JitterGain = 1.0 / 16.0;
+	static constexpr uint32_t LockEvents = 8;
+	// Gaps longer than this many periods are treated as a discontinuity (pause, stall).
+	static constexpr double MaxGapPeriods = 8.0;
+
+	double _nominalPeriod = 333333.0;
+	double _period = 333333.0;
+	double _phase = 0.0;
+	double _jitter = 0.0;
+	int64_t _lastEventTime = 0;
+	uint32_t _events = 0;
+};
+
+// Decides whether a request that found no new frame should hold for an imminent one.
+// Holding only when the producer is predicted to deliver within a fraction of the consumer
+// period pulls the consumer's request phase to land just before each frame arrival, which
+// removes the one-interval latency and the double-delivery/drop flip-flop of free-running clocks.
+class FramePhaseLock
+{
+public:
+	void Reset(int64_t frameDuration)
+	{
+		_frameDuration = frameDuration > 0 ? frameDuration : 333333;
+		_lastFrameTime = 0;
+		_consumer.Reset(_frameDuration);
+		_producer.Reset(_frameDuration);
+	}
+
+	void OnRequest(int64_t now, bool firstAfterDelivery)
+	{
+		// Re-requests after a miss are storm noise; only the first request after a delivery
+		// reflects when the consumer is ready for its next frame.
+		if (firstAfterDelivery)
+		{
+			_consumer.OnEvent(now);
+		}
+	}
+
+	void OnFrameTime(int64_t frameTime)
+	{
+		if (frameTime && frameTime != _lastFrameTime)
+		{
+			_lastFrameTime = frameTime;
+			_producer.OnEvent(frameTime);
+		}
+	}
+
+	int64_t ExpectedArrival(int64_t now) const
+	{
+		if (_producer.IsLocked())
+		{
+			return _producer.PredictNext(now);
+		}
+		return _lastFrameTime ? _lastFrameTime + _frameDuration : 0;
+	}
+
+	int64_t HoldTime(int64_t now) const
+	{
+		if (!_producer.IsLocked())
+		{
+			return 0;
+		}
+
+		const auto consumerPeriod = _consumer.IsLocked() ? _consumer.GetPeriod() : _frameDuration;
+		const auto window = static_cast<int64_t>(consumerPeriod * HoldFraction);
+		const auto untilArrival = _producer.PredictNext(now) - now + _producer.GetJitter() + HoldSlack;
+		if (untilArrival <= 0 || untilArrival > window)
+		{
+			return 0;
+		}
+		return untilArrival;
+	}
+
+	const CadenceEstimator& Consumer() const { return _consumer; }
+	const CadenceEstimator& Producer() const { return _producer; }
+
+private:
+	// A request holds for a frame predicted within this fraction of the consumer period.
+	static constexpr double HoldFraction = 0.25;
+	static constexpr int64_t HoldSlack = 5000; // 0.5ms
+
+	int64_t _frameDuration = 333333;
+	int64_t _lastFrameTime = 0;
+	CadenceEstimator _consumer;
+	CadenceEstimator _producer;
+};
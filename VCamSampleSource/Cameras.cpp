@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "Cameras.h"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr PCWSTR kConfigPath = L"SOFTWARE\\VCamSample\\GStreamer";
+	constexpr PCWSTR kCameraCountValueName = L"CameraCount";
+	constexpr PCWSTR kVirtualCameraName = L"VCamSample";
+}
+
+GUID VCamCameraClsid(UINT camera)
+{
+	auto clsid = CLSID_VCam;
+	clsid.Data4[7] = static_cast<BYTE>(clsid.Data4[7] + camera);
+	return clsid;
+}
+
+bool VCamTryGetCamera(REFCLSID clsid, UINT* camera)
+{
+	for (UINT i = 0; i < VCamMaxCameras; i++)
+	{
+		if (clsid == VCamCameraClsid(i))
+		{
+			*camera = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::wstring VCamCameraConfigPath(UINT camera)
+{
+	if (!camera)
+	{
+		return kConfigPath;
+	}
+	return std::format(L"{}\\Camera{}", kConfigPath, camera);
+}
+
+std::wstring VCamCameraName(UINT camera)
+{
+	if (!camera)
+	{
+		return kVirtualCameraName;
+	}
+	return std::format(L"{} {}", kVirtualCameraName, camera + 1);
+}
+
+UINT VCamCameraCount()
+{
+	DWORD count = 1;
+	DWORD size = sizeof(count);
+	if (RegGetValueW(HKEY_LOCAL_MACHINE, kConfigPath, kCameraCountValueName, RRF_RT_REG_DWORD, nullptr, &count, &size) != ERROR_SUCCESS)
+	{
+		return 1;
+	}
+	return std::clamp<UINT>(count, 1, VCamMaxCameras);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// One DLL can host several virtual cameras. Camera 0 keeps the historical CLSID, name and
+// config key; camera N uses a CLSID derived from CLSID_VCam and the CameraN config subkey.
+// All cameras in a process share the GStreamer runtime and the pipeline worker thread.
+constexpr UINT VCamMaxCameras = 8;
+
+GUID VCamCameraClsid(UINT camera);
+bool VCamTryGetCamera(REFCLSID clsid, UINT* camera);
+std::wstring VCamCameraConfigPath(UINT camera);
+std::wstring VCamCameraName(UINT camera);
+// Reads CameraCount from the main config key, clamped to [1, VCamMaxCameras].
+UINT VCamCameraCount();
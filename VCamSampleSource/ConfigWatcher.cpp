@@ -0,0 +1,82 @@
+#include "pch.h"
+#include "ConfigWatcher.h"
+
+RegistryConfigWatcher::~RegistryConfigWatcher()
+{
+	Stop();
+}
+
+HRESULT RegistryConfigWatcher::Start(const std::wstring& keyPath, std::function<void()> onChange)
+{
+	RETURN_HR_IF(E_INVALIDARG, !onChange);
+	std::lock_guard<std::mutex> lock(_controlLock);
+	if (_thread.joinable())
+	{
+		return S_FALSE;
+	}
+
+	wil::unique_hkey key;
+	RETURN_IF_WIN32_ERROR_MSG(RegOpenKeyExW(HKEY_LOCAL_MACHINE, keyPath.c_str(), 0, KEY_NOTIFY | KEY_READ, &key), "Cannot watch '%s'", keyPath.c_str());
+	RETURN_IF_FAILED(_changeEvent.create(wil::EventOptions::None));
+	RETURN_IF_FAILED(_stopEvent.create(wil::EventOptions::ManualReset));
+
+	_key = std::move(key);
+	_keyPath = keyPath;
+	_onChange = std::move(onChange);
+	_thread = std::thread(&RegistryConfigWatcher::WatchLoop, this);
+	WINTRACE(L"RegistryConfigWatcher::Start '%s'", _keyPath.c_str());
+	return S_OK;
+}
+
+void RegistryConfigWatcher::Stop()
+{
+	std::lock_guard<std::mutex> lock(_controlLock);
+	if (!_thread.joinable())
+	{
+		return;
+	}
+
+	_stopEvent.SetEvent();
+	_thread.join();
+	_key.reset();
+	_onChange = nullptr;
+	WINTRACE(L"RegistryConfigWatcher::Stop '%s'", _keyPath.c_str());
+}
+
+HRESULT RegistryConfigWatcher::Arm()
+{
+	// Registered from the watcher thread itself, which outlives every notification it asks for.
+	RETURN_IF_WIN32_ERROR(RegNotifyChangeKeyValue(_key.get(), FALSE, REG_NOTIFY_CHANGE_LAST_SET, _changeEvent.get(), TRUE));
+	return S_OK;
+}
+
+void RegistryConfigWatcher::WatchLoop()
+{
+	if (FAILED_LOG(Arm()))
+	{
+		return;
+	}
+
+	HANDLE waits[] = { _stopEvent.get(), _changeEvent.get() };
+	while (WaitForMultipleObjects(_countof(waits), waits, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+	{
+		// Keep re-arming until the key has been quiet for SettleMs.
+		auto result = WAIT_OBJECT_0 + 1;
+		while (result == WAIT_OBJECT_0 + 1)
+		{
+			if (FAILED_LOG(Arm()))
+			{
+				return;
+			}
+			result = WaitForMultipleObjects(_countof(waits), waits, FALSE, SettleMs);
+		}
+
+		if (result != WAIT_TIMEOUT)
+		{
+			return;
+		}
+
+		WINTRACE(L"RegistryConfigWatcher '%s' changed", _keyPath.c_str());
+		_onChange();
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Watches the values of an HKLM key (not its subkeys) and calls onChange on the watcher
+// thread once a burst of writes has been quiet for SettleMs, so a .reg import that sets
+// several values triggers one reload. Start and Stop may be called from different threads.
+class RegistryConfigWatcher
+{
+public:
+	~RegistryConfigWatcher();
+
+	// S_FALSE when already watching.
+	HRESULT Start(const std::wstring& keyPath, std::function<void()> onChange);
+	void Stop();
+	// Signaled by Stop before it joins; a long onChange should wait on it to return early.
+	HANDLE GetStopEvent() const { return _stopEvent.get(); }
+
+private:
+	HRESULT Arm();
+	void WatchLoop();
+
+	static constexpr DWORD SettleMs = 300;
+
+	// Serializes Start/Stop; never taken by the watcher thread.
+	std::mutex _controlLock;
+	std::wstring _keyPath;
+	std::function<void()> _onChange;
+	wil::unique_hkey _key;
+	wil::unique_event_nothrow _changeEvent;
+	wil::unique_event_nothrow _stopEvent;
+	std::thread _thread;
+};
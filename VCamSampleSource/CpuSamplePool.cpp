@@ -0,0 +1,340 @@
+#include "pch.h"
+#include "Tools.h"
+#include "CpuSamplePool.h"
+
+namespace
+{
+	// Private sample attribute tagging which Initialize generation a sample belongs to, so samples
+	// released after a Stop/Start cycle don't disturb the new pool's accounting.
+	// {5C7F3C1E-2B7A-4D43-9A55-0E6A2E1B7C31}
+	const GUID CpuSamplePool_Generation = { 0x5c7f3c1e, 0x2b7a, 0x4d43, { 0x9a, 0x55, 0x0e, 0x6a, 0x2e, 0x1b, 0x7c, 0x31 } };
+
+	// NV12 system-memory buffer laid out as Nv12BufferLayout describes. The producer writes through
+	// the 2D interfaces at the padded pitch; a 1D Lock hands out a packed copy (written back on
+	// the last Unlock) unless the pitch already equals the width, like MF's own 2D buffers.
+	struct PoolBuffer : winrt::implements<PoolBuffer, IMFMediaBuffer, IMF2DBuffer2>
+	{
+	public:
+		explicit PoolBuffer(const Nv12BufferLayout& layout) :
+			_layout(layout),
+			_length(layout.PitchedLength())
+		{
+		}
+
+		~PoolBuffer()
+		{
+			if (_data)
+			{
+				_aligned_free(_data);
+			}
+			if (_packed)
+			{
+				_aligned_free(_packed);
+			}
+		}
+
+		HRESULT Initialize()
+		{
+			_data = static_cast<BYTE*>(_aligned_malloc(_length, CpuSamplePool::Alignment));
+			RETURN_IF_NULL_ALLOC(_data);
+
+			// Pre-fault every page now (and start from black) so the first frames don't pay for it.
+			const auto lumaLength = static_cast<size_t>(_layout.pitch) * _layout.height;
+			memset(_data, 16, lumaLength);
+			memset(_data + lumaLength, 128, _length - lumaLength);
+			_currentLength = _layout.ContiguousLength();
+			return S_OK;
+		}
+
+		// IMFMediaBuffer
+		STDMETHODIMP Lock(BYTE** ppbBuffer, DWORD* pcbMaxLength, DWORD* pcbCurrentLength)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, ppbBuffer);
+			*ppbBuffer = nullptr;
+
+			std::lock_guard<std::mutex> lock(_lockState);
+			auto data = _data;
+			if (!_layout.IsContiguous())
+			{
+				if (!_lockCount)
+				{
+					// Allocated on the first 1D lock only; the 2D path never needs it.
+					if (!_packed)
+					{
+						_packed = static_cast<BYTE*>(_aligned_malloc(_layout.ContiguousLength(), CpuSamplePool::Alignment));
+						RETURN_IF_NULL_ALLOC(_packed);
+					}
+					_layout.Pack(_data, _packed);
+				}
+				data = _packed;
+			}
+			_lockCount++;
+
+			*ppbBuffer = data;
+			if (pcbMaxLength)
+			{
+				*pcbMaxLength = _layout.ContiguousLength();
+			}
+			if (pcbCurrentLength)
+			{
+				*pcbCurrentLength = _currentLength;
+			}
+			return S_OK;
+		}
+
+		STDMETHODIMP Unlock()
+		{
+			std::lock_guard<std::mutex> lock(_lockState);
+			RETURN_HR_IF(MF_E_INVALIDREQUEST, !_lockCount);
+			if (--_lockCount == 0 && !_layout.IsContiguous())
+			{
+				_layout.Unpack(_packed, _data);
+			}
+			return S_OK;
+		}
+
+		STDMETHODIMP GetCurrentLength(DWORD* pcbCurrentLength)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pcbCurrentLength);
+			*pcbCurrentLength = _currentLength;
+			return S_OK;
+		}
+
+		STDMETHODIMP SetCurrentLength(DWORD cbCurrentLength)
+		{
+			RETURN_HR_IF(E_INVALIDARG, cbCurrentLength > _layout.ContiguousLength());
+			_currentLength = cbCurrentLength;
+			return S_OK;
+		}
+
+		STDMETHODIMP GetMaxLength(DWORD* pcbMaxLength)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pcbMaxLength);
+			*pcbMaxLength = _layout.ContiguousLength();
+			return S_OK;
+		}
+
+		// IMF2DBuffer
+		STDMETHODIMP Lock2D(BYTE** ppbScanline0, LONG* plPitch)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, ppbScanline0);
+			RETURN_HR_IF_NULL(E_POINTER, plPitch);
+			*ppbScanline0 = _data;
+			*plPitch = static_cast<LONG>(_layout.pitch);
+			return S_OK;
+		}
+
+		STDMETHODIMP Unlock2D()
+		{
+			return S_OK;
+		}
+
+		STDMETHODIMP GetScanline0AndPitch(BYTE** pbScanline0, LONG* plPitch)
+		{
+			return Lock2D(pbScanline0, plPitch);
+		}
+
+		STDMETHODIMP IsContiguousFormat(BOOL* pfIsContiguous)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pfIsContiguous);
+			*pfIsContiguous = _layout.IsContiguous();
+			return S_OK;
+		}
+
+		STDMETHODIMP GetContiguousLength(DWORD* pcbLength)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pcbLength);
+			*pcbLength = _layout.ContiguousLength();
+			return S_OK;
+		}
+
+		STDMETHODIMP ContiguousCopyTo(BYTE* pbDestBuffer, DWORD cbDestBuffer)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pbDestBuffer);
+			RETURN_HR_IF(E_INVALIDARG, cbDestBuffer < _layout.ContiguousLength());
+			_layout.Pack(_data, pbDestBuffer);
+			return S_OK;
+		}
+
+		STDMETHODIMP ContiguousCopyFrom(const BYTE* pbSrcBuffer, DWORD cbSrcBuffer)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pbSrcBuffer);
+			RETURN_HR_IF(E_INVALIDARG, cbSrcBuffer < _layout.ContiguousLength());
+			_layout.Unpack(pbSrcBuffer, _data);
+			return S_OK;
+		}
+
+		// IMF2DBuffer2
+		STDMETHODIMP Lock2DSize(MF2DBuffer_LockFlags lockFlags, BYTE** ppbScanline0, LONG* plPitch, BYTE** ppbBufferStart, DWORD* pcbBufferLength)
+		{
+			UNREFERENCED_PARAMETER(lockFlags);
+			RETURN_IF_FAILED(Lock2D(ppbScanline0, plPitch));
+			if (ppbBufferStart)
+			{
+				*ppbBufferStart = _data;
+			}
+			if (pcbBufferLength)
+			{
+				*pcbBufferLength = _length;
+			}
+			return S_OK;
+		}
+
+		STDMETHODIMP Copy2DTo(IMF2DBuffer2* pDestBuffer)
+		{
+			RETURN_HR_IF_NULL(E_POINTER, pDestBuffer);
+			std::vector<BYTE> contiguous(_layout.ContiguousLength());
+			RETURN_IF_FAILED(ContiguousCopyTo(contiguous.data(), static_cast<DWORD>(contiguous.size())));
+			RETURN_HR(pDestBuffer->ContiguousCopyFrom(contiguous.data(), static_cast<DWORD>(contiguous.size())));
+		}
+
+	private:
+		const Nv12BufferLayout _layout;
+		const DWORD _length;
+		DWORD _currentLength = 0;
+		BYTE* _data = nullptr;
+		// 1D lock state: nesting count and the packed copy handed out while the pitch is padded.
+		std::mutex _lockState;
+		UINT _lockCount = 0;
+		BYTE* _packed = nullptr;
+	};
+}
+
+HRESULT CpuSamplePool::Initialize(UINT width, UINT height, UINT sampleCount)
+{
+	RETURN_HR_IF(E_INVALIDARG, !width || !height || (height & 1) || !sampleCount);
+
+	std::lock_guard<std::mutex> lock(_lock);
+	_freeSamples.clear();
+	_layout = Nv12BufferLayout::Aligned(width, height, Alignment);
+	_ledger.Reset(0);
+	RETURN_IF_FAILED(Resize_NoLock(sampleCount));
+
+	WINTRACE(L"CpuSamplePool::Initialize %ux%u pitch:%u length:%u samples:%u", _layout.width, _layout.height, _layout.pitch, _layout.PitchedLength(), _ledger.Target());
+	return S_OK;
+}
+
+HRESULT CpuSamplePool::Resize(UINT sampleCount)
+{
+	RETURN_HR_IF(E_INVALIDARG, !sampleCount);
+	std::lock_guard<std::mutex> lock(_lock);
+	RETURN_HR_IF(MF_E_NOT_INITIALIZED, !_ledger.IsInitialized());
+	RETURN_IF_FAILED(Resize_NoLock(sampleCount));
+	WINTRACE(L"CpuSamplePool::Resize samples:%u free:%zu outstanding:%u", _ledger.Target(), _freeSamples.size(), _ledger.Outstanding());
+	return S_OK;
+}
+
+HRESULT CpuSamplePool::Resize_NoLock(UINT sampleCount)
+{
+	auto delta = _ledger.Resize(sampleCount, _freeSamples.size());
+	for (; delta > 0; delta--)
+	{
+		wil::com_ptr_nothrow<IMFSample> sample;
+		RETURN_IF_FAILED(CreateSample(&sample));
+		_freeSamples.push_back(std::move(sample));
+	}
+	for (; delta < 0; delta++)
+	{
+		_freeSamples.pop_back();
+	}
+	return S_OK;
+}
+
+void CpuSamplePool::Uninitialize()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	// Outstanding samples are dropped (not recycled) when their owners release them.
+	_freeSamples.clear();
+	_ledger.Clear();
+}
+
+HRESULT CpuSamplePool::CreateSample(IMFSample** sample)
+{
+	auto buffer = winrt::make_self<PoolBuffer>(_layout);
+	RETURN_IF_FAILED(buffer->Initialize());
+
+	wil::com_ptr_nothrow<IMFTrackedSample> tracked;
+	RETURN_IF_FAILED(MFCreateTrackedSample(&tracked));
+
+	wil::com_ptr_nothrow<IMFSample> created;
+	RETURN_IF_FAILED(tracked->QueryInterface(IID_PPV_ARGS(&created)));
+	RETURN_IF_FAILED(created->AddBuffer(buffer.as<IMFMediaBuffer>().get()));
+	RETURN_IF_FAILED(created->SetUINT32(CpuSamplePool_Generation, _ledger.Generation()));
+	*sample = created.detach();
+	return S_OK;
+}
+
+HRESULT CpuSamplePool::AllocateSample(IMFSample** sample)
+{
+	RETURN_HR_IF_NULL(E_POINTER, sample);
+	*sample = nullptr;
+
+	wil::com_ptr_nothrow<IMFSample> allocated;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		RETURN_HR_IF(MF_E_NOT_INITIALIZED, !_ledger.IsInitialized());
+		if (_freeSamples.empty())
+		{
+			return MF_E_SAMPLEALLOCATOR_EMPTY;
+		}
+		allocated = std::move(_freeSamples.back());
+		_freeSamples.pop_back();
+		_ledger.OnAcquired();
+	}
+
+	// The tracked sample calls Invoke once, when its last external reference goes away.
+	wil::com_ptr_nothrow<IMFTrackedSample> tracked;
+	RETURN_IF_FAILED(allocated->QueryInterface(IID_PPV_ARGS(&tracked)));
+	RETURN_IF_FAILED(tracked->SetAllocator(this, nullptr));
+	*sample = allocated.detach();
+	return S_OK;
+}
+
+UINT CpuSamplePool::GetSampleCount()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _ledger.Target();
+}
+
+UINT CpuSamplePool::GetFreeSampleCount()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return static_cast<UINT>(_freeSamples.size());
+}
+
+UINT CpuSamplePool::GetOutstandingCount()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _ledger.Outstanding();
+}
+
+// IMFAsyncCallback
+STDMETHODIMP CpuSamplePool::GetParameters(DWORD* pdwFlags, DWORD* pdwQueue)
+{
+	UNREFERENCED_PARAMETER(pdwFlags);
+	UNREFERENCED_PARAMETER(pdwQueue);
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CpuSamplePool::Invoke(IMFAsyncResult* pAsyncResult)
+{
+	RETURN_HR_IF_NULL(E_POINTER, pAsyncResult);
+
+	wil::com_ptr_nothrow<IUnknown> object;
+	RETURN_IF_FAILED(pAsyncResult->GetObject(&object));
+	wil::com_ptr_nothrow<IMFSample> sample;
+	RETURN_IF_FAILED(object->QueryInterface(IID_PPV_ARGS(&sample)));
+
+	// Drop per-delivery state (token, flags) before the sample is handed out again.
+	UINT32 generation = 0;
+	std::ignore = sample->GetUINT32(CpuSamplePool_Generation, &generation);
+	LOG_IF_FAILED(sample->DeleteAllItems());
+
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_ledger.OnReturned(generation, _freeSamples.size()))
+	{
+		LOG_IF_FAILED(sample->SetUINT32(CpuSamplePool_Generation, generation));
+		_freeSamples.push_back(std::move(sample));
+	}
+	return S_OK;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "SamplePoolCore.h"
+
+// Source-owned pool of NV12 system-memory samples used instead of the FrameServer-provided
+// allocator (which may hand back GPU-backed surfaces). Buffers are 64-byte aligned, use a
+// 64-byte aligned pitch for 2D access (1D locks see packed rows, see SamplePoolCore.h) and are
+// pre-faulted at allocation; samples are IMFTrackedSample
+// instances that return to the free list when the consumer releases them, so steady-state
+// delivery allocates nothing.
+struct CpuSamplePool : winrt::implements<CpuSamplePool, IMFAsyncCallback>
+{
+public:
+	// IMFAsyncCallback
+	STDMETHOD(GetParameters)(DWORD* pdwFlags, DWORD* pdwQueue);
+	STDMETHOD(Invoke)(IMFAsyncResult* pAsyncResult);
+
+public:
+	static constexpr UINT Alignment = 64;
+
+	HRESULT Initialize(UINT width, UINT height, UINT sampleCount);
+	void Uninitialize();
+	// Grows by allocating new samples; shrinks by trimming free ones and dropping returns.
+	HRESULT Resize(UINT sampleCount);
+	HRESULT AllocateSample(IMFSample** sample);
+
+	UINT GetPitch() const { return _layout.pitch; }
+	DWORD GetBufferLength() const { return _layout.PitchedLength(); }
+	UINT GetSampleCount();
+	UINT GetFreeSampleCount();
+	UINT GetOutstandingCount();
+
+private:
+	HRESULT CreateSample(IMFSample** sample);
+	HRESULT Resize_NoLock(UINT sampleCount);
+
+private:
+	std::mutex _lock;
+	Nv12BufferLayout _layout;
+	SamplePoolLedger _ledger;
+	std::vector<wil::com_ptr_nothrow<IMFSample>> _freeSamples;
+};
@@ -2,6 +2,10 @@
 #include "Tools.h"
 #include "EnumNames.h"
 
+#include <algorithm>
+#include <array>
+#include <string_view>
+
 struct DWORDAndNameW
 {
 	DWORD dw;
@@ -17,9 +21,52 @@ struct DWORDAndNameA
 #define ID_AND_NAME_W(x) { (DWORD)x, L#x }
 #define ID_AND_NAME_A(x) { (DWORD)x, #x }
 
-static DWORDAndNameA __WM[] =
+// Name table sorted by value at compile time. Values that form a contiguous range are looked up
+// by index, others by binary search; names are views over the string literals.
+template<typename Entry, size_t N>
+class EnumNameTable
+{
+public:
+	using Char = std::remove_cv_t<std::remove_pointer_t<decltype(Entry::name)>>;
+
+	consteval EnumNameTable(const Entry(&entries)[N])
+	{
+		std::copy(std::begin(entries), std::end(entries), _entries.begin());
+		std::sort(_entries.begin(), _entries.end(), [](const Entry& left, const Entry& right) { return left.dw < right.dw; });
+		_dense = _entries[N - 1].dw - _entries[0].dw == N - 1;
+	}
+
+	consteval bool IsUnique() const
+	{
+		return std::adjacent_find(_entries.begin(), _entries.end(), [](const Entry& left, const Entry& right) { return left.dw == right.dw; }) == _entries.end();
+	}
+
+	constexpr std::basic_string_view<Char> Find(DWORD value) const
+	{
+		if (_dense)
+		{
+			// Values below the first one wrap around and fail the bound check.
+			const auto index = static_cast<size_t>(value - _entries[0].dw);
+			return index < N ? _entries[index].name : std::basic_string_view<Char>();
+		}
+
+		const auto it = std::lower_bound(_entries.begin(), _entries.end(), value, [](const Entry& entry, DWORD v) { return entry.dw < v; });
+		return it != _entries.end() && it->dw == value ? it->name : std::basic_string_view<Char>();
+	}
+
+	const std::array<Entry, N>& Entries() const { return _entries; }
+
+private:
+	std::array<Entry, N> _entries{};
+	bool _dense = false;
+};
+
+#define ENUM_NAME_TABLE(table, entries) \
+	static constexpr EnumNameTable table(entries); \
+	static_assert(table.IsUnique(), #entries " lists the same value twice")
+
+static constexpr DWORDAndNameA __WM[] =
 {
-	ID_AND_NAME_A(WM_CREATE),
 	ID_AND_NAME_A(WM_NULL),
 	ID_AND_NAME_A(WM_CREATE),
 	ID_AND_NAME_A(WM_DELETEITEM),
@@ -255,12 +302,11 @@ static DWORDAndNameA __WM[] =
 	ID_AND_NAME_A(WM_DWMSENDICONICLIVEPREVIEWBITMAP),
 };
 
-static DWORDAndNameW __KSPROPERTY_TYPE[]
+static constexpr DWORDAndNameW __KSPROPERTY_TYPE[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_TYPE_GET),
 	ID_AND_NAME_W(KSPROPERTY_TYPE_GETPAYLOADSIZE),
 	ID_AND_NAME_W(KSPROPERTY_TYPE_SET),
-	ID_AND_NAME_W(KSPROPERTY_TYPE_GETPAYLOADSIZE),
 	ID_AND_NAME_W(KSPROPERTY_TYPE_SETSUPPORT),
 	ID_AND_NAME_W(KSPROPERTY_TYPE_BASICSUPPORT),
 	ID_AND_NAME_W(KSPROPERTY_TYPE_RELATIONS),
@@ -276,7 +322,7 @@ static DWORDAndNameW __KSPROPERTY_TYPE[]
 	ID_AND_NAME_W(KSPROPERTY_TYPE_COPYPAYLOAD),
 };
 
-static DWORDAndNameW __KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY[]
+static constexpr DWORDAndNameW __KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_EXTENDED_PHOTOMODE),
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_EXTENDED_PHOTOFRAMERATE),
@@ -324,7 +370,7 @@ static DWORDAndNameW __KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY[]
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_EXTENDED_DIGITALWINDOW),
 };
 
-static DWORDAndNameW __KSPROPERTY_VIDCAP_CAMERACONTROL[]
+static constexpr DWORDAndNameW __KSPROPERTY_VIDCAP_CAMERACONTROL[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_PAN),
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_TILT),
@@ -348,7 +394,7 @@ static DWORDAndNameW __KSPROPERTY_VIDCAP_CAMERACONTROL[]
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_AUTO_EXPOSURE_PRIORITY),
 };
 
-static DWORDAndNameW __KSPROPERTY_VIDCAP_VIDEOPROCAMP[]
+static constexpr DWORDAndNameW __KSPROPERTY_VIDCAP_VIDEOPROCAMP[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_VIDEOPROCAMP_BRIGHTNESS),
 	ID_AND_NAME_W(KSPROPERTY_VIDEOPROCAMP_CONTRAST),
@@ -366,24 +412,24 @@ static DWORDAndNameW __KSPROPERTY_VIDCAP_VIDEOPROCAMP[]
 	ID_AND_NAME_W(KSPROPERTY_VIDEOPROCAMP_POWERLINE_FREQUENCY),
 };
 
-static DWORDAndNameW __KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY[]
+static constexpr DWORDAndNameW __KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_CAPABILITY),
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_SET),
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_CLEAR),
 };
 
-static DWORDAndNameW __KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST[]
+static constexpr DWORDAndNameW __KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_PROPERTY_ID),
 };
 
-static DWORDAndNameW __KSPROPERTY_CAMERACONTROL_IMAGE_PIN_CAPABILITY[]
+static constexpr DWORDAndNameW __KSPROPERTY_CAMERACONTROL_IMAGE_PIN_CAPABILITY[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_CAMERACONTROL_IMAGE_PIN_CAPABILITY_PROPERTY_ID),
 };
 
-static DWORDAndNameW __KSPROPERTY_TOPOLOGY[]
+static constexpr DWORDAndNameW __KSPROPERTY_TOPOLOGY[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_TOPOLOGY_CATEGORIES),
 	ID_AND_NAME_W(KSPROPERTY_TOPOLOGY_NODES),
@@ -391,7 +437,7 @@ static DWORDAndNameW __KSPROPERTY_TOPOLOGY[]
 	ID_AND_NAME_W(KSPROPERTY_TOPOLOGY_NAME),
 };
 
-static DWORDAndNameW __KSPROPERTY_PIN[]
+static constexpr DWORDAndNameW __KSPROPERTY_PIN[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_PIN_CINSTANCES),
 	ID_AND_NAME_W(KSPROPERTY_PIN_CTYPES),
@@ -412,7 +458,7 @@ static DWORDAndNameW __KSPROPERTY_PIN[]
 	ID_AND_NAME_W(KSPROPERTY_PIN_MODEDATAFORMATS),
 };
 
-static DWORDAndNameW __KSPROPERTY_CONNECTION[]
+static constexpr DWORDAndNameW __KSPROPERTY_CONNECTION[] =
 {
 	ID_AND_NAME_W(KSPROPERTY_CONNECTION_STATE),
 	ID_AND_NAME_W(KSPROPERTY_CONNECTION_PRIORITY),
@@ -424,7 +470,7 @@ static DWORDAndNameW __KSPROPERTY_CONNECTION[]
 	ID_AND_NAME_W(KSPROPERTY_CONNECTION_STARTAT),
 };
 
-static DWORDAndNameW __MF_ATTRIBUTE_TYPE[]
+static constexpr DWORDAndNameW __MF_ATTRIBUTE_TYPE[] =
 {
 	ID_AND_NAME_W(MF_ATTRIBUTE_UINT32),
 	ID_AND_NAME_W(MF_ATTRIBUTE_UINT64),
@@ -435,7 +481,7 @@ static DWORDAndNameW __MF_ATTRIBUTE_TYPE[]
 	ID_AND_NAME_W(MF_ATTRIBUTE_IUNKNOWN),
 };
 
-static DWORDAndNameW __VARTYPE[] =
+static constexpr DWORDAndNameW __VARTYPE[] =
 {
 	ID_AND_NAME_W(VT_EMPTY),
 	ID_AND_NAME_W(VT_NULL),
@@ -483,103 +529,72 @@ static DWORDAndNameW __VARTYPE[] =
 	ID_AND_NAME_W(VT_VERSIONED_STREAM),
 };
 
-static const std::wstring ToString(DWORDAndNameW* def, UINT defLen, DWORD value, bool flags = FALSE);
-static const std::string ToString(DWORDAndNameA* def, UINT defLen, DWORD value, bool flags = FALSE);
-static const std::wstring ToString(DWORDAndNameW* def, UINT defLen, DWORD value, bool flags)
+ENUM_NAME_TABLE(WmNames, __WM);
+ENUM_NAME_TABLE(KsPropertyTypeNames, __KSPROPERTY_TYPE);
+ENUM_NAME_TABLE(ExtendedPropertyNames, __KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY);
+ENUM_NAME_TABLE(CameraControlNames, __KSPROPERTY_VIDCAP_CAMERACONTROL);
+ENUM_NAME_TABLE(VideoProcAmpNames, __KSPROPERTY_VIDCAP_VIDEOPROCAMP);
+ENUM_NAME_TABLE(PerFrameSettingNames, __KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY);
+ENUM_NAME_TABLE(RegionOfInterestNames, __KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST);
+ENUM_NAME_TABLE(ImagePinCapabilityNames, __KSPROPERTY_CAMERACONTROL_IMAGE_PIN_CAPABILITY);
+ENUM_NAME_TABLE(TopologyNames, __KSPROPERTY_TOPOLOGY);
+ENUM_NAME_TABLE(PinNames, __KSPROPERTY_PIN);
+ENUM_NAME_TABLE(ConnectionNames, __KSPROPERTY_CONNECTION);
+ENUM_NAME_TABLE(AttributeTypeNames, __MF_ATTRIBUTE_TYPE);
+ENUM_NAME_TABLE(VarTypeNames, __VARTYPE);
+
+static const std::wstring ToString(std::wstring_view name, DWORD value)
 {
-	if (!def)
-		return L"???";
+	return name.empty() ? std::to_wstring(value) : std::wstring(name);
+}
 
-	std::wstring str;
-	if (flags)
-	{
-		for (DWORD i = 0; i < defLen; i++)
-		{
-			if (def[i].dw == 0 || (value & def[i].dw) == def[i].dw)
-			{
-				if (!str.empty())
-				{
-					str.append(L" | ");
-				}
-				str.append(def[i].name);
-			}
-		}
-	}
-	else
-	{
-		for (DWORD i = 0; i < defLen; i++)
-		{
-			if (value == def[i].dw)
-			{
-				str.append(def[i].name);
-				break;
-			}
-		}
-	}
+std::wstring_view KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY_Name(ULONG value) { return ExtendedPropertyNames.Find(value); }
+std::wstring_view PROPSETID_VIDCAP_CAMERACONTROL_Name(ULONG value) { return CameraControlNames.Find(value); }
+std::wstring_view PROPSETID_VIDCAP_VIDEOPROCAMP_Name(ULONG value) { return VideoProcAmpNames.Find(value); }
+std::wstring_view PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY_Name(ULONG value) { return ImagePinCapabilityNames.Find(value); }
+std::wstring_view KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY_Name(ULONG value) { return PerFrameSettingNames.Find(value); }
+std::wstring_view KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_Name(ULONG value) { return RegionOfInterestNames.Find(value); }
+std::wstring_view KSPROPERTY_TOPOLOGY_Name(ULONG value) { return TopologyNames.Find(value); }
+std::wstring_view KSPROPERTY_PIN_Name(ULONG value) { return PinNames.Find(value); }
+std::wstring_view KSPROPSETID_Connection_Name(ULONG value) { return ConnectionNames.Find(value); }
 
-	if (str.empty())
-	{
-		str.append(std::to_wstring(value));
-	}
-	return str;
-}
+const std::wstring KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY_ToString(ULONG value) { return ToString(ExtendedPropertyNames.Find(value), value); }
+const std::wstring PROPSETID_VIDCAP_CAMERACONTROL_ToString(ULONG value) { return ToString(CameraControlNames.Find(value), value); }
+const std::wstring PROPSETID_VIDCAP_VIDEOPROCAMP_ToString(ULONG value) { return ToString(VideoProcAmpNames.Find(value), value); }
+const std::wstring KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY_ToString(ULONG value) { return ToString(PerFrameSettingNames.Find(value), value); }
+const std::wstring KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_ToString(ULONG value) { return ToString(RegionOfInterestNames.Find(value), value); }
+const std::wstring PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY_ToString(ULONG value) { return ToString(ImagePinCapabilityNames.Find(value), value); }
+const std::wstring KSPROPERTY_TOPOLOGY_ToString(ULONG value) { return ToString(TopologyNames.Find(value), value); }
+const std::wstring KSPROPERTY_PIN_ToString(ULONG value) { return ToString(PinNames.Find(value), value); }
+const std::wstring KSPROPSETID_Connection_ToString(ULONG value) { return ToString(ConnectionNames.Find(value), value); }
 
-static const std::string ToString(DWORDAndNameA* def, UINT defLen, DWORD value, bool flags)
+const std::wstring KSPROPERTY_TYPE_ToString(ULONG value)
 {
-	if (!def)
-		return "???";
-
-	std::string str;
-	if (flags)
-	{
-		for (DWORD i = 0; i < defLen; i++)
-		{
-			if (def[i].dw == 0 || (value & def[i].dw) == def[i].dw)
-			{
-				if (!str.empty())
-				{
-					str.append(" | ");
-				}
-				str.append(def[i].name);
-			}
-		}
-	}
-	else
+	std::wstring str;
+	for (const auto& entry : KsPropertyTypeNames.Entries())
 	{
-		for (DWORD i = 0; i < defLen; i++)
+		if (entry.dw == 0 || (value & entry.dw) == entry.dw)
 		{
-			if (value == def[i].dw)
+			if (!str.empty())
 			{
-				str.append(def[i].name);
-				break;
+				str.append(L" | ");
 			}
+			str.append(entry.name);
 		}
 	}
+	return str.empty() ? std::to_wstring(value) : str;
+}
 
-	if (str.empty())
-	{
-		str.append(std::to_string(value));
-	}
-	return str;
+const std::wstring MF_ATTRIBUTE_TYPE_ToString(MF_ATTRIBUTE_TYPE value) { return ToString(AttributeTypeNames.Find(value), value); }
+const std::string WM_ToString(UINT msg)
+{
+	const auto name = WmNames.Find(msg);
+	return name.empty() ? std::to_string(msg) : std::string(name);
 }
 
-const std::wstring KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY_ToString(ULONG value) { return ToString(__KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY, sizeof(__KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY) / sizeof(DWORDAndNameA), value); }
-const std::wstring PROPSETID_VIDCAP_CAMERACONTROL_ToString(ULONG value) { return ToString(__KSPROPERTY_VIDCAP_CAMERACONTROL, sizeof(__KSPROPERTY_VIDCAP_CAMERACONTROL) / sizeof(DWORDAndNameA), value); }
-const std::wstring PROPSETID_VIDCAP_VIDEOPROCAMP_ToString(ULONG value) { return ToString(__KSPROPERTY_VIDCAP_VIDEOPROCAMP, sizeof(__KSPROPERTY_VIDCAP_VIDEOPROCAMP) / sizeof(DWORDAndNameA), value); }
-const std::wstring KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY_ToString(ULONG value) { return ToString(__KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY, sizeof(__KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY) / sizeof(DWORDAndNameA), value); }
-const std::wstring KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_ToString(ULONG value) { return ToString(__KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST, sizeof(__KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST) / sizeof(DWORDAndNameA), value); }
-const std::wstring PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY_ToString(ULONG value) { return ToString(__KSPROPERTY_CAMERACONTROL_IMAGE_PIN_CAPABILITY, sizeof(__KSPROPERTY_CAMERACONTROL_IMAGE_PIN_CAPABILITY) / sizeof(DWORDAndNameA), value); }
-const std::wstring KSPROPERTY_TOPOLOGY_ToString(ULONG value) { return ToString(__KSPROPERTY_TOPOLOGY, sizeof(__KSPROPERTY_TOPOLOGY) / sizeof(DWORDAndNameA), value); }
-const std::wstring KSPROPERTY_PIN_ToString(ULONG value) { return ToString(__KSPROPERTY_PIN, sizeof(__KSPROPERTY_PIN) / sizeof(DWORDAndNameA), value); }
-const std::wstring KSPROPSETID_Connection_ToString(ULONG value) { return ToString(__KSPROPERTY_CONNECTION, sizeof(__KSPROPERTY_CONNECTION) / sizeof(DWORDAndNameA), value); }
-
-const std::wstring KSPROPERTY_TYPE_ToString(ULONG value) { return ToString(__KSPROPERTY_TYPE, sizeof(__KSPROPERTY_TYPE) / sizeof(DWORDAndNameA), value, true); }
-const std::wstring MF_ATTRIBUTE_TYPE_ToString(MF_ATTRIBUTE_TYPE value) { return ToString(__MF_ATTRIBUTE_TYPE, sizeof(__MF_ATTRIBUTE_TYPE) / sizeof(DWORDAndNameA), value); }
-const std::string WM_ToString(UINT msg) { return ToString(__WM, sizeof(__WM) / sizeof(DWORDAndNameA), msg); }
 const std::wstring VARTYPE_ToString(VARTYPE value)
 {
-	auto type = value & VT_TYPEMASK;
-	auto str = ToString(__VARTYPE, sizeof(__VARTYPE) / sizeof(DWORDAndNameW), value);
+	auto str = ToString(VarTypeNames.Find(value), value);
 	if (value & VT_VECTOR)
 	{
 		str += L"VT_VECTOR";
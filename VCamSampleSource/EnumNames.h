@@ -14,4 +14,15 @@ const std::wstring KSPROPERTY_TOPOLOGY_ToString(ULONG value);
 const std::wstring KSPROPERTY_PIN_ToString(ULONG value);
 const std::wstring KSPROPSETID_Connection_ToString(ULONG value);
 
+// Same lookups without allocating: views over the names, empty when the value is not known.
+std::wstring_view KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY_Name(ULONG value);
+std::wstring_view PROPSETID_VIDCAP_CAMERACONTROL_Name(ULONG value);
+std::wstring_view PROPSETID_VIDCAP_VIDEOPROCAMP_Name(ULONG value);
+std::wstring_view PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY_Name(ULONG value);
+std::wstring_view KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY_Name(ULONG value);
+std::wstring_view KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_Name(ULONG value);
+std::wstring_view KSPROPERTY_TOPOLOGY_Name(ULONG value);
+std::wstring_view KSPROPERTY_PIN_Name(ULONG value);
+std::wstring_view KSPROPSETID_Connection_Name(ULONG value);
+
 
@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "FrameRecording.h"
+#include "FrameRecorder.h"
+
+FrameRecorder::~FrameRecorder()
+{
+	Close();
+}
+
+HRESULT FrameRecorder::Open(const std::wstring& path, UINT width, UINT height, UINT fpsNumerator, UINT fpsDenominator, UINT maxFrames)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	RETURN_HR_IF(E_INVALIDARG, path.empty() || !width || !height || !maxFrames);
+	Close_NoLock();
+
+	VCamRecordingHeader header{};
+	const auto fileSize = VCamRecordingInitHeader(&header, width, height, fpsNumerator, fpsDenominator, maxFrames);
+	RETURN_HR_IF(E_INVALIDARG, !fileSize);
+
+	_file.reset(CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+	RETURN_LAST_ERROR_IF(!_file);
+
+	ULARGE_INTEGER size{};
+	size.QuadPart = fileSize;
+	_mapping.reset(CreateFileMappingW(_file.get(), nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr));
+	if (!_mapping)
+	{
+		const auto hr = HRESULT_FROM_WIN32(GetLastError());
+		Close_NoLock();
+		RETURN_HR_MSG(hr, "Cannot map recording '%s' size:%llu", path.c_str(), fileSize);
+	}
+
+	_view = static_cast<BYTE*>(MapViewOfFile(_mapping.get(), FILE_MAP_WRITE, 0, 0, 0));
+	if (!_view)
+	{
+		const auto hr = HRESULT_FROM_WIN32(GetLastError());
+		Close_NoLock();
+		RETURN_HR(hr);
+	}
+
+	_path = path;
+	_header = reinterpret_cast<VCamRecordingHeader*>(_view);
+	memcpy(_header, &header, sizeof(header));
+	_firstArrivalTime = 0;
+	_fullLogged = false;
+	WINTRACE(L"FrameRecorder::Open '%s' %ux%u capacity:%u size:%llu", path.c_str(), width, height, maxFrames, fileSize);
+	return S_OK;
+}
+
+bool FrameRecorder::Append(const BYTE* data, LONG stride, LONGLONG arrivalTime)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (!_header || !data)
+	{
+		return false;
+	}
+
+	const auto count = _header->frameCount;
+	if (!count)
+	{
+		_firstArrivalTime = arrivalTime;
+	}
+
+	if (!VCamRecordingAppendFrame(_header, _view, data, stride, static_cast<uint64_t>(arrivalTime - _firstArrivalTime)))
+	{
+		if (!_fullLogged)
+		{
+			_fullLogged = true;
+			WINTRACE(L"FrameRecorder '%s' is full after %u frames", _path.c_str(), count);
+		}
+		return false;
+	}
+	return true;
+}
+
+void FrameRecorder::Close()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	Close_NoLock();
+}
+
+void FrameRecorder::Close_NoLock()
+{
+	uint64_t usedSize = 0;
+	UINT frames = 0;
+	if (_header)
+	{
+		frames = _header->frameCount;
+		usedSize = VCamRecordingFrameOffset(_header, frames);
+	}
+
+	if (_view)
+	{
+		FlushViewOfFile(_view, 0);
+		UnmapViewOfFile(_view);
+		_view = nullptr;
+		_header = nullptr;
+	}
+	_mapping.reset();
+
+	if (_file)
+	{
+		// Drop the preallocated but unused tail.
+		LARGE_INTEGER end{};
+		end.QuadPart = static_cast<LONGLONG>(usedSize);
+		if (usedSize && SetFilePointerEx(_file.get(), end, nullptr, FILE_BEGIN))
+		{
+			SetEndOfFile(_file.get());
+		}
+		_file.reset();
+		WINTRACE(L"FrameRecorder::Close '%s' frames:%u", _path.c_str(), frames);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+struct VCamRecordingHeader;
+
+// Appends delivered NV12 frames and their arrival times to a memory-mapped recording file
+// (see FrameRecording.h). The file is preallocated for maxFrames so recording never grows or
+// remaps it, and trimmed to the recorded frames on Close. Thread-safe.
+class FrameRecorder
+{
+public:
+	~FrameRecorder();
+
+	HRESULT Open(const std::wstring& path, UINT width, UINT height, UINT fpsNumerator, UINT fpsDenominator, UINT maxFrames);
+	void Close();
+	// Returns false when not open or once the file is full.
+	bool Append(const BYTE* data, LONG stride, LONGLONG arrivalTime);
+
+private:
+	void Close_NoLock();
+
+	std::mutex _lock;
+	std::wstring _path;
+	wil::unique_hfile _file;
+	wil::unique_handle _mapping;
+	BYTE* _view = nullptr;
+	VCamRecordingHeader* _header = nullptr;
+	LONGLONG _firstArrivalTime = 0;
+	bool _fullLogged = false;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+#include <atomic>
+#define VCAM_RECORDING_RELEASE_FENCE() std::atomic_thread_fence(std::memory_order_release)
+#else
+#include <stdatomic.h>
+#define VCAM_RECORDING_RELEASE_FENCE() atomic_thread_fence(memory_order_release)
+#endif
+
+// Raw frame recording container written by FrameRecorder and played back by
+// ReplayFrameSource. Plain C types only so offline tools on any OS can read it.
+//
+// [VCamRecordingHeader][VCamRecordingIndexEntry x frameCapacity][pad][frame 0][frame 1]...
+// Frames are packed NV12 (stride == width), frameSize bytes each, starting at dataOffset.
+// frameCount is published after the frame data and index entry are written, so a file
+// truncated by a crash still holds frameCount complete frames.
+
+#define VCAM_RECORDING_MAGIC 0x46524356u // "VCRF"
+#define VCAM_RECORDING_VERSION 1u
+#define VCAM_RECORDING_ALIGNMENT 4096u
+
+typedef struct VCamRecordingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+	uint32_t frameCapacity;
+	volatile uint32_t frameCount;
+	uint64_t frameSize;
+	uint64_t indexOffset;
+	uint64_t dataOffset;
+	uint8_t reserved[16];
+} VCamRecordingHeader;
+
+typedef struct VCamRecordingIndexEntry
+{
+	// Arrival time in 100ns units relative to the first recorded frame.
+	uint64_t arrivalTime;
+	uint64_t dataOffset;
+} VCamRecordingIndexEntry;
+
+// Header fields a reader uses, copied once and validated by VCamRecordingReadLayout.
+typedef struct VCamRecordingLayout
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+	uint32_t frameCount;
+	uint64_t frameSize;
+	uint64_t indexOffset;
+} VCamRecordingLayout;
+
+static inline uint64_t VCamRecordingAlignUp(uint64_t value)
+{
+	return (value + VCAM_RECORDING_ALIGNMENT - 1) / VCAM_RECORDING_ALIGNMENT * VCAM_RECORDING_ALIGNMENT;
+}
+
+// Offset at which the writer places frame number frame.
+static inline uint64_t VCamRecordingFrameOffset(const volatile VCamRecordingHeader* header, uint32_t frame)
+{
+	return header->dataOffset + VCamRecordingAlignUp(header->frameSize) * frame;
+}
+
+// Fills the header of an empty recording with room for frameCapacity frames and returns the
+// file size that needs, or 0 when the dimensions are not even or the file would not fit 64 bits.
+static inline uint64_t VCamRecordingInitHeader(VCamRecordingHeader* header, uint32_t width, uint32_t height, uint32_t fpsNumerator, uint32_t fpsDenominator, uint32_t frameCapacity)
+{
+	uint64_t pixels;
+	uint64_t slotSize;
+	uint64_t dataOffset;
+	unsigned i;
+	pixels = (uint64_t)width * height;
+	if (!width || !height || (width & 1) || (height & 1) || !frameCapacity || pixels > UINT64_MAX / 3 - VCAM_RECORDING_ALIGNMENT)
+	{
+		return 0;
+	}
+
+	slotSize = VCamRecordingAlignUp(pixels * 3 / 2);
+	dataOffset = VCamRecordingAlignUp(sizeof(VCamRecordingHeader) + sizeof(VCamRecordingIndexEntry) * (uint64_t)frameCapacity);
+	if (slotSize > (UINT64_MAX - dataOffset) / frameCapacity)
+	{
+		return 0;
+	}
+
+	header->magic = VCAM_RECORDING_MAGIC;
+	header->version = VCAM_RECORDING_VERSION;
+	header->width = width;
+	header->height = height;
+	header->fpsNumerator = fpsNumerator;
+	header->fpsDenominator = fpsDenominator;
+	header->frameCapacity = frameCapacity;
+	header->frameCount = 0;
+	header->frameSize = pixels * 3 / 2;
+	header->indexOffset = sizeof(VCamRecordingHeader);
+	header->dataOffset = dataOffset;
+	for (i = 0; i < sizeof(header->reserved); i++)
+	{
+		header->reserved[i] = 0;
+	}
+	return dataOffset + slotSize * frameCapacity;
+}
+
+// Writes the next frame of a recording mapped at view: height * 3 / 2 rows of width bytes, stride
+// apart in data (Y rows then UV rows), and its arrival time in 100ns units relative to the first
+// frame. The index entry is filled before frameCount is published, so a reader never sees a
+// frame that is not complete. Returns 0 once the recording is full.
+static inline int VCamRecordingAppendFrame(volatile VCamRecordingHeader* header, uint8_t* view, const uint8_t* data, ptrdiff_t stride, uint64_t arrivalTime)
+{
+	uint32_t count;
+	uint32_t width;
+	uint32_t rows;
+	uint32_t row;
+	uint64_t offset;
+	VCamRecordingIndexEntry* entry;
+	count = header->frameCount;
+	if (count >= header->frameCapacity)
+	{
+		return 0;
+	}
+
+	width = header->width;
+	rows = header->height * 3 / 2;
+	offset = VCamRecordingFrameOffset(header, count);
+	for (row = 0; row < rows; row++)
+	{
+		memcpy(view + offset + (size_t)row * width, data + (ptrdiff_t)row * stride, width);
+	}
+
+	entry = (VCamRecordingIndexEntry*)(view + header->indexOffset) + count;
+	entry->arrivalTime = arrivalTime;
+	entry->dataOffset = offset;
+	VCAM_RECORDING_RELEASE_FENCE();
+	header->frameCount = count + 1;
+	return 1;
+}
+
+// Copies the layout out of a recording of fileSize bytes and checks that the header describes
+// whole NV12 frames and that the index of frameCount entries fits in the file. Returns 0 (and
+// leaves *layout unspecified) when the file is not a usable recording.
+static inline int VCamRecordingReadLayout(const volatile VCamRecordingHeader* header, uint64_t fileSize, VCamRecordingLayout* layout)
+{
+	uint64_t pixels;
+	if (fileSize < sizeof(VCamRecordingHeader) || header->magic != VCAM_RECORDING_MAGIC || header->version != VCAM_RECORDING_VERSION)
+	{
+		return 0;
+	}
+
+	layout->width = header->width;
+	layout->height = header->height;
+	layout->fpsNumerator = header->fpsNumerator;
+	layout->fpsDenominator = header->fpsDenominator;
+	layout->frameCount = header->frameCount;
+	layout->frameSize = header->frameSize;
+	layout->indexOffset = header->indexOffset;
+
+	if (!layout->width || !layout->height || (layout->width & 1) || (layout->height & 1) ||
+		!layout->frameCount || layout->frameCount > header->frameCapacity)
+	{
+		return 0;
+	}
+
+	// A frame must fit in the file, which bounds the pixel count before it is scaled by 3/2.
+	pixels = (uint64_t)layout->width * layout->height;
+	if (layout->frameSize > fileSize || pixels > layout->frameSize || layout->frameSize - pixels < pixels / 2)
+	{
+		return 0;
+	}
+
+	return layout->indexOffset <= fileSize &&
+		layout->frameCount <= (fileSize - layout->indexOffset) / sizeof(VCamRecordingIndexEntry);
+}
+
+// Returns how many leading index entries point at a complete frame inside the file; anything
+// less than layout->frameCount means the recording is truncated or its index is damaged.
+static inline uint32_t VCamRecordingCountFrames(const VCamRecordingIndexEntry* index, const VCamRecordingLayout* layout, uint64_t fileSize)
+{
+	uint32_t i;
+	for (i = 0; i < layout->frameCount; i++)
+	{
+		if (index[i].dataOffset > fileSize || layout->frameSize > fileSize - index[i].dataOffset)
+		{
+			break;
+		}
+	}
+	return i;
+}
+
+#ifdef __cplusplus
+static_assert(sizeof(VCamRecordingHeader) == 72, "recording header layout");
+static_assert(sizeof(VCamRecordingIndexEntry) == 16, "recording index layout");
+#endif
@@ -0,0 +1,210 @@
+#include "FrameScaler.h"
+
+#include <algorithm>
+#include <cstring>
+
+void NV12Scaler::SetOutputSize(uint32_t width, uint32_t height)
+{
+	if (width == _outputWidth && height == _outputHeight)
+	{
+		return;
+	}
+
+	_outputWidth = width;
+	_outputHeight = height;
+	_sourceWidth = 0;
+	_sourceHeight = 0;
+}
+
+void NV12Scaler::SetLetterbox(bool letterbox)
+{
+	if (letterbox == _letterbox)
+	{
+		return;
+	}
+
+	_letterbox = letterbox;
+	_sourceWidth = 0;
+	_sourceHeight = 0;
+}
+
+void NV12Scaler::BuildTaps(uint32_t sourceSize, uint32_t outputSize, uint32_t channels, std::vector<Tap>* taps)
+{
+	taps->resize(outputSize);
+	const auto last = sourceSize ? sourceSize - 1 : 0;
+	for (uint32_t i = 0; i < outputSize; i++)
+	{
+		// Center-aligned sample position in 16.16 fixed point.
+		auto position = static_cast<int64_t>((2 * static_cast<uint64_t>(i) + 1) * sourceSize * 65536 / (2 * static_cast<uint64_t>(outputSize))) - 32768;
+		if (position < 0)
+		{
+			position = 0;
+		}
+
+		auto index = static_cast<uint32_t>(position >> 16);
+		auto weight = static_cast<uint32_t>((position >> 8) & 0xFF);
+		if (index >= last)
+		{
+			index = last;
+			weight = 0;
+		}
+
+		auto& tap = (*taps)[i];
+		tap.index0 = index * channels;
+		tap.index1 = (index < last ? index + 1 : index) * channels;
+		tap.weight = weight;
+	}
+}
+
+void NV12Scaler::ScalePlane(
+	const uint8_t* source,
+	ptrdiff_t sourceStride,
+	uint8_t* destination,
+	ptrdiff_t destinationStride,
+	const std::vector<Tap>& columns,
+	const std::vector<Tap>& rows,
+	uint32_t channels)
+{
+	for (size_t y = 0; y < rows.size(); y++)
+	{
+		const auto& row = rows[y];
+		const auto top = source + static_cast<ptrdiff_t>(row.index0) * sourceStride;
+		const auto bottom = source + static_cast<ptrdiff_t>(row.index1) * sourceStride;
+		const auto wy = row.weight;
+		auto output = destination + static_cast<ptrdiff_t>(y) * destinationStride;
+		for (const auto& column : columns)
+		{
+			const auto wx = column.weight;
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				const uint32_t t = top[column.index0 + c] * (256 - wx) + top[column.index1 + c] * wx;
+				const uint32_t b = bottom[column.index0 + c] * (256 - wx) + bottom[column.index1 + c] * wx;
+				*output++ = static_cast<uint8_t>((t * (256 - wy) + b * wy + 32768) >> 16);
+			}
+		}
+	}
+}
+
+void NV12Scaler::Prepare(uint32_t sourceWidth, uint32_t sourceHeight)
+{
+	if (sourceWidth == _sourceWidth && sourceHeight == _sourceHeight)
+	{
+		return;
+	}
+
+	_sourceWidth = sourceWidth;
+	_sourceHeight = sourceHeight;
+	_contentX = 0;
+	_contentY = 0;
+	_contentWidth = _outputWidth;
+	_contentHeight = _outputHeight;
+	if (_letterbox && sourceWidth && sourceHeight)
+	{
+		// Fit the source aspect ratio inside the output; offsets and sizes stay even for chroma.
+		if (static_cast<uint64_t>(sourceWidth) * _outputHeight > static_cast<uint64_t>(_outputWidth) * sourceHeight)
+		{
+			_contentHeight = static_cast<uint32_t>(static_cast<uint64_t>(_outputWidth) * sourceHeight / sourceWidth);
+		}
+		else
+		{
+			_contentWidth = static_cast<uint32_t>(static_cast<uint64_t>(_outputHeight) * sourceWidth / sourceHeight);
+		}
+		_contentWidth = (std::max)(_contentWidth & ~1u, 2u);
+		_contentHeight = (std::max)(_contentHeight & ~1u, 2u);
+		_contentX = ((_outputWidth - _contentWidth) / 2) & ~1u;
+		_contentY = ((_outputHeight - _contentHeight) / 2) & ~1u;
+	}
+
+	BuildTaps(sourceWidth, _contentWidth, 1, &_lumaColumns);
+	BuildTaps(sourceHeight, _contentHeight, 1, &_lumaRows);
+	BuildTaps((sourceWidth + 1) / 2, _contentWidth / 2, 2, &_chromaColumns);
+	BuildTaps((sourceHeight + 1) / 2, _contentHeight / 2, 1, &_chromaRows);
+	_layoutVersion++;
+}
+
+void NV12Scaler::FillBorders(uint8_t* destination, uint8_t* uvDestination, ptrdiff_t destinationStride) const
+{
+	if (_contentWidth == _outputWidth && _contentHeight == _outputHeight)
+	{
+		return;
+	}
+
+	// Black is Y=16, U=V=128 in video range. Output buffers are recycled, so borders are
+	// rewritten on every frame.
+	const auto right = _contentX + _contentWidth;
+	const auto bottom = _contentY + _contentHeight;
+	for (uint32_t row = 0; row < _outputHeight; row++)
+	{
+		auto line = destination + static_cast<size_t>(row) * destinationStride;
+		if (row < _contentY || row >= bottom)
+		{
+			std::memset(line, 16, _outputWidth);
+			continue;
+		}
+		std::memset(line, 16, _contentX);
+		std::memset(line + right, 16, _outputWidth - right);
+	}
+
+	for (uint32_t row = 0; row < _outputHeight / 2; row++)
+	{
+		auto line = uvDestination + static_cast<size_t>(row) * destinationStride;
+		if (row < _contentY / 2 || row >= bottom / 2)
+		{
+			std::memset(line, 128, _outputWidth);
+			continue;
+		}
+		std::memset(line, 128, _contentX);
+		std::memset(line + right, 128, _outputWidth - right);
+	}
+}
+
+void NV12Scaler::Copy(
+	const uint8_t* sourceY,
+	ptrdiff_t sourceYStride,
+	const uint8_t* sourceUV,
+	ptrdiff_t sourceUVStride,
+	uint32_t sourceWidth,
+	uint32_t sourceHeight,
+	uint8_t* destination,
+	ptrdiff_t destinationStride)
+{
+	auto uvDestination = destination + static_cast<size_t>(destinationStride) * _outputHeight;
+	if (!IsScaling(sourceWidth, sourceHeight))
+	{
+		for (uint32_t row = 0; row < _outputHeight; row++)
+		{
+			std::memcpy(
+				destination + static_cast<size_t>(row) * destinationStride,
+				sourceY + static_cast<ptrdiff_t>(row) * sourceYStride,
+				_outputWidth);
+		}
+
+		for (uint32_t row = 0; row < _outputHeight / 2; row++)
+		{
+			std::memcpy(
+				uvDestination + static_cast<size_t>(row) * destinationStride,
+				sourceUV + static_cast<ptrdiff_t>(row) * sourceUVStride,
+				_outputWidth);
+		}
+		return;
+	}
+
+	Prepare(sourceWidth, sourceHeight);
+	FillBorders(destination, uvDestination, destinationStride);
+	ScalePlane(
+		sourceY,
+		sourceYStride,
+		destination + static_cast<size_t>(_contentY) * destinationStride + _contentX,
+		destinationStride,
+		_lumaColumns,
+		_lumaRows,
+		1);
+	ScalePlane(
+		sourceUV,
+		sourceUVStride,
+		uvDestination + static_cast<size_t>(_contentY / 2) * destinationStride + _contentX,
+		destinationStride,
+		_chromaColumns,
+		_chromaRows,
+		2);
+}
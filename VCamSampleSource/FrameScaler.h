@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Copies NV12 frames into an output of fixed size. When the source has the same size this is
+// a plain row copy; otherwise it is a fixed-point bilinear resample whose per-row/column taps
+// are cached and only rebuilt when the source size changes. With letterboxing the source
+// aspect ratio is kept and the remaining border is filled with black. Not thread-safe; one per stream.
+// Only std types so it also builds in tests/.
+class NV12Scaler
+{
+public:
+	void SetOutputSize(uint32_t width, uint32_t height);
+	void SetLetterbox(bool letterbox);
+	uint32_t GetOutputWidth() const { return _outputWidth; }
+	uint32_t GetOutputHeight() const { return _outputHeight; }
+	bool IsScaling(uint32_t sourceWidth, uint32_t sourceHeight) const { return sourceWidth != _outputWidth || sourceHeight != _outputHeight; }
+
+	// Where the last scaled source landed in the output; bumped each time the taps are rebuilt.
+	uint32_t GetLayoutVersion() const { return _layoutVersion; }
+	uint32_t GetSourceWidth() const { return _sourceWidth; }
+	uint32_t GetSourceHeight() const { return _sourceHeight; }
+	uint32_t GetContentX() const { return _contentX; }
+	uint32_t GetContentY() const { return _contentY; }
+	uint32_t GetContentWidth() const { return _contentWidth; }
+	uint32_t GetContentHeight() const { return _contentHeight; }
+
+	void Copy(
+		const uint8_t* sourceY,
+		ptrdiff_t sourceYStride,
+		const uint8_t* sourceUV,
+		ptrdiff_t sourceUVStride,
+		uint32_t sourceWidth,
+		uint32_t sourceHeight,
+		uint8_t* destination,
+		ptrdiff_t destinationStride);
+
+private:
+	struct Tap
+	{
+		uint32_t index0;
+		uint32_t index1;
+		uint32_t weight; // 0..256, weight of index1
+	};
+
+	static void BuildTaps(uint32_t sourceSize, uint32_t outputSize, uint32_t channels, std::vector<Tap>* taps);
+	static void ScalePlane(
+		const uint8_t* source,
+		ptrdiff_t sourceStride,
+		uint8_t* destination,
+		ptrdiff_t destinationStride,
+		const std::vector<Tap>& columns,
+		const std::vector<Tap>& rows,
+		uint32_t channels);
+	void Prepare(uint32_t sourceWidth, uint32_t sourceHeight);
+	void FillBorders(uint8_t* destination, uint8_t* uvDestination, ptrdiff_t destinationStride) const;
+
+	bool _letterbox = false;
+	uint32_t _outputWidth = 0;
+	uint32_t _outputHeight = 0;
+	// Part of the output the scaled source lands in; the whole output unless letterboxing.
+	uint32_t _contentX = 0;
+	uint32_t _contentY = 0;
+	uint32_t _contentWidth = 0;
+	uint32_t _contentHeight = 0;
+	uint32_t _sourceWidth = 0;
+	uint32_t _sourceHeight = 0;
+	uint32_t _layoutVersion = 0;
+	std::vector<Tap> _lumaColumns;
+	std::vector<Tap> _lumaRows;
+	std::vector<Tap> _chromaColumns;
+	std::vector<Tap> _chromaRows;
+};
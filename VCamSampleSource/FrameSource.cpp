@@ -0,0 +1,20 @@
+#include "pch.h"
+#include "FrameSource.h"
+#include "GstPipelineSource.h"
+#include "ShmFrameSource.h"
+#include "ReplayFrameSource.h"
+
+std::shared_ptr<FrameSource> CreateFrameSource(const VCamPipelineConfig& config)
+{
+	if (!config.replayPath.empty())
+	{
+		WINTRACE(L"CreateFrameSource replay '%s' speed:%u%%", config.replayPath.c_str(), config.replaySpeedPercent);
+		return std::make_shared<ReplayFrameSource>();
+	}
+	if (!config.shmName.empty())
+	{
+		WINTRACE(L"CreateFrameSource native shared-memory ring '%s'", config.shmName.c_str());
+		return std::make_shared<ShmFrameSource>();
+	}
+	return std::make_shared<GstPipelineSource>();
+}
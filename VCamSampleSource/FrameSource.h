@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+struct VCamPipelineConfig;
+class NV12Scaler;
+
+// Input backend feeding every stream of a source. Start/Stop are counted per running stream;
+// frame ids are per-source and only increase while it runs, and each stream tracks the last id
+// it delivered. Implementations publish frames latest-only.
+class FrameSource
+{
+public:
+	virtual ~FrameSource() = default;
+
+	virtual HRESULT Start(const VCamPipelineConfig& config) = 0;
+	virtual void Stop() = 0;
+	virtual bool HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId) = 0;
+	virtual LONGLONG GetLatestFrameTime() = 0;
+	// Waits until a frame newer than lastDeliveredFrameId is published, the source stops or the timeout elapses.
+	virtual bool WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs) = 0;
+	// S_FALSE when no frame newer than minimumFrameIdExclusive is available.
+	virtual HRESULT CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId) = 0;
+};
+
+// Native shared-memory reader when the config names a ring, GStreamer pipeline otherwise.
+std::shared_ptr<FrameSource> CreateFrameSource(const VCamPipelineConfig& config);
@@ -1,21 +1,41 @@
 #include "pch.h"
 #include "Tools.h"
 #include "GstPipelineSource.h"
+#include "FrameScaler.h"
+#include "Metrics.h"
+#include "ServiceWorker.h"
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cwctype>
 #include <mutex>
+#include <thread>
 
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
 #include <gst/video/video.h>
 
+#pragma comment(lib, "Synchronization.lib")
+
+// Caps parsed once per caps object (see SampleFormatCache); status is the validation result.
+struct GstSampleFormat
+{
+	SampleFormatStatus status = SampleFormatStatus::Ok;
+	GstVideoInfo info{};
+	UINT width = 0;
+	UINT height = 0;
+};
+
 namespace
 {
 	std::once_flag g_gstInitOnce;
 	HRESULT g_gstInitHr = E_FAIL;
 	constexpr ULONGLONG kNoSampleLogIntervalMs = 2000;
 	constexpr ULONGLONG kFallbackLogIntervalMs = 2000;
+	constexpr ULONGLONG kSampleErrorLogIntervalMs = 10000;
+	// How long a PLAYING transition may stay pending before it is reported.
+	constexpr ULONGLONG kPlayPendingLogMs = 2000;
 
 	std::wstring ReadEnvVar(PCWSTR name)
 	{
@@ -98,14 +118,14 @@ namespace
 		auto registry = gst_registry_get();
 		if (!registry)
 		{
-			WINTRACE(L"GStreamer registry unavailable while probing '%S'", elementName);
+			WINTRACE_ERROR(L"GStreamer registry unavailable while probing '%S'", elementName);
 			return;
 		}
 
 		GstPluginFeature* feature = gst_registry_find_feature(registry, elementName, GST_TYPE_ELEMENT_FACTORY);
 		if (!feature)
 		{
-			WINTRACE(L"GStreamer element factory '%S' not found in registry", elementName);
+			WINTRACE_ERROR(L"GStreamer element factory '%S' not found in registry", elementName);
 			return;
 		}
 
@@ -139,9 +159,49 @@ namespace
 	}
 }
 
+// One process-wide thread drives state changes, bus draining and stall logging for every running
+// pipeline, so hosting several cameras does not add a pull thread per camera. Samples are taken
+// from appsink callbacks on GStreamer's own streaming threads instead of a polling loop.
+class GstPipelineWorker
+{
+public:
+	static GstPipelineWorker& Instance()
+	{
+		static GstPipelineWorker worker;
+		return worker;
+	}
+
+	static GstFlowReturn OnNewSample(GstAppSink* appSink, gpointer userData)
+	{
+		static_cast<GstPipelineSource*>(userData)->PullSample(appSink);
+		return GST_FLOW_OK;
+	}
+
+	void Add(GstPipelineSource* source)
+	{
+		if (_worker.Add(source))
+		{
+			WINTRACE(L"GstPipelineWorker thread started");
+		}
+	}
+
+	// The caller holds the source's _stateLock. A Service pass already running on it cannot get
+	// past that lock, so the wait is short and never spans a state change.
+	void Remove(GstPipelineSource* source)
+	{
+		_worker.Remove(source);
+	}
+
+private:
+	static constexpr DWORD kServiceIntervalMs = 200;
+	ServiceWorker<GstPipelineSource> _worker{ std::chrono::milliseconds(kServiceIntervalMs) };
+};
+
 GstPipelineSource::~GstPipelineSource()
 {
-	Stop();
+	std::lock_guard<std::mutex> lock(_stateLock);
+	_users = 0;
+	StopPipeline_NoLock();
 }
 
 HRESULT GstPipelineSource::EnsureGStreamerInitialized()
@@ -155,7 +215,7 @@ HRESULT GstPipelineSource::EnsureGStreamerInitialized()
 			{
 				if (error)
 				{
-					WINTRACE(L"GStreamer initialization failed: %s", to_wstring(error->message).c_str());
+					WINTRACE_ERROR(L"GStreamer initialization failed: %s", to_wstring(error->message).c_str());
 					g_clear_error(&error);
 				}
 				g_gstInitHr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
@@ -189,10 +249,16 @@ HRESULT GstPipelineSource::Start(const VCamPipelineConfig& config)
 	RETURN_IF_FAILED(EnsureGStreamerInitialized());
 	if (_running.load())
 	{
+		// Another stream already runs the pipeline; this one just shares its frames.
+		_users++;
+		WINTRACE(L"GstPipelineSource::Start shared users:%u", _users);
 		return S_OK;
 	}
 
 	_config = config;
+	const auto latencyPrefix = _config.camera ? std::format("cam{}.latency.", _config.camera) : std::string("latency.");
+	_storeLatency = LatencyGet((latencyPrefix + "store").c_str());
+	_waitLatency = LatencyGet((latencyPrefix + "wait").c_str());
 	if (_config.pipeline.empty())
 	{
 		_config.pipeline = BuildDefaultPipeline(_config);
@@ -234,6 +300,9 @@ HRESULT GstPipelineSource::Start(const VCamPipelineConfig& config)
 	}
 
 	auto appSink = GST_APP_SINK(appSinkElement);
+	GstAppSinkCallbacks callbacks{};
+	callbacks.new_sample = &GstPipelineWorker::OnNewSample;
+	gst_app_sink_set_callbacks(appSink, &callbacks, this, nullptr);
 	g_object_set(
 		G_OBJECT(appSinkElement),
 		"emit-signals", FALSE,
@@ -242,12 +311,11 @@ HRESULT GstPipelineSource::Start(const VCamPipelineConfig& config)
 		"drop", TRUE,
 		nullptr);
 
+	// Only the format is pinned: a fixed size would make upstream fail to negotiate (or refuse
+	// to renegotiate) rather than hand StoreSample a frame it can scale.
 	GstCaps* caps = gst_caps_new_simple(
 		"video/x-raw",
 		"format", G_TYPE_STRING, "NV12",
-		"width", G_TYPE_INT, static_cast<int>(_config.width),
-		"height", G_TYPE_INT, static_cast<int>(_config.height),
-		"framerate", GST_TYPE_FRACTION, static_cast<int>(_config.fpsNumerator), static_cast<int>(_config.fpsDenominator),
 		nullptr);
 	if (caps)
 	{
@@ -278,16 +346,16 @@ HRESULT GstPipelineSource::Start(const VCamPipelineConfig& config)
 			_latestSample = nullptr;
 		}
 		_hasFrame = false;
-		_formatMismatchLogged.store(false);
 		_firstFrameLogged.store(false);
 		_firstCopyLogged.store(false);
+		_latestFormat.reset();
 	}
 
-	const auto now = GetTickCount64();
-	_lastNoSampleLogTick.store(now);
-	_lastFallbackLogTick.store(now);
+	_lastSampleTick.store(GetTickCount64());
 	_running.store(true);
-	_pullThread = std::thread(&GstPipelineSource::PullLoop, this);
+	_users = 1;
+	_playRequested = false;
+	GstPipelineWorker::Instance().Add(this);
 	WINTRACE(L"GStreamer pipeline started");
 	return S_OK;
 }
@@ -295,23 +363,34 @@ HRESULT GstPipelineSource::Start(const VCamPipelineConfig& config)
 void GstPipelineSource::Stop()
 {
 	std::lock_guard<std::mutex> lock(_stateLock);
-	if (!_pipeline && !_pullThread.joinable())
+	if (_users > 1)
 	{
+		_users--;
+		WINTRACE(L"GstPipelineSource::Stop shared users:%u", _users);
 		return;
 	}
 
-	_running.store(false);
-	if (_pipeline)
-	{
-		const auto stateResult = gst_element_set_state(_pipeline, GST_STATE_NULL);
-		WINTRACE(L"gst_element_set_state(NULL) => %d", stateResult);
-	}
+	_users = 0;
+	StopPipeline_NoLock();
+}
 
-	if (_pullThread.joinable())
+void GstPipelineSource::StopPipeline_NoLock()
+{
+	if (!_pipeline)
 	{
-		_pullThread.join();
+		return;
 	}
 
+	_running.store(false);
+	// Release any RequestSample thread parked waiting for the next frame.
+	WakeByAddressAll(&_publishedFrameId);
+	GstPipelineWorker::Instance().Remove(this);
+
+	// Going to NULL joins the streaming threads, so no appsink callback runs after this.
+	const auto stateResult = gst_element_set_state(_pipeline, GST_STATE_NULL);
+	WINTRACE(L"gst_element_set_state(NULL) => %d", stateResult);
+	DrainBusMessages();
+
 	ResetPipelineObjects();
 	WINTRACE(L"GStreamer pipeline stopped");
 }
@@ -325,10 +404,17 @@ void GstPipelineSource::ResetPipelineObjects()
 			gst_sample_unref(_latestSample);
 			_latestSample = nullptr;
 		}
+		_latestFormat.reset();
 		_hasFrame = false;
 		_latestFrameId = 0;
+		_latestFrameTime = 0;
+		_publishedFrameId.store(0);
 	}
 
+	// The streaming thread is gone, so its caps cache can be dropped.
+	_formatCache.Reset();
+	gst_caps_replace(&_formatCaps, nullptr);
+
 	if (_bus)
 	{
 		gst_object_unref(_bus);
@@ -349,66 +435,127 @@ void GstPipelineSource::ResetPipelineObjects()
 	}
 }
 
-void GstPipelineSource::PullLoop()
+void GstPipelineSource::Service()
 {
-	WINTRACE(L"GstPipelineSource::PullLoop enter");
-	if (_pipeline && _running.load())
+	// A Start/Stop in progress owns the pipeline; it is picked up again on the next pass.
+	std::unique_lock<std::mutex> lock(_stateLock, std::try_to_lock);
+	if (!lock.owns_lock() || !_pipeline || !_running.load())
+	{
+		return;
+	}
+
+	if (!_playRequested)
 	{
+		_playRequested = true;
+		_playSettled = false;
+		_playRequestTick = GetTickCount64();
 		WINTRACE(L"About to call gst_element_set_state(PLAYING)");
 		const auto stateResult = gst_element_set_state(_pipeline, GST_STATE_PLAYING);
 		WINTRACE(L"gst_element_set_state(PLAYING) => %d", stateResult);
 		if (stateResult == GST_STATE_CHANGE_FAILURE)
 		{
-			WINTRACE(L"Failed to start GStreamer pipeline in pull thread");
+			WINTRACE_ERROR(L"Failed to start GStreamer pipeline on worker thread");
+			_playSettled = true;
 		}
-		else
+	}
+
+	if (!_playSettled)
+	{
+		// Polled without a timeout so an ASYNC transition never blocks the other pipelines.
+		GstState currentState = GST_STATE_NULL;
+		GstState pendingState = GST_STATE_VOID_PENDING;
+		const auto waitResult = gst_element_get_state(_pipeline, &currentState, &pendingState, 0);
+		const auto pendingMs = GetTickCount64() - _playRequestTick;
+		if (waitResult != GST_STATE_CHANGE_ASYNC || pendingMs >= kPlayPendingLogMs)
 		{
-			GstState currentState = GST_STATE_NULL;
-			GstState pendingState = GST_STATE_VOID_PENDING;
-			const auto waitResult = gst_element_get_state(_pipeline, &currentState, &pendingState, 2000 * GST_MSECOND);
+			_playSettled = true;
 			WINTRACE(
-				L"gst_element_get_state => %d current:%S pending:%S",
+				L"gst_element_get_state => %d current:%S pending:%S after %llu ms",
 				waitResult,
 				gst_element_state_get_name(currentState),
-				gst_element_state_get_name(pendingState));
+				gst_element_state_get_name(pendingState),
+				pendingMs);
 		}
 	}
 
-	while (_running.load())
+	DrainBusMessages();
+	if (WinTraceIsOn(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_FRAMES))
 	{
-		DrainBusMessages();
-		if (!_appSink)
+		const auto idleMs = GetTickCount64() - _lastSampleTick.load(std::memory_order_relaxed);
+		if (idleMs >= kNoSampleLogIntervalMs)
 		{
-			Sleep(10);
-			continue;
+			WINTRACE_EX_LIMITED(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_FRAMES, kNoSampleLogIntervalMs, 1, L"No sample pulled from appsink for %llu ms", idleMs);
 		}
+	}
+}
 
-		GstSample* sample = gst_app_sink_try_pull_sample(_appSink, 200 * GST_MSECOND);
-		if (!sample)
+void GstPipelineSource::PullSample(GstAppSink* appSink)
+{
+	const auto arrival = LatencyNow();
+	GstSample* sample = gst_app_sink_pull_sample(appSink);
+	if (!sample)
+	{
+		return;
+	}
+
+	_lastSampleTick.store(GetTickCount64(), std::memory_order_relaxed);
+	const auto hr = StoreSample(sample, arrival);
+	if (FAILED(hr))
+	{
+		WINTRACE_EX_LIMITED(WINTRACE_LEVEL_ERROR, WINTRACE_KEYWORD_FAILURES, kSampleErrorLogIntervalMs, 1, L"Could not consume sample from appsink, hr:0x%08X", hr);
+	}
+	gst_sample_unref(sample);
+}
+
+std::shared_ptr<const GstSampleFormat> GstPipelineSource::GetSampleFormat(GstCaps* caps)
+{
+	const auto lookup = _formatCache.Get(caps, [caps](const void*)
+	{
+		auto format = std::make_shared<GstSampleFormat>();
+		if (!gst_video_info_from_caps(&format->info, caps))
 		{
-			const auto now = GetTickCount64();
-			if (now - _lastNoSampleLogTick.load() >= kNoSampleLogIntervalMs)
-			{
-				_lastNoSampleLogTick.store(now);
-				WINTRACE(L"No sample pulled from appsink for %llu ms", kNoSampleLogIntervalMs);
-			}
-			continue;
+			format->status = SampleFormatStatus::Unparsable;
+			return format;
 		}
 
-		_lastNoSampleLogTick.store(GetTickCount64());
-		const auto hr = StoreSample(sample);
-		if (FAILED(hr) && !_formatMismatchLogged.exchange(true))
+		format->width = static_cast<UINT>(GST_VIDEO_INFO_WIDTH(&format->info));
+		format->height = static_cast<UINT>(GST_VIDEO_INFO_HEIGHT(&format->info));
+		format->status = CheckNV12SampleFormat(GST_VIDEO_INFO_FORMAT(&format->info) == GST_VIDEO_FORMAT_NV12, format->width, format->height);
+		if (format->status == SampleFormatStatus::NotNV12)
+		{
+			WINTRACE_ERROR(L"Unexpected sink format. Expected NV12, got:%d", GST_VIDEO_INFO_FORMAT(&format->info));
+		}
+		else if (format->status == SampleFormatStatus::BadSize)
 		{
-			WINTRACE(L"Could not consume sample from appsink, hr:0x%08X", hr);
+			WINTRACE_ERROR(L"Unsupported sink dimensions %ux%u", format->width, format->height);
 		}
-		gst_sample_unref(sample);
+		return format;
+	});
+	if (!lookup.parsed)
+	{
+		return lookup.format;
 	}
 
-	DrainBusMessages();
-	WINTRACE(L"GstPipelineSource::PullLoop exit");
+	// The cache is keyed on the caps address; the reference keeps it from being reused.
+	gst_caps_replace(&_formatCaps, caps);
+
+	// Renegotiated upstream; streams keep their MF size and scale from the new one.
+	if (lookup.resized)
+	{
+		WINTRACE(
+			L"Sink caps changed %ux%u -> %ux%u (configured %ux%u)",
+			lookup.previousWidth,
+			lookup.previousHeight,
+			lookup.format->width,
+			lookup.format->height,
+			_config.width,
+			_config.height);
+		MetricsGet("source.capschanges")->Add(1);
+	}
+	return lookup.format;
 }
 
-HRESULT GstPipelineSource::StoreSample(GstSample* sample)
+HRESULT GstPipelineSource::StoreSample(GstSample* sample, LONGLONG arrival)
 {
 	RETURN_HR_IF_NULL(E_POINTER, sample);
 
@@ -417,36 +564,20 @@ HRESULT GstPipelineSource::StoreSample(GstSample* sample)
 	RETURN_HR_IF_NULL(E_FAIL, caps);
 	RETURN_HR_IF_NULL(E_FAIL, buffer);
 
-	GstVideoInfo info;
-	RETURN_HR_IF(E_FAIL, !gst_video_info_from_caps(&info, caps));
-	if (GST_VIDEO_INFO_FORMAT(&info) != GST_VIDEO_FORMAT_NV12)
-	{
-		WINTRACE(L"Unexpected sink format. Expected NV12, got:%d", GST_VIDEO_INFO_FORMAT(&info));
-		RETURN_HR(MF_E_INVALIDMEDIATYPE);
-	}
-	if (GST_VIDEO_INFO_WIDTH(&info) != _config.width || GST_VIDEO_INFO_HEIGHT(&info) != _config.height)
-	{
-		WINTRACE(
-			L"Unexpected sink dimensions. Expected %ux%u, got %ux%u",
-			_config.width,
-			_config.height,
-			GST_VIDEO_INFO_WIDTH(&info),
-			GST_VIDEO_INFO_HEIGHT(&info));
-		RETURN_HR(MF_E_INVALIDMEDIATYPE);
-	}
+	auto format = GetSampleFormat(caps);
+	RETURN_HR_IF(E_FAIL, format->status == SampleFormatStatus::Unparsable);
+	RETURN_HR_IF(MF_E_INVALIDMEDIATYPE, format->status != SampleFormatStatus::Ok);
 
-	const auto yStride = GST_VIDEO_INFO_PLANE_STRIDE(&info, 0);
-	const auto uvStride = GST_VIDEO_INFO_PLANE_STRIDE(&info, 1);
 	if (!_firstFrameLogged.exchange(true))
 	{
 		const auto capsStr = gst_caps_to_string(caps);
 		WINTRACE(
 			L"First sample received caps:%S yStride:%d uvStride:%d ySize:%u uvSize:%u",
 			capsStr ? capsStr : "",
-			yStride,
-			uvStride,
-			_config.width * _config.height,
-			(_config.width * _config.height) / 2);
+			GST_VIDEO_INFO_PLANE_STRIDE(&format->info, 0),
+			GST_VIDEO_INFO_PLANE_STRIDE(&format->info, 1),
+			format->width * format->height,
+			(format->width * format->height) / 2);
 		if (capsStr)
 		{
 			g_free(capsStr);
@@ -460,9 +591,15 @@ HRESULT GstPipelineSource::StoreSample(GstSample* sample)
 			gst_sample_unref(_latestSample);
 		}
 		_latestSample = gst_sample_ref(sample);
+		_latestFormat = std::move(format);
 		_hasFrame = true;
 		_latestFrameId++;
+		_latestFrameTime = MFGetSystemTime();
+		_latestPublishTime = LatencyNow();
+		_publishedFrameId.store(_latestFrameId);
 	}
+	WakeByAddressAll(&_publishedFrameId);
+	_storeLatency->RecordTicks(_latestPublishTime - arrival);
 	return S_OK;
 }
 
@@ -489,49 +626,75 @@ bool GstPipelineSource::HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t
 	return true;
 }
 
-HRESULT GstPipelineSource::CopyLatestFrameTo(BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId)
+LONGLONG GstPipelineSource::GetLatestFrameTime()
+{
+	std::lock_guard<std::mutex> lock(_frameLock);
+	return _latestFrameTime;
+}
+
+bool GstPipelineSource::WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs)
+{
+	if (!_running.load())
+	{
+		return false;
+	}
+
+	// Returns immediately if a newer frame was published since lastDeliveredFrameId was read.
+	auto compare = lastDeliveredFrameId;
+	if (_publishedFrameId.load() != compare)
+	{
+		return true;
+	}
+	return WaitOnAddress(&_publishedFrameId, &compare, sizeof(compare), timeoutMs) != FALSE;
+}
+
+HRESULT GstPipelineSource::CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId)
 {
 	RETURN_HR_IF_NULL(E_POINTER, destination);
 	RETURN_HR_IF(E_INVALIDARG, destinationStride <= 0);
-	RETURN_HR_IF(E_INVALIDARG, destinationStride < static_cast<LONG>(_config.width));
+	RETURN_HR_IF(E_INVALIDARG, destinationStride < static_cast<LONG>(scaler.GetOutputWidth()));
 	RETURN_HR_IF_NULL(E_POINTER, outCopiedFrameId);
 	*outCopiedFrameId = 0;
 
-	const auto requiredLength = static_cast<size_t>(destinationStride) * _config.height * 3 / 2;
+	const auto requiredLength = static_cast<size_t>(destinationStride) * scaler.GetOutputHeight() * 3 / 2;
 	RETURN_HR_IF(E_BOUNDS, destinationLength < requiredLength);
 
 	GstSample* sample = nullptr;
+	std::shared_ptr<const GstSampleFormat> format;
 	bool hasFrame = false;
 	uint64_t frameId = 0;
+	LONGLONG publishTime = 0;
 	{
 		std::lock_guard<std::mutex> lock(_frameLock);
 		hasFrame = _hasFrame;
 		if (_hasFrame && _latestSample)
 		{
 			frameId = _latestFrameId;
+			publishTime = _latestPublishTime;
 			sample = gst_sample_ref(_latestSample);
+			format = _latestFormat;
 		}
 	}
 
 	if (!sample || frameId <= minimumFrameIdExclusive)
 	{
-		const auto now = GetTickCount64();
-		if (now - _lastFallbackLogTick.load() >= kFallbackLogIntervalMs)
-		{
-			_lastFallbackLogTick.store(now);
-			WINTRACE(
-				L"No new frame available hasFrame:%u sample:%p frameId:%llu lastDelivered:%llu",
-				hasFrame ? 1 : 0,
-				sample,
-				frameId,
-				minimumFrameIdExclusive);
-		}
+		WINTRACE_EX_LIMITED(
+			WINTRACE_LEVEL_VERBOSE,
+			WINTRACE_KEYWORD_FRAMES,
+			kFallbackLogIntervalMs,
+			1,
+			L"No new frame available hasFrame:%u sample:%p frameId:%llu lastDelivered:%llu",
+			hasFrame ? 1 : 0,
+			sample,
+			frameId,
+			minimumFrameIdExclusive);
 		if (sample)
 		{
 			gst_sample_unref(sample);
 		}
 		return S_FALSE;
 	}
+	_waitLatency->RecordTicks(LatencyNow() - publishTime);
 
 	if (!_firstCopyLogged.exchange(true))
 	{
@@ -545,33 +708,15 @@ HRESULT GstPipelineSource::CopyLatestFrameTo(BYTE* destination, LONG destination
 	const BYTE* uvSrc = nullptr;
 	int yStride = 0;
 	int uvStride = 0;
-	BYTE* uvDst = nullptr;
-	GstCaps* caps = gst_sample_get_caps(sample);
+	// Only validated samples are stored, each with the format parsed from its caps.
 	GstBuffer* buffer = gst_sample_get_buffer(sample);
-	if (!caps || !buffer)
+	if (!buffer || !format)
 	{
 		hr = E_FAIL;
 		goto Cleanup;
 	}
 
-	GstVideoInfo info;
-	if (!gst_video_info_from_caps(&info, caps))
-	{
-		hr = E_FAIL;
-		goto Cleanup;
-	}
-	if (GST_VIDEO_INFO_FORMAT(&info) != GST_VIDEO_FORMAT_NV12)
-	{
-		hr = MF_E_INVALIDMEDIATYPE;
-		goto Cleanup;
-	}
-	if (GST_VIDEO_INFO_WIDTH(&info) != _config.width || GST_VIDEO_INFO_HEIGHT(&info) != _config.height)
-	{
-		hr = MF_E_INVALIDMEDIATYPE;
-		goto Cleanup;
-	}
-
-	if (!gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ))
+	if (!gst_video_frame_map(&frame, &format->info, buffer, GST_MAP_READ))
 	{
 		hr = E_FAIL;
 		goto Cleanup;
@@ -582,23 +727,7 @@ HRESULT GstPipelineSource::CopyLatestFrameTo(BYTE* destination, LONG destination
 	uvSrc = static_cast<const BYTE*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 1));
 	yStride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
 	uvStride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 1);
-
-	for (UINT row = 0; row < _config.height; row++)
-	{
-		memcpy(
-			destination + static_cast<size_t>(row) * destinationStride,
-			ySrc + static_cast<ptrdiff_t>(row) * yStride,
-			_config.width);
-	}
-
-	uvDst = destination + static_cast<size_t>(destinationStride) * _config.height;
-	for (UINT row = 0; row < _config.height / 2; row++)
-	{
-		memcpy(
-			uvDst + static_cast<size_t>(row) * destinationStride,
-			uvSrc + static_cast<ptrdiff_t>(row) * uvStride,
-			_config.width);
-	}
+	scaler.Copy(ySrc, yStride, uvSrc, uvStride, format->width, format->height, destination, destinationStride);
 
 Cleanup:
 	if (frameMapped)
@@ -631,7 +760,7 @@ void GstPipelineSource::DrainBusMessages()
 			gchar* debug = nullptr;
 			gst_message_parse_error(message, &error, &debug);
 			const char* srcName = GST_OBJECT_NAME(message->src);
-			WINTRACE(
+			WINTRACE_ERROR(
 				L"GStreamer bus ERROR src:%S message:%s debug:%s",
 				srcName ? srcName : "",
 				error ? to_wstring(error->message).c_str() : L"",
@@ -652,7 +781,7 @@ void GstPipelineSource::DrainBusMessages()
 			gchar* debug = nullptr;
 			gst_message_parse_warning(message, &error, &debug);
 			const char* srcName = GST_OBJECT_NAME(message->src);
-			WINTRACE(
+			WINTRACE_WARNING(
 				L"GStreamer bus WARNING src:%S message:%s debug:%s",
 				srcName ? srcName : "",
 				error ? to_wstring(error->message).c_str() : L"",
@@ -4,37 +4,47 @@
 #include <cstdint>
 #include <mutex>
 #include <string>
-#include <thread>
+
+#include "FrameSource.h"
+#include "LatencyHistogram.h"
+#include "PipelineConfig.h"
+#include "SampleFormatCache.h"
 
 typedef struct _GstElement GstElement;
 typedef struct _GstAppSink GstAppSink;
 typedef struct _GstSample GstSample;
 typedef struct _GstBus GstBus;
+typedef struct _GstCaps GstCaps;
+struct GstSampleFormat;
+template <typename Client> class ServiceWorker;
 
-struct VCamPipelineConfig
-{
-	std::wstring pipeline;
-	UINT width = 1280;
-	UINT height = 960;
-	UINT fpsNumerator = 30;
-	UINT fpsDenominator = 1;
-};
-
-class GstPipelineSource
+// One pipeline shared by every stream of a source. Start/Stop are counted so the pipeline runs
+// while at least one stream does; each stream tracks its own last delivered frame id and copies
+// (scaling if needed) into its own output size, so decode/shm reads happen once per frame.
+// The appsink only requires NV12, so upstream may negotiate any size and change it mid-stream;
+// each stream scales such frames into its own size.
+class GstPipelineSource : public FrameSource
 {
 public:
-	GstPipelineSource() = default;
-	~GstPipelineSource();
+	~GstPipelineSource() override;
 
-	HRESULT Start(const VCamPipelineConfig& config);
-	void Stop();
-	bool HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId);
-	HRESULT CopyLatestFrameTo(BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId);
+	HRESULT Start(const VCamPipelineConfig& config) override;
+	void Stop() override;
+	bool HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId) override;
+	LONGLONG GetLatestFrameTime() override;
+	bool WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs) override;
+	HRESULT CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId) override;
 
 private:
+	friend class GstPipelineWorker;
+	friend class ServiceWorker<GstPipelineSource>;
+
 	HRESULT EnsureGStreamerInitialized();
-	HRESULT StoreSample(GstSample* sample);
-	void PullLoop();
+	HRESULT StoreSample(GstSample* sample, LONGLONG arrival);
+	std::shared_ptr<const GstSampleFormat> GetSampleFormat(GstCaps* caps);
+	void PullSample(GstAppSink* appSink);
+	void Service();
+	void StopPipeline_NoLock();
 	void ResetPipelineObjects();
 	void DrainBusMessages();
 
@@ -42,17 +52,34 @@ private:
 	std::atomic<bool> _running = false;
 	// Protects start/stop transitions and ownership of GStreamer objects.
 	std::mutex _stateLock;
-	std::thread _pullThread;
-	// Protects _latestSample/_hasFrame shared between pull and MF request threads.
+	UINT _users = 0;
+	// PLAYING requested by the shared worker, and its outcome (or a pending timeout) traced.
+	bool _playRequested = false;
+	bool _playSettled = false;
+	ULONGLONG _playRequestTick = 0;
+	// Protects _latestSample/_hasFrame shared between appsink callbacks and MF request threads.
 	std::mutex _frameLock;
 	GstSample* _latestSample = nullptr;
+	// Parsed caps of _latestSample, so request threads never parse caps.
+	std::shared_ptr<const GstSampleFormat> _latestFormat;
 	bool _hasFrame = false;
 	uint64_t _latestFrameId = 0;
-	std::atomic<bool> _formatMismatchLogged = false;
+	LONGLONG _latestFrameTime = 0;
+	// LatencyNow() when _latestSample was published.
+	LONGLONG _latestPublishTime = 0;
+	// Mirrors _latestFrameId for WaitOnAddress so every stream waiting on the pipeline wakes up.
+	std::atomic<uint64_t> _publishedFrameId = 0;
 	std::atomic<bool> _firstFrameLogged = false;
 	std::atomic<bool> _firstCopyLogged = false;
-	std::atomic<ULONGLONG> _lastNoSampleLogTick = 0;
-	std::atomic<ULONGLONG> _lastFallbackLogTick = 0;
+	// Tick of the last sample pulled; Service reports a stall after kNoSampleLogIntervalMs without one.
+	std::atomic<ULONGLONG> _lastSampleTick = 0;
+	// Last caps seen on the streaming thread (a reference is held) and their parsed form; caps
+	// only change on renegotiation, so steady-state samples skip parsing and validation.
+	GstCaps* _formatCaps = nullptr;
+	SampleFormatCache<GstSampleFormat> _formatCache;
+	// appsink callback -> sample published, and published -> picked up by a copy.
+	LatencyHistogram* _storeLatency = nullptr;
+	LatencyHistogram* _waitLatency = nullptr;
 
 	VCamPipelineConfig _config;
 	GstElement* _pipeline = nullptr;
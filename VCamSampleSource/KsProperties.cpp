@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "KsProperties.h"
+
+namespace
+{
+	// A LONG-valued property reported as fixed: GET returns value, BASICSUPPORT the range.
+	// PROPSETID_VIDCAP_VIDEOPROCAMP and PROPSETID_VIDCAP_CAMERACONTROL share the GET layout
+	// (KSPROPERTY_VIDEOPROCAMP_S / KSPROPERTY_CAMERACONTROL_S).
+	struct FixedProperty
+	{
+		const GUID& set;
+		ULONG id;
+		LONG minimum;
+		LONG maximum;
+		LONG value;
+	};
+
+	const FixedProperty kProperties[] =
+	{
+		// Frames come from software, there is no mains flicker to cancel.
+		{ PROPSETID_VIDCAP_VIDEOPROCAMP, KSPROPERTY_VIDEOPROCAMP_POWERLINE_FREQUENCY, 0, 0, 0 },
+	};
+
+	struct RangeDescription
+	{
+		KSPROPERTY_DESCRIPTION description;
+		KSPROPERTY_MEMBERSHEADER members;
+		KSPROPERTY_STEPPING_LONG stepping;
+	};
+
+	constexpr ULONG kAccessFlags = KSPROPERTY_TYPE_GET | KSPROPERTY_TYPE_BASICSUPPORT;
+
+	HRESULT Reply(LPVOID data, ULONG dataLength, const void* reply, ULONG replyLength, ULONG* bytesReturned)
+	{
+		// Size query: report what is needed, as KS drivers do.
+		*bytesReturned = replyLength;
+		if (!data || !dataLength)
+			return HRESULT_FROM_WIN32(ERROR_MORE_DATA);
+
+		RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), dataLength < replyLength);
+		memcpy(data, reply, replyLength);
+		return S_OK;
+	}
+
+	HRESULT BasicSupport(const FixedProperty& entry, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
+	{
+		// Callers may ask for the access flags alone or for the description header only.
+		if (data && dataLength == sizeof(ULONG))
+			return Reply(data, dataLength, &kAccessFlags, sizeof(ULONG), bytesReturned);
+
+		RangeDescription range{};
+		range.description.AccessFlags = kAccessFlags;
+		range.description.DescriptionSize = sizeof(range);
+		range.description.PropTypeSet.Set = KSPROPTYPESETID_General;
+		range.description.PropTypeSet.Id = VT_I4;
+		range.description.MembersListCount = 1;
+		range.members.MembersFlags = KSPROPERTY_MEMBER_STEPPEDRANGES;
+		range.members.MembersSize = sizeof(KSPROPERTY_STEPPING_LONG);
+		range.members.MembersCount = 1;
+		range.stepping.SteppingDelta = 1;
+		range.stepping.Bounds.SignedMinimum = entry.minimum;
+		range.stepping.Bounds.SignedMaximum = entry.maximum;
+
+		if (data && dataLength >= sizeof(KSPROPERTY_DESCRIPTION) && dataLength < sizeof(range))
+			return Reply(data, dataLength, &range.description, sizeof(KSPROPERTY_DESCRIPTION), bytesReturned);
+
+		return Reply(data, dataLength, &range, sizeof(range), bytesReturned);
+	}
+}
+
+HRESULT KsPropertyFromTable(PKSPROPERTY property, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
+{
+	RETURN_HR_IF_NULL(E_POINTER, property);
+	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
+	RETURN_HR_IF(E_INVALIDARG, length < sizeof(KSPROPERTY));
+	*bytesReturned = 0;
+
+	const FixedProperty* entry = nullptr;
+	auto setFound = false;
+	for (const auto& candidate : kProperties)
+	{
+		if (candidate.set != property->Set)
+			continue;
+
+		setFound = true;
+		if (candidate.id == property->Id)
+		{
+			entry = &candidate;
+			break;
+		}
+	}
+
+	// Expected failures, FrameServer probes them by the dozen: no RETURN_HR logging.
+	if (!entry)
+		return HRESULT_FROM_WIN32(setFound ? ERROR_NOT_FOUND : ERROR_SET_NOT_FOUND);
+
+	const auto type = property->Flags & ~KSPROPERTY_TYPE_TOPOLOGY;
+	if (type == KSPROPERTY_TYPE_BASICSUPPORT)
+		return BasicSupport(*entry, data, dataLength, bytesReturned);
+
+	if (type == KSPROPERTY_TYPE_GET)
+	{
+		KSPROPERTY_VIDEOPROCAMP_S reply{};
+		reply.Property = *property;
+		reply.Value = entry->value;
+		reply.Flags = KSPROPERTY_VIDEOPROCAMP_FLAGS_MANUAL;
+		reply.Capabilities = KSPROPERTY_VIDEOPROCAMP_FLAGS_MANUAL;
+		return Reply(data, dataLength, &reply, sizeof(reply), bytesReturned);
+	}
+
+	return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+}
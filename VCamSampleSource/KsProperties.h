@@ -0,0 +1,7 @@
+#pragma once
+
+// IKsControl::KsProperty answered from a fixed table of read-only properties, shared by the
+// source and its streams. FrameServer probes dozens of camera control properties at every
+// activation; none of them depend on source state, so no lock is taken and anything not in
+// the table fails immediately.
+HRESULT KsPropertyFromTable(PKSPROPERTY property, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned);
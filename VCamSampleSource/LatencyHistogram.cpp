@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+
+#include <mutex>
+
+namespace
+{
+	constexpr size_t kMaxHistograms = 32;
+	constexpr ULONGLONG kPublishIntervalMs = 10000;
+
+	std::mutex g_histogramsLock;
+	LatencyHistogram g_histograms[kMaxHistograms];
+	std::atomic<size_t> g_histogramCount = 0;
+	LatencyHistogram g_overflow;
+	std::atomic<ULONGLONG> g_nextPublish = 0;
+
+	LONGLONG QpcFrequency()
+	{
+		static const auto frequency = []
+		{
+			LARGE_INTEGER value{};
+			QueryPerformanceFrequency(&value);
+			return value.QuadPart;
+		}();
+		return frequency;
+	}
+
+	uint64_t Percentile(const uint32_t* counts, uint64_t total, uint32_t percent)
+	{
+		const auto rank = (total * percent + 99) / 100;
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i < LatencyHistogram::BucketCount; i++)
+		{
+			seen += counts[i];
+			if (seen >= rank)
+			{
+				return LatencyHistogram::BucketValue(i);
+			}
+		}
+		return LatencyHistogram::BucketValue(LatencyHistogram::BucketCount - 1);
+	}
+}
+
+void LatencyHistogram::RecordTicks(LONGLONG ticks)
+{
+	Record(ticks > 0 ? static_cast<uint64_t>(ticks) * 1000000 / QpcFrequency() : 0);
+}
+
+LatencySummary LatencyHistogram::TakeInterval()
+{
+	uint32_t counts[BucketCount];
+	LatencySummary summary;
+	for (uint32_t i = 0; i < BucketCount; i++)
+	{
+		counts[i] = _counts[i].exchange(0, std::memory_order_relaxed);
+		summary.count += counts[i];
+	}
+	summary.max = _max.exchange(0, std::memory_order_relaxed);
+	if (summary.count)
+	{
+		summary.p50 = Percentile(counts, summary.count, 50);
+		summary.p90 = Percentile(counts, summary.count, 90);
+		summary.p99 = Percentile(counts, summary.count, 99);
+	}
+	return summary;
+}
+
+LatencyHistogram* LatencyGet(PCSTR name)
+{
+	if (!name || !*name)
+	{
+		return &g_overflow;
+	}
+
+	std::lock_guard<std::mutex> lock(g_histogramsLock);
+	const auto count = g_histogramCount.load();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!strcmp(g_histograms[i].name, name))
+		{
+			return &g_histograms[i];
+		}
+	}
+
+	if (count >= kMaxHistograms)
+	{
+		return &g_overflow;
+	}
+
+	auto histogram = &g_histograms[count];
+	StringCchCopyA(histogram->name, _countof(histogram->name), name);
+	g_histogramCount.store(count + 1);
+	return histogram;
+}
+
+LONGLONG LatencyNow()
+{
+	LARGE_INTEGER counter{};
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+void LatencyPublishIfDue()
+{
+	const auto now = GetTickCount64();
+	auto due = g_nextPublish.load(std::memory_order_relaxed);
+	if (now < due || !g_nextPublish.compare_exchange_strong(due, now + kPublishIntervalMs, std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	const auto count = g_histogramCount.load();
+	for (size_t i = 0; i < count; i++)
+	{
+		auto& histogram = g_histograms[i];
+		const auto summary = histogram.TakeInterval();
+		const std::string prefix = histogram.name;
+		MetricsGet((prefix + ".count").c_str())->Set(static_cast<int64_t>(summary.count));
+		MetricsGet((prefix + ".p50us").c_str())->Set(static_cast<int64_t>(summary.p50));
+		MetricsGet((prefix + ".p90us").c_str())->Set(static_cast<int64_t>(summary.p90));
+		MetricsGet((prefix + ".p99us").c_str())->Set(static_cast<int64_t>(summary.p99));
+		MetricsGet((prefix + ".maxus").c_str())->Set(static_cast<int64_t>(summary.max));
+		if (summary.count)
+		{
+			WINTRACE_EX(
+				WINTRACE_LEVEL_INFORMATION,
+				WINTRACE_KEYWORD_FRAMES,
+				L"Latency %S n:%llu p50:%lluus p90:%lluus p99:%lluus max:%lluus",
+				histogram.name,
+				summary.count,
+				summary.p50,
+				summary.p90,
+				summary.p99,
+				summary.max);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+struct LatencySummary
+{
+	uint64_t count = 0;
+	uint64_t p50 = 0;
+	uint64_t p90 = 0;
+	uint64_t p99 = 0;
+	uint64_t max = 0;
+};
+
+// Log-linear (HDR-style) histogram of microsecond latencies: exact below 32 us, then 16 linear
+// sub-buckets per power of two (about 6% resolution) up to ~134 s, where values are clamped.
+// Recording is two relaxed atomics and never blocks, so frame paths keep it on in every build.
+class LatencyHistogram
+{
+public:
+	static constexpr uint32_t SubBucketBits = 4;
+	static constexpr uint32_t SubBuckets = 1u << SubBucketBits;
+	static constexpr uint32_t MaxValueBits = 27;
+	static constexpr uint32_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBuckets;
+
+	static uint32_t BucketIndex(uint64_t value)
+	{
+		value = (std::min)(value, (uint64_t{ 1 } << MaxValueBits) - 1);
+		if (value < 2 * SubBuckets)
+		{
+			return static_cast<uint32_t>(value);
+		}
+
+		const auto shift = static_cast<uint32_t>(std::bit_width(value)) - (SubBucketBits + 1);
+		return (shift + 1) * SubBuckets + static_cast<uint32_t>(value >> shift) - SubBuckets;
+	}
+
+	// Highest value falling in the bucket, so reported percentiles never understate.
+	static uint64_t BucketValue(uint32_t index)
+	{
+		if (index < 2 * SubBuckets)
+		{
+			return index;
+		}
+
+		const auto shift = index / SubBuckets - 1;
+		return ((static_cast<uint64_t>(index % SubBuckets + SubBuckets) + 1) << shift) - 1;
+	}
+
+	void Record(uint64_t microseconds)
+	{
+		_counts[BucketIndex(microseconds)].fetch_add(1, std::memory_order_relaxed);
+		auto max = _max.load(std::memory_order_relaxed);
+		while (microseconds > max && !_max.compare_exchange_weak(max, microseconds, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// A QueryPerformanceCounter delta (see LatencyNow).
+	void RecordTicks(LONGLONG ticks);
+
+	// Summarizes what was recorded since the previous call and starts a new interval.
+	LatencySummary TakeInterval();
+
+	char name[48]{};
+
+private:
+	std::atomic<uint32_t> _counts[BucketCount]{};
+	std::atomic<uint64_t> _max = 0;
+};
+
+// Finds or registers a histogram by name; never returns null (a shared overflow slot is used when full).
+LatencyHistogram* LatencyGet(PCSTR name);
+// QueryPerformanceCounter value for stage timestamps.
+LONGLONG LatencyNow();
+// At most every few seconds (the first caller past the deadline does the work): sets the
+// "<name>.count/p50us/p90us/p99us/maxus" metrics of every histogram from the interval since
+// the previous call and writes one trace line per histogram that recorded something.
+void LatencyPublishIfDue();
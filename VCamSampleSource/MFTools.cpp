@@ -32,18 +32,18 @@ void TraceMFAttributes(IUnknown* unknown, PCWSTR prefix)
 		{
 			if (pv.vt == VT_CLSID)
 			{
-				WINTRACE(L" %s:[%u] attribute, '%s' type %s/(0x%02X), value: '%s'", prefix, i, GUID_ToStringW(pk).c_str(), VARTYPE_ToString(pv.vt).c_str(), pv.vt, GUID_ToStringW(*pv.puuid).c_str());
+				WINTRACE(L" %s:[%u] attribute, '%s' type %s/(0x%02X), value: '%s'", prefix, i, GUID_ToName(pk).c_str(), VARTYPE_ToString(pv.vt).c_str(), pv.vt, GUID_ToName(*pv.puuid).c_str());
 			}
 			else
 			{
 				wil::unique_cotaskmem_ptr<wchar_t> str;
 				if (SUCCEEDED(PropVariantToStringAlloc(pv, wil::out_param(str))))
 				{
-					WINTRACE(L" %s:[%u] attribute, '%s' type %s/(0x%02X), value: '%s'", prefix, i, GUID_ToStringW(pk).c_str(), VARTYPE_ToString(pv.vt).c_str(), pv.vt, str.get());
+					WINTRACE(L" %s:[%u] attribute, '%s' type %s/(0x%02X), value: '%s'", prefix, i, GUID_ToName(pk).c_str(), VARTYPE_ToString(pv.vt).c_str(), pv.vt, str.get());
 				}
 				else
 				{
-					WINTRACE(L" %s:[%u] attribute, '%s' type %s/(0x%02X) cannot be converted to string", prefix, i, GUID_ToStringW(pk).c_str(), VARTYPE_ToString(pv.vt).c_str(), pv.vt);
+					WINTRACE(L" %s:[%u] attribute, '%s' type %s/(0x%02X) cannot be converted to string", prefix, i, GUID_ToName(pk).c_str(), VARTYPE_ToString(pv.vt).c_str(), pv.vt);
 				}
 			}
 		}
@@ -62,33 +62,38 @@ std::wstring PKSIDENTIFIER_ToString(PKSIDENTIFIER id, ULONG length)
 	if (length < sizeof(KSIDENTIFIER))
 		return std::format(L"<length:{}>", length);
 
-	auto flags = KSPROPERTY_TYPE_ToString(id->Flags);
-	if (id->Set == KSPROPERTYSETID_ExtendedCameraControl)
-		return L"KSPROPERTYSETID_ExtendedCameraControl " + KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY_ToString(id->Id) + L" " + flags;
-
-	if (id->Set == PROPSETID_VIDCAP_CAMERACONTROL)
-		return L"PROPSETID_VIDCAP_CAMERACONTROL " + PROPSETID_VIDCAP_CAMERACONTROL_ToString(id->Id) + L" " + flags;
-
-	if (id->Set == PROPSETID_VIDCAP_VIDEOPROCAMP)
-		return L"PROPSETID_VIDCAP_VIDEOPROCAMP " + PROPSETID_VIDCAP_CAMERACONTROL_ToString(id->Id) + L" " + flags;
-
-	if (id->Set == KSPROPERTYSETID_PerFrameSettingControl)
-		return L"KSPROPERTYSETID_PerFrameSettingControl " + KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY_ToString(id->Id) + L" " + flags;
-
-	if (id->Set == PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST)
-		return L"PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST " + KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_ToString(id->Id) + L" " + flags;
-
-	if (id->Set == PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY)
-		return L"PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY " + KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_ToString(id->Id) + L" " + flags;
+	struct PropertySet
+	{
+		const GUID& set;
+		PCWSTR name;
+		std::wstring_view(*idName)(ULONG);
+	};
 
-	if (id->Set == KSPROPSETID_Topology)
-		return L"KSPROPSETID_Topology " + KSPROPERTY_TOPOLOGY_ToString(id->Id) + L" " + flags;
+	static const PropertySet sets[] =
+	{
+		{ KSPROPERTYSETID_ExtendedCameraControl, L"KSPROPERTYSETID_ExtendedCameraControl", KSPROPERTY_CAMERACONTROL_EXTENDED_PROPERTY_Name },
+		{ PROPSETID_VIDCAP_CAMERACONTROL, L"PROPSETID_VIDCAP_CAMERACONTROL", PROPSETID_VIDCAP_CAMERACONTROL_Name },
+		{ PROPSETID_VIDCAP_VIDEOPROCAMP, L"PROPSETID_VIDCAP_VIDEOPROCAMP", PROPSETID_VIDCAP_VIDEOPROCAMP_Name },
+		{ KSPROPERTYSETID_PerFrameSettingControl, L"KSPROPERTYSETID_PerFrameSettingControl", KSPROPERTY_CAMERACONTROL_PERFRAMESETTING_PROPERTY_Name },
+		{ PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST, L"PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST", KSPROPERTY_CAMERACONTROL_REGION_OF_INTEREST_Name },
+		{ PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY, L"PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY", PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY_Name },
+		{ KSPROPSETID_Topology, L"KSPROPSETID_Topology", KSPROPERTY_TOPOLOGY_Name },
+		{ KSPROPSETID_Pin, L"KSPROPSETID_Pin", KSPROPERTY_PIN_Name },
+		{ KSPROPSETID_Connection, L"KSPROPSETID_Connection", KSPROPSETID_Connection_Name },
+	};
 
-	if (id->Set == KSPROPSETID_Pin)
-		return L"KSPROPSETID_Pin " + KSPROPERTY_PIN_ToString(id->Id) + L" " + flags;
+	const auto flags = KSPROPERTY_TYPE_ToString(id->Flags);
+	for (const auto& set : sets)
+	{
+		if (id->Set == set.set)
+		{
+			const auto idName = set.idName(id->Id);
+			if (idName.empty())
+				return std::format(L"{} {} {}", set.name, id->Id, flags);
 
-	if (id->Set == KSPROPSETID_Connection)
-		return L"KSPROPSETID_Connection " + KSPROPSETID_Connection_ToString(id->Id) + L" " + flags;
+			return std::format(L"{} {} {}", set.name, idName, flags);
+		}
+	}
 
-	return std::format(L"{} {} {}", GUID_ToStringW(id->Set), id->Id, flags);
+	return std::format(L"{} {} {}", GUID_ToName(id->Set).c_str(), id->Id, flags);
 }
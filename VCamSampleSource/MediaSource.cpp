@@ -3,14 +3,23 @@
 #include "Tools.h"
 #include "EnumNames.h"
 #include "MFTools.h"
+#include "FrameSource.h"
 #include "GstPipelineSource.h"
+#include "FrameScaler.h"
+#include "RequestGovernor.h"
+#include "CadenceEstimator.h"
+#include "CpuSamplePool.h"
+#include "SampleDepth.h"
+#include "Metrics.h"
 #include "MediaStream.h"
 #include "MediaSource.h"
+#include "Cameras.h"
+#include "KsProperties.h"
+#include "ActivationCache.h"
+#include "TcpKick.h"
 
 namespace
 {
-	constexpr PCWSTR kConfigPath = L"SOFTWARE\\VCamSample\\GStreamer";
-	constexpr PCWSTR kPipelineValueName = L"Pipeline";
 	constexpr PCWSTR kWidthValueName = L"Width";
 	constexpr PCWSTR kHeightValueName = L"Height";
 	constexpr PCWSTR kFpsNumValueName = L"FpsNumerator";
@@ -26,7 +35,7 @@ namespace
 		}
 	}
 
-	void LoadPipelineConfigFromRegistry(VCamPipelineConfig* config)
+	void LoadPipelineConfigFromRegistry(const std::wstring& configPath, VCamPipelineConfig* config)
 	{
 		config->pipeline = std::format(
 			L"videotestsrc is-live=true pattern=smpte ! video/x-raw,format=NV12,width={},height={},framerate={}/{} ! appsink name=vcamsink",
@@ -36,60 +45,110 @@ namespace
 			config->fpsDenominator);
 
 		HKEY key = nullptr;
-		if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, kConfigPath, 0, KEY_READ, &key) != ERROR_SUCCESS)
+		if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, configPath.c_str(), 0, KEY_READ, &key) != ERROR_SUCCESS)
 		{
 			return;
 		}
 
-		wchar_t pipeline[4096];
-		DWORD type = 0;
-		DWORD size = sizeof(pipeline);
-		if (RegGetValueW(key, nullptr, kPipelineValueName, RRF_RT_REG_SZ, &type, pipeline, &size) == ERROR_SUCCESS)
+		// Validation and defaults live in PipelineConfig.h, shared with the tests.
+		for (auto name : VCamPipelineStringValueNames)
 		{
-			config->pipeline = pipeline;
+			wchar_t value[4096];
+			DWORD size = sizeof(value);
+			if (RegGetValueW(key, nullptr, name, RRF_RT_REG_SZ, nullptr, value, &size) == ERROR_SUCCESS)
+			{
+				ApplyPipelineConfigString(config, name, value);
+			}
 		}
 
-		LoadDwordValue(key, kWidthValueName, &config->width);
-		LoadDwordValue(key, kHeightValueName, &config->height);
-		LoadDwordValue(key, kFpsNumValueName, &config->fpsNumerator);
-		LoadDwordValue(key, kFpsDenValueName, &config->fpsDenominator);
-		if (!config->fpsDenominator)
+		for (auto name : VCamPipelineDwordValueNames)
 		{
-			config->fpsDenominator = 1;
+			DWORD value = 0;
+			DWORD size = sizeof(value);
+			if (RegGetValueW(key, nullptr, name, RRF_RT_REG_DWORD, nullptr, &value, &size) == ERROR_SUCCESS)
+			{
+				ApplyPipelineConfigDword(config, name, value);
+			}
 		}
 
 		RegCloseKey(key);
 	}
+
+	// Extra streams fed by the same pipeline: StreamN subkeys (N >= 1) override the output size
+	// and frame rate, everything else is inherited. Missing subkeys end the list.
+	void LoadStreamConfigsFromRegistry(const std::wstring& configPath, const VCamPipelineConfig& sourceConfig, int maxStreams, std::vector<VCamPipelineConfig>* configs)
+	{
+		configs->clear();
+		configs->push_back(sourceConfig);
+		for (int i = 1; i < maxStreams; i++)
+		{
+			const auto path = std::format(L"{}\\Stream{}", configPath, i);
+			HKEY key = nullptr;
+			if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, path.c_str(), 0, KEY_READ, &key) != ERROR_SUCCESS)
+			{
+				break;
+			}
+
+			auto config = sourceConfig;
+			config.pipeline.clear();
+			LoadDwordValue(key, kWidthValueName, &config.width);
+			LoadDwordValue(key, kHeightValueName, &config.height);
+			LoadDwordValue(key, kFpsNumValueName, &config.fpsNumerator);
+			LoadDwordValue(key, kFpsDenValueName, &config.fpsDenominator);
+			RegCloseKey(key);
+
+			// NV12 needs even dimensions for the chroma plane.
+			config.width &= ~1u;
+			config.height &= ~1u;
+			if (!config.width || !config.height)
+			{
+				continue;
+			}
+			configs->push_back(config);
+		}
+	}
 }
 
-HRESULT MediaSource::Initialize(IMFAttributes* attributes)
+HRESULT MediaSource::Initialize(IMFAttributes* attributes, UINT camera)
 {
 	if (attributes)
 	{
 		RETURN_IF_FAILED(attributes->CopyAllItems(this));
 	}
 
-	LoadPipelineConfigFromRegistry(&_pipelineConfig);
+	_configPath = VCamCameraConfigPath(camera);
+	const auto snapshot = ActivationCacheGetConfig(camera, _configPath, MaxStreams, [&](VCamConfigSnapshot* loaded)
+	{
+		loaded->pipeline.camera = camera;
+		LoadPipelineConfigFromRegistry(_configPath, &loaded->pipeline);
+		LoadStreamConfigsFromRegistry(_configPath, loaded->pipeline, MaxStreams, &loaded->streams);
+	});
+	_pipelineConfig = snapshot->pipeline;
+	_streamConfigs = snapshot->streams;
 	WINTRACE(
-		L"VCam pipeline config width:%u height:%u fps:%u/%u pipeline:%s",
+		L"VCam pipeline config camera:%u width:%u height:%u fps:%u/%u allocator:%u shm:%s replay:%s record:%s pipeline:%s",
+		camera,
 		_pipelineConfig.width,
 		_pipelineConfig.height,
 		_pipelineConfig.fpsNumerator,
 		_pipelineConfig.fpsDenominator,
+		static_cast<UINT>(_pipelineConfig.sampleAllocator),
+		_pipelineConfig.shmName.empty() ? L"<none>" : _pipelineConfig.shmName.c_str(),
+		_pipelineConfig.replayPath.empty() ? L"<none>" : _pipelineConfig.replayPath.c_str(),
+		_pipelineConfig.recordDirectory.empty() ? L"<none>" : _pipelineConfig.recordDirectory.c_str(),
 		_pipelineConfig.pipeline.c_str());
+	WINTRACE(L"VCam stream count:%zu", _streamConfigs.size());
 
-	wil::com_ptr_nothrow<IMFSensorProfileCollection> collection;
-	RETURN_IF_FAILED(MFCreateSensorProfileCollection(&collection));
-
-	DWORD streamId = 0;
-	wil::com_ptr_nothrow<IMFSensorProfile> profile;
-	RETURN_IF_FAILED(MFCreateSensorProfile(KSCAMERAPROFILE_Legacy, 0, nullptr, &profile));
-	RETURN_IF_FAILED(profile->AddProfileFilter(streamId, L"((RES==;FRT<=30,1;SUT==))"));
-	RETURN_IF_FAILED(collection->AddProfile(profile.get()));
+	_frameSource = std::make_shared<ReloadableFrameSource>(_pipelineConfig);
+	_streams = winrt::com_array<wil::com_ptr_nothrow<MediaStream>>(static_cast<uint32_t>(_streamConfigs.size()));
+	for (uint32_t i = 0; i < _streams.size(); i++)
+	{
+		auto stream = winrt::make_self<MediaStream>();
+		_streams[i].attach(stream.detach()); // this is needed because of wil+winrt mumbo-jumbo, as "_streams[i] = stream.detach()" just cause one extra AddRef
+	}
 
-	RETURN_IF_FAILED(MFCreateSensorProfile(KSCAMERAPROFILE_HighFrameRate, 0, nullptr, &profile));
-	RETURN_IF_FAILED(profile->AddProfileFilter(streamId, L"((RES==;FRT>=60,1;SUT==))"));
-	RETURN_IF_FAILED(collection->AddProfile(profile.get()));
+	wil::com_ptr_nothrow<IMFSensorProfileCollection> collection;
+	RETURN_IF_FAILED(ActivationCacheGetSensorProfiles(static_cast<DWORD>(_streams.size()), &collection));
 	RETURN_IF_FAILED(SetUnknown(MF_DEVICEMFT_SENSORPROFILE_COLLECTION, collection.get()));
 
 	try
@@ -108,7 +167,7 @@ HRESULT MediaSource::Initialize(IMFAttributes* attributes)
 	auto streams = wil::make_unique_cotaskmem_array<wil::com_ptr_nothrow<IMFStreamDescriptor>>(_streams.size());
 	for (uint32_t i = 0; i < streams.size(); i++)
 	{
-		RETURN_IF_FAILED(_streams[i]->Initialize(this, i, _pipelineConfig));
+		RETURN_IF_FAILED(_streams[i]->Initialize(this, i, _pipelineConfig, _streamConfigs[i], _frameSource));
 		wil::com_ptr_nothrow<IMFStreamDescriptor> desc;
 		RETURN_IF_FAILED(_streams[i]->GetStreamDescriptor(&desc));
 		streams[i] = desc.detach();
@@ -118,6 +177,81 @@ HRESULT MediaSource::Initialize(IMFAttributes* attributes)
 	return S_OK;
 }
 
+MediaSource::~MediaSource()
+{
+	// DetachObject drops the source without Shutdown; don't leave the host prewarmed.
+	ReleasePrewarm_NoLock();
+}
+
+void MediaSource::Prewarm()
+{
+	winrt::slim_lock_guard lock(_lock);
+	if (!_queue || _kickPrewarmed)
+		return;
+
+	// Lets the host spin up its producer while FrameServer is still negotiating, before Start.
+	TcpKickCameraFormat format;
+	format.width = _pipelineConfig.width;
+	format.height = _pipelineConfig.height;
+	format.fpsNumerator = _pipelineConfig.fpsNumerator;
+	format.fpsDenominator = _pipelineConfig.fpsDenominator;
+	TcpKickPrewarm(_pipelineConfig.camera, format);
+	_kickPrewarmed = true;
+}
+
+void MediaSource::ReleasePrewarm_NoLock()
+{
+	if (!_kickPrewarmed)
+		return;
+
+	_kickPrewarmed = false;
+	TcpKickRelease(_pipelineConfig.camera);
+}
+
+void MediaSource::ReloadPipelineConfig(HANDLE cancelEvent)
+{
+	// Only the frame source can change under running streams; stream sizes, StreamN subkeys
+	// and the allocator are negotiated with the client and apply the next time it opens the camera.
+	// Only this watcher thread writes _pipelineConfig after Initialize, so the snapshot stays
+	// current while the reload runs without _lock.
+	VCamPipelineConfig current;
+	std::shared_ptr<ReloadableFrameSource> frameSource;
+	{
+		winrt::slim_lock_guard lock(_lock);
+		if (!_queue)
+			return;
+
+		current = _pipelineConfig;
+		frameSource = _frameSource;
+	}
+
+	VCamPipelineConfig config;
+	config.camera = current.camera;
+	LoadPipelineConfigFromRegistry(_configPath, &config);
+	if (!PipelineConfigChangesSource(current, config))
+	{
+		return;
+	}
+
+	WINTRACE(
+		L"MediaSource::ReloadPipelineConfig camera:%u width:%u height:%u fps:%u/%u pipeline:%s",
+		config.camera,
+		config.width,
+		config.height,
+		config.fpsNumerator,
+		config.fpsDenominator,
+		config.pipeline.c_str());
+	const auto hr = frameSource->Reload(config, cancelEvent);
+	if (hr == HRESULT_FROM_WIN32(ERROR_CANCELLED))
+		return;
+
+	if (SUCCEEDED_LOG(hr))
+	{
+		winrt::slim_lock_guard lock(_lock);
+		_pipelineConfig = config;
+	}
+}
+
 int MediaSource::GetStreamIndexById(DWORD id)
 {
 	for (uint32_t i = 0; i < _streams.size(); i++)
@@ -212,6 +346,8 @@ STDMETHODIMP MediaSource::Pause()
 STDMETHODIMP MediaSource::Shutdown()
 {
 	WINTRACE(L"MediaSource::Shutdown");
+	// Outside _lock: a reload in progress is cancelled and returns before the streams go away.
+	_configWatcher.Stop();
 	winrt::slim_lock_guard lock(_lock);
 	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
 
@@ -222,6 +358,7 @@ STDMETHODIMP MediaSource::Shutdown()
 	{
 		_streams[i]->Shutdown();
 	}
+	ReleasePrewarm_NoLock();
 
 	_descriptor.reset();
 	_attributes.reset();
@@ -234,6 +371,12 @@ STDMETHODIMP MediaSource::Start(IMFPresentationDescriptor* pPresentationDescript
 	RETURN_HR_IF_NULL(E_POINTER, pPresentationDescriptor);
 	RETURN_HR_IF_NULL(E_POINTER, pvarStartPosition);
 	RETURN_HR_IF_MSG(E_INVALIDARG, pguidTimeFormat && *pguidTimeFormat != GUID_NULL, "Unsupported guid time format");
+
+	// Only sources that actually stream watch their key; FrameServer creates and drops several
+	// that never start. Outside _lock, like the Stop in Shutdown, since a reload takes _lock.
+	// Without the key there is nothing to watch and the defaults stay in effect.
+	LOG_IF_FAILED_MSG(_configWatcher.Start(_configPath, [this]() { ReloadPipelineConfig(_configWatcher.GetStopEvent()); }), "Config changes will need the camera to be reopened");
+
 	winrt::slim_lock_guard lock(_lock);
 	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue || !_descriptor);
 
@@ -373,7 +516,7 @@ STDMETHODIMP MediaSource::GetService(REFGUID siid, REFIID iid, LPVOID* ppvObject
 	RETURN_HR_IF_NULL(E_POINTER, ppvObject);
 	*ppvObject = nullptr;
 
-	WINTRACE(L"MediaSource::GetService siid '%s' iid '%s'", GUID_ToStringW(siid).c_str(), GUID_ToStringW(iid).c_str());
+	WINTRACE(L"MediaSource::GetService siid '%s' iid '%s'", GUID_ToName(siid).c_str(), GUID_ToName(iid).c_str());
 
 	// Expose interfaces this source already implements.
 	const auto qiHr = QueryInterface(iid, ppvObject);
@@ -385,7 +528,7 @@ STDMETHODIMP MediaSource::GetService(REFGUID siid, REFIID iid, LPVOID* ppvObject
 	if (iid == __uuidof(IMFDeviceController) || iid == __uuidof(IMFDeviceController2))
 		return MF_E_UNSUPPORTED_SERVICE;
 
-	WINTRACE(L"MediaSource::GetService unsupported siid '%s' iid '%s' qih:0x%08X", GUID_ToStringW(siid).c_str(), GUID_ToStringW(iid).c_str(), qiHr);
+	WINTRACE(L"MediaSource::GetService unsupported siid '%s' iid '%s' qih:0x%08X", GUID_ToName(siid).c_str(), GUID_ToName(iid).c_str(), qiHr);
 	RETURN_HR(MF_E_UNSUPPORTED_SERVICE);
 }
 
@@ -422,21 +565,10 @@ STDMETHODIMP MediaSource::GetAllocatorUsage(DWORD dwOutputStreamID, DWORD* pdwIn
 // IKsControl
 STDMETHODIMP_(NTSTATUS) MediaSource::KsProperty(PKSPROPERTY property, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
 {
-	WINTRACE(L"MediaSource::KsProperty len:%u data:%p dataLength:%u", length, data, dataLength);
-	RETURN_HR_IF_NULL(E_POINTER, property);
-	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
-	winrt::slim_lock_guard lock(_lock);
-
-	WINTRACE(L"MediaSource::KsProperty prop:%s", PKSIDENTIFIER_ToString(property, length).c_str());
-
-	// right now, we don't expose any property, but this is where we'll typically be asked for
-	// 
-	// KSPROPSETID_Pin, KSPROPSETID_Topology, PROPSETID_VIDCAP_CAMERACONTROL, PROPSETID_VIDCAP_VIDEOPROCAMP
-	// PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST, KSPROPERTYSETID_PerFrameSettingControl, KSPROPERTYSETID_ExtendedCameraControl
-	// 
-	// etc
-
-	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
+	// No lock: answers come from the static table in KsProperties.cpp.
+	const auto hr = KsPropertyFromTable(property, length, data, dataLength, bytesReturned);
+	WINTRACE_EX(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_LIFECYCLE, L"MediaSource::KsProperty prop:%s dataLength:%u hr:0x%08X", property ? PKSIDENTIFIER_ToString(property, length).c_str() : L"<null>", dataLength, hr);
+	return hr;
 }
 
 STDMETHODIMP_(NTSTATUS) MediaSource::KsMethod(PKSMETHOD method, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
@@ -444,8 +576,6 @@ STDMETHODIMP_(NTSTATUS) MediaSource::KsMethod(PKSMETHOD method, ULONG length, LP
 	WINTRACE(L"MediaSource::KsMethod len:%u data:%p dataLength:%u", length, data, dataLength);
 	RETURN_HR_IF_NULL(E_POINTER, method);
 	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
-	winrt::slim_lock_guard lock(_lock);
-
 	WINTRACE(L"MediaSource::KsMethod method:%s", PKSIDENTIFIER_ToString(method, length).c_str());
 
 	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
@@ -455,8 +585,6 @@ STDMETHODIMP_(NTSTATUS) MediaSource::KsEvent(PKSEVENT evt, ULONG length, LPVOID
 {
 	WINTRACE(L"MediaSource::KsEvent evt:%p len:%u data:%p dataLength:%u", evt, length, data, dataLength);
 	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
-	winrt::slim_lock_guard lock(_lock);
-
 	WINTRACE(L"MediaSource::KsEvent event:%s", PKSIDENTIFIER_ToString(evt, length).c_str());
 	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
 }
@@ -2,6 +2,8 @@
 
 #include "MFTools.h"
 #include "MediaStream.h"
+#include "ReloadableFrameSource.h"
+#include "ConfigWatcher.h"
 
 struct MediaSource : winrt::implements<MediaSource, CBaseAttributes<IMFAttributes>, IMFMediaSourceEx, IMFGetService, IKsControl, IMFSampleAllocatorControl>
 {
@@ -41,18 +43,16 @@ public:
 	STDMETHOD_(NTSTATUS, KsEvent)(PKSEVENT Event, ULONG EventLength, LPVOID EventData, ULONG DataLength, ULONG* BytesReturned);
 
 public:
-	MediaSource() :
-		_streams(_numStreams)
+	MediaSource()
 	{
 		SetBaseAttributesTraceName(L"MediaSourceAtts");
-		for (auto i = 0; i < _numStreams; i++)
-		{
-			auto stream = winrt::make_self<MediaStream>();
-			_streams[i].attach(stream.detach()); // this is needed because of wil+winrt mumbo-jumbo, as "_streams[i] = stream.detach()" just cause one extra AddRef
-		}
 	}
 
-	HRESULT Initialize(IMFAttributes* attributes);
+	~MediaSource();
+
+	HRESULT Initialize(IMFAttributes* attributes, UINT camera);
+	// Tells the kick host this camera is about to be used; called once the source is actually activated.
+	void Prewarm();
 
 private:
 #if _DEBUG
@@ -71,18 +71,29 @@ private:
 			id == winrt::guid_of<IMFMediaSource2>())
 			return E_NOINTERFACE;
 
-		RETURN_HR_MSG(E_NOINTERFACE, "MediaSource QueryInterface failed on IID %s", GUID_ToStringW(id).c_str());
+		RETURN_HR_MSG(E_NOINTERFACE, "MediaSource QueryInterface failed on IID %s", GUID_ToName(id).c_str());
 	}
 #endif
 
 	int GetStreamIndexById(DWORD id);
+	void ReloadPipelineConfig(HANDLE cancelEvent);
+	void ReleasePrewarm_NoLock();
 
 private:
-	const int _numStreams = 1;  // 1 stream for now
+	// Stream 0 uses the main config, streams 1..MaxStreams-1 come from optional StreamN subkeys.
+	static constexpr int MaxStreams = 4;
 	winrt::slim_mutex _lock;
 	winrt::com_array<wil::com_ptr_nothrow<MediaStream>> _streams;
 	wil::com_ptr_nothrow<IMFMediaEventQueue> _queue;
 	wil::com_ptr_nothrow<IMFPresentationDescriptor> _descriptor;
 	VCamPipelineConfig _pipelineConfig;
+	// Set between Prewarm and the matching TcpKickRelease, so a source that is only detached still releases.
+	bool _kickPrewarmed = false;
+	std::vector<VCamPipelineConfig> _streamConfigs;
+	std::wstring _configPath;
+	// Shared by every stream: one pipeline or shm ring, one decode/read per frame.
+	std::shared_ptr<ReloadableFrameSource> _frameSource;
+	// Declared last so its thread is gone before the members it reloads.
+	RegistryConfigWatcher _configWatcher;
 };
 
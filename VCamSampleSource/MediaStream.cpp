@@ -1,147 +1,374 @@
-#include "pch.h"
-#include "Undocumented.h"
-#include "Tools.h"
-#include "EnumNames.h"
-#include "MFTools.h"
+#include "pch.h"
+#include "Undocumented.h"
+#include "Tools.h"
+#include "EnumNames.h"
+#include "MFTools.h"
+#include "FrameSource.h"
 #include "GstPipelineSource.h"
+#include "FrameScaler.h"
+#include "RequestGovernor.h"
+#include "CadenceEstimator.h"
+#include "CpuSamplePool.h"
+#include "SampleDepth.h"
+#include "Metrics.h"
 #include "TcpKick.h"
+#include "ActivationCache.h"
 #include "MediaStream.h"
 #include "MediaSource.h"
-
-HRESULT MediaStream::Initialize(IMFMediaSource* source, int index, const VCamPipelineConfig& config)
-{
-	RETURN_HR_IF_NULL(E_POINTER, source);
-	_source = source;
-	_index = index;
-	_config = config;
-
-	RETURN_IF_FAILED(SetGUID(MF_DEVICESTREAM_STREAM_CATEGORY, PINNAME_VIDEO_CAPTURE));
-	RETURN_IF_FAILED(SetUINT32(MF_DEVICESTREAM_STREAM_ID, index));
-	RETURN_IF_FAILED(SetUINT32(MF_DEVICESTREAM_FRAMESERVER_SHARED, 1));
-	RETURN_IF_FAILED(SetUINT32(MF_DEVICESTREAM_ATTRIBUTE_FRAMESOURCE_TYPES, MFFrameSourceTypes::MFFrameSourceTypes_Color));
-
-	RETURN_IF_FAILED(MFCreateEventQueue(&_queue));
-
-	auto types = wil::make_unique_cotaskmem_array<wil::com_ptr_nothrow<IMFMediaType>>(1);
-
-	wil::com_ptr_nothrow<IMFMediaType> nv12Type;
-	RETURN_IF_FAILED(MFCreateMediaType(&nv12Type));
-	nv12Type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-	nv12Type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
-	nv12Type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
-	nv12Type->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE);
-	MFSetAttributeSize(nv12Type.get(), MF_MT_FRAME_SIZE, _config.width, _config.height);
-	nv12Type->SetUINT32(MF_MT_DEFAULT_STRIDE, _config.width);
-	MFSetAttributeRatio(nv12Type.get(), MF_MT_FRAME_RATE, _config.fpsNumerator, _config.fpsDenominator);
-
-	auto bitrate = static_cast<uint32_t>((static_cast<double>(_config.width) * _config.height * 3.0 / 2.0) * 8.0 * _config.fpsNumerator / _config.fpsDenominator);
-	nv12Type->SetUINT32(MF_MT_AVG_BITRATE, bitrate);
-	MFSetAttributeRatio(nv12Type.get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
-	types[0] = nv12Type.detach();
-
-	RETURN_IF_FAILED_MSG(MFCreateStreamDescriptor(_index, (DWORD)types.size(), types.get(), &_descriptor), "MFCreateStreamDescriptor failed");
-
-	wil::com_ptr_nothrow<IMFMediaTypeHandler> handler;
-	RETURN_IF_FAILED(_descriptor->GetMediaTypeHandler(&handler));
-	TraceMFAttributes(handler.get(), L"MediaTypeHandler");
-	RETURN_IF_FAILED(handler->SetCurrentMediaType(types[0]));
-	_frameDuration = static_cast<LONGLONG>(10000000.0 * _config.fpsDenominator / _config.fpsNumerator);
-
-	return S_OK;
-}
-
+
+namespace
+{
+	PCWSTR SampleBacking_ToString(SampleBacking backing)
+	{
+		switch (backing)
+		{
+		case SampleBacking::SystemMemory:
+			return L"system-memory";
+		case SampleBacking::Gpu:
+			return L"gpu";
+		case SampleBacking::SourcePool:
+			return L"source-pool";
+		default:
+			return L"unknown";
+		}
+	}
+
+	// Allocates one sample and inspects its first buffer: DXGI-backed buffers live in a GPU
+	// surface, so every CPU write into them turns into an upload.
+	SampleBacking ProbeAllocatorBacking(IMFVideoSampleAllocatorEx* allocator)
+	{
+		wil::com_ptr_nothrow<IMFSample> sample;
+		wil::com_ptr_nothrow<IMFMediaBuffer> buffer;
+		if (FAILED(allocator->AllocateSample(&sample)) || FAILED(sample->GetBufferByIndex(0, &buffer)))
+		{
+			return SampleBacking::Unknown;
+		}
+
+		wil::com_ptr_nothrow<IMFDXGIBuffer> dxgiBuffer;
+		if (SUCCEEDED(buffer->QueryInterface(IID_PPV_ARGS(&dxgiBuffer))))
+		{
+			return SampleBacking::Gpu;
+		}
+		return SampleBacking::SystemMemory;
+	}
+}
+
+HRESULT MediaStream::Initialize(IMFMediaSource* source, int index, const VCamPipelineConfig& sourceConfig, const VCamPipelineConfig& config, std::shared_ptr<FrameSource> frameSource)
+{
+	RETURN_HR_IF_NULL(E_POINTER, source);
+	RETURN_HR_IF_NULL(E_POINTER, frameSource);
+	_source = source;
+	_index = index;
+	_sourceConfig = sourceConfig;
+	_config = config;
+	_frameSource = std::move(frameSource);
+	_scaler.SetOutputSize(_config.width, _config.height);
+	_scaler.SetLetterbox(_config.scaleMode == VCamScaleMode::Letterbox);
+	_metricPrefix = _config.camera ? std::format("cam{}.stream{}.", _config.camera, _index) : std::format("stream{}.", _index);
+	_copyLatency = LatencyGet((_metricPrefix + "latency.copy").c_str());
+	_queueLatency = LatencyGet((_metricPrefix + "latency.queue").c_str());
+	WINTRACE(
+		L"MediaStream::Initialize stream:%i output:%ux%u@%u/%u pipeline:%ux%u%s",
+		_index,
+		_config.width,
+		_config.height,
+		_config.fpsNumerator,
+		_config.fpsDenominator,
+		_sourceConfig.width,
+		_sourceConfig.height,
+		_scaler.IsScaling(_sourceConfig.width, _sourceConfig.height) ? L" (scaled)" : L"");
+
+	// The first stream is the capture pin, additional ones are exposed as preview pins.
+	RETURN_IF_FAILED(SetGUID(MF_DEVICESTREAM_STREAM_CATEGORY, index == 0 ? PINNAME_VIDEO_CAPTURE : PINNAME_VIDEO_PREVIEW));
+	RETURN_IF_FAILED(SetUINT32(MF_DEVICESTREAM_STREAM_ID, index));
+	RETURN_IF_FAILED(SetUINT32(MF_DEVICESTREAM_FRAMESERVER_SHARED, 1));
+	RETURN_IF_FAILED(SetUINT32(MF_DEVICESTREAM_ATTRIBUTE_FRAMESOURCE_TYPES, MFFrameSourceTypes::MFFrameSourceTypes_Color));
+
+	RETURN_IF_FAILED(MFCreateEventQueue(&_queue));
+
+	auto types = wil::make_unique_cotaskmem_array<wil::com_ptr_nothrow<IMFMediaType>>(1);
+
+	RETURN_IF_FAILED(ActivationCacheCreateMediaType(_config, &types[0]));
+
+	RETURN_IF_FAILED_MSG(MFCreateStreamDescriptor(_index, (DWORD)types.size(), types.get(), &_descriptor), "MFCreateStreamDescriptor failed");
+
+	wil::com_ptr_nothrow<IMFMediaTypeHandler> handler;
+	RETURN_IF_FAILED(_descriptor->GetMediaTypeHandler(&handler));
+	TraceMFAttributes(handler.get(), L"MediaTypeHandler");
+	RETURN_IF_FAILED(handler->SetCurrentMediaType(types[0]));
+	_frameDuration = static_cast<LONGLONG>(10000000.0 * _config.fpsDenominator / _config.fpsNumerator);
+
+	return S_OK;
+}
+
 HRESULT MediaStream::Start(IMFMediaType* type)
 {
 	// Serialize lifecycle transitions with RequestSample and Stop/Shutdown.
 	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue || !_allocator);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue || (!_allocator && RequiresProvidedAllocator()));
 	if (_state == MF_STREAM_STATE_RUNNING)
 	{
 		return S_OK;
 	}
+
+	if (_state == MF_STREAM_STATE_PAUSED)
+	{
+		// Resuming: the frame source, kick stream and samples taken by the first Start are still
+		// held, and the frame source counts every Start, so only the state changes.
+		RETURN_IF_FAILED(_queue->QueueEventParamVar(MEStreamStarted, GUID_NULL, S_OK, nullptr));
+		_state = MF_STREAM_STATE_RUNNING;
+		return S_OK;
+	}
+
 	WINTRACE(
 		L"MediaStream::Start config width:%u height:%u fps:%u/%u",
 		_config.width,
-		_config.height,
-		_config.fpsNumerator,
-		_config.fpsDenominator);
-
-	wil::com_ptr_nothrow<IMFMediaType> currentType;
-	if (!type)
-	{
-		wil::com_ptr_nothrow<IMFMediaTypeHandler> handler;
-		RETURN_IF_FAILED(_descriptor->GetMediaTypeHandler(&handler));
-		RETURN_IF_FAILED(handler->GetCurrentMediaType(&currentType));
-		type = currentType.get();
-	}
-
+		_config.height,
+		_config.fpsNumerator,
+		_config.fpsDenominator);
+
+	wil::com_ptr_nothrow<IMFMediaType> currentType;
+	if (!type)
+	{
+		wil::com_ptr_nothrow<IMFMediaTypeHandler> handler;
+		RETURN_IF_FAILED(_descriptor->GetMediaTypeHandler(&handler));
+		RETURN_IF_FAILED(handler->GetCurrentMediaType(&currentType));
+		type = currentType.get();
+	}
+
 	if (type)
 	{
 		RETURN_IF_FAILED(type->GetGUID(MF_MT_SUBTYPE, &_format));
-		WINTRACE(L"MediaStream::Start format: %s", GUID_ToStringW(_format).c_str());
+		WINTRACE(L"MediaStream::Start format: %s", GUID_ToName(_format).c_str());
 	}
 
 	RETURN_HR_IF_MSG(MF_E_INVALIDMEDIATYPE, _format != MFVideoFormat_NV12, "Only NV12 stream format is supported");
-	RETURN_IF_FAILED_MSG(TcpKickConnectFromRegistry(), "TcpKickConnectFromRegistry failed");
-	const auto startHr = _pipelineSource.Start(_config);
+	RETURN_IF_FAILED_MSG(TcpKickStart(_sourceConfig.camera), "TcpKickStart failed");
+	const auto startHr = _frameSource->Start(_sourceConfig);
 	if (FAILED(startHr))
 	{
-		TcpKickDisconnect();
+		TcpKickStop(_sourceConfig.camera);
 		return startHr;
 	}
-
-	RETURN_IF_FAILED(_allocator->InitializeSampleAllocator(10, type));
-	RETURN_IF_FAILED(_queue->QueueEventParamVar(MEStreamStarted, GUID_NULL, S_OK, nullptr));
+
+	const auto samplesHr = InitializeSamples(type);
+	if (FAILED(samplesHr))
+	{
+		_frameSource->Stop();
+		TcpKickStop(_sourceConfig.camera);
+		RETURN_HR(samplesHr);
+	}
+
+	const auto startedHr = _queue->QueueEventParamVar(MEStreamStarted, GUID_NULL, S_OK, nullptr);
+	if (FAILED(startedHr))
+	{
+		LOG_IF_FAILED(UninitializeSamples_NoLock());
+		_frameSource->Stop();
+		TcpKickStop(_sourceConfig.camera);
+		RETURN_HR(startedHr);
+	}
 	_state = MF_STREAM_STATE_RUNNING;
 	_lastDeliveredFrameId = 0;
+	_governor.Reset(_frameDuration);
+	_phaseLock.Reset(_frameDuration);
+	_requestAfterDelivery = false;
+	_holdCount = 0;
+	OpenRecorder_NoLock();
 	return S_OK;
 }
-
+
+void MediaStream::OpenRecorder_NoLock()
+{
+	// Only the primary stream is recorded; the others carry the same frames at other sizes.
+	if (_index != 0 || _config.recordDirectory.empty() || !_config.replayPath.empty())
+	{
+		return;
+	}
+
+	SYSTEMTIME now{};
+	GetLocalTime(&now);
+	const auto path = std::format(
+		L"{}\\vcam-{}-{:04}{:02}{:02}-{:02}{:02}{:02}.vcrec",
+		_config.recordDirectory,
+		_config.camera,
+		now.wYear,
+		now.wMonth,
+		now.wDay,
+		now.wHour,
+		now.wMinute,
+		now.wSecond);
+	LOG_IF_FAILED_MSG(_recorder.Open(path, _config.width, _config.height, _config.fpsNumerator, _config.fpsDenominator, _config.recordMaxFrames), "Recording disabled");
+}
+
 HRESULT MediaStream::Stop()
 {
 	// Stop can race with frame requests when clients switch cameras.
 	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue || !_allocator);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue || (!_allocator && RequiresProvidedAllocator()));
 	if (_state == MF_STREAM_STATE_STOPPED)
 	{
 		return S_OK;
 	}
 
-	RETURN_IF_FAILED(_allocator->UninitializeSampleAllocator());
-	_pipelineSource.Stop();
-	TcpKickDisconnect();
+	RETURN_IF_FAILED(UninitializeSamples_NoLock());
+	_frameSource->Stop();
+	TcpKickStop(_sourceConfig.camera);
+	_recorder.Close();
 	RETURN_IF_FAILED(_queue->QueueEventParamVar(MEStreamStopped, GUID_NULL, S_OK, nullptr));
 	_state = MF_STREAM_STATE_STOPPED;
 	_lastDeliveredFrameId = 0;
 	return S_OK;
 }
-
-MFSampleAllocatorUsage MediaStream::GetAllocatorUsage()
-{
-	return MFSampleAllocatorUsage_UsesProvidedAllocator;
-}
-
-HRESULT MediaStream::SetAllocator(IUnknown* allocator)
-{
-	RETURN_HR_IF_NULL(E_POINTER, allocator);
-	_allocator.reset();
-	RETURN_HR(allocator->QueryInterface(&_allocator));
-}
-
-HRESULT MediaStream::SetD3DManager(IUnknown* manager)
-{
-	RETURN_HR_IF_NULL(E_POINTER, manager);
-	// This stream writes CPU NV12 bytes from GStreamer appsink.
-	// Keep this as a no-op so allocator remains CPU-backed.
-	return S_OK;
-}
-
+
+MFSampleAllocatorUsage MediaStream::GetAllocatorUsage()
+{
+	// With the CPU pool the stream owns its samples, so writes never land in a GPU surface.
+	// Auto mode still asks for the provided allocator and falls back at Start if it is GPU-backed.
+	return _config.sampleAllocator == VCamSampleAllocatorMode::CpuPool ? MFSampleAllocatorUsage_UsesCustomAllocator : MFSampleAllocatorUsage_UsesProvidedAllocator;
+}
+
+HRESULT MediaStream::UninitializeSamples_NoLock()
+{
+	if (_usingSamplePool)
+	{
+		_samplePool->Uninitialize();
+		_usingSamplePool = false;
+	}
+	else
+	{
+		RETURN_IF_FAILED(_allocator->UninitializeSampleAllocator());
+	}
+	_allocatorCallback.reset();
+	_sampleType.reset();
+	return S_OK;
+}
+
+HRESULT MediaStream::InitializeSamples(IMFMediaType* type)
+{
+	// Depth comes from frame size and the memory budget, then tracks outstanding samples at runtime.
+	// Frames are budgeted at the CPU pool's padded size, also a fair bound for provided samples.
+	const auto frameBytes = Nv12BufferLayout::Aligned(_config.width, _config.height, CpuSamplePool::Alignment).PitchedLength();
+	_sampleDepth.Reset(frameBytes, static_cast<uint64_t>(_config.sampleMemoryBudgetMB) * 1024 * 1024);
+	const auto depth = _sampleDepth.GetDepth();
+	_sampleType = type;
+	_allocatorCallback.reset();
+
+	auto usePool = _config.sampleAllocator == VCamSampleAllocatorMode::CpuPool || !_allocator;
+	auto backing = SampleBacking::SourcePool;
+	auto fallback = false;
+	if (!usePool)
+	{
+		RETURN_IF_FAILED(_allocator->InitializeSampleAllocator(depth, type));
+		backing = ProbeAllocatorBacking(_allocator.get());
+		if (backing == SampleBacking::Gpu && _config.sampleAllocator == VCamSampleAllocatorMode::Auto)
+		{
+			LOG_IF_FAILED(_allocator->UninitializeSampleAllocator());
+			usePool = true;
+			fallback = true;
+		}
+	}
+
+	if (usePool)
+	{
+		if (!_samplePool)
+		{
+			_samplePool = winrt::make_self<CpuSamplePool>();
+		}
+		RETURN_IF_FAILED(_samplePool->Initialize(_config.width, _config.height, depth));
+	}
+	else
+	{
+		// Optional: lets us observe how many provided samples the consumer keeps outstanding.
+		std::ignore = _allocator->QueryInterface(IID_PPV_ARGS(&_allocatorCallback));
+	}
+
+	_usingSamplePool = usePool;
+	_sampleBacking = backing;
+	_sampleDepth.SetShrinkEnabled(usePool);
+	WINTRACE(
+		L"MediaStream::Start stream:%i allocator mode:%u backing:%s using:%s fallback:%u depth:%u max:%u",
+		_index,
+		static_cast<UINT>(_config.sampleAllocator),
+		SampleBacking_ToString(backing),
+		usePool ? L"source-pool" : L"provided",
+		fallback ? 1 : 0,
+		depth,
+		_sampleDepth.GetMaxDepth());
+
+	const auto prefix = _metricPrefix + "allocator.";
+	MetricsGet((prefix + "backing").c_str())->Set(static_cast<int64_t>(backing));
+	MetricsGet((prefix + "sourcepool").c_str())->Set(usePool ? 1 : 0);
+	if (fallback)
+	{
+		MetricsGet((prefix + "fallbacks").c_str())->Add(1);
+	}
+	_depthMetric = MetricsGet((prefix + "depth").c_str());
+	_highWaterMetric = MetricsGet((prefix + "highwater").c_str());
+	_resizeMetric = MetricsGet((prefix + "resizes").c_str());
+	_depthMetric->Set(depth);
+	_highWaterMetric->Set(0);
+	return S_OK;
+}
+
+UINT MediaStream::GetOutstandingSamples_NoLock()
+{
+	if (_usingSamplePool)
+	{
+		return _samplePool->GetOutstandingCount();
+	}
+
+	LONG freeSamples = 0;
+	if (!_allocatorCallback || FAILED(_allocatorCallback->GetFreeSampleCount(&freeSamples)))
+	{
+		return 0;
+	}
+	const auto depth = static_cast<LONG>(_sampleDepth.GetDepth());
+	return freeSamples < depth ? static_cast<UINT>(depth - freeSamples) : 0;
+}
+
+HRESULT MediaStream::ResizeSamples_NoLock(UINT depth)
+{
+	WINTRACE(L"MediaStream::ResizeSamples stream:%i depth:%u highWater:%u", _index, depth, _sampleDepth.GetHighWaterMark());
+	_resizeMetric->Add(1);
+	_depthMetric->Set(depth);
+	if (_usingSamplePool)
+	{
+		RETURN_HR(_samplePool->Resize(depth));
+	}
+
+	// Only reached to grow (see SetShrinkEnabled). Outstanding provided samples stay valid across
+	// re-initialization and are released normally.
+	RETURN_HR_IF(MF_E_NOT_INITIALIZED, !_allocator || !_sampleType);
+	RETURN_IF_FAILED(_allocator->UninitializeSampleAllocator());
+	RETURN_HR(_allocator->InitializeSampleAllocator(depth, _sampleType.get()));
+}
+
+HRESULT MediaStream::SetAllocator(IUnknown* allocator)
+{
+	RETURN_HR_IF_NULL(E_POINTER, allocator);
+	_allocator.reset();
+	RETURN_HR(allocator->QueryInterface(&_allocator));
+}
+
+HRESULT MediaStream::SetD3DManager(IUnknown* manager)
+{
+	RETURN_HR_IF_NULL(E_POINTER, manager);
+	// This stream writes CPU NV12 bytes from GStreamer appsink.
+	// Keep this as a no-op so allocator remains CPU-backed.
+	return S_OK;
+}
+
 void MediaStream::Shutdown()
 {
 	// Hold the same lock used by request/start/stop so teardown is ordered.
 	winrt::slim_lock_guard lock(_lock);
-	_pipelineSource.Stop();
-	TcpKickDisconnect();
+	if (_frameSource && _state != MF_STREAM_STATE_STOPPED)
+	{
+		// Release this stream's share; the pipeline and kick stay up for sibling streams.
+		_frameSource->Stop();
+		TcpKickStop(_sourceConfig.camera);
+		_recorder.Close();
+	}
 
 	if (_queue)
 	{
@@ -149,6 +376,14 @@ void MediaStream::Shutdown()
 		_queue.reset();
 	}
 
+	if (_samplePool)
+	{
+		_samplePool->Uninitialize();
+		_samplePool = nullptr;
+	}
+	_usingSamplePool = false;
+	_allocatorCallback.reset();
+	_sampleType.reset();
 	_allocator.reset();
 	_descriptor.reset();
 	_source.reset();
@@ -156,118 +391,168 @@ void MediaStream::Shutdown()
 	_state = MF_STREAM_STATE_STOPPED;
 	_lastDeliveredFrameId = 0;
 }
-
-// IMFMediaEventGenerator
-STDMETHODIMP MediaStream::BeginGetEvent(IMFAsyncCallback* pCallback, IUnknown* punkState)
-{
-	//WINTRACE(L"MediaSource::BeginGetEvent");
-	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
-
-	RETURN_IF_FAILED(_queue->BeginGetEvent(pCallback, punkState));
-	return S_OK;
-}
-
-STDMETHODIMP MediaStream::EndGetEvent(IMFAsyncResult* pResult, IMFMediaEvent** ppEvent)
-{
-	//WINTRACE(L"MediaStream::EndGetEvent");
-	RETURN_HR_IF_NULL(E_POINTER, ppEvent);
-	*ppEvent = nullptr;
-	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
-
-	RETURN_IF_FAILED(_queue->EndGetEvent(pResult, ppEvent));
-	return S_OK;
-}
-
-STDMETHODIMP MediaStream::GetEvent(DWORD dwFlags, IMFMediaEvent** ppEvent)
-{
-	WINTRACE(L"MediaStream::GetEvent");
-	RETURN_HR_IF_NULL(E_POINTER, ppEvent);
-	*ppEvent = nullptr;
-	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
-
-	RETURN_IF_FAILED(_queue->GetEvent(dwFlags, ppEvent));
-	return S_OK;
-}
-
-STDMETHODIMP MediaStream::QueueEvent(MediaEventType met, REFGUID guidExtendedType, HRESULT hrStatus, const PROPVARIANT* pvValue)
-{
-	WINTRACE(L"MediaStream::QueueEvent");
-	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
-
-	RETURN_IF_FAILED(_queue->QueueEventParamVar(met, guidExtendedType, hrStatus, pvValue));
-	return S_OK;
-}
-
-// IMFMediaStream
-STDMETHODIMP MediaStream::GetMediaSource(IMFMediaSource** ppMediaSource)
-{
-	WINTRACE(L"MediaSource::GetMediaSource");
-	RETURN_HR_IF_NULL(E_POINTER, ppMediaSource);
-	*ppMediaSource = nullptr;
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_source);
-
-	RETURN_IF_FAILED(_source.copy_to(ppMediaSource));
-	return S_OK;
-}
-
-STDMETHODIMP MediaStream::GetStreamDescriptor(IMFStreamDescriptor** ppStreamDescriptor)
-{
-	WINTRACE(L"MediaStream::GetStreamDescriptor");
-	RETURN_HR_IF_NULL(E_POINTER, ppStreamDescriptor);
-	*ppStreamDescriptor = nullptr;
-	winrt::slim_lock_guard lock(_lock);
-	RETURN_HR_IF(MF_E_SHUTDOWN, !_descriptor);
-
-	RETURN_IF_FAILED(_descriptor.copy_to(ppStreamDescriptor));
-	return S_OK;
-}
-
+
+// IMFMediaEventGenerator
+STDMETHODIMP MediaStream::BeginGetEvent(IMFAsyncCallback* pCallback, IUnknown* punkState)
+{
+	//WINTRACE(L"MediaSource::BeginGetEvent");
+	winrt::slim_lock_guard lock(_lock);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
+
+	RETURN_IF_FAILED(_queue->BeginGetEvent(pCallback, punkState));
+	return S_OK;
+}
+
+STDMETHODIMP MediaStream::EndGetEvent(IMFAsyncResult* pResult, IMFMediaEvent** ppEvent)
+{
+	//WINTRACE(L"MediaStream::EndGetEvent");
+	RETURN_HR_IF_NULL(E_POINTER, ppEvent);
+	*ppEvent = nullptr;
+	winrt::slim_lock_guard lock(_lock);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
+
+	RETURN_IF_FAILED(_queue->EndGetEvent(pResult, ppEvent));
+	return S_OK;
+}
+
+STDMETHODIMP MediaStream::GetEvent(DWORD dwFlags, IMFMediaEvent** ppEvent)
+{
+	WINTRACE(L"MediaStream::GetEvent");
+	RETURN_HR_IF_NULL(E_POINTER, ppEvent);
+	*ppEvent = nullptr;
+	winrt::slim_lock_guard lock(_lock);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
+
+	RETURN_IF_FAILED(_queue->GetEvent(dwFlags, ppEvent));
+	return S_OK;
+}
+
+STDMETHODIMP MediaStream::QueueEvent(MediaEventType met, REFGUID guidExtendedType, HRESULT hrStatus, const PROPVARIANT* pvValue)
+{
+	WINTRACE(L"MediaStream::QueueEvent");
+	winrt::slim_lock_guard lock(_lock);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue);
+
+	RETURN_IF_FAILED(_queue->QueueEventParamVar(met, guidExtendedType, hrStatus, pvValue));
+	return S_OK;
+}
+
+// IMFMediaStream
+STDMETHODIMP MediaStream::GetMediaSource(IMFMediaSource** ppMediaSource)
+{
+	WINTRACE(L"MediaSource::GetMediaSource");
+	RETURN_HR_IF_NULL(E_POINTER, ppMediaSource);
+	*ppMediaSource = nullptr;
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_source);
+
+	RETURN_IF_FAILED(_source.copy_to(ppMediaSource));
+	return S_OK;
+}
+
+STDMETHODIMP MediaStream::GetStreamDescriptor(IMFStreamDescriptor** ppStreamDescriptor)
+{
+	WINTRACE(L"MediaStream::GetStreamDescriptor");
+	RETURN_HR_IF_NULL(E_POINTER, ppStreamDescriptor);
+	*ppStreamDescriptor = nullptr;
+	winrt::slim_lock_guard lock(_lock);
+	RETURN_HR_IF(MF_E_SHUTDOWN, !_descriptor);
+
+	RETURN_IF_FAILED(_descriptor.copy_to(ppStreamDescriptor));
+	return S_OK;
+}
+
 STDMETHODIMP MediaStream::RequestSample(IUnknown* pToken)
 {
 	//WINTRACE(L"MediaStream::RequestSample pToken:%p", pToken);
 	wil::com_ptr_nothrow<IMFVideoSampleAllocatorEx> allocator;
+	winrt::com_ptr<CpuSamplePool> samplePool;
 	wil::com_ptr_nothrow<IMFMediaEventQueue> queue;
 	LONGLONG frameDuration = 0;
 	uint64_t lastDeliveredFrameId = 0;
+	LONGLONG expectedArrival = 0;
+	LONGLONG holdTime = 0;
 	{
 		// Snapshot mutable state, then release the stream lock for heavy per-frame work.
 		winrt::slim_lock_guard lock(_lock);
-		RETURN_HR_IF(MF_E_SHUTDOWN, !_allocator || !_queue);
+		RETURN_HR_IF(MF_E_SHUTDOWN, (!_allocator && !_usingSamplePool) || !_queue);
 		RETURN_HR_IF(MF_E_INVALIDREQUEST, _state != MF_STREAM_STATE_RUNNING);
 		allocator = _allocator;
+		if (_usingSamplePool)
+		{
+			samplePool = _samplePool;
+		}
 		queue = _queue;
 		frameDuration = _frameDuration;
 		lastDeliveredFrameId = _lastDeliveredFrameId;
+
+		const auto now = MFGetSystemTime();
+		_phaseLock.OnRequest(now, _requestAfterDelivery);
+		_phaseLock.OnFrameTime(_frameSource->GetLatestFrameTime());
+		_requestAfterDelivery = false;
+		expectedArrival = _phaseLock.ExpectedArrival(now);
+		holdTime = _phaseLock.HoldTime(now);
 	}
 
 	uint64_t latestFrameId = 0;
-	if (!_pipelineSource.HasNewFrameSince(lastDeliveredFrameId, &latestFrameId))
+	if (!_frameSource->HasNewFrameSince(lastDeliveredFrameId, &latestFrameId) && !BackoffUntilNewFrame(lastDeliveredFrameId, expectedArrival, holdTime))
 	{
-		std::this_thread::yield();
 		return S_OK;
 	}
 
 	wil::com_ptr_nothrow<IMFSample> sample;
-	RETURN_IF_FAILED(allocator->AllocateSample(&sample));
+	auto allocateHr = samplePool ? samplePool->AllocateSample(&sample) : allocator->AllocateSample(&sample);
+	if (allocateHr == MF_E_SAMPLEALLOCATOR_EMPTY)
+	{
+		// The consumer holds every sample: grow within the memory budget and retry once.
+		{
+			winrt::slim_lock_guard lock(_lock);
+			RETURN_HR_IF(MF_E_INVALIDREQUEST, _state != MF_STREAM_STATE_RUNNING);
+			const auto depth = _sampleDepth.OnPoolEmpty(GetOutstandingSamples_NoLock());
+			if (depth)
+			{
+				RETURN_IF_FAILED(ResizeSamples_NoLock(depth));
+			}
+		}
+		allocateHr = samplePool ? samplePool->AllocateSample(&sample) : allocator->AllocateSample(&sample);
+	}
+	RETURN_IF_FAILED(allocateHr);
 	RETURN_IF_FAILED(sample->SetSampleTime(MFGetSystemTime()));
 	RETURN_IF_FAILED(sample->SetSampleDuration(frameDuration));
-
-	wil::com_ptr_nothrow<IMFMediaBuffer> mediaBuffer;
-	RETURN_IF_FAILED(sample->GetBufferByIndex(0, &mediaBuffer));
-	wil::com_ptr_nothrow<IMF2DBuffer2> buffer2D;
-	RETURN_IF_FAILED(mediaBuffer->QueryInterface(IID_PPV_ARGS(&buffer2D)));
-
-	BYTE* scanline = nullptr;
+
+	wil::com_ptr_nothrow<IMFMediaBuffer> mediaBuffer;
+	RETURN_IF_FAILED(sample->GetBufferByIndex(0, &mediaBuffer));
+	wil::com_ptr_nothrow<IMF2DBuffer2> buffer2D;
+	RETURN_IF_FAILED(mediaBuffer->QueryInterface(IID_PPV_ARGS(&buffer2D)));
+
+	BYTE* scanline = nullptr;
 	BYTE* start = nullptr;
 	LONG pitch = 0;
 	DWORD length = 0;
 	RETURN_IF_FAILED(buffer2D->Lock2DSize(MF2DBuffer_LockFlags_Write, &scanline, &pitch, &start, &length));
 	uint64_t copiedFrameId = 0;
-	const auto copyHr = _pipelineSource.CopyLatestFrameTo(scanline, pitch, length, lastDeliveredFrameId, &copiedFrameId);
+	const auto copyStart = LatencyNow();
+	const auto copyHr = _frameSource->CopyLatestFrameTo(_scaler, scanline, pitch, length, lastDeliveredFrameId, &copiedFrameId);
+	const auto copyEnd = LatencyNow();
+	if (copyHr == S_OK)
+	{
+		_copyLatency->RecordTicks(copyEnd - copyStart);
+		_recorder.Append(scanline, pitch, _frameSource->GetLatestFrameTime());
+		if (_scaler.GetLayoutVersion() != _scalerLayoutVersion)
+		{
+			_scalerLayoutVersion = _scaler.GetLayoutVersion();
+			WINTRACE(
+				L"MediaStream::RequestSample stream:%i scaling %ux%u -> %ux%u content:%ux%u at %u,%u",
+				_index,
+				_scaler.GetSourceWidth(),
+				_scaler.GetSourceHeight(),
+				_scaler.GetOutputWidth(),
+				_scaler.GetOutputHeight(),
+				_scaler.GetContentWidth(),
+				_scaler.GetContentHeight(),
+				_scaler.GetContentX(),
+				_scaler.GetContentY());
+		}
+	}
 	buffer2D->Unlock2D();
 	if (copyHr == S_FALSE)
 	{
@@ -281,27 +566,92 @@ STDMETHODIMP MediaStream::RequestSample(IUnknown* pToken)
 		RETURN_IF_FAILED(sample->SetUnknown(MFSampleExtension_Token, pToken));
 	}
 	RETURN_IF_FAILED(queue->QueueEventParamUnk(MEMediaSample, GUID_NULL, S_OK, sample.get()));
+	_queueLatency->RecordTicks(LatencyNow() - copyEnd);
+	_governor.OnFrameDelivered();
+	LatencyPublishIfDue();
 
 	{
 		winrt::slim_lock_guard lock(_lock);
 		_requestCount++;
-		const auto now = GetTickCount64();
-		if (_requestCount == 1 || now - _lastRequestTraceTick >= 2000)
+		static WinTraceRateLimit requestTraceLimit;
+		if (WinTraceIsOn(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_FRAMES) && requestTraceLimit.TryAcquire(2000, 1))
 		{
-			_lastRequestTraceTick = now;
-			WINTRACE(
-				L"MediaStream::RequestSample count:%u pitch:%ld length:%u frameId:%llu",
+			const auto stats = _governor.GetStats();
+			WINTRACE_FRAMES(
+				L"MediaStream::RequestSample count:%u pitch:%ld length:%u frameId:%llu misses:%llu spin:%llu yield:%llu sleep:%llu wait:%llu maxRun:%u",
 				_requestCount,
 				pitch,
 				length,
-				copiedFrameId);
+				copiedFrameId,
+				stats.misses,
+				stats.spins,
+				stats.yields,
+				stats.sleeps,
+				stats.waits,
+				stats.maxConsecutiveMisses);
+			WINTRACE_FRAMES(
+				L"MediaStream::RequestSample cadence consumer:%lld/%lld%s producer:%lld/%lld%s holds:%llu",
+				_phaseLock.Consumer().GetPeriod(),
+				_phaseLock.Consumer().GetJitter(),
+				_phaseLock.Consumer().IsLocked() ? L"(locked)" : L"",
+				_phaseLock.Producer().GetPeriod(),
+				_phaseLock.Producer().GetJitter(),
+				_phaseLock.Producer().IsLocked() ? L"(locked)" : L"",
+				_holdCount);
+			WINTRACE_FRAMES(L"Metrics %S", MetricsSnapshot().c_str());
 		}
 		_lastDeliveredFrameId = copiedFrameId;
+		_requestAfterDelivery = true;
+
+		const auto depth = _sampleDepth.OnDelivered(GetOutstandingSamples_NoLock());
+		_highWaterMetric->Set(_sampleDepth.GetHighWaterMark());
+		if (depth)
+		{
+			LOG_IF_FAILED(ResizeSamples_NoLock(depth));
+		}
 	}
 	return S_OK;
 }
-
-// IMFMediaStream2
+
+bool MediaStream::BackoffUntilNewFrame(uint64_t lastDeliveredFrameId, LONGLONG expectedArrival, LONGLONG holdTime)
+{
+	if (holdTime > 0)
+	{
+		// The producer is about to deliver: hold this request rather than answering late next time.
+		{
+			winrt::slim_lock_guard lock(_lock);
+			_holdCount++;
+		}
+		_frameSource->WaitForNewFrame(lastDeliveredFrameId, static_cast<DWORD>((holdTime + 9999) / 10000));
+		if (_frameSource->HasNewFrameSince(lastDeliveredFrameId, nullptr))
+		{
+			return true;
+		}
+	}
+
+	uint32_t waitMs = 0;
+	switch (_governor.OnMiss(MFGetSystemTime(), expectedArrival, &waitMs))
+	{
+	case RequestBackoff::Spin:
+		return false;
+
+	case RequestBackoff::Yield:
+		std::this_thread::yield();
+		break;
+
+	case RequestBackoff::Sleep:
+		Sleep(waitMs);
+		break;
+
+	case RequestBackoff::Wait:
+		// Park until the appsink callback publishes a frame; stop also wakes waiters.
+		_frameSource->WaitForNewFrame(lastDeliveredFrameId, waitMs);
+		break;
+	}
+	return _frameSource->HasNewFrameSince(lastDeliveredFrameId, nullptr);
+}
+
+// IMFMediaStream2
 STDMETHODIMP MediaStream::SetStreamState(MF_STREAM_STATE value)
 {
 	MF_STREAM_STATE currentState = MF_STREAM_STATE_STOPPED;
@@ -320,22 +670,22 @@ STDMETHODIMP MediaStream::SetStreamState(MF_STREAM_STATE value)
 			_state = value;
 		}
 		break;
-
-	case MF_STREAM_STATE_RUNNING:
-		RETURN_IF_FAILED(Start(nullptr));
-		break;
-
-	case MF_STREAM_STATE_STOPPED:
-		RETURN_IF_FAILED(Stop());
-		break;
-
-	default:
-		RETURN_HR(MF_E_INVALID_STATE_TRANSITION);
-		break;
-	}
-	return S_OK;
-}
-
+
+	case MF_STREAM_STATE_RUNNING:
+		RETURN_IF_FAILED(Start(nullptr));
+		break;
+
+	case MF_STREAM_STATE_STOPPED:
+		RETURN_IF_FAILED(Stop());
+		break;
+
+	default:
+		RETURN_HR(MF_E_INVALID_STATE_TRANSITION);
+		break;
+	}
+	return S_OK;
+}
+
 STDMETHODIMP MediaStream::GetStreamState(MF_STREAM_STATE* value)
 {
 	RETURN_HR_IF_NULL(E_POINTER, value);
@@ -344,38 +694,31 @@ STDMETHODIMP MediaStream::GetStreamState(MF_STREAM_STATE* value)
 	*value = _state;
 	return S_OK;
 }
-
-// IKsControl
-STDMETHODIMP_(NTSTATUS) MediaStream::KsProperty(PKSPROPERTY property, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
-{
-	WINTRACE(L"MediaStream::KsProperty len:%u data:%p dataLength:%u", length, data, dataLength);
-	RETURN_HR_IF_NULL(E_POINTER, property);
-	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
-	winrt::slim_lock_guard lock(_lock);
-
-	WINTRACE(L"MediaStream::KsProperty prop:%s", PKSIDENTIFIER_ToString(property, length).c_str());
-
-	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
-}
-
-STDMETHODIMP_(NTSTATUS) MediaStream::KsMethod(PKSMETHOD method, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
-{
-	WINTRACE(L"MediaStream::KsMethod len:%u data:%p dataLength:%u", length, data, dataLength);
-	RETURN_HR_IF_NULL(E_POINTER, method);
-	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
-	winrt::slim_lock_guard lock(_lock);
-
-	WINTRACE(L"MediaStream::KsMethod method:%s", PKSIDENTIFIER_ToString(method, length).c_str());
-
-	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
-}
-
-STDMETHODIMP_(NTSTATUS) MediaStream::KsEvent(PKSEVENT evt, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
-{
-	WINTRACE(L"MediaStream::KsEvent evt:%p len:%u data:%p dataLength:%u", evt, length, data, dataLength);
-	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
-	winrt::slim_lock_guard lock(_lock);
-
-	WINTRACE(L"MediaStream::KsEvent event:%s", PKSIDENTIFIER_ToString(evt, length).c_str());
-	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
-}
+
+// IKsControl
+STDMETHODIMP_(NTSTATUS) MediaStream::KsProperty(PKSPROPERTY property, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
+{
+	RETURN_HR_IF_NULL(E_POINTER, property);
+	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
+	// Stream (pin) properties are not exposed; no lock, probes fail right away.
+	WINTRACE_EX(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_LIFECYCLE, L"MediaStream::KsProperty prop:%s dataLength:%u", PKSIDENTIFIER_ToString(property, length).c_str(), dataLength);
+	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
+}
+
+STDMETHODIMP_(NTSTATUS) MediaStream::KsMethod(PKSMETHOD method, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
+{
+	WINTRACE(L"MediaStream::KsMethod len:%u data:%p dataLength:%u", length, data, dataLength);
+	RETURN_HR_IF_NULL(E_POINTER, method);
+	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
+	WINTRACE(L"MediaStream::KsMethod method:%s", PKSIDENTIFIER_ToString(method, length).c_str());
+
+	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
+}
+
+STDMETHODIMP_(NTSTATUS) MediaStream::KsEvent(PKSEVENT evt, ULONG length, LPVOID data, ULONG dataLength, ULONG* bytesReturned)
+{
+	WINTRACE(L"MediaStream::KsEvent evt:%p len:%u data:%p dataLength:%u", evt, length, data, dataLength);
+	RETURN_HR_IF_NULL(E_POINTER, bytesReturned);
+	WINTRACE(L"MediaStream::KsEvent event:%s", PKSIDENTIFIER_ToString(evt, length).c_str());
+	return HRESULT_FROM_WIN32(ERROR_SET_NOT_FOUND);
+}
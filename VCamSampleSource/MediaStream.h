@@ -1,7 +1,24 @@
 #pragma once
 
 #include "MFTools.h"
+#include "FrameSource.h"
 #include "GstPipelineSource.h"
+#include "FrameScaler.h"
+#include "FrameRecorder.h"
+#include "RequestGovernor.h"
+#include "CadenceEstimator.h"
+#include "CpuSamplePool.h"
+#include "SampleDepth.h"
+#include "Metrics.h"
+#include "LatencyHistogram.h"
+
+enum class SampleBacking : UINT
+{
+	Unknown = 0,
+	SystemMemory = 1,
+	Gpu = 2,
+	SourcePool = 3,
+};
 
 struct MediaStream : winrt::implements<MediaStream, CBaseAttributes<IMFAttributes>, IMFMediaStream2, IKsControl>
 {
@@ -35,7 +52,7 @@ public:
 		SetBaseAttributesTraceName(L"MediaStreamAtts");
 	}
 
-	HRESULT Initialize(IMFMediaSource* source, int index, const VCamPipelineConfig& config);
+	HRESULT Initialize(IMFMediaSource* source, int index, const VCamPipelineConfig& sourceConfig, const VCamPipelineConfig& config, std::shared_ptr<FrameSource> frameSource);
 	HRESULT SetAllocator(IUnknown* allocator);
 	MFSampleAllocatorUsage GetAllocatorUsage();
 	HRESULT SetD3DManager(IUnknown* manager);
@@ -47,22 +64,52 @@ private:
 #if _DEBUG
 	int32_t query_interface_tearoff(winrt::guid const& id, void** object) const noexcept override
 	{
-		RETURN_HR_MSG(E_NOINTERFACE, "MediaStream QueryInterface failed on IID %s", GUID_ToStringW(id).c_str());
+		RETURN_HR_MSG(E_NOINTERFACE, "MediaStream QueryInterface failed on IID %s", GUID_ToName(id).c_str());
 	}
 #endif
 
+	bool RequiresProvidedAllocator() const { return _config.sampleAllocator == VCamSampleAllocatorMode::Provided; }
+	HRESULT InitializeSamples(IMFMediaType* type);
+	HRESULT UninitializeSamples_NoLock();
+	UINT GetOutstandingSamples_NoLock();
+	HRESULT ResizeSamples_NoLock(UINT depth);
+	bool BackoffUntilNewFrame(uint64_t lastDeliveredFrameId, LONGLONG expectedArrival, LONGLONG holdTime);
+	void OpenRecorder_NoLock();
+
 	winrt::slim_mutex  _lock;
 	MF_STREAM_STATE _state;
-	GstPipelineSource _pipelineSource;
+	std::shared_ptr<FrameSource> _frameSource;
+	NV12Scaler _scaler;
+	uint32_t _scalerLayoutVersion = 0;
+	FrameRecorder _recorder;
+	RequestGovernor _governor;
+	FramePhaseLock _phaseLock;
+	bool _requestAfterDelivery = false;
+	uint64_t _holdCount = 0;
+	// Pipeline-wide config (what the shared pipeline produces) and this stream's output config.
+	VCamPipelineConfig _sourceConfig;
 	VCamPipelineConfig _config;
 	LONGLONG _frameDuration = 333333;
 	GUID _format;
 	uint32_t _requestCount = 0;
-	ULONGLONG _lastRequestTraceTick = 0;
 	uint64_t _lastDeliveredFrameId = 0;
 	wil::com_ptr_nothrow<IMFStreamDescriptor> _descriptor;
 	wil::com_ptr_nothrow<IMFMediaEventQueue> _queue;
 	wil::com_ptr_nothrow<IMFMediaSource> _source;
 	wil::com_ptr_nothrow<IMFVideoSampleAllocatorEx> _allocator;
+	winrt::com_ptr<CpuSamplePool> _samplePool;
+	bool _usingSamplePool = false;
+	SampleBacking _sampleBacking = SampleBacking::Unknown;
+	SampleDepthController _sampleDepth;
+	wil::com_ptr_nothrow<IMFMediaType> _sampleType;
+	wil::com_ptr_nothrow<IMFVideoSampleAllocatorCallback> _allocatorCallback;
+	// "streamN." for camera 0, "camC.streamN." otherwise, so cameras in one process don't collide.
+	std::string _metricPrefix;
+	Metric* _depthMetric = nullptr;
+	Metric* _highWaterMetric = nullptr;
+	Metric* _resizeMetric = nullptr;
+	// CopyLatestFrameTo duration, and copy end -> MEMediaSample queued.
+	LatencyHistogram* _copyLatency = nullptr;
+	LatencyHistogram* _queueLatency = nullptr;
 	int _index;
 };
@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "Metrics.h"
+
+#include <mutex>
+
+namespace
+{
+	constexpr size_t kMaxMetrics = 128;
+
+	std::mutex g_metricsLock;
+	Metric g_metrics[kMaxMetrics];
+	std::atomic<size_t> g_metricCount = 0;
+	Metric g_overflow;
+}
+
+Metric* MetricsGet(PCSTR name)
+{
+	if (!name || !*name)
+	{
+		return &g_overflow;
+	}
+
+	std::lock_guard<std::mutex> lock(g_metricsLock);
+	const auto count = g_metricCount.load();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!strcmp(g_metrics[i].name, name))
+		{
+			return &g_metrics[i];
+		}
+	}
+
+	if (count >= kMaxMetrics)
+	{
+		return &g_overflow;
+	}
+
+	auto metric = &g_metrics[count];
+	StringCchCopyA(metric->name, _countof(metric->name), name);
+	g_metricCount.store(count + 1);
+	return metric;
+}
+
+std::string MetricsSnapshot()
+{
+	std::string snapshot;
+	const auto count = g_metricCount.load();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!snapshot.empty())
+		{
+			snapshot += ' ';
+		}
+		snapshot += std::format("{}={}", g_metrics[i].name, g_metrics[i].Get());
+	}
+	return snapshot;
+}
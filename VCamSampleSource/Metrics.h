@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Process-wide named metric. Updates are single relaxed atomics, so hot paths can keep a
+// cached Metric* (see MetricsGet) and update it on every frame.
+struct Metric
+{
+	void Set(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+	void Add(int64_t delta) { _value.fetch_add(delta, std::memory_order_relaxed); }
+	void Max(int64_t value)
+	{
+		auto current = _value.load(std::memory_order_relaxed);
+		while (value > current && !_value.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+	int64_t Get() const { return _value.load(std::memory_order_relaxed); }
+
+	char name[64]{};
+
+private:
+	std::atomic<int64_t> _value = 0;
+};
+
+// Finds or registers a metric by name; never returns null (a shared overflow slot is used when full).
+Metric* MetricsGet(PCSTR name);
+// Space-separated "name=value" list of every registered metric.
+std::string MetricsSnapshot();
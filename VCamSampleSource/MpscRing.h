@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer, single-consumer ring of fixed-size payloads (Vyukov sequence slots).
+// Producers never block: when every slot is taken Reserve counts a drop and returns null, and the
+// consumer collects the count with TakeDropped. A slot's sequence is its position while free,
+// position + 1 once published and position + SlotCount after the consumer took it. Header-only
+// with standard types so the tests build it on any host.
+template <typename Payload, uint32_t SlotCount>
+class MpscRing
+{
+	static_assert(SlotCount && (SlotCount & (SlotCount - 1)) == 0, "slot count must be a power of two");
+
+public:
+	MpscRing()
+	{
+		for (uint64_t i = 0; i < SlotCount; i++)
+		{
+			_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpscRing(const MpscRing&) = delete;
+	MpscRing& operator=(const MpscRing&) = delete;
+
+	// Claims the next free slot for the caller to fill, or counts a drop and returns null when the
+	// ring is full.
+	Payload* Reserve(uint64_t* outPosition)
+	{
+		auto position = _enqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			auto& slot = _slots[position % SlotCount];
+			const auto sequence = slot.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<int64_t>(sequence - position);
+			if (diff == 0)
+			{
+				if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					*outPosition = position;
+					return &slot.payload;
+				}
+			}
+			else if (diff < 0)
+			{
+				_dropped.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			else
+			{
+				position = _enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Hands a filled slot to the consumer. Returns how many slots the consumer has yet to take,
+	// counting this one, so producers can decide to wake it early.
+	uint64_t Publish(uint64_t position)
+	{
+		_slots[position % SlotCount].sequence.store(position + 1, std::memory_order_release);
+		return position + 1 - _dequeuePosition.load(std::memory_order_relaxed);
+	}
+
+	// Consumer only: passes every published payload, in order, to consume and frees its slot.
+	// Stops at the first slot that is reserved but not yet published.
+	template <typename Consume>
+	size_t Drain(Consume&& consume)
+	{
+		auto position = _dequeuePosition.load(std::memory_order_relaxed);
+		size_t count = 0;
+		for (;;)
+		{
+			auto& slot = _slots[position % SlotCount];
+			if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+			{
+				break;
+			}
+
+			consume(static_cast<const Payload&>(slot.payload));
+			slot.sequence.store(position + SlotCount, std::memory_order_release);
+			position++;
+			count++;
+		}
+		_dequeuePosition.store(position, std::memory_order_relaxed);
+		return count;
+	}
+
+	// Drops counted since the last call.
+	uint64_t TakeDropped()
+	{
+		return _dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	// Consumer only: whether nothing has been reserved since the last Drain.
+	bool IsEmpty() const
+	{
+		return _enqueuePosition.load(std::memory_order_acquire) == _dequeuePosition.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;
+		Payload payload;
+	};
+
+	alignas(64) std::atomic<uint64_t> _enqueuePosition = 0;
+	alignas(64) std::atomic<uint64_t> _dequeuePosition = 0; // advanced by the single consumer
+	alignas(64) std::atomic<uint64_t> _dropped = 0;
+	Slot _slots[SlotCount];
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <cwctype>
+#include <string>
+#include <string_view>
+
+// Per-camera source configuration and how the values of the camera's config key map onto it.
+// Standard types only: MediaSource reads the values from the registry, the tests from files.
+
+enum class VCamSampleAllocatorMode : uint32_t
+{
+	Provided = 0,
+	CpuPool = 1,
+	// Provided allocator unless it hands back GPU-backed buffers, then the CPU pool.
+	Auto = 2,
+};
+
+// How a source frame whose size differs from a stream's negotiated size is fitted into it.
+enum class VCamScaleMode
+{
+	Stretch = 0,
+	Letterbox = 1,
+};
+
+struct VCamPipelineConfig
+{
+	// Index of the hosting virtual camera (see Cameras.h).
+	uint32_t camera = 0;
+	std::wstring pipeline;
+	uint32_t width = 1280;
+	uint32_t height = 960;
+	uint32_t fpsNumerator = 30;
+	uint32_t fpsDenominator = 1;
+	VCamSampleAllocatorMode sampleAllocator = VCamSampleAllocatorMode::Auto;
+	uint32_t sampleMemoryBudgetMB = 64;
+	VCamScaleMode scaleMode = VCamScaleMode::Stretch;
+	// Name of a shared-memory frame ring (see ShmFrameRing.h); when set, frames are read from it
+	// directly and the pipeline is not used.
+	std::wstring shmName;
+	// Directory that receives a raw recording of stream 0 (see FrameRecorder.h); empty disables.
+	std::wstring recordDirectory;
+	uint32_t recordMaxFrames = 300;
+	// Recording to play back instead of any live source; takes precedence over shmName.
+	std::wstring replayPath;
+	uint32_t replaySpeedPercent = 100;
+};
+
+// Value names of the camera's config key, by type (REG_SZ and REG_DWORD).
+inline constexpr const wchar_t* VCamPipelineStringValueNames[] = { L"Pipeline", L"ShmName", L"RecordDirectory", L"ReplayPath" };
+inline constexpr const wchar_t* VCamPipelineDwordValueNames[] = {
+	L"Width",
+	L"Height",
+	L"FpsNumerator",
+	L"FpsDenominator",
+	L"SampleAllocator",
+	L"SampleMemoryBudgetMB",
+	L"ScaleMode",
+	L"RecordMaxFrames",
+	L"ReplaySpeedPercent",
+};
+
+// Value names compare case-insensitively, as in the registry.
+inline bool PipelineConfigNameEquals(std::wstring_view name, std::wstring_view expected)
+{
+	if (name.size() != expected.size())
+		return false;
+
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		if (std::towlower(name[i]) != std::towlower(expected[i]))
+			return false;
+	}
+	return true;
+}
+
+// Applies one REG_SZ value; unknown names are ignored.
+inline void ApplyPipelineConfigString(VCamPipelineConfig* config, std::wstring_view name, std::wstring_view value)
+{
+	if (PipelineConfigNameEquals(name, L"Pipeline"))
+	{
+		config->pipeline = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"ShmName"))
+	{
+		config->shmName = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"RecordDirectory"))
+	{
+		config->recordDirectory = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"ReplayPath"))
+	{
+		config->replayPath = value;
+	}
+}
+
+// Applies one REG_DWORD value. Zero sizes, rates and limits keep the current value and
+// out-of-range modes are ignored; unknown names are ignored.
+inline void ApplyPipelineConfigDword(VCamPipelineConfig* config, std::wstring_view name, uint32_t value)
+{
+	if (PipelineConfigNameEquals(name, L"SampleAllocator"))
+	{
+		if (value <= static_cast<uint32_t>(VCamSampleAllocatorMode::Auto))
+		{
+			config->sampleAllocator = static_cast<VCamSampleAllocatorMode>(value);
+		}
+		return;
+	}
+
+	if (PipelineConfigNameEquals(name, L"ScaleMode"))
+	{
+		if (value <= static_cast<uint32_t>(VCamScaleMode::Letterbox))
+		{
+			config->scaleMode = static_cast<VCamScaleMode>(value);
+		}
+		return;
+	}
+
+	if (!value)
+		return;
+
+	if (PipelineConfigNameEquals(name, L"Width"))
+	{
+		config->width = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"Height"))
+	{
+		config->height = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"FpsNumerator"))
+	{
+		config->fpsNumerator = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"FpsDenominator"))
+	{
+		config->fpsDenominator = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"SampleMemoryBudgetMB"))
+	{
+		config->sampleMemoryBudgetMB = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"RecordMaxFrames"))
+	{
+		config->recordMaxFrames = value;
+	}
+	else if (PipelineConfigNameEquals(name, L"ReplaySpeedPercent"))
+	{
+		config->replaySpeedPercent = value;
+	}
+}
+
+// True when loaded differs from current in a value that selects or shapes the frame source, the
+// part that can be swapped under running streams. Stream sizes, StreamN subkeys, the allocator
+// and recording are negotiated or set up when the camera is opened and apply the next time.
+inline bool PipelineConfigChangesSource(const VCamPipelineConfig& current, const VCamPipelineConfig& loaded)
+{
+	return loaded.pipeline != current.pipeline ||
+		loaded.width != current.width ||
+		loaded.height != current.height ||
+		loaded.fpsNumerator != current.fpsNumerator ||
+		loaded.fpsDenominator != current.fpsDenominator ||
+		loaded.shmName != current.shmName ||
+		loaded.replayPath != current.replayPath ||
+		loaded.replaySpeedPercent != current.replaySpeedPercent;
+}
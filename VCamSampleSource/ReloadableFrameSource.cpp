@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "FrameScaler.h"
+#include "Metrics.h"
+#include "ReloadableFrameSource.h"
+
+ReloadableFrameSource::ReloadableFrameSource(const VCamPipelineConfig& config) :
+	_config(config),
+	_source(CreateFrameSource(config))
+{
+}
+
+ReloadableFrameSource::~ReloadableFrameSource()
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	if (_users)
+	{
+		_users = 0;
+		_source->Stop();
+	}
+}
+
+HRESULT ReloadableFrameSource::Start(const VCamPipelineConfig& config)
+{
+	UNREFERENCED_PARAMETER(config);
+	std::lock_guard<std::mutex> lock(_stateLock);
+	if (_users)
+	{
+		_users++;
+		return S_OK;
+	}
+
+	// Streams restart their frame ids from zero together with the inner source.
+	RETURN_IF_FAILED(_source->Start(_config));
+	std::unique_lock<std::shared_mutex> activeLock(_activeLock);
+	_baseFrameId = 0;
+	_users = 1;
+	return S_OK;
+}
+
+void ReloadableFrameSource::Stop()
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	if (!_users)
+	{
+		return;
+	}
+
+	if (--_users == 0)
+	{
+		_source->Stop();
+	}
+}
+
+HRESULT ReloadableFrameSource::Reload(const VCamPipelineConfig& config, HANDLE cancelEvent)
+{
+	std::lock_guard<std::mutex> reloadLock(_reloadLock);
+	auto candidate = CreateFrameSource(config);
+	{
+		std::lock_guard<std::mutex> lock(_stateLock);
+		if (!_users)
+		{
+			// Nothing is streaming: the next Start simply uses the new source.
+			std::unique_lock<std::shared_mutex> activeLock(_activeLock);
+			_source = std::move(candidate);
+			_baseFrameId = 0;
+			_config = config;
+			WINTRACE(L"ReloadableFrameSource::Reload applied while stopped");
+			return S_OK;
+		}
+	}
+
+	// Warm the new source up outside the state lock so streams keep starting and stopping.
+	const auto warmupStart = GetTickCount64();
+	RETURN_IF_FAILED_MSG(candidate->Start(config), "New frame source failed to start, keeping the current one");
+	auto warmedUp = false;
+	while (!warmedUp && GetTickCount64() - warmupStart < WarmupTimeoutMs)
+	{
+		if (cancelEvent && WaitForSingleObject(cancelEvent, 0) == WAIT_OBJECT_0)
+		{
+			candidate->Stop();
+			WINTRACE(L"ReloadableFrameSource::Reload cancelled during warm-up");
+			return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+		}
+		warmedUp = candidate->WaitForNewFrame(0, WarmupSliceMs);
+	}
+
+	if (!warmedUp)
+	{
+		candidate->Stop();
+		RETURN_HR_MSG(HRESULT_FROM_WIN32(ERROR_TIMEOUT), "New frame source produced no frame in %u ms, keeping the current one", WarmupTimeoutMs);
+	}
+
+	std::shared_ptr<FrameSource> previous;
+	{
+		std::lock_guard<std::mutex> lock(_stateLock);
+		std::unique_lock<std::shared_mutex> activeLock(_activeLock);
+		if (_users)
+		{
+			// Rebase past every id the old source could have handed out, so the new source's
+			// first frame is newer than anything a stream already delivered.
+			uint64_t previousLatest = 0;
+			_source->HasNewFrameSince(0, &previousLatest);
+			_baseFrameId += previousLatest;
+			previous = std::move(_source);
+		}
+		else
+		{
+			// The last stream stopped during warm-up; the next Start restarts the new source.
+			candidate->Stop();
+			_baseFrameId = 0;
+		}
+		_source = std::move(candidate);
+		_config = config;
+	}
+
+	// Stopping the old source wakes any stream still waiting on it.
+	if (previous)
+	{
+		previous->Stop();
+	}
+	MetricsGet("source.reloads")->Add(1);
+	WINTRACE(L"ReloadableFrameSource::Reload swapped after %llu ms warm-up", GetTickCount64() - warmupStart);
+	return S_OK;
+}
+
+bool ReloadableFrameSource::HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId)
+{
+	std::shared_lock<std::shared_mutex> lock(_activeLock);
+	uint64_t latest = 0;
+	const auto hasNew = _source->HasNewFrameSince(ToInnerFrameId(lastDeliveredFrameId, _baseFrameId), &latest);
+	if (outLatestFrameId)
+	{
+		*outLatestFrameId = hasNew && latest ? _baseFrameId + latest : 0;
+	}
+	return hasNew;
+}
+
+LONGLONG ReloadableFrameSource::GetLatestFrameTime()
+{
+	std::shared_lock<std::shared_mutex> lock(_activeLock);
+	return _source->GetLatestFrameTime();
+}
+
+bool ReloadableFrameSource::WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs)
+{
+	std::shared_ptr<FrameSource> source;
+	uint64_t baseFrameId = 0;
+	{
+		std::shared_lock<std::shared_mutex> lock(_activeLock);
+		source = _source;
+		baseFrameId = _baseFrameId;
+	}
+
+	// Not held across the wait: a swap stops the old source, which ends the wait early.
+	return source->WaitForNewFrame(ToInnerFrameId(lastDeliveredFrameId, baseFrameId), timeoutMs);
+}
+
+HRESULT ReloadableFrameSource::CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId)
+{
+	RETURN_HR_IF_NULL(E_POINTER, outCopiedFrameId);
+	std::shared_lock<std::shared_mutex> lock(_activeLock);
+	uint64_t copiedFrameId = 0;
+	const auto hr = _source->CopyLatestFrameTo(scaler, destination, destinationStride, destinationLength, ToInnerFrameId(minimumFrameIdExclusive, _baseFrameId), &copiedFrameId);
+	*outCopiedFrameId = copiedFrameId ? _baseFrameId + copiedFrameId : 0;
+	return hr;
+}
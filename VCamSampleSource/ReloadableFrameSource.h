@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+#include "FrameSource.h"
+#include "GstPipelineSource.h"
+
+// FrameSource that forwards to a replaceable inner source. Reload builds and starts the new
+// source next to the running one and swaps it in once it has published its first frame, so
+// streams keep getting frames from the old source until then and never see a gap. Frame ids
+// are rebased across swaps so every stream's last delivered id stays valid.
+// Start ignores its config argument: the inner source always runs the latest reloaded config.
+class ReloadableFrameSource : public FrameSource
+{
+public:
+	explicit ReloadableFrameSource(const VCamPipelineConfig& config);
+	~ReloadableFrameSource() override;
+
+	HRESULT Start(const VCamPipelineConfig& config) override;
+	void Stop() override;
+	bool HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId) override;
+	LONGLONG GetLatestFrameTime() override;
+	bool WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs) override;
+	HRESULT CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId) override;
+
+	// Replaces the inner source with one built for config. When running, the current source
+	// keeps serving until the new one produces a frame or fails to within the warm-up timeout.
+	// Signaling cancelEvent abandons the warm-up (HRESULT_FROM_WIN32(ERROR_CANCELLED)).
+	HRESULT Reload(const VCamPipelineConfig& config, HANDLE cancelEvent = nullptr);
+
+private:
+	static uint64_t ToInnerFrameId(uint64_t frameId, uint64_t baseFrameId) { return frameId > baseFrameId ? frameId - baseFrameId : 0; }
+
+	static constexpr DWORD WarmupTimeoutMs = 5000;
+	// Warm-up waits in slices this long so a cancel is seen promptly.
+	static constexpr DWORD WarmupSliceMs = 50;
+
+	// Serializes reloads; taken before _stateLock.
+	std::mutex _reloadLock;
+	// Guards _users and _config, and is held while the inner source is started or stopped.
+	std::mutex _stateLock;
+	UINT _users = 0;
+	VCamPipelineConfig _config;
+
+	// Held shared for each forwarded call (except waits) and exclusively for the swap itself.
+	std::shared_mutex _activeLock;
+	std::shared_ptr<FrameSource> _source;
+	uint64_t _baseFrameId = 0;
+};
@@ -0,0 +1,222 @@
+#include "pch.h"
+#include "Tools.h"
+#include "FrameScaler.h"
+#include "FrameRecording.h"
+#include "ReplayFrameSource.h"
+#include "ReplayPacer.h"
+
+#pragma comment(lib, "Synchronization.lib")
+
+ReplayFrameSource::~ReplayFrameSource()
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	_users = 0;
+	StopPlayback_NoLock();
+}
+
+HRESULT ReplayFrameSource::Open_NoLock(const std::wstring& path)
+{
+	_file.reset(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+	RETURN_LAST_ERROR_IF_MSG(!_file, "Cannot open recording '%s'", path.c_str());
+
+	LARGE_INTEGER fileSize{};
+	RETURN_IF_WIN32_BOOL_FALSE(GetFileSizeEx(_file.get(), &fileSize));
+	RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), static_cast<uint64_t>(fileSize.QuadPart) < sizeof(VCamRecordingHeader));
+
+	_mapping.reset(CreateFileMappingW(_file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	RETURN_LAST_ERROR_IF(!_mapping);
+	_view = static_cast<const BYTE*>(MapViewOfFile(_mapping.get(), FILE_MAP_READ, 0, 0, 0));
+	RETURN_LAST_ERROR_IF_NULL(_view);
+
+	const auto size = static_cast<uint64_t>(fileSize.QuadPart);
+	RETURN_HR_IF_MSG(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), !VCamRecordingReadLayout(reinterpret_cast<const VCamRecordingHeader*>(_view), size, &_layout), "'%s' is not a valid frame recording", path.c_str());
+
+	_index = reinterpret_cast<const VCamRecordingIndexEntry*>(_view + _layout.indexOffset);
+	const auto completeFrames = VCamRecordingCountFrames(_index, &_layout, size);
+	RETURN_HR_IF_MSG(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), completeFrames < _layout.frameCount, "Recording frame %u is truncated", completeFrames);
+
+	WINTRACE(
+		L"ReplayFrameSource::Open '%s' %ux%u frames:%u duration:%llums",
+		path.c_str(),
+		_layout.width,
+		_layout.height,
+		_layout.frameCount,
+		_index[_layout.frameCount - 1].arrivalTime / 10000);
+	return S_OK;
+}
+
+void ReplayFrameSource::Close_NoLock()
+{
+	if (_view)
+	{
+		UnmapViewOfFile(_view);
+	}
+	_view = nullptr;
+	_index = nullptr;
+	_layout = {};
+	_mapping.reset();
+	_file.reset();
+}
+
+HRESULT ReplayFrameSource::Start(const VCamPipelineConfig& config)
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	RETURN_HR_IF(E_INVALIDARG, config.replayPath.empty());
+	if (_running.load())
+	{
+		_users++;
+		return S_OK;
+	}
+
+	_config = config;
+	{
+		std::unique_lock<std::shared_mutex> viewLock(_viewLock);
+		const auto openHr = Open_NoLock(_config.replayPath);
+		if (FAILED(openHr))
+		{
+			Close_NoLock();
+			return openHr;
+		}
+	}
+
+	if (!_stopEvent)
+	{
+		RETURN_IF_FAILED(_stopEvent.create(wil::EventOptions::ManualReset));
+	}
+	_stopEvent.ResetEvent();
+	_publishedFrameId.store(0);
+	_currentFrame.store(0);
+	_latestFrameTime.store(0);
+	_running.store(true);
+	_users = 1;
+	_playThread = std::thread(&ReplayFrameSource::PlayLoop, this);
+	return S_OK;
+}
+
+void ReplayFrameSource::Stop()
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	if (_users > 1)
+	{
+		_users--;
+		return;
+	}
+
+	_users = 0;
+	StopPlayback_NoLock();
+}
+
+void ReplayFrameSource::StopPlayback_NoLock()
+{
+	if (!_playThread.joinable())
+	{
+		return;
+	}
+
+	_running.store(false);
+	_stopEvent.SetEvent();
+	WakeByAddressAll(&_publishedFrameId);
+	_playThread.join();
+
+	std::unique_lock<std::shared_mutex> viewLock(_viewLock);
+	Close_NoLock();
+	WINTRACE(L"ReplayFrameSource stopped");
+}
+
+void ReplayFrameSource::PlayLoop()
+{
+	ReplayPacer pacer(_index, _layout, _config.replaySpeedPercent);
+	wil::unique_handle timer(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+	HANDLE waits[] = { _stopEvent.get(), timer.get() };
+	pacer.Start(MFGetSystemTime());
+	while (_running.load())
+	{
+		const auto wait = pacer.GetDueTime() - MFGetSystemTime();
+		if (wait > 0)
+		{
+			if (timer)
+			{
+				LARGE_INTEGER relative{};
+				relative.QuadPart = -wait;
+				SetWaitableTimer(timer.get(), &relative, 0, nullptr, nullptr, FALSE);
+				WaitForMultipleObjects(_countof(waits), waits, FALSE, INFINITE);
+			}
+			else
+			{
+				WaitForSingleObject(_stopEvent.get(), static_cast<DWORD>((wait + 9999) / 10000));
+			}
+			continue;
+		}
+
+		const auto now = MFGetSystemTime();
+		_currentFrame.store(pacer.GetFrame());
+		_latestFrameTime.store(now);
+		_publishedFrameId.fetch_add(1);
+		WakeByAddressAll(&_publishedFrameId);
+		if (pacer.Advance(now))
+		{
+			WINTRACE(L"ReplayFrameSource loop:%llu frames:%u", pacer.GetLoops(), _layout.frameCount);
+		}
+	}
+}
+
+bool ReplayFrameSource::HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId)
+{
+	const auto frameId = _publishedFrameId.load();
+	if (outLatestFrameId)
+	{
+		*outLatestFrameId = frameId > lastDeliveredFrameId ? frameId : 0;
+	}
+	return frameId > lastDeliveredFrameId;
+}
+
+LONGLONG ReplayFrameSource::GetLatestFrameTime()
+{
+	return _latestFrameTime.load();
+}
+
+bool ReplayFrameSource::WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs)
+{
+	if (!_running.load())
+	{
+		return false;
+	}
+
+	auto compare = lastDeliveredFrameId;
+	if (_publishedFrameId.load() != compare)
+	{
+		return true;
+	}
+	return WaitOnAddress(&_publishedFrameId, &compare, sizeof(compare), timeoutMs) != FALSE;
+}
+
+HRESULT ReplayFrameSource::CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId)
+{
+	RETURN_HR_IF_NULL(E_POINTER, destination);
+	RETURN_HR_IF(E_INVALIDARG, destinationStride <= 0);
+	RETURN_HR_IF(E_INVALIDARG, destinationStride < static_cast<LONG>(scaler.GetOutputWidth()));
+	RETURN_HR_IF_NULL(E_POINTER, outCopiedFrameId);
+	*outCopiedFrameId = 0;
+
+	const auto requiredLength = static_cast<size_t>(destinationStride) * scaler.GetOutputHeight() * 3 / 2;
+	RETURN_HR_IF(E_BOUNDS, destinationLength < requiredLength);
+
+	const auto frameId = _publishedFrameId.load();
+	if (!frameId || frameId <= minimumFrameIdExclusive)
+	{
+		return S_FALSE;
+	}
+
+	std::shared_lock<std::shared_mutex> viewLock(_viewLock);
+	if (!_index)
+	{
+		return S_FALSE;
+	}
+
+	const auto width = _layout.width;
+	const auto height = _layout.height;
+	const auto frame = _view + _index[_currentFrame.load()].dataOffset;
+	scaler.Copy(frame, static_cast<LONG>(width), frame + static_cast<size_t>(width) * height, static_cast<LONG>(width), width, height, destination, destinationStride);
+	*outCopiedFrameId = frameId;
+	return S_OK;
+}
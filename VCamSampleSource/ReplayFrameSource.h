@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "FrameRecording.h"
+#include "FrameSource.h"
+#include "GstPipelineSource.h"
+
+// Plays a FrameRecorder file back through the normal FrameSource handoff, looping at the end.
+// Frames are published at their recorded arrival times scaled by replaySpeedPercent (100 is
+// the original timing, 200 twice as fast), so pacing and copy behaviour can be reproduced
+// without a live producer.
+class ReplayFrameSource : public FrameSource
+{
+public:
+	~ReplayFrameSource() override;
+
+	HRESULT Start(const VCamPipelineConfig& config) override;
+	void Stop() override;
+	bool HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId) override;
+	LONGLONG GetLatestFrameTime() override;
+	bool WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs) override;
+	HRESULT CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId) override;
+
+private:
+	HRESULT Open_NoLock(const std::wstring& path);
+	void Close_NoLock();
+	void StopPlayback_NoLock();
+	void PlayLoop();
+
+private:
+	std::mutex _stateLock;
+	UINT _users = 0;
+	std::atomic<bool> _running = false;
+	std::thread _playThread;
+	wil::unique_event_nothrow _stopEvent;
+	VCamPipelineConfig _config;
+
+	// Read-only view of the recording. Copies run outside any stream lock and may overlap the
+	// last Stop, so they hold this shared while Open/Close map and unmap it exclusively.
+	std::shared_mutex _viewLock;
+	wil::unique_hfile _file;
+	wil::unique_handle _mapping;
+	const BYTE* _view = nullptr;
+	const VCamRecordingIndexEntry* _index = nullptr;
+	VCamRecordingLayout _layout{};
+
+	std::atomic<uint64_t> _publishedFrameId = 0;
+	std::atomic<UINT> _currentFrame = 0;
+	std::atomic<LONGLONG> _latestFrameTime = 0;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FrameRecording.h"
+
+// Schedule of a looping replay, in 100ns units on the caller's clock. Frame i of a loop is due at
+// the loop start plus its recorded arrival time divided by the speed (speedPercent 100 is the
+// original timing, 200 twice as fast, 0 means 100). Due times come from the loop start rather
+// than the previous frame, so a late publish is caught up instead of shifting every frame after
+// it. The next loop starts one nominal frame after the last frame was published. Header-only with
+// standard types so the tests build it on any host.
+class ReplayPacer
+{
+public:
+	ReplayPacer(const VCamRecordingIndexEntry* index, const VCamRecordingLayout& layout, uint32_t speedPercent) :
+		_index(index),
+		_frameCount(layout.frameCount),
+		_speedPercent(speedPercent ? speedPercent : 100),
+		_frameDuration(layout.fpsNumerator && layout.fpsDenominator ? 10000000ll * layout.fpsDenominator / layout.fpsNumerator : 10000000ll / 30)
+	{
+	}
+
+	void Start(int64_t now)
+	{
+		_loopStart = now;
+		_frame = 0;
+		_loops = 0;
+	}
+
+	// Recording frame to publish next.
+	uint32_t GetFrame() const { return _frame; }
+
+	// When the next frame is due.
+	int64_t GetDueTime() const
+	{
+		return _loopStart + static_cast<int64_t>(_index[_frame].arrivalTime * 100 / _speedPercent);
+	}
+
+	// Completed passes over the recording.
+	uint64_t GetLoops() const { return _loops; }
+
+	// Moves on once the next frame was published at now. Returns true when that was the last
+	// frame of the recording and a new loop starts.
+	bool Advance(int64_t now)
+	{
+		if (++_frame < _frameCount)
+			return false;
+
+		_frame = 0;
+		_loops++;
+		_loopStart = now + _frameDuration * 100 / _speedPercent;
+		return true;
+	}
+
+private:
+	const VCamRecordingIndexEntry* const _index;
+	const uint32_t _frameCount;
+	const uint32_t _speedPercent;
+	const int64_t _frameDuration;
+	int64_t _loopStart = 0;
+	uint32_t _frame = 0;
+	uint64_t _loops = 0;
+};
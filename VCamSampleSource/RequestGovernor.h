@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+enum class RequestBackoff
+{
+	Spin,
+	Yield,
+	Sleep,
+	Wait,
+};
+
+struct RequestGovernorStats
+{
+	uint64_t misses = 0;
+	uint64_t spins = 0;
+	uint64_t yields = 0;
+	uint64_t sleeps = 0;
+	uint64_t waits = 0;
+	uint32_t consecutiveMisses = 0;
+	uint32_t maxConsecutiveMisses = 0;
+};
+
+// Picks how RequestSample backs off when FrameServer asks for a frame that does not exist yet.
+// Consecutive misses escalate spin -> yield -> sleep -> event wait, and the sleep/wait length is
+// keyed to the expected arrival of the next frame so delivery latency stays below one interval.
+// Times are in 100ns units. Header-only with standard types so the tests build it on any host.
+class RequestGovernor
+{
+public:
+	// Thresholds are in consecutive misses since the last delivered frame.
+	static constexpr uint32_t SpinMisses = 2;
+	static constexpr uint32_t YieldMisses = 8;
+	static constexpr uint32_t SleepMisses = 16;
+
+	void Reset(int64_t frameDuration)
+	{
+		_frameDuration.store(frameDuration > 0 ? frameDuration : 333333);
+		_consecutiveMisses.store(0);
+		_maxConsecutiveMisses.store(0);
+		_misses.store(0);
+		_spins.store(0);
+		_yields.store(0);
+		_sleeps.store(0);
+		_waits.store(0);
+	}
+
+	void OnFrameDelivered()
+	{
+		_consecutiveMisses.store(0);
+	}
+
+	RequestBackoff OnMiss(int64_t now, int64_t expectedArrival, uint32_t* outWaitMs)
+	{
+		if (outWaitMs)
+		{
+			*outWaitMs = 0;
+		}
+
+		_misses.fetch_add(1);
+		const auto misses = _consecutiveMisses.fetch_add(1) + 1;
+		auto maxMisses = _maxConsecutiveMisses.load();
+		while (misses > maxMisses && !_maxConsecutiveMisses.compare_exchange_weak(maxMisses, misses))
+		{
+		}
+
+		// Without an arrival estimate, assume the next frame lands a full interval from now.
+		const auto frameDuration = _frameDuration.load();
+		const auto remaining = (expectedArrival ? expectedArrival : now + frameDuration) - now;
+
+		if (misses <= SpinMisses)
+		{
+			_spins.fetch_add(1);
+			return RequestBackoff::Spin;
+		}
+
+		// Sleeping when the frame is due within a millisecond would only add latency.
+		if (misses <= YieldMisses || (remaining > 0 && remaining < OneMs))
+		{
+			_yields.fetch_add(1);
+			return RequestBackoff::Yield;
+		}
+
+		if (misses <= SleepMisses)
+		{
+			_sleeps.fetch_add(1);
+			if (outWaitMs)
+			{
+				*outWaitMs = 1;
+			}
+			return RequestBackoff::Sleep;
+		}
+
+		// Overdue frames (stalled producer) wait at most one interval per request.
+		const auto waitTime = remaining > 0 ? remaining : frameDuration;
+		_waits.fetch_add(1);
+		if (outWaitMs)
+		{
+			*outWaitMs = static_cast<uint32_t>(std::clamp<int64_t>((waitTime + OneMs - 1) / OneMs, 1, (frameDuration + OneMs - 1) / OneMs));
+		}
+		return RequestBackoff::Wait;
+	}
+
+	RequestGovernorStats GetStats() const
+	{
+		RequestGovernorStats stats;
+		stats.misses = _misses.load();
+		stats.spins = _spins.load();
+		stats.yields = _yields.load();
+		stats.sleeps = _sleeps.load();
+		stats.waits = _waits.load();
+		stats.consecutiveMisses = _consecutiveMisses.load();
+		stats.maxConsecutiveMisses = _maxConsecutiveMisses.load();
+		return stats;
+	}
+
+private:
+	static constexpr int64_t OneMs = 10000; // 100ns units
+
+	std::atomic<int64_t> _frameDuration = 333333;
+	std::atomic<uint32_t> _consecutiveMisses = 0;
+	std::atomic<uint32_t> _maxConsecutiveMisses = 0;
+	std::atomic<uint64_t> _misses = 0;
+	std::atomic<uint64_t> _spins = 0;
+	std::atomic<uint64_t> _yields = 0;
+	std::atomic<uint64_t> _sleeps = 0;
+	std::atomic<uint64_t> _waits = 0;
+};
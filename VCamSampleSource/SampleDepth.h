@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Sizes the sample pool from frame size, a memory budget and the observed number of samples
+// the consumer keeps outstanding. Grows when allocation runs dry and, unless shrinking is
+// disabled, shrinks back once a full observation window stays well below the current depth.
+// Not thread-safe; callers serialize. Header-only with standard types so the tests build it on
+// any host.
+class SampleDepthController
+{
+public:
+	static constexpr uint32_t MinDepth = 3;
+	static constexpr uint32_t MaxDepth = 16;
+	static constexpr uint32_t InitialDepth = 6;
+	// Deliveries per shrink observation window (~10 s at 30 fps).
+	static constexpr uint32_t ShrinkWindow = 300;
+
+	// frameBytes is the allocated size of one sample, padding included.
+	void Reset(uint64_t frameBytes, uint64_t memoryBudgetBytes)
+	{
+		const auto budgetDepth = static_cast<uint32_t>((std::min)(memoryBudgetBytes / (std::max)(frameBytes, uint64_t(1)), uint64_t(MaxDepth)));
+		_maxDepth = (std::max)(MinDepth, budgetDepth);
+		_depth = (std::min)(InitialDepth, _maxDepth);
+		_shrinkEnabled = true;
+		_highWaterMark = 0;
+		_windowHighWaterMark = 0;
+		_windowDeliveries = 0;
+	}
+
+	// Resizing a provided allocator re-initializes it, so that path only ever grows.
+	void SetShrinkEnabled(bool enabled) { _shrinkEnabled = enabled; }
+	uint32_t GetDepth() const { return _depth; }
+	uint32_t GetMaxDepth() const { return _maxDepth; }
+	uint32_t GetHighWaterMark() const { return _highWaterMark; }
+
+	// Both return the new depth when the pool should be resized, 0 otherwise.
+	uint32_t OnDelivered(uint32_t outstanding)
+	{
+		_highWaterMark = (std::max)(_highWaterMark, outstanding);
+		_windowHighWaterMark = (std::max)(_windowHighWaterMark, outstanding);
+		if (++_windowDeliveries < ShrinkWindow)
+		{
+			return 0;
+		}
+
+		const auto target = (std::max)(MinDepth, _windowHighWaterMark + Headroom);
+		_windowDeliveries = 0;
+		_windowHighWaterMark = 0;
+		if (!_shrinkEnabled || target >= _depth)
+		{
+			return 0;
+		}
+
+		_depth = target;
+		return _depth;
+	}
+
+	uint32_t OnPoolEmpty(uint32_t outstanding)
+	{
+		_highWaterMark = (std::max)(_highWaterMark, outstanding);
+		_windowHighWaterMark = (std::max)(_windowHighWaterMark, outstanding);
+		if (_depth >= _maxDepth)
+		{
+			return 0;
+		}
+
+		_depth = (std::min)(_maxDepth, _depth + GrowStep);
+		_windowDeliveries = 0;
+		return _depth;
+	}
+
+private:
+	// Samples kept above the observed outstanding count to absorb consumer jitter.
+	static constexpr uint32_t Headroom = 2;
+	static constexpr uint32_t GrowStep = 2;
+
+	uint32_t _depth = MinDepth;
+	uint32_t _maxDepth = MaxDepth;
+	uint32_t _highWaterMark = 0;
+	uint32_t _windowHighWaterMark = 0;
+	uint32_t _windowDeliveries = 0;
+	bool _shrinkEnabled = true;
+};
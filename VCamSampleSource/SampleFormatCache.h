@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+enum class SampleFormatStatus
+{
+	Ok,
+	Unparsable,
+	NotNV12,
+	BadSize,
+};
+
+// NV12 needs non-zero, even dimensions for its 2x2 chroma.
+inline SampleFormatStatus CheckNV12SampleFormat(bool nv12, uint32_t width, uint32_t height)
+{
+	if (!nv12)
+		return SampleFormatStatus::NotNV12;
+
+	if (!width || !height || (width & 1) || (height & 1))
+		return SampleFormatStatus::BadSize;
+
+	return SampleFormatStatus::Ok;
+}
+
+// Decides when a sample's format has to be parsed again. Samples keep the same caps object until
+// upstream renegotiates, so the parsed form is keyed on its address; the owner holds a reference
+// to the cached object (taken when Get reports parsed), or a new one allocated at the same address
+// would be mistaken for it. Rejected formats are cached as well, so a run of bad samples is not
+// re-parsed either. Format needs status, width and height members. Streaming thread only; header-
+// only with standard types so the tests build it on any host.
+template <typename Format>
+class SampleFormatCache
+{
+public:
+	struct Lookup
+	{
+		std::shared_ptr<const Format> format;
+		// The key was not the cached one and parse ran.
+		bool parsed = false;
+		// A valid format replaced a valid one of another size (upstream renegotiated).
+		bool resized = false;
+		uint32_t previousWidth = 0;
+		uint32_t previousHeight = 0;
+	};
+
+	// parse(key) returns a std::shared_ptr<const Format> (or convertible) and never null.
+	template <typename Parse>
+	Lookup Get(const void* key, Parse&& parse)
+	{
+		Lookup lookup;
+		if (key == _key && _format)
+		{
+			_hits++;
+			lookup.format = _format;
+			return lookup;
+		}
+
+		_parses++;
+		lookup.parsed = true;
+		lookup.format = std::forward<Parse>(parse)(key);
+		if (_format && _format->status == SampleFormatStatus::Ok && lookup.format->status == SampleFormatStatus::Ok &&
+			(lookup.format->width != _format->width || lookup.format->height != _format->height))
+		{
+			lookup.resized = true;
+			lookup.previousWidth = _format->width;
+			lookup.previousHeight = _format->height;
+		}
+
+		_key = key;
+		_format = lookup.format;
+		return lookup;
+	}
+
+	void Reset()
+	{
+		_key = nullptr;
+		_format.reset();
+	}
+
+	uint64_t GetHits() const { return _hits; }
+	uint64_t GetParses() const { return _parses; }
+
+private:
+	const void* _key = nullptr;
+	std::shared_ptr<const Format> _format;
+	uint64_t _hits = 0;
+	uint64_t _parses = 0;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Portable core of CpuSamplePool: the NV12 buffer layout and the sample accounting. Only
+// standard types, so the tests build it without the Windows project.
+
+// One NV12 allocation: height rows of Y followed by height/2 rows of interleaved UV, both using
+// the same pitch. IMFMediaBuffer::Lock callers expect rows packed at the width (the media
+// type's default stride), so a padded pitch is packed/unpacked around a 1D lock.
+struct Nv12BufferLayout
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t pitch = 0;
+
+	static Nv12BufferLayout Aligned(uint32_t width, uint32_t height, uint32_t alignment)
+	{
+		Nv12BufferLayout layout;
+		layout.width = width;
+		layout.height = height;
+		layout.pitch = (width + alignment - 1) / alignment * alignment;
+		return layout;
+	}
+
+	uint32_t Rows() const { return height + height / 2; }
+	uint32_t PitchedLength() const { return pitch * Rows(); }
+	uint32_t ContiguousLength() const { return width * Rows(); }
+	bool IsContiguous() const { return pitch == width; }
+
+	void Pack(const uint8_t* pitched, uint8_t* contiguous) const
+	{
+		for (uint32_t row = 0; row < Rows(); row++)
+		{
+			memcpy(contiguous + static_cast<size_t>(row) * width, pitched + static_cast<size_t>(row) * pitch, width);
+		}
+	}
+
+	void Unpack(const uint8_t* contiguous, uint8_t* pitched) const
+	{
+		for (uint32_t row = 0; row < Rows(); row++)
+		{
+			memcpy(pitched + static_cast<size_t>(row) * pitch, contiguous + static_cast<size_t>(row) * width, width);
+		}
+	}
+};
+
+// Owned samples are free + outstanding. Only free samples can be created or trimmed, so a
+// shrink below the outstanding count completes as samples come back. Each Reset starts a new
+// generation; samples returned from an older one are dropped instead of recycled.
+// Not thread-safe; the pool serializes access.
+class SamplePoolLedger
+{
+public:
+	void Reset(uint32_t target)
+	{
+		_initialized = true;
+		_generation++;
+		_target = target;
+		_outstanding = 0;
+	}
+
+	void Clear()
+	{
+		_initialized = false;
+		_target = 0;
+		_outstanding = 0;
+	}
+
+	// Free samples to create (positive) or trim (negative) to own target samples.
+	int64_t Resize(uint32_t target, size_t freeCount)
+	{
+		_target = target;
+		const auto owned = static_cast<int64_t>(freeCount) + _outstanding;
+		const auto delta = static_cast<int64_t>(target) - owned;
+		return delta < -static_cast<int64_t>(freeCount) ? -static_cast<int64_t>(freeCount) : delta;
+	}
+
+	void OnAcquired() { _outstanding++; }
+
+	// True when the returned sample goes back on the free list.
+	bool OnReturned(uint32_t generation, size_t freeCount)
+	{
+		if (!_initialized || generation != _generation)
+		{
+			return false;
+		}
+
+		_outstanding = _outstanding ? _outstanding - 1 : 0;
+		return freeCount + _outstanding < _target;
+	}
+
+	bool IsInitialized() const { return _initialized; }
+	uint32_t Generation() const { return _generation; }
+	uint32_t Target() const { return _target; }
+	uint32_t Outstanding() const { return _outstanding; }
+
+private:
+	bool _initialized = false;
+	uint32_t _generation = 0;
+	uint32_t _target = 0;
+	uint32_t _outstanding = 0;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One thread shared by every registered client (each camera's pipeline), calling Client::Service
+// on each in turn every interval. The thread starts with the first client and exits once the last
+// one is removed. Service runs without the registry lock, so a client stuck in Service never holds
+// up another client's Add or Remove; Remove only waits for a Service call on the client being
+// removed. Header-only with standard types so the tests build it on any host.
+template <typename Client>
+class ServiceWorker
+{
+public:
+	explicit ServiceWorker(std::chrono::milliseconds interval) :
+		_interval(interval)
+	{
+	}
+
+	~ServiceWorker()
+	{
+		// Never join from static destruction (loader lock); the thread exits once no client is left.
+		if (_thread.joinable())
+		{
+			_thread.detach();
+		}
+	}
+
+	ServiceWorker(const ServiceWorker&) = delete;
+	ServiceWorker& operator=(const ServiceWorker&) = delete;
+
+	// Returns true when this started the thread.
+	bool Add(Client* client)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_clients.push_back(client);
+		_wake.notify_one();
+		if (_threadRunning)
+		{
+			return false;
+		}
+
+		if (_thread.joinable())
+		{
+			// The previous thread already left its loop under this lock; this only reaps it.
+			_thread.join();
+		}
+		_threadRunning = true;
+		_thread = std::thread(&ServiceWorker::Run, this);
+		return true;
+	}
+
+	// Takes the client off the list. Once this returns, the worker no longer references it.
+	void Remove(Client* client)
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		std::erase(_clients, client);
+		_wake.notify_one();
+		_serviced.wait(lock, [this, client] { return _servicing != client; });
+	}
+
+	bool IsRunning()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _threadRunning;
+	}
+
+private:
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		while (!_clients.empty())
+		{
+			for (size_t i = 0; i < _clients.size(); i++)
+			{
+				const auto client = _clients[i];
+				_servicing = client;
+				lock.unlock();
+				client->Service();
+				lock.lock();
+				_servicing = nullptr;
+				_serviced.notify_all();
+			}
+			_wake.wait_for(lock, _interval);
+		}
+		_threadRunning = false;
+	}
+
+	const std::chrono::milliseconds _interval;
+	// Protects _clients/_servicing/_threadRunning.
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::condition_variable _serviced;
+	std::vector<Client*> _clients;
+	// Client whose Service() is running outside _lock, if any.
+	Client* _servicing = nullptr;
+	std::thread _thread;
+	bool _threadRunning = false;
+};
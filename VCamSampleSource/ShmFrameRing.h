@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <atomic>
+#define VCAM_SHM_ACQUIRE_FENCE() std::atomic_thread_fence(std::memory_order_acquire)
+#else
+#include <stdatomic.h>
+#define VCAM_SHM_ACQUIRE_FENCE() atomic_thread_fence(memory_order_acquire)
+#endif
+
+// Layout of the shared-memory NV12 frame ring read by ShmFrameSource. Plain C types only, so
+// a producer on another OS (e.g. a POSIX shm_open writer on the host) can include this file.
+//
+// [VCamShmRingHeader][pad to dataOffset][slot 0][slot 1]...[slot slotCount-1]
+// Each slot is a VCamShmSlotHeader followed by stride*height Y bytes and stride*height/2
+// interleaved UV bytes, and slots are slotSize bytes apart.
+//
+// Producer, per frame:
+//   slot = &slots[frameNumber % slotCount]
+//   slot->sequence++ (odd: being written), release fence
+//   write pixels, slot->frameNumber, slot->timestampNs
+//   release fence, slot->sequence++ (even: stable)
+//   header->latestFrame = frameNumber (release), optionally signal the frame event
+//
+// Reader (VCamShmRingReadLatest): read latestFrame, read the slot's sequence (retry if odd),
+// copy, acquire fence, re-read sequence; a change means the producer lapped the reader and the
+// copy is discarded.
+
+#define VCAM_SHM_RING_MAGIC 0x52534356u // "VCSR"
+#define VCAM_SHM_RING_VERSION 1u
+#define VCAM_SHM_RING_ALIGNMENT 64u
+
+typedef struct VCamShmRingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t slotCount;
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+	uint64_t slotSize;
+	uint64_t dataOffset;
+	uint8_t reserved[16];
+	// Frame number of the most recently completed slot; 0 until the first frame. Frame numbers
+	// start at 1 and only increase for the lifetime of a producer.
+	volatile uint64_t latestFrame;
+	uint8_t reserved2[56];
+} VCamShmRingHeader;
+
+typedef struct VCamShmSlotHeader
+{
+	volatile uint64_t sequence;
+	uint64_t frameNumber;
+	uint64_t timestampNs;
+	uint8_t reserved[40];
+} VCamShmSlotHeader;
+
+// Geometry of a mapped ring as read once and validated. The producer can rewrite the header at
+// any time, so readers use only this copy for offsets and sizes until they map the ring again.
+typedef struct VCamShmRingGeometry
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t slotCount;
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+	uint64_t slotSize;
+	uint64_t dataOffset;
+} VCamShmRingGeometry;
+
+// Copies the geometry out of a header mapped with viewSize bytes and checks that every slot
+// fits in the view. Returns 0 (and leaves *geometry unspecified) when the ring is not usable.
+static inline int VCamShmRingReadGeometry(const volatile VCamShmRingHeader* header, uint64_t viewSize, VCamShmRingGeometry* geometry)
+{
+	uint64_t frameBytes;
+	if (viewSize < sizeof(VCamShmRingHeader) || header->magic != VCAM_SHM_RING_MAGIC || header->version != VCAM_SHM_RING_VERSION)
+	{
+		return 0;
+	}
+
+	geometry->width = header->width;
+	geometry->height = header->height;
+	geometry->stride = header->stride;
+	geometry->slotCount = header->slotCount;
+	geometry->fpsNumerator = header->fpsNumerator;
+	geometry->fpsDenominator = header->fpsDenominator;
+	geometry->slotSize = header->slotSize;
+	geometry->dataOffset = header->dataOffset;
+
+	if (!geometry->width || !geometry->height || (geometry->width & 1) || (geometry->height & 1) ||
+		geometry->stride < geometry->width || !geometry->slotCount)
+	{
+		return 0;
+	}
+
+	// stride * height cannot overflow 64 bits, but three halves of it can.
+	if ((uint64_t)geometry->stride * geometry->height > UINT64_MAX / 3)
+	{
+		return 0;
+	}
+
+	frameBytes = (uint64_t)geometry->stride * geometry->height * 3 / 2;
+	if (geometry->slotSize < sizeof(VCamShmSlotHeader) + frameBytes ||
+		geometry->dataOffset < sizeof(VCamShmRingHeader) || geometry->dataOffset > viewSize)
+	{
+		return 0;
+	}
+
+	// Division rather than slotSize * slotCount, which a hostile header could overflow.
+	return geometry->slotCount <= (viewSize - geometry->dataOffset) / geometry->slotSize;
+}
+
+// Receives the planes of a stable slot. The producer may overwrite them while this runs, so the
+// copy is only valid once VCamShmRingReadLatest returns its frame number.
+typedef void (*VCamShmCopyFrame)(void* context, const uint8_t* y, const uint8_t* uv, const VCamShmRingGeometry* geometry);
+
+// Copies the newest complete frame of a ring mapped at view (validated into geometry) through
+// copy, retrying up to maxAttempts times while the slot is being written or the producer laps
+// the copy. Returns the producer frame number copied, or 0 if there is no frame yet or no
+// attempt succeeded. *tornCopies (optional) is increased once per discarded copy.
+static inline uint64_t VCamShmRingReadLatest(
+	const uint8_t* view,
+	const VCamShmRingGeometry* geometry,
+	int maxAttempts,
+	VCamShmCopyFrame copy,
+	void* context,
+	uint32_t* tornCopies)
+{
+	const volatile VCamShmRingHeader* header = (const volatile VCamShmRingHeader*)view;
+	const volatile VCamShmSlotHeader* slot;
+	const uint8_t* pixels;
+	uint64_t latest;
+	uint64_t before;
+	int attempt;
+	for (attempt = 0; attempt < maxAttempts; attempt++)
+	{
+		// Always the newest complete slot, even if the caller asked about an older frame.
+		latest = header->latestFrame;
+		VCAM_SHM_ACQUIRE_FENCE();
+		if (!latest)
+		{
+			return 0;
+		}
+
+		slot = (const volatile VCamShmSlotHeader*)(view + geometry->dataOffset + (latest % geometry->slotCount) * geometry->slotSize);
+		before = slot->sequence;
+		VCAM_SHM_ACQUIRE_FENCE();
+		if ((before & 1) || slot->frameNumber != latest)
+		{
+			continue;
+		}
+
+		pixels = (const uint8_t*)(slot + 1);
+		copy(context, pixels, pixels + (uint64_t)geometry->stride * geometry->height, geometry);
+
+		VCAM_SHM_ACQUIRE_FENCE();
+		if (slot->sequence == before)
+		{
+			return latest;
+		}
+
+		if (tornCopies)
+		{
+			(*tornCopies)++;
+		}
+	}
+	return 0;
+}
+
+#ifdef __cplusplus
+static_assert(sizeof(VCamShmRingHeader) == 128, "ring header layout");
+static_assert(sizeof(VCamShmSlotHeader) == VCAM_SHM_RING_ALIGNMENT, "slot header layout");
+#endif
@@ -0,0 +1,329 @@
+#include "pch.h"
+#include "Tools.h"
+#include "FrameScaler.h"
+#include "Metrics.h"
+#include "ShmFrameRing.h"
+#include "ShmFrameSource.h"
+
+#pragma comment(lib, "Synchronization.lib")
+
+namespace
+{
+	constexpr DWORD kMapRetryIntervalMs = 500;
+	// With a producer event the watcher sleeps until it is signaled; the timeout only notices a
+	// producer that tears the ring down without a final signal.
+	constexpr DWORD kProducerEventTimeoutMs = 100;
+	constexpr DWORD kStalledPollIntervalMs = 20;
+	constexpr int kMaxReadAttempts = 3;
+
+	uint64_t ReadAcquire(const volatile uint64_t* value)
+	{
+		return static_cast<uint64_t>(ReadAcquire64(reinterpret_cast<const volatile LONG64*>(value)));
+	}
+
+	// Without a producer event: sleep through most of the expected gap after a frame, poll every
+	// millisecond around the expected arrival, and fall back to a slow poll once the producer stalls.
+	DWORD PollIntervalMs(ULONGLONG sinceFrameMs, const VCamShmRingGeometry& geometry)
+	{
+		const auto periodMs = geometry.fpsNumerator && geometry.fpsDenominator ? (std::max)(1000ull * geometry.fpsDenominator / geometry.fpsNumerator, 1ull) : 33ull;
+		const auto quietMs = periodMs * 3 / 4;
+		if (sinceFrameMs < quietMs)
+		{
+			return static_cast<DWORD>(quietMs - sinceFrameMs);
+		}
+		return sinceFrameMs < periodMs * 2 ? 1 : kStalledPollIntervalMs;
+	}
+
+}
+
+ShmFrameSource::~ShmFrameSource()
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	_users = 0;
+	StopWatcher_NoLock();
+}
+
+HRESULT ShmFrameSource::Start(const VCamPipelineConfig& config)
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	RETURN_HR_IF(E_INVALIDARG, config.shmName.empty() || !config.width || !config.height);
+	if (_running.load())
+	{
+		_users++;
+		WINTRACE(L"ShmFrameSource::Start shared users:%u", _users);
+		return S_OK;
+	}
+
+	_config = config;
+	_publishedFrameId.store(0);
+	_latestFrameTime.store(0);
+	_lastProducerFrame = 0;
+	_firstCopyLogged.store(false);
+	if (!_stopEvent)
+	{
+		RETURN_IF_FAILED(_stopEvent.create(wil::EventOptions::ManualReset));
+	}
+	_stopEvent.ResetEvent();
+	WINTRACE(L"ShmFrameSource::Start name:%s output:%ux%u", _config.shmName.c_str(), _config.width, _config.height);
+
+	// The producer may come up later; the watcher keeps trying to map the section.
+	_running.store(true);
+	_users = 1;
+	_watchThread = std::thread(&ShmFrameSource::WatchLoop, this);
+	return S_OK;
+}
+
+void ShmFrameSource::Stop()
+{
+	std::lock_guard<std::mutex> lock(_stateLock);
+	if (_users > 1)
+	{
+		_users--;
+		WINTRACE(L"ShmFrameSource::Stop shared users:%u", _users);
+		return;
+	}
+
+	_users = 0;
+	StopWatcher_NoLock();
+}
+
+void ShmFrameSource::StopWatcher_NoLock()
+{
+	if (!_watchThread.joinable())
+	{
+		return;
+	}
+
+	_running.store(false);
+	_stopEvent.SetEvent();
+	WakeByAddressAll(&_publishedFrameId);
+	_watchThread.join();
+
+	std::unique_lock<std::shared_mutex> mapLock(_mapLock);
+	Unmap_NoLock();
+	WINTRACE(L"ShmFrameSource stopped");
+}
+
+bool ShmFrameSource::TryMap_NoLock()
+{
+	_mapping.reset(OpenFileMappingW(FILE_MAP_READ, FALSE, _config.shmName.c_str()));
+	if (!_mapping)
+	{
+		return false;
+	}
+
+	auto view = static_cast<const BYTE*>(MapViewOfFile(_mapping.get(), FILE_MAP_READ, 0, 0, 0));
+	if (!view)
+	{
+		_mapping.reset();
+		return false;
+	}
+
+	MEMORY_BASIC_INFORMATION info{};
+	const auto viewSize = VirtualQuery(view, &info, sizeof(info)) ? info.RegionSize : 0;
+	auto header = reinterpret_cast<const VCamShmRingHeader*>(view);
+	VCamShmRingGeometry geometry{};
+	if (!VCamShmRingReadGeometry(header, viewSize, &geometry))
+	{
+		WINTRACE(L"ShmFrameSource ring '%s' is not valid yet size:%Iu magic:0x%08X", _config.shmName.c_str(), viewSize, viewSize >= sizeof(VCamShmRingHeader) ? header->magic : 0);
+		UnmapViewOfFile(view);
+		_mapping.reset();
+		return false;
+	}
+
+	_view = view;
+	_viewSize = viewSize;
+	_header = header;
+	_geometry = geometry;
+	_producerEvent.reset(OpenEventW(SYNCHRONIZE, FALSE, (_config.shmName + L"_event").c_str()));
+	WINTRACE(
+		L"ShmFrameSource mapped '%s' %ux%u stride:%u slots:%u slotSize:%llu event:%u",
+		_config.shmName.c_str(),
+		geometry.width,
+		geometry.height,
+		geometry.stride,
+		geometry.slotCount,
+		geometry.slotSize,
+		_producerEvent ? 1 : 0);
+	return true;
+}
+
+void ShmFrameSource::Unmap_NoLock()
+{
+	if (_view)
+	{
+		UnmapViewOfFile(_view);
+	}
+	_view = nullptr;
+	_viewSize = 0;
+	_header = nullptr;
+	_geometry = {};
+	_producerEvent.reset();
+	_mapping.reset();
+}
+
+void ShmFrameSource::WatchLoop()
+{
+	WINTRACE(L"ShmFrameSource::WatchLoop enter");
+	wil::unique_handle timer(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+	auto mapped = false;
+	auto lastFrameTick = GetTickCount64();
+	while (_running.load())
+	{
+		if (!mapped)
+		{
+			{
+				std::unique_lock<std::shared_mutex> mapLock(_mapLock);
+				mapped = TryMap_NoLock();
+			}
+			if (!mapped)
+			{
+				WaitForSingleObject(_stopEvent.get(), kMapRetryIntervalMs);
+				continue;
+			}
+		}
+
+		// A producer tearing the ring down clears the magic, and one reconfiguring it rewrites the
+		// geometry; drop the view and map (and validate) it again.
+		VCamShmRingGeometry geometry{};
+		if (!VCamShmRingReadGeometry(_header, _viewSize, &geometry) || memcmp(&geometry, &_geometry, sizeof(geometry)) != 0)
+		{
+			WINTRACE(L"ShmFrameSource ring '%s' closed or changed by producer", _config.shmName.c_str());
+			std::unique_lock<std::shared_mutex> mapLock(_mapLock);
+			Unmap_NoLock();
+			_lastProducerFrame = 0;
+			mapped = false;
+			continue;
+		}
+
+		const auto latest = ReadAcquire(&_header->latestFrame);
+		if (latest && latest != _lastProducerFrame)
+		{
+			if (latest < _lastProducerFrame)
+			{
+				WINTRACE(L"ShmFrameSource producer restarted frame:%llu previous:%llu", latest, _lastProducerFrame);
+			}
+			_lastProducerFrame = latest;
+			lastFrameTick = GetTickCount64();
+			_latestFrameTime.store(MFGetSystemTime());
+			_publishedFrameId.fetch_add(1);
+			WakeByAddressAll(&_publishedFrameId);
+		}
+
+		if (_producerEvent)
+		{
+			HANDLE waits[] = { _stopEvent.get(), _producerEvent.get() };
+			WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, kProducerEventTimeoutMs);
+		}
+		else
+		{
+			const auto pollMs = PollIntervalMs(GetTickCount64() - lastFrameTick, _geometry);
+			if (timer)
+			{
+				LARGE_INTEGER due{};
+				due.QuadPart = -10000ll * pollMs; // relative
+				SetWaitableTimer(timer.get(), &due, 0, nullptr, nullptr, FALSE);
+				HANDLE waits[] = { _stopEvent.get(), timer.get() };
+				WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, INFINITE);
+			}
+			else
+			{
+				WaitForSingleObject(_stopEvent.get(), pollMs);
+			}
+		}
+	}
+	WINTRACE(L"ShmFrameSource::WatchLoop exit");
+}
+
+bool ShmFrameSource::HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId)
+{
+	const auto frameId = _publishedFrameId.load();
+	if (outLatestFrameId)
+	{
+		*outLatestFrameId = frameId > lastDeliveredFrameId ? frameId : 0;
+	}
+	return frameId > lastDeliveredFrameId;
+}
+
+LONGLONG ShmFrameSource::GetLatestFrameTime()
+{
+	return _latestFrameTime.load();
+}
+
+bool ShmFrameSource::WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs)
+{
+	if (!_running.load())
+	{
+		return false;
+	}
+
+	auto compare = lastDeliveredFrameId;
+	if (_publishedFrameId.load() != compare)
+	{
+		return true;
+	}
+	return WaitOnAddress(&_publishedFrameId, &compare, sizeof(compare), timeoutMs) != FALSE;
+}
+
+HRESULT ShmFrameSource::CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId)
+{
+	RETURN_HR_IF_NULL(E_POINTER, destination);
+	RETURN_HR_IF(E_INVALIDARG, destinationStride <= 0);
+	RETURN_HR_IF(E_INVALIDARG, destinationStride < static_cast<LONG>(scaler.GetOutputWidth()));
+	RETURN_HR_IF_NULL(E_POINTER, outCopiedFrameId);
+	*outCopiedFrameId = 0;
+
+	const auto requiredLength = static_cast<size_t>(destinationStride) * scaler.GetOutputHeight() * 3 / 2;
+	RETURN_HR_IF(E_BOUNDS, destinationLength < requiredLength);
+
+	const auto frameId = _publishedFrameId.load();
+	if (!frameId || frameId <= minimumFrameIdExclusive)
+	{
+		return S_FALSE;
+	}
+
+	std::shared_lock<std::shared_mutex> mapLock(_mapLock);
+	if (!_header)
+	{
+		return S_FALSE;
+	}
+
+	// Offsets and sizes only come from the copy validated at map time.
+	const auto geometry = _geometry;
+	struct CopyTarget
+	{
+		NV12Scaler* scaler;
+		BYTE* destination;
+		LONG destinationStride;
+	} target{ &scaler, destination, destinationStride };
+	uint32_t tornCopies = 0;
+	const auto latest = VCamShmRingReadLatest(
+		_view,
+		&geometry,
+		kMaxReadAttempts,
+		[](void* context, const uint8_t* y, const uint8_t* uv, const VCamShmRingGeometry* ring)
+		{
+			auto target = static_cast<CopyTarget*>(context);
+			target->scaler->Copy(y, ring->stride, uv, ring->stride, ring->width, ring->height, target->destination, target->destinationStride);
+		},
+		&target,
+		&tornCopies);
+
+	// Copies the producer lapped are discarded; the buffer content is garbage unless one succeeded.
+	static auto tornMetric = MetricsGet("shm.torn");
+	if (tornCopies)
+	{
+		tornMetric->Add(tornCopies);
+	}
+	if (!latest)
+	{
+		return S_FALSE;
+	}
+
+	if (!_firstCopyLogged.exchange(true))
+	{
+		WINTRACE(L"ShmFrameSource first frame copy stride:%ld length:%u producerFrame:%llu", destinationStride, destinationLength, latest);
+	}
+	*outCopiedFrameId = frameId;
+	return S_OK;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+#include "FrameSource.h"
+#include "GstPipelineSource.h"
+
+#include "ShmFrameRing.h"
+
+// Reads NV12 frames straight out of a shared-memory ring (see ShmFrameRing.h) into MF buffers:
+// no GStreamer allocation, caps negotiation or queue hop, and one copy per delivered frame.
+// A watcher thread maps the section (retrying until the producer creates it), notices new
+// frames by sleeping on the producer's optional "<name>_event" or else polling paced by the ring's
+// frame rate, and publishes frame ids/arrival times with the same semantics as GstPipelineSource.
+class ShmFrameSource : public FrameSource
+{
+public:
+	~ShmFrameSource() override;
+
+	HRESULT Start(const VCamPipelineConfig& config) override;
+	void Stop() override;
+	bool HasNewFrameSince(uint64_t lastDeliveredFrameId, uint64_t* outLatestFrameId) override;
+	LONGLONG GetLatestFrameTime() override;
+	bool WaitForNewFrame(uint64_t lastDeliveredFrameId, DWORD timeoutMs) override;
+	HRESULT CopyLatestFrameTo(NV12Scaler& scaler, BYTE* destination, LONG destinationStride, DWORD destinationLength, uint64_t minimumFrameIdExclusive, uint64_t* outCopiedFrameId) override;
+
+private:
+	void WatchLoop();
+	bool TryMap_NoLock();
+	void Unmap_NoLock();
+	void StopWatcher_NoLock();
+
+private:
+	// Protects start/stop transitions.
+	std::mutex _stateLock;
+	UINT _users = 0;
+	std::atomic<bool> _running = false;
+	std::thread _watchThread;
+	wil::unique_event_nothrow _stopEvent;
+	VCamPipelineConfig _config;
+
+	// Shared by copies, exclusive while the watcher maps or unmaps the section.
+	std::shared_mutex _mapLock;
+	wil::unique_handle _mapping;
+	wil::unique_handle _producerEvent;
+	const BYTE* _view = nullptr;
+	SIZE_T _viewSize = 0;
+	const VCamShmRingHeader* _header = nullptr;
+	VCamShmRingGeometry _geometry{};
+
+	// Local ids increase by one per producer frame seen, so they survive producer restarts.
+	std::atomic<uint64_t> _publishedFrameId = 0;
+	std::atomic<LONGLONG> _latestFrameTime = 0;
+	uint64_t _lastProducerFrame = 0;
+	std::atomic<bool> _firstCopyLogged = false;
+};
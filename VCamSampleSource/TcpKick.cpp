@@ -1,9 +1,15 @@
 #include "pch.h"
 #include "Tools.h"
 
+#include "TcpKick.h"
+#include "TcpKickClient.h"
+#include "Metrics.h"
+
 #include <climits>
-#include <mutex>
 #include <string>
+#include <vector>
+
+#include <mstcpip.h>
 
 #pragma comment(lib, "ws2_32.lib")
 
@@ -12,10 +18,16 @@ namespace
 	constexpr PCWSTR kConfigPath = L"SOFTWARE\\VCamSample\\GStreamer";
 	constexpr PCWSTR kLogEndpointValueName = L"LogEndpoint";
 	constexpr PCWSTR kDefaultLogEndpoint = L"tcp://192.168.122.1:5555";
-
-	std::mutex g_lock;
-	SOCKET g_socket = INVALID_SOCKET;
-	bool g_wsaInitialized = false;
+	constexpr PCWSTR kConnectTimeoutValueName = L"KickConnectTimeoutMs";
+	constexpr PCWSTR kStartPolicyValueName = L"KickStartPolicy";
+	constexpr DWORD kDefaultConnectTimeoutMs = 2000;
+	// Delay before racing the next address while earlier attempts are pending (RFC 8305 suggests 250 ms).
+	constexpr ULONGLONG kAttemptDelayMs = 250;
+	constexpr DWORD kWaitSlackMs = 500;
+	constexpr ULONG kKeepAliveIdleMs = 10000;
+	constexpr ULONG kKeepAliveIntervalMs = 1000;
+	// Log bytes waiting for the session thread; batches that do not fit are dropped and counted.
+	constexpr size_t kLogQueueBytes = 256 * 1024;
 
 	std::wstring ReadLogEndpoint()
 	{
@@ -58,116 +70,441 @@ namespace
 		return !host->empty() && !port->empty();
 	}
 
-	void CloseSocket_NoLock()
+	DWORD ReadDwordValue(PCWSTR valueName, DWORD defaultValue)
 	{
-		if (g_socket != INVALID_SOCKET)
+		DWORD value = 0;
+		DWORD size = sizeof(value);
+		if (RegGetValueW(HKEY_LOCAL_MACHINE, kConfigPath, valueName, RRF_RT_REG_DWORD, nullptr, &value, &size) != ERROR_SUCCESS)
 		{
-			closesocket(g_socket);
-			g_socket = INVALID_SOCKET;
+			return defaultValue;
 		}
+		return value;
 	}
 
-	HRESULT EnsureWsa_NoLock()
+	void EnableKeepAlive(SOCKET sock)
 	{
-		if (g_wsaInitialized)
-			return S_OK;
-
-		WSADATA wsaData{};
-		const auto wsaStatus = WSAStartup(MAKEWORD(2, 2), &wsaData);
-		RETURN_HR_IF(HRESULT_FROM_WIN32(wsaStatus), wsaStatus != 0);
-		g_wsaInitialized = true;
-		return S_OK;
+		// A host that vanishes without a FIN is noticed within kKeepAliveIdleMs plus ten probes.
+		tcp_keepalive keepAlive{ 1, kKeepAliveIdleMs, kKeepAliveIntervalMs };
+		DWORD returned = 0;
+		WSAIoctl(sock, SIO_KEEPALIVE_VALS, &keepAlive, sizeof(keepAlive), nullptr, 0, &returned, nullptr, nullptr);
 	}
-}
 
-HRESULT TcpKickConnectFromRegistry()
-{
-	std::lock_guard<std::mutex> guard(g_lock);
-	if (g_socket != INVALID_SOCKET)
+	// Resolves host and races connects over the results (RFC 8305): addresses alternate between
+	// IPv6 and IPv4, a new attempt starts every kAttemptDelayMs while earlier ones are pending,
+	// and the first to complete wins. Returns a blocking socket.
+	HRESULT ConnectHappyEyeballs(const std::string& host, const std::string& port, ULONGLONG deadline, SOCKET* outSocket)
 	{
-		return S_OK;
-	}
+		*outSocket = INVALID_SOCKET;
+
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+
+		addrinfo* result = nullptr;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+		{
+			return HRESULT_FROM_WIN32(WSAGetLastError());
+		}
+
+		std::vector<addrinfo*> v6;
+		std::vector<addrinfo*> v4;
+		for (auto ptr = result; ptr; ptr = ptr->ai_next)
+		{
+			(ptr->ai_family == AF_INET6 ? v6 : v4).push_back(ptr);
+		}
+
+		std::vector<addrinfo*> candidates;
+		for (size_t i = 0; i < (std::max)(v6.size(), v4.size()); i++)
+		{
+			if (i < v6.size())
+				candidates.push_back(v6[i]);
+			if (i < v4.size())
+				candidates.push_back(v4[i]);
+		}
+
+		HRESULT hr = HRESULT_FROM_WIN32(WSAECONNREFUSED);
+		std::vector<SOCKET> pending;
+		SOCKET winner = INVALID_SOCKET;
+		size_t next = 0;
+		ULONGLONG nextAttempt = 0;
+		while (winner == INVALID_SOCKET)
+		{
+			const auto now = GetTickCount64();
+			if (now >= deadline)
+			{
+				hr = HRESULT_FROM_WIN32(WSAETIMEDOUT);
+				break;
+			}
 
-	std::string host;
-	std::string port;
-	const auto endpoint = ReadLogEndpoint();
-	RETURN_HR_IF(E_INVALIDARG, !ParseTcpEndpoint(endpoint, &host, &port));
+			if (next < candidates.size() && (pending.empty() || now >= nextAttempt))
+			{
+				const auto candidate = candidates[next++];
+				nextAttempt = now + kAttemptDelayMs;
+				auto sock = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+				u_long nonBlocking = 1;
+				if (sock == INVALID_SOCKET || ioctlsocket(sock, FIONBIO, &nonBlocking) != 0)
+				{
+					hr = HRESULT_FROM_WIN32(WSAGetLastError());
+					if (sock != INVALID_SOCKET)
+						closesocket(sock);
+					continue;
+				}
 
-	RETURN_IF_FAILED(EnsureWsa_NoLock());
+				if (connect(sock, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0)
+				{
+					winner = sock;
+					break;
+				}
 
-	addrinfo hints{};
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
+				const auto error = WSAGetLastError();
+				if (error != WSAEWOULDBLOCK)
+				{
+					hr = HRESULT_FROM_WIN32(error);
+					closesocket(sock);
+					continue;
+				}
+				pending.push_back(sock);
+			}
 
-	addrinfo* result = nullptr;
-	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
-	{
-		return HRESULT_FROM_WIN32(WSAGetLastError());
+			if (pending.empty())
+			{
+				if (next >= candidates.size())
+					break;
+				continue;
+			}
+
+			// Wake up for the first completion, the next attempt or the deadline.
+			auto wakeAt = deadline;
+			if (next < candidates.size())
+			{
+				wakeAt = (std::min)(wakeAt, nextAttempt);
+			}
+			const auto waitMs = wakeAt > now ? wakeAt - now : 0;
+			timeval timeout{ static_cast<long>(waitMs / 1000), static_cast<long>((waitMs % 1000) * 1000) };
+
+			fd_set writeSet;
+			fd_set exceptSet;
+			FD_ZERO(&writeSet);
+			FD_ZERO(&exceptSet);
+			for (auto sock : pending)
+			{
+				FD_SET(sock, &writeSet);
+				FD_SET(sock, &exceptSet);
+			}
+
+			if (select(0, nullptr, &writeSet, &exceptSet, &timeout) == SOCKET_ERROR)
+			{
+				hr = HRESULT_FROM_WIN32(WSAGetLastError());
+				break;
+			}
+
+			for (auto it = pending.begin(); it != pending.end();)
+			{
+				if (FD_ISSET(*it, &exceptSet))
+				{
+					// Winsock reports a failed non-blocking connect through the except set.
+					int error = 0;
+					int length = sizeof(error);
+					getsockopt(*it, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length);
+					hr = HRESULT_FROM_WIN32(error ? error : WSAECONNREFUSED);
+					closesocket(*it);
+					it = pending.erase(it);
+					continue;
+				}
+
+				if (winner == INVALID_SOCKET && FD_ISSET(*it, &writeSet))
+				{
+					winner = *it;
+					it = pending.erase(it);
+					continue;
+				}
+				it++;
+			}
+		}
+
+		for (auto sock : pending)
+		{
+			closesocket(sock);
+		}
+		freeaddrinfo(result);
+
+		if (winner == INVALID_SOCKET)
+		{
+			return hr;
+		}
+
+		u_long blocking = 0;
+		ioctlsocket(winner, FIONBIO, &blocking);
+		*outSocket = winner;
+		return S_OK;
 	}
 
-	HRESULT hr = HRESULT_FROM_WIN32(WSAECONNREFUSED);
-	for (addrinfo* ptr = result; ptr; ptr = ptr->ai_next)
+	DWORD WINAPI SessionThread(LPVOID parameter);
+	VOID CALLBACK StartSessionCallback(PTP_CALLBACK_INSTANCE instance, PVOID context);
+
+	// Winsock side of the kick session (see TcpKickClient.h). Only the session thread touches
+	// the socket; Wake and the thread starts run under the client lock.
+	class WinsockKickTransport
 	{
-		SOCKET sock = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
-		if (sock == INVALID_SOCKET)
+	public:
+		int64_t StartSessionThread()
 		{
-			hr = HRESULT_FROM_WIN32(WSAGetLastError());
-			continue;
+			if (!_sendWake)
+			{
+				RETURN_IF_FAILED(_sendWake.create());
+			}
+
+			// The thread pins the DLL until it exits, so an unload can never pull code from under it.
+			HMODULE module = nullptr;
+			RETURN_IF_WIN32_BOOL_FALSE(GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&SessionThread), &module));
+			auto thread = CreateThread(nullptr, 0, SessionThread, module, 0, nullptr);
+			if (!thread)
+			{
+				const auto error = GetLastError();
+				FreeLibrary(module);
+				RETURN_WIN32(error);
+			}
+			CloseHandle(thread);
+			return S_OK;
 		}
 
-		if (connect(sock, ptr->ai_addr, static_cast<int>(ptr->ai_addrlen)) == 0)
+		bool QueueSessionStart()
 		{
-			g_socket = sock;
-			hr = S_OK;
-			break;
+			HMODULE module = nullptr;
+			if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&StartSessionCallback), &module))
+			{
+				LOG_LAST_ERROR();
+				return false;
+			}
+
+			if (!TrySubmitThreadpoolCallback(StartSessionCallback, module, nullptr))
+			{
+				LOG_LAST_ERROR();
+				FreeLibrary(module);
+				return false;
+			}
+			return true;
 		}
 
-		hr = HRESULT_FROM_WIN32(WSAGetLastError());
-		closesocket(sock);
+		// Session thread only, around Run.
+		void SetStartupStatus(int wsaStatus) { _wsaStatus = wsaStatus; }
+
+		int64_t Connect()
+		{
+			if (_wsaStatus != 0)
+			{
+				return HRESULT_FROM_WIN32(_wsaStatus);
+			}
+
+			std::string host;
+			std::string port;
+			_endpoint = ReadLogEndpoint();
+			const auto timeoutMs = ReadDwordValue(kConnectTimeoutValueName, kDefaultConnectTimeoutMs);
+			SOCKET sock = INVALID_SOCKET;
+			auto hr = ParseTcpEndpoint(_endpoint, &host, &port) ? ConnectHappyEyeballs(host, port, GetTickCount64() + timeoutMs, &sock) : E_INVALIDARG;
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			EnableKeepAlive(sock);
+			// Makes the socket non-blocking; a send that would block waits for FD_WRITE.
+			hr = _socketEvent ? S_OK : _socketEvent.create();
+			if (SUCCEEDED(hr) && WSAEventSelect(sock, _socketEvent.get(), FD_READ | FD_WRITE | FD_CLOSE) != 0)
+			{
+				hr = HRESULT_FROM_WIN32(WSAGetLastError());
+			}
+			if (FAILED(hr))
+			{
+				closesocket(sock);
+				return hr;
+			}
+			_socket = sock;
+			return S_OK;
+		}
+
+		int64_t Send(const char* data, size_t size)
+		{
+			const auto chunk = static_cast<int>((std::min)(size, static_cast<size_t>(INT_MAX)));
+			const auto result = send(_socket, data, chunk, 0);
+			if (result > 0)
+			{
+				return result;
+			}
+			return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+		}
+
+		bool Wait(bool writeBlocked, uint64_t timeoutMs)
+		{
+			// FD_WRITE is signaled whenever a blocked send can go on, so writeBlocked needs no setup.
+			UNREFERENCED_PARAMETER(writeBlocked);
+			const HANDLE events[] = { _socketEvent.get(), _sendWake.get() };
+			WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, timeoutMs == UINT64_MAX ? INFINITE : static_cast<DWORD>((std::min)(timeoutMs, static_cast<uint64_t>(INFINITE - 1))));
+
+			WSANETWORKEVENTS network{};
+			if (WSAEnumNetworkEvents(_socket, _socketEvent.get(), &network) != 0 || (network.lNetworkEvents & FD_CLOSE))
+			{
+				return false;
+			}
+
+			if (network.lNetworkEvents & FD_READ)
+			{
+				// The host has nothing to say yet; read and discard so FD_READ re-arms.
+				char buffer[256];
+				const auto received = recv(_socket, buffer, sizeof(buffer), 0);
+				if (received == 0 || (received < 0 && WSAGetLastError() != WSAEWOULDBLOCK))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void Wake()
+		{
+			if (_sendWake)
+			{
+				_sendWake.SetEvent();
+			}
+		}
+
+		void Close()
+		{
+			if (_socket != INVALID_SOCKET)
+			{
+				closesocket(_socket);
+				_socket = INVALID_SOCKET;
+			}
+		}
+
+		std::string Stats() { return MetricsSnapshot(); }
+
+		void OnSent(size_t bytes)
+		{
+			static const auto sentBytes = MetricsGet("kick.sentbytes");
+			sentBytes->Add(static_cast<int64_t>(bytes));
+		}
+
+		void OnConnected()
+		{
+			WINTRACE(L"TcpKick connected to '%s'", _endpoint.c_str());
+		}
+
+		void OnDisconnected(uint64_t retryMs)
+		{
+			UNREFERENCED_PARAMETER(retryMs);
+			WINTRACE(L"TcpKick disconnected from '%s'", _endpoint.c_str());
+		}
+
+		void OnConnectFailed(int64_t error, uint64_t retryMs)
+		{
+			if (FAILED(static_cast<HRESULT>(error)))
+			{
+				WINTRACE_ERROR(L"TcpKick connect to '%s' failed hr:0x%08X, retrying in %u ms", _endpoint.c_str(), static_cast<HRESULT>(error), static_cast<UINT>(retryMs));
+			}
+		}
+
+	private:
+		// Wakes the connected session thread for queued data or shutdown.
+		wil::unique_event_nothrow _sendWake;
+		wil::unique_event_nothrow _socketEvent;
+		SOCKET _socket = INVALID_SOCKET;
+		std::wstring _endpoint;
+		int _wsaStatus = 0;
+	};
+
+	WinsockKickTransport g_transport;
+	TcpKickClient<WinsockKickTransport> g_client(g_transport, kLogQueueBytes, GetCurrentProcessId());
+
+	// Owns Winsock for the lifetime of the session.
+	DWORD WINAPI SessionThread(LPVOID parameter)
+	{
+		WSADATA wsaData{};
+		const auto wsaStatus = WSAStartup(MAKEWORD(2, 2), &wsaData);
+		g_transport.SetStartupStatus(wsaStatus);
+		g_client.Run();
+		if (wsaStatus == 0)
+		{
+			WSACleanup();
+		}
+		FreeLibraryAndExitThread(static_cast<HMODULE>(parameter), 0);
 	}
 
-	freeaddrinfo(result);
-	return hr;
+	VOID CALLBACK StartSessionCallback(PTP_CALLBACK_INSTANCE instance, PVOID context)
+	{
+		LOG_IF_FAILED(static_cast<HRESULT>(g_client.StartQueuedSession()));
+		FreeLibraryWhenCallbackReturns(instance, static_cast<HMODULE>(context));
+	}
+}
+
+void TcpKickPrewarm(UINT camera, const TcpKickCameraFormat& format)
+{
+	g_client.OnActivated(camera, format);
+}
+
+void TcpKickRelease(UINT camera)
+{
+	g_client.OnReleased(camera);
 }
 
-void TcpKickDisconnect()
+HRESULT TcpKickStart(UINT camera)
 {
-	std::lock_guard<std::mutex> guard(g_lock);
-	CloseSocket_NoLock();
+	const auto policy = ReadDwordValue(kStartPolicyValueName, static_cast<DWORD>(TcpKickStartPolicy::WaitForConnection));
+	const auto timeoutMs = ReadDwordValue(kConnectTimeoutValueName, kDefaultConnectTimeoutMs);
 
-	if (g_wsaInitialized)
+	// Bounded by the connect deadline (plus some slack for name resolution) instead of the OS
+	// TCP timeout; the session keeps reconnecting in the background either way.
+	const auto waitMs = policy == static_cast<DWORD>(TcpKickStartPolicy::Optimistic) ? 0 : static_cast<uint64_t>(timeoutMs) + kWaitSlackMs;
+	const auto result = g_client.StartStream(camera, waitMs);
+	switch (result.status)
 	{
-		WSACleanup();
-		g_wsaInitialized = false;
+	case TcpKickStartStatus::Connected:
+	case TcpKickStartStatus::Pending:
+		return S_OK;
+
+	case TcpKickStartStatus::Failed:
+		return static_cast<HRESULT>(result.error);
+
+	case TcpKickStartStatus::TimedOut:
+		return HRESULT_FROM_WIN32(WSAETIMEDOUT);
+
+	default:
+		RETURN_HR(result.error ? static_cast<HRESULT>(result.error) : HRESULT_FROM_WIN32(WSAESHUTDOWN));
 	}
 }
 
-bool TcpKickSendLogUtf8(const char* data, size_t size)
+void TcpKickStop(UINT camera)
+{
+	g_client.StopStream(camera);
+}
+
+void TcpKickShutdown()
+{
+	g_client.Shutdown();
+}
+
+bool TcpKickForwardLogUtf8(const char* data, size_t size)
 {
 	if (!data || size == 0)
 	{
 		return false;
 	}
 
-	std::lock_guard<std::mutex> guard(g_lock);
-	if (g_socket == INVALID_SOCKET)
+	static const auto droppedBytes = MetricsGet("kick.droppedbytes");
+	static const auto queuedMax = MetricsGet("kick.queuedmax");
+	size_t queuedBytes = 0;
+	switch (g_client.ForwardLog(data, size, &queuedBytes))
 	{
+	case TcpKickLogStatus::Queued:
+		queuedMax->Max(static_cast<int64_t>(queuedBytes));
+		return true;
+
+	case TcpKickLogStatus::Dropped:
+		droppedBytes->Add(static_cast<int64_t>(size));
 		return false;
-	}
 
-	size_t totalSent = 0;
-	while (totalSent < size)
-	{
-		const auto remaining = size - totalSent;
-		const auto maxInt = static_cast<size_t>(INT_MAX);
-		const auto chunk = static_cast<int>((remaining > maxInt) ? maxInt : remaining);
-		const auto sent = send(g_socket, data + totalSent, chunk, 0);
-		if (sent <= 0)
-		{
-			return false;
-		}
-		totalSent += static_cast<size_t>(sent);
+	default:
+		return false;
 	}
-	return true;
 }
@@ -1,6 +1,28 @@
 #pragma once
 #include <cstddef>
 
-HRESULT TcpKickConnectFromRegistry();
-void TcpKickDisconnect();
-bool TcpKickSendLogUtf8(const char* data, size_t size);
+#include "TcpKickSession.h"
+
+// KickStartPolicy on the main config key.
+enum class TcpKickStartPolicy
+{
+	// Start waits up to KickConnectTimeoutMs for the connection and fails without it.
+	WaitForConnection = 0,
+	// Start returns at once; the connection is made (and retried) in the background.
+	Optimistic = 1,
+};
+
+// Prewarm/Release are counted per activated media source and Start/Stop per running stream. Prewarm
+// only queues its frame and leaves starting the session to a threadpool worker. The
+// host hears about them over one long-lived connection (see TcpKickProtocol.h), so a start
+// costs a single send once the session is up. The session thread owns Winsock and the socket:
+// it races IPv6 and IPv4 addresses, keeps the connection alive and reconnects with backoff
+// until TcpKickShutdown (DllCanUnloadNow).
+void TcpKickPrewarm(UINT camera, const TcpKickCameraFormat& format);
+void TcpKickRelease(UINT camera);
+HRESULT TcpKickStart(UINT camera);
+void TcpKickStop(UINT camera);
+void TcpKickShutdown();
+// Queues a batch of complete log lines for the session thread and returns at once. Nothing is
+// queued while disconnected; batches beyond the queue bound are dropped and reported to the host.
+bool TcpKickForwardLogUtf8(const char* data, size_t size);
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "TcpKickSession.h"
+
+enum class TcpKickStartStatus
+{
+	// The connection is up; the START frame is queued on it.
+	Connected,
+	// waitMs was 0: the START frame goes out once the session connects.
+	Pending,
+	// The attempt made for this start failed with error; the stream is not counted.
+	Failed,
+	// No attempt completed within waitMs; the stream is not counted.
+	TimedOut,
+	// The session thread could not be started (error) or is shutting down.
+	Unavailable,
+};
+
+struct TcpKickStartResult
+{
+	TcpKickStartStatus status = TcpKickStartStatus::Connected;
+	int64_t error = 0;
+};
+
+enum class TcpKickLogStatus
+{
+	Queued,
+	// Nothing is queued while disconnected.
+	NotConnected,
+	// Over the queue bound; counted and reported to the host after the gap.
+	Dropped,
+};
+
+// The kick session: producers (stream starts, activations, the trace writer) queue frames under
+// one lock that is never held across network I/O, and the session thread (Run) connects, sends,
+// and reconnects with TcpKickReconnectPolicy until Shutdown. Everything platform-specific comes
+// from Transport, so the tests drive the same loop over POSIX sockets:
+//   int64_t StartSessionThread()      start a thread calling Run(); 0 or an error (under the lock)
+//   bool QueueSessionStart()          have StartQueuedSession() called soon on another thread
+//   int64_t Connect()                 resolve and connect within the transport's deadline; 0 or an error
+//   int64_t Send(const char*, size_t) bytes sent, 0 if it would block, < 0 once the connection is gone
+//   bool Wait(bool writeBlocked, uint64_t timeoutMs)  sleep until the connection has news (writable
+//                                     again if writeBlocked), Wake is called or the timeout passes
+//                                     (UINT64_MAX: none); false once the connection is gone
+//   void Wake()                       end a Wait early, from any thread
+//   void Close()                      drop the connection made by Connect
+//   std::string Stats()               payload of the periodic STATS frame
+//   void OnSent(size_t), OnConnected(), OnDisconnected(uint64_t retryMs),
+//   OnConnectFailed(int64_t error, uint64_t retryMs)  metrics and tracing
+template <typename Transport>
+class TcpKickClient
+{
+public:
+	static constexpr uint64_t StatsIntervalMs = 5000;
+
+	TcpKickClient(Transport& transport, size_t logQueueBytes, uint32_t processId) :
+		_transport(transport),
+		_pendingLogs(logQueueBytes),
+		_processId(processId)
+	{
+	}
+
+	TcpKickClient(const TcpKickClient&) = delete;
+	TcpKickClient& operator=(const TcpKickClient&) = delete;
+
+	// An activated source: queues its PREWARM and has the session started off the caller's thread,
+	// so activation only pays for queueing the frame.
+	void OnActivated(uint32_t camera, const TcpKickCameraFormat& format)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_session.OnActivated(camera, format, _pendingControl);
+		WakeSender_NoLock();
+		_shutdown = false;
+		if (!_sessionRunning && !_sessionStartQueued && _transport.QueueSessionStart())
+		{
+			_sessionStartQueued = true;
+		}
+	}
+
+	void OnReleased(uint32_t camera)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_session.OnReleased(camera, _pendingControl);
+		WakeSender_NoLock();
+	}
+
+	// Called by the transport for QueueSessionStart. A Shutdown that came in meanwhile wins.
+	int64_t StartQueuedSession()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_sessionStartQueued = false;
+		return _shutdown ? 0 : EnsureSession_NoLock();
+	}
+
+	// Counts a running stream, starting the session if needed, and waits up to waitMs for the
+	// connection, cutting any reconnect backoff short. A stream that does not get one is uncounted
+	// again, except with waitMs 0, where it stays counted and is reported once connected.
+	TcpKickStartResult StartStream(uint32_t camera, uint64_t waitMs)
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		_shutdown = false;
+		if (const auto error = EnsureSession_NoLock())
+		{
+			return { TcpKickStartStatus::Unavailable, error };
+		}
+
+		_session.OnStreamStarted(camera, _pendingControl);
+		WakeSender_NoLock();
+		if (_connected)
+		{
+			return {};
+		}
+
+		_retryNow = true;
+		_sessionWake.notify_all();
+		if (!waitMs)
+		{
+			return { TcpKickStartStatus::Pending, 0 };
+		}
+
+		const auto attempts = _completedAttempts;
+		_attemptDone.wait_for(lock, std::chrono::milliseconds(waitMs), [this, attempts] { return _connected || _completedAttempts != attempts || !_sessionRunning; });
+		if (_connected)
+		{
+			return {};
+		}
+
+		_session.OnStreamStopped(camera, _pendingControl);
+		if (!_sessionRunning)
+		{
+			return { TcpKickStartStatus::Unavailable, 0 };
+		}
+		return _completedAttempts != attempts ? TcpKickStartResult{ TcpKickStartStatus::Failed, _lastConnectError } : TcpKickStartResult{ TcpKickStartStatus::TimedOut, 0 };
+	}
+
+	void StopStream(uint32_t camera)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_session.OnStreamStopped(camera, _pendingControl);
+		WakeSender_NoLock();
+	}
+
+	// Returns at once; the session thread sends the batch. *queuedBytes (optional) is the queue
+	// size after a successful append.
+	TcpKickLogStatus ForwardLog(const char* data, size_t size, size_t* queuedBytes)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (!_connected)
+		{
+			return TcpKickLogStatus::NotConnected;
+		}
+
+		if (!_pendingLogs.Append(data, size))
+		{
+			return TcpKickLogStatus::Dropped;
+		}
+
+		if (queuedBytes)
+		{
+			*queuedBytes = _pendingLogs.QueuedBytes();
+		}
+		_transport.Wake();
+		return TcpKickLogStatus::Queued;
+	}
+
+	// The session thread leaves its connection (or backoff) and exits; the next start or prewarm
+	// starts a new one.
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_shutdown = true;
+			_transport.Wake();
+		}
+		_sessionWake.notify_all();
+	}
+
+	bool IsConnected()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _connected;
+	}
+
+	bool IsSessionRunning()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _sessionRunning;
+	}
+
+	uint64_t DroppedLogBatches()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _pendingLogs.DroppedBatches();
+	}
+
+	// Body of the session thread: connects, runs the connection until it drops and reconnects
+	// with backoff until Shutdown.
+	void Run()
+	{
+		TcpKickReconnectPolicy reconnect;
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				if (_shutdown)
+				{
+					_sessionRunning = false;
+					break;
+				}
+				_retryNow = false;
+			}
+			reconnect.OnAttemptStarted();
+
+			const auto error = _transport.Connect();
+			auto connected = false;
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_lastConnectError = error;
+				_completedAttempts++;
+				if (!error && !_shutdown)
+				{
+					_connected = connected = true;
+					_session.OnConnected(_processId, _pendingControl);
+					WakeSender_NoLock();
+				}
+			}
+			_attemptDone.notify_all();
+
+			uint64_t retryDelay = 0;
+			if (connected)
+			{
+				reconnect.OnConnected();
+				_transport.OnConnected();
+				RunConnection();
+				{
+					std::lock_guard<std::mutex> lock(_lock);
+					_connected = false;
+					_session.OnDisconnected();
+					_pendingControl.clear();
+					_pendingLogs.Clear();
+				}
+				_transport.Close();
+				retryDelay = reconnect.OnDisconnected();
+				_transport.OnDisconnected(retryDelay);
+			}
+			else
+			{
+				if (!error)
+				{
+					// Connected just as Shutdown came in.
+					_transport.Close();
+				}
+				retryDelay = reconnect.OnAttemptFailed();
+				_transport.OnConnectFailed(error, retryDelay);
+			}
+
+			// A starting stream cuts the wait short.
+			std::unique_lock<std::mutex> lock(_lock);
+			_sessionWake.wait_for(lock, std::chrono::milliseconds(retryDelay), [this] { return _shutdown || _retryNow; });
+		}
+		_attemptDone.notify_all();
+	}
+
+private:
+	static uint64_t NowMs()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	int64_t EnsureSession_NoLock()
+	{
+		if (_sessionRunning)
+		{
+			return 0;
+		}
+
+		const auto error = _transport.StartSessionThread();
+		_sessionRunning = !error;
+		return error;
+	}
+
+	// Session changes append their frames to _pendingControl; wake the sender if there are any.
+	void WakeSender_NoLock()
+	{
+		if (!_pendingControl.empty())
+		{
+			_transport.Wake();
+		}
+	}
+
+	// Control frames go first; a notice about dropped logs precedes the logs that follow the gap.
+	// Returns false when the session is shutting down.
+	bool TakePending(std::string& sending, const std::string& stats)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (_shutdown)
+		{
+			return false;
+		}
+
+		sending.swap(_pendingControl);
+		if (!stats.empty())
+		{
+			TcpKickSession::AppendFrame(sending, VCAM_KICK_STATS, stats.data(), static_cast<uint32_t>(stats.size()));
+		}
+		_pendingLogs.Take(sending);
+		return true;
+	}
+
+	// Sends queued frames, and a STATS frame every StatsIntervalMs, until the connection drops or
+	// the session shuts down. A send that would block waits for the connection to drain while
+	// producers keep queueing (and dropping past the log queue bound).
+	void RunConnection()
+	{
+		std::string sending;
+		size_t sent = 0;
+		auto nextStats = NowMs() + StatsIntervalMs;
+		for (;;)
+		{
+			auto now = NowMs();
+			if (sent == sending.size())
+			{
+				std::string stats;
+				if (now >= nextStats)
+				{
+					stats = _transport.Stats();
+					nextStats = now + StatsIntervalMs;
+				}
+
+				sending.clear();
+				sent = 0;
+				if (!TakePending(sending, stats))
+				{
+					return;
+				}
+			}
+
+			if (sent < sending.size())
+			{
+				const auto result = _transport.Send(sending.data() + sent, sending.size() - sent);
+				if (result < 0)
+				{
+					return;
+				}
+
+				if (result > 0)
+				{
+					sent += static_cast<size_t>(result);
+					_transport.OnSent(static_cast<size_t>(result));
+					continue;
+				}
+			}
+
+			// Blocked on a send the stats wait; otherwise wake up when they are due.
+			const auto writeBlocked = sent < sending.size();
+			now = NowMs();
+			const auto timeoutMs = writeBlocked ? UINT64_MAX : (nextStats > now ? nextStats - now : 0);
+			if (!_transport.Wait(writeBlocked, timeoutMs))
+			{
+				return;
+			}
+		}
+	}
+
+	Transport& _transport;
+	std::mutex _lock;
+	std::condition_variable _attemptDone;
+	std::condition_variable _sessionWake;
+	// Running streams of every camera in the process share one session.
+	TcpKickSession _session;
+	std::string _pendingControl;
+	TcpKickLogQueue _pendingLogs;
+	const uint32_t _processId;
+	bool _connected = false;
+	// The session thread starts with the first stream and runs until Shutdown.
+	bool _sessionRunning = false;
+	bool _sessionStartQueued = false;
+	bool _shutdown = false;
+	bool _retryNow = false;
+	uint64_t _completedAttempts = 0;
+	int64_t _lastConnectError = 0;
+};
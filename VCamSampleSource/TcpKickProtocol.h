@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Kick channel protocol (the LogEndpoint connection). Every message is a frame: a
+// VCamKickFrameHeader followed by `size` bytes of payload, little-endian, source to host.
+// On every connection the source sends HELLO, then PREWARM or START for each camera that is
+// activated or streaming, then state changes, log batches and periodic stats as they happen.
+// Per camera the host sees PREWARM (a FrameServer activated it, streams will likely start),
+// START (its first stream started) and STOP (nothing running any more; a PREWARM follows if
+// the camera stays activated). tools/kick_host.py is a stand-in host. Plain C types only.
+
+#define VCAM_KICK_MAGIC 0x4B56u // "VK"
+#define VCAM_KICK_VERSION 1u
+
+#define VCAM_KICK_HELLO 1u   // VCamKickHelloPayload
+#define VCAM_KICK_PREWARM 2u // VCamKickCameraPayload
+#define VCAM_KICK_START 3u   // VCamKickCameraPayload
+#define VCAM_KICK_STOP 4u    // VCamKickCameraPayload
+#define VCAM_KICK_STATS 5u   // UTF-8 "name=value" list, space separated
+#define VCAM_KICK_LOG 6u     // UTF-8 log lines, CRLF terminated
+
+#pragma pack(push, 1)
+typedef struct VCamKickFrameHeader
+{
+	uint16_t magic;
+	uint8_t version;
+	uint8_t type;
+	// Payload bytes following the header.
+	uint32_t size;
+} VCamKickFrameHeader;
+
+typedef struct VCamKickHelloPayload
+{
+	uint32_t processId;
+} VCamKickHelloPayload;
+
+// The configured output of the camera, so the host can pre-spin a matching producer.
+typedef struct VCamKickCameraPayload
+{
+	uint32_t camera;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+} VCamKickCameraPayload;
+#pragma pack(pop)
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "TcpKickProtocol.h"
+
+// Portable state of the kick channel: what the host has been told, when to reconnect and which
+// log batches are waiting. None of it does I/O or locking (TcpKickClient.h adds the lock and the
+// session thread, TcpKick.cpp the sockets), so the tests build it on any host.
+
+struct TcpKickCameraFormat
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t fpsNumerator = 0;
+	uint32_t fpsDenominator = 0;
+};
+
+// Protocol state of the long-lived kick connection (see TcpKickProtocol.h). Activations and
+// running streams are counted per camera and each change appends the frames bringing the host
+// up to date; a new connection is resynchronized from scratch. It does no I/O (the caller sends
+// the appended frames) and is not thread-safe; callers serialize access.
+class TcpKickSession
+{
+public:
+	static constexpr uint32_t MaxCameras = 8;
+
+	void OnActivated(uint32_t camera, const TcpKickCameraFormat& format, std::string& frames)
+	{
+		if (camera >= MaxCameras)
+			return;
+
+		_cameras[camera].activations++;
+		_cameras[camera].format = format;
+		Synchronize(camera, frames);
+	}
+
+	void OnReleased(uint32_t camera, std::string& frames)
+	{
+		if (camera >= MaxCameras || !_cameras[camera].activations)
+			return;
+
+		_cameras[camera].activations--;
+		Synchronize(camera, frames);
+	}
+
+	void OnStreamStarted(uint32_t camera, std::string& frames)
+	{
+		if (camera >= MaxCameras)
+			return;
+
+		_cameras[camera].streams++;
+		Synchronize(camera, frames);
+	}
+
+	void OnStreamStopped(uint32_t camera, std::string& frames)
+	{
+		if (camera >= MaxCameras || !_cameras[camera].streams)
+			return;
+
+		_cameras[camera].streams--;
+		Synchronize(camera, frames);
+	}
+
+	void OnConnected(uint32_t processId, std::string& frames)
+	{
+		_connected = true;
+		VCamKickHelloPayload hello{};
+		hello.processId = processId;
+		AppendFrame(frames, VCAM_KICK_HELLO, &hello, sizeof(hello));
+		for (uint32_t camera = 0; camera < MaxCameras; camera++)
+		{
+			_cameras[camera].host = HostState::Idle;
+			Synchronize(camera, frames);
+		}
+	}
+
+	void OnDisconnected()
+	{
+		_connected = false;
+		for (auto& camera : _cameras)
+		{
+			camera.host = HostState::Idle;
+		}
+	}
+
+	bool IsConnected() const { return _connected; }
+	uint32_t Streams(uint32_t camera) const { return camera < MaxCameras ? _cameras[camera].streams : 0; }
+
+	static void AppendFrame(std::string& frames, uint8_t type, const void* payload, uint32_t size)
+	{
+		VCamKickFrameHeader header{};
+		header.magic = VCAM_KICK_MAGIC;
+		header.version = VCAM_KICK_VERSION;
+		header.type = type;
+		header.size = size;
+		frames.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (size)
+		{
+			frames.append(static_cast<const char*>(payload), size);
+		}
+	}
+
+private:
+	enum class HostState
+	{
+		Idle,
+		Prewarmed,
+		Streaming,
+	};
+
+	struct Camera
+	{
+		uint32_t activations = 0;
+		uint32_t streams = 0;
+		TcpKickCameraFormat format;
+		// What the host has been told on the current connection.
+		HostState host = HostState::Idle;
+	};
+
+	void Synchronize(uint32_t camera, std::string& frames)
+	{
+		auto& state = _cameras[camera];
+		const auto wanted = state.streams ? HostState::Streaming : state.activations ? HostState::Prewarmed : HostState::Idle;
+		if (!_connected || wanted == state.host)
+			return;
+
+		// Streaming -> prewarmed is reported as STOP then PREWARM, so STOP always means "not running".
+		if (state.host == HostState::Streaming || wanted == HostState::Idle)
+		{
+			AppendCameraFrame(camera, VCAM_KICK_STOP, frames);
+		}
+
+		if (wanted != HostState::Idle)
+		{
+			AppendCameraFrame(camera, wanted == HostState::Streaming ? VCAM_KICK_START : VCAM_KICK_PREWARM, frames);
+		}
+		state.host = wanted;
+	}
+
+	void AppendCameraFrame(uint32_t camera, uint8_t type, std::string& frames) const
+	{
+		const auto& format = _cameras[camera].format;
+		VCamKickCameraPayload payload{};
+		payload.camera = camera;
+		payload.width = format.width;
+		payload.height = format.height;
+		payload.fpsNumerator = format.fpsNumerator;
+		payload.fpsDenominator = format.fpsDenominator;
+		AppendFrame(frames, type, &payload, sizeof(payload));
+	}
+
+	Camera _cameras[MaxCameras];
+	bool _connected = false;
+};
+
+// Connection lifecycle of the session thread: Connecting, then Connected until the host goes
+// away, Waiting in between. Each failed attempt doubles the wait before the next one, up to
+// MaxDelayMs; a connection resets it, so a dropped connection is retried after InitialDelayMs.
+class TcpKickReconnectPolicy
+{
+public:
+	static constexpr uint64_t InitialDelayMs = 1000;
+	static constexpr uint64_t MaxDelayMs = 30000;
+
+	enum class State
+	{
+		Connecting,
+		Connected,
+		Waiting,
+	};
+
+	void OnAttemptStarted() { _state = State::Connecting; }
+
+	void OnConnected()
+	{
+		_state = State::Connected;
+		_delayMs = InitialDelayMs;
+	}
+
+	// Both return how long to wait before the next attempt.
+	uint64_t OnAttemptFailed()
+	{
+		_state = State::Waiting;
+		const auto delayMs = _delayMs;
+		_delayMs = (std::min)(_delayMs * 2, MaxDelayMs);
+		return delayMs;
+	}
+
+	uint64_t OnDisconnected()
+	{
+		_state = State::Waiting;
+		return _delayMs;
+	}
+
+	State GetState() const { return _state; }
+
+private:
+	State _state = State::Connecting;
+	uint64_t _delayMs = InitialDelayMs;
+};
+
+// LOG frames waiting for the session thread, bounded to a byte budget. A batch that does not fit
+// is dropped and counted, and the next Take puts a notice about the gap ahead of the logs that
+// follow it, so a slow sink only loses log lines and never stalls the producers.
+class TcpKickLogQueue
+{
+public:
+	explicit TcpKickLogQueue(size_t capacityBytes) :
+		_capacityBytes(capacityBytes)
+	{
+	}
+
+	// False when the batch was dropped.
+	bool Append(const char* data, size_t size)
+	{
+		if (size > UINT32_MAX || _frames.size() + sizeof(VCamKickFrameHeader) + size > _capacityBytes)
+		{
+			_droppedBatches++;
+			_droppedBytes += size;
+			return false;
+		}
+
+		TcpKickSession::AppendFrame(_frames, VCAM_KICK_LOG, data, static_cast<uint32_t>(size));
+		return true;
+	}
+
+	// Appends the drop notice (if any) and the queued frames to frames, leaving the queue empty.
+	void Take(std::string& frames)
+	{
+		if (_droppedBatches)
+		{
+			const auto notice = "[kick] log queue full, dropped " + std::to_string(_droppedBatches) + " batches (" + std::to_string(_droppedBytes) + " bytes)\r\n";
+			TcpKickSession::AppendFrame(frames, VCAM_KICK_LOG, notice.data(), static_cast<uint32_t>(notice.size()));
+			_droppedBatches = 0;
+			_droppedBytes = 0;
+		}
+		frames += _frames;
+		_frames.clear();
+	}
+
+	void Clear() { _frames.clear(); }
+	size_t QueuedBytes() const { return _frames.size(); }
+	uint64_t DroppedBatches() const { return _droppedBatches; }
+
+private:
+	const size_t _capacityBytes;
+	std::string _frames;
+	uint64_t _droppedBatches = 0;
+	uint64_t _droppedBytes = 0;
+};
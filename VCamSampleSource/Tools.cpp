@@ -3,6 +3,9 @@
 #include "Tools.h"
 #include "EnumNames.h"
 
+#include <algorithm>
+#include <vector>
+
 std::string to_string(const std::wstring& ws)
 {
 	if (ws.empty())
@@ -41,103 +44,164 @@ std::wstring to_wstring(const std::string& s)
 	return ws;
 }
 
-#define IFIID(x) if (guid == __uuidof(##x)) return L#x;
-#define IFGUID(x) if (guid == ##x) return L#x;
+namespace
+{
+	struct KnownGuid
+	{
+		const GUID* guid;
+		PCWSTR name;
+	};
 
-const std::string GUID_ToStringA(const GUID& guid, bool resolve) { return to_string(GUID_ToStringW(guid, resolve)); }
-const std::wstring GUID_ToStringW(const GUID& guid, bool resolve)
+#define KNOWN_GUID(x) { &x, L#x }
+#define KNOWN_IID(x) { &__uuidof(x), L#x }
+
+	// GUIDs we're interested in; some values are only known at link time, so the lookup index
+	// is sorted once on first use.
+	const KnownGuid kKnownGuids[] =
+	{
+		KNOWN_GUID(GUID_NULL),
+		KNOWN_GUID(CLSID_VCam),
+		KNOWN_GUID(PINNAME_VIDEO_CAPTURE),
+		KNOWN_GUID(MF_DEVICESTREAM_STREAM_CATEGORY),
+		KNOWN_GUID(MF_DEVICESTREAM_STREAM_ID),
+		KNOWN_GUID(MF_DEVICESTREAM_FRAMESERVER_SHARED),
+		KNOWN_GUID(MF_DEVICESTREAM_ATTRIBUTE_FRAMESOURCE_TYPES),
+		KNOWN_GUID(MF_DEVICESTREAM_MULTIPLEXED_MANAGER),
+		KNOWN_GUID(MF_DEVICEMFT_SENSORPROFILE_COLLECTION),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_D3D_ADAPTERLUID),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_CATEGORY),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_DEVICETYPE),
+		KNOWN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_HW_SOURCE),
+		KNOWN_GUID(MF_VIRTUALCAMERA_PROVIDE_ASSOCIATED_CAMERA_SOURCES),
+		KNOWN_GUID(MF_VIRTUALCAMERA_CONFIGURATION_APP_PACKAGE_FAMILY_NAME),
+		KNOWN_GUID(MF_VIRTUALCAMERA_ASSOCIATED_CAMERA_SOURCES),
+		KNOWN_GUID(MF_CAPTURE_ENGINE_SELECTEDCAMERAPROFILE_INDEX),
+		KNOWN_GUID(MF_CAPTURE_ENGINE_SELECTEDCAMERAPROFILE),
+		KNOWN_GUID(MF_MEDIACAPTURE_INIT_ENABLE_MULTIPLEXOR),
+		KNOWN_GUID(MF_FRAMESERVER_CLIENTCONTEXT_CLIENTPID),
+		KNOWN_GUID(MF_FRAMESERVER_VCAM_CONFIGURATION_APP),
+		KNOWN_GUID(MF_DEVICE_DSHOW_BRIDGE_FILTER),
+		KNOWN_GUID(MF_DEVPROXY_COMPRESSED_MEDIATYPE_PASSTHROUGH_MODE),
+		KNOWN_GUID(MF_DEVICESTREAM_ATTRIBUTE_PLUGIN_ENABLED),
+		KNOWN_GUID(MEDIA_TELEMETRY_SESSION_ID),
+		KNOWN_GUID(MFT_TRANSFORM_CLSID_Attribute),
+
+		KNOWN_GUID(MF_MT_FRAME_SIZE),
+		KNOWN_GUID(MF_MT_AVG_BITRATE),
+		KNOWN_GUID(MF_MT_MAJOR_TYPE),
+		KNOWN_GUID(MF_MT_FRAME_RATE),
+		KNOWN_GUID(MF_MT_PIXEL_ASPECT_RATIO),
+		KNOWN_GUID(MF_MT_ALL_SAMPLES_INDEPENDENT),
+		KNOWN_GUID(MF_MT_INTERLACE_MODE),
+		KNOWN_GUID(MF_MT_SUBTYPE),
+
+		KNOWN_GUID(MFT_SUPPORT_3DVIDEO),
+		KNOWN_GUID(MF_SA_D3D11_AWARE),
+
+		KNOWN_GUID(KSCATEGORY_VIDEO_CAMERA),
+		KNOWN_GUID(KSDATAFORMAT_TYPE_VIDEO),
+		KNOWN_GUID(CLSID_VideoInputDeviceCategory),
+		KNOWN_GUID(MFVideoFormat_RGB32),
+		KNOWN_GUID(MFVideoFormat_NV12),
+
+		KNOWN_GUID(KSPROPSETID_Pin),
+		KNOWN_GUID(KSPROPSETID_Topology),
+		KNOWN_GUID(KSPROPSETID_Connection),
+		KNOWN_GUID(PROPSETID_VIDCAP_CAMERACONTROL),
+		KNOWN_GUID(PROPSETID_VIDCAP_VIDEOPROCAMP),
+		KNOWN_GUID(PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST),
+		KNOWN_GUID(PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY),
+		KNOWN_GUID(KSPROPERTYSETID_PerFrameSettingControl),
+		KNOWN_GUID(KSPROPERTYSETID_ExtendedCameraControl),
+
+		KNOWN_IID(IUnknown),
+		KNOWN_IID(IInspectable),
+		KNOWN_IID(IClassFactory),
+		KNOWN_IID(IPersistPropertyBag),
+		KNOWN_IID(IUndocumented1),
+		KNOWN_IID(INoMarshal),
+		KNOWN_IID(IMFMediaStream2),
+		KNOWN_IID(IKsControl),
+		KNOWN_IID(IMFMediaSourceEx),
+		KNOWN_IID(IMFMediaSource),
+		KNOWN_IID(IMFMediaSource2),
+		KNOWN_IID(IMFDeviceController),
+		KNOWN_IID(IMFDeviceController2),
+		KNOWN_IID(IMFDeviceTransformManager),
+		KNOWN_IID(IMFSampleAllocatorControl),
+		KNOWN_IID(IMFDeviceSourceInternal),
+		KNOWN_IID(IMFDeviceSourceInternal2),
+		KNOWN_IID(IMFCollection),
+		KNOWN_IID(IMFRealTimeClientEx),
+		KNOWN_IID(IMFDeviceSourceStatus),
+		KNOWN_IID(IMFAttributes),
+	};
+
+#undef KNOWN_GUID
+#undef KNOWN_IID
+
+	struct GuidIndexEntry
+	{
+		GUID guid;
+		PCWSTR name;
+	};
+
+	bool GuidLess(const GUID& left, const GUID& right)
+	{
+		return memcmp(&left, &right, sizeof(GUID)) < 0;
+	}
+
+	const std::vector<GuidIndexEntry>& GuidIndex()
+	{
+		static const auto index = []
+		{
+			std::vector<GuidIndexEntry> entries;
+			entries.reserve(_countof(kKnownGuids));
+			for (const auto& known : kKnownGuids)
+			{
+				entries.push_back({ *known.guid, known.name });
+			}
+			std::stable_sort(entries.begin(), entries.end(), [](const auto& left, const auto& right) { return GuidLess(left.guid, right.guid); });
+			// The first name listed wins for aliases of the same value.
+			entries.erase(std::unique(entries.begin(), entries.end(), [](const auto& left, const auto& right) { return left.guid == right.guid; }), entries.end());
+			return entries;
+		}();
+		return index;
+	}
+}
+
+PCWSTR GUID_FindName(const GUID& guid)
 {
+	const auto& index = GuidIndex();
+	const auto it = std::lower_bound(index.begin(), index.end(), guid, [](const auto& entry, const GUID& value) { return GuidLess(entry.guid, value); });
+	return it != index.end() && it->guid == guid ? it->name : nullptr;
+}
+
+GuidName GUID_ToName(const GUID& guid, bool resolve)
+{
+	GuidName result;
 	if (resolve)
 	{
-		// list of known GUIDs we're interested in
-		IFGUID(GUID_NULL);
-		IFGUID(CLSID_VCam);
-		IFGUID(PINNAME_VIDEO_CAPTURE);
-		IFGUID(MF_DEVICESTREAM_STREAM_CATEGORY);
-		IFGUID(MF_DEVICESTREAM_STREAM_ID);
-		IFGUID(MF_DEVICESTREAM_FRAMESERVER_SHARED);
-		IFGUID(MF_DEVICESTREAM_ATTRIBUTE_FRAMESOURCE_TYPES);
-		IFGUID(MF_DEVICESTREAM_MULTIPLEXED_MANAGER);
-		IFGUID(MF_DEVICEMFT_SENSORPROFILE_COLLECTION);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_D3D_ADAPTERLUID);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_CATEGORY);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_DEVICETYPE);
-		IFGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_HW_SOURCE);
-		IFGUID(MF_VIRTUALCAMERA_PROVIDE_ASSOCIATED_CAMERA_SOURCES);
-		IFGUID(MF_VIRTUALCAMERA_CONFIGURATION_APP_PACKAGE_FAMILY_NAME);
-		IFGUID(MF_VIRTUALCAMERA_ASSOCIATED_CAMERA_SOURCES);
-		IFGUID(MF_CAPTURE_ENGINE_SELECTEDCAMERAPROFILE_INDEX);
-		IFGUID(MF_CAPTURE_ENGINE_SELECTEDCAMERAPROFILE);
-		IFGUID(MF_MEDIACAPTURE_INIT_ENABLE_MULTIPLEXOR);
-		IFGUID(MF_FRAMESERVER_CLIENTCONTEXT_CLIENTPID);
-		IFGUID(MF_FRAMESERVER_VCAM_CONFIGURATION_APP);
-		IFGUID(MF_DEVICE_DSHOW_BRIDGE_FILTER);
-		IFGUID(MF_DEVPROXY_COMPRESSED_MEDIATYPE_PASSTHROUGH_MODE);
-		IFGUID(MF_DEVICESTREAM_ATTRIBUTE_PLUGIN_ENABLED);
-		IFGUID(MEDIA_TELEMETRY_SESSION_ID);
-		IFGUID(MFT_TRANSFORM_CLSID_Attribute);
-
-		IFGUID(MF_MT_FRAME_SIZE);
-		IFGUID(MF_MT_AVG_BITRATE);
-		IFGUID(MF_MT_MAJOR_TYPE);
-		IFGUID(MF_MT_FRAME_RATE);
-		IFGUID(MF_MT_PIXEL_ASPECT_RATIO);
-		IFGUID(MF_MT_ALL_SAMPLES_INDEPENDENT);
-		IFGUID(MF_MT_INTERLACE_MODE);
-		IFGUID(MF_MT_SUBTYPE);
-		IFGUID(MF_MT_SUBTYPE);
-
-		IFGUID(MFT_SUPPORT_3DVIDEO);
-		IFGUID(MF_SA_D3D11_AWARE);
-
-		IFGUID(KSCATEGORY_VIDEO_CAMERA);
-		IFGUID(KSDATAFORMAT_TYPE_VIDEO);
-		IFGUID(CLSID_VideoInputDeviceCategory);
-		IFGUID(MFVideoFormat_RGB32);
-		IFGUID(MFVideoFormat_NV12);
-
-		IFGUID(KSPROPSETID_Pin);
-		IFGUID(KSPROPSETID_Topology);
-		IFGUID(KSPROPSETID_Connection);
-		IFGUID(PROPSETID_VIDCAP_CAMERACONTROL);
-		IFGUID(PROPSETID_VIDCAP_VIDEOPROCAMP);
-		IFGUID(PROPSETID_VIDCAP_CAMERACONTROL_REGION_OF_INTEREST);
-		IFGUID(PROPSETID_VIDCAP_CAMERACONTROL_IMAGE_PIN_CAPABILITY);
-		IFGUID(KSPROPERTYSETID_PerFrameSettingControl);
-		IFGUID(KSPROPERTYSETID_ExtendedCameraControl);
-
-		IFIID(IUnknown);
-		IFIID(IInspectable);
-		IFIID(IClassFactory);
-		IFIID(IPersistPropertyBag);
-		IFIID(IUndocumented1);
-		IFIID(INoMarshal);
-		IFIID(IMFMediaStream2);
-		IFIID(IKsControl);
-		IFIID(IMFMediaSourceEx);
-		IFIID(IMFMediaSource);
-		IFIID(IMFMediaSource2);
-		IFIID(IMFDeviceController);
-		IFIID(IMFDeviceController2);
-		IFIID(IMFDeviceTransformManager);
-		IFIID(IMFSampleAllocatorControl);
-		IFIID(IMFDeviceSourceInternal);
-		IFIID(IMFDeviceSourceInternal2);
-		IFIID(IMFCollection);
-		IFIID(IMFRealTimeClientEx);
-		IFIID(IMFDeviceSourceStatus);
-		IFIID(IMFAttributes);
+		result.name = GUID_FindName(guid);
 	}
+	if (!result.name)
+	{
+		std::ignore = StringFromGUID2(guid, result.text, _countof(result.text));
+	}
+	return result;
+}
 
-	wchar_t name[64];
-	std::ignore = StringFromGUID2(guid, name, _countof(name));
-	return name;
+const std::wstring GUID_ToStringW(const GUID& guid, bool resolve)
+{
+	return GUID_ToName(guid, resolve).c_str();
 }
 
+const std::string GUID_ToStringA(const GUID& guid, bool resolve) { return to_string(GUID_ToStringW(guid, resolve)); }
+
 const std::wstring PROPVARIANT_ToString(const PROPVARIANT& pv)
 {
 	std::wstring type = std::format(L"{}(0x{:08X})", VARTYPE_ToString(pv.vt), pv.vt);
@@ -2,6 +2,18 @@
 
 std::string to_string(const std::wstring& ws);
 std::wstring to_wstring(const std::string& s);
+// Name of a known GUID (a string literal) or its registry form, without heap allocation, for
+// trace arguments: GUID_ToName(guid).c_str() is valid until the end of the full expression.
+struct GuidName
+{
+	PCWSTR name = nullptr;
+	wchar_t text[39]{};
+
+	PCWSTR c_str() const { return name ? name : text; }
+};
+
+PCWSTR GUID_FindName(const GUID& guid); // nullptr when not known
+GuidName GUID_ToName(const GUID& guid, bool resolve = true);
 const std::wstring GUID_ToStringW(const GUID& guid, bool resolve = true);
 const std::string GUID_ToStringA(const GUID& guid, bool resolve = true);
 const std::wstring PROPVARIANT_ToString(const PROPVARIANT& pv);
@@ -55,6 +67,11 @@ namespace winrt
 	{
 		return is_guid_of<IMFActivate, IMFAttributes>(id);
 	}
+
+	template<> inline bool is_guid_of<IMF2DBuffer2>(guid const& id) noexcept
+	{
+		return is_guid_of<IMF2DBuffer2, IMF2DBuffer>(id);
+	}
 }
 
 struct registry_traits
@@ -1,23 +1,88 @@
 #include "pch.h"
 #include "Tools.h"
 #include "TcpKick.h"
+#include "Cameras.h"
+#include "MpscRing.h"
 
+#include <atomic>
 #include <mutex>
 #include <string>
+#include <vector>
+
+#if defined(_DEBUG)
+#define WINTRACE_DEFAULT_LEVEL WINTRACE_LEVEL_VERBOSE
+#define WINTRACE_DEFAULT_KEYWORDS (~WINTRACE_KEYWORD_ATTRIBUTES)
+#else
+#define WINTRACE_DEFAULT_LEVEL WINTRACE_LEVEL_ERROR
+#define WINTRACE_DEFAULT_KEYWORDS (~0ull)
+#endif
+
+#define WINTRACE_DEFAULT_MASK(level) ((level) <= WINTRACE_DEFAULT_LEVEL ? WINTRACE_DEFAULT_KEYWORDS : 0ull)
+
+std::atomic<ULONGLONG> g_winTraceKeywordsByLevel[8] =
+{
+	0ull,
+	WINTRACE_DEFAULT_MASK(1),
+	WINTRACE_DEFAULT_MASK(2),
+	WINTRACE_DEFAULT_MASK(3),
+	WINTRACE_DEFAULT_MASK(4),
+	WINTRACE_DEFAULT_MASK(5),
+	0ull,
+	0ull,
+};
 
 namespace
 {
+	static constexpr PCWSTR kTraceLevelValueName = L"TraceLevel";
+	static constexpr PCWSTR kTraceKeywordsValueName = L"TraceKeywords";
 	static constexpr PCWSTR kTraceFilePath = L"C:\\gstvcam_trace.txt";
-	static std::mutex g_traceLock;
-	static bool g_traceEnabled = false;
+	static constexpr PCWSTR kBinaryTraceFilePath = L"C:\\gstvcam_trace.bin";
+	static std::atomic<bool> g_traceEnabled = false;
+
+	// Lines are handed to a background writer through a bounded multi-producer ring (MpscRing),
+	// so callers never touch the file or the kick socket. When the ring is full the line is
+	// dropped and counted; the writer reports the count in the next batch.
+	constexpr UINT kSlotCount = 512;
+	constexpr UINT kSlotBytes = 2048;
+	constexpr DWORD kWriterIntervalMs = 50;
+	constexpr ULONGLONG kFlushIntervalMs = 1000;
+	// The writer thread exits after this long without lines and is restarted on demand.
+	constexpr ULONGLONG kWriterIdleExitMs = 10000;
+
+	enum class TraceSlotKind : uint8_t
+	{
+		Text,
+		Binary,
+	};
+
+	struct TraceSlot
+	{
+		uint32_t length;
+		TraceSlotKind kind;
+		// A UTF-8 line with CRLF, or one complete binary EVENT record.
+		char text[kSlotBytes];
+	};
 
-	std::wstring TrimLineEnding(std::wstring text)
+	MpscRing<TraceSlot, kSlotCount> g_ring;
+	// 0 when no writer thread owns the ring, 1 while one does.
+	std::atomic<LONG> g_writerState = 0;
+	// Set at process detach: no new writer may start, callers write their own lines.
+	std::atomic<bool> g_detaching = false;
+	wil::unique_event_nothrow g_writerWake;
+	HANDLE g_file = INVALID_HANDLE_VALUE; // writer only
+	HANDLE g_binaryFile = INVALID_HANDLE_VALUE; // writer only
+	size_t g_sitesWritten = 0; // writer only, sites already in g_binaryFile
+
+	// Binary trace format strings in UTF-8; site id N is g_sites[N - 1].
+	std::mutex g_siteLock;
+	std::vector<std::string> g_sites;
+
+	void TrimLineEnding(std::wstring& text)
 	{
 		while (!text.empty() && (text.back() == L'\r' || text.back() == L'\n'))
 		{
 			text.pop_back();
 		}
-		return text;
 	}
 
 	std::wstring BuildTimestamp()
@@ -35,48 +100,439 @@ namespace
 			st.wMilliseconds);
 	}
 
-	void WriteUtf8LineToFileAndFlush(const std::string& utf8Line)
+	// Converts to UTF-8 and appends CRLF, truncating on a character boundary to fit capacity.
+	uint32_t EncodeLine(const std::wstring& line, char* output, uint32_t capacity)
+	{
+		auto length = WideCharToMultiByte(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), output, static_cast<int>(capacity - 2), nullptr, nullptr);
+		if (length <= 0)
+		{
+			if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+			{
+				return 0;
+			}
+
+			// Too long for one slot: convert a prefix that is guaranteed to fit (3 bytes per UTF-16 unit).
+			const auto prefix = static_cast<int>((capacity - 2) / 3);
+			length = WideCharToMultiByte(CP_UTF8, 0, line.c_str(), (std::min)(prefix, static_cast<int>(line.size())), output, static_cast<int>(capacity - 2), nullptr, nullptr);
+			if (length <= 0)
+			{
+				return 0;
+			}
+		}
+		output[length++] = '\r';
+		output[length++] = '\n';
+		return static_cast<uint32_t>(length);
+	}
+
+	DWORD WINAPI WriterThread(LPVOID);
+	void WriteSynchronously();
+
+	void EnsureWriter()
 	{
-		HANDLE file = CreateFileW(
-			kTraceFilePath,
-			FILE_APPEND_DATA,
-			FILE_SHARE_READ | FILE_SHARE_WRITE,
-			nullptr,
-			OPEN_ALWAYS,
-			FILE_ATTRIBUTE_NORMAL,
-			nullptr);
-		if (file == INVALID_HANDLE_VALUE)
+		LONG expected = 0;
+		if (g_writerState.load(std::memory_order_acquire) != 0 || !g_writerState.compare_exchange_strong(expected, 1))
 		{
 			return;
 		}
 
-		DWORD written = 0;
-		WriteFile(file, utf8Line.data(), static_cast<DWORD>(utf8Line.size()), &written, nullptr);
-		FlushFileBuffers(file);
-		CloseHandle(file);
+		// The thread pins the DLL until it exits, so an unload can never pull code from under it.
+		HMODULE module = nullptr;
+		if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&WriterThread), &module))
+		{
+			g_writerState.store(0);
+			return;
+		}
+
+		auto thread = CreateThread(nullptr, 0, WriterThread, module, 0, nullptr);
+		if (!thread)
+		{
+			FreeLibrary(module);
+			g_writerState.store(0);
+			return;
+		}
+		CloseHandle(thread);
+	}
+
+	void PublishSlot(uint64_t position)
+	{
+		const auto backlog = g_ring.Publish(position);
+		if (g_detaching.load())
+		{
+			WriteSynchronously();
+			return;
+		}
+
+		// The writer polls on an interval; only wake it early when the ring is filling up.
+		if (backlog > kSlotCount / 2 && g_writerWake)
+		{
+			g_writerWake.SetEvent();
+		}
+		EnsureWriter();
+	}
+
+	void EmitLine(std::wstring msg)
+	{
+		TrimLineEnding(msg);
+		const auto line = std::format(L"[{}]{}", BuildTimestamp(), msg);
+
+		uint64_t position = 0;
+		auto slot = g_ring.Reserve(&position);
+		if (!slot)
+		{
+			return;
+		}
+
+		slot->kind = TraceSlotKind::Text;
+		slot->length = EncodeLine(line, slot->text, kSlotBytes);
+		PublishSlot(position);
+	}
+
+	template<typename Record>
+	void AppendRecord(std::string& batch, Record record, UINT type, const void* tail = nullptr, size_t tailSize = 0)
+	{
+		record.header.type = static_cast<uint16_t>(type);
+		record.header.size = static_cast<uint16_t>(sizeof(record) + tailSize);
+		batch.append(reinterpret_cast<const char*>(&record), sizeof(record));
+		if (tailSize)
+		{
+			batch.append(static_cast<const char*>(tail), tailSize);
+		}
 	}
 
-	void EmitLine(const std::wstring& rawMessage)
+	void AppendDroppedNotice(std::string& textBatch, std::string& binaryBatch)
 	{
-		auto msg = TrimLineEnding(rawMessage);
-		auto line = std::format(L"[{}]{}", BuildTimestamp(), msg);
-		const auto utf8Bytes = WideCharToMultiByte(CP_UTF8, 0, line.c_str(), -1, nullptr, 0, nullptr, nullptr);
-		if (utf8Bytes <= 1)
+		const auto dropped = g_ring.TakeDropped();
+		if (!dropped)
 		{
 			return;
 		}
 
-		std::string utf8(static_cast<size_t>(utf8Bytes), '\0');
-		if (WideCharToMultiByte(CP_UTF8, 0, line.c_str(), -1, utf8.data(), utf8Bytes, nullptr, nullptr) <= 0)
+#if defined(VCAM_BINARY_TRACE)
+		UNREFERENCED_PARAMETER(textBatch);
+		VCamTraceDroppedRecord record{};
+		record.count = dropped;
+		AppendRecord(binaryBatch, record, VCAM_TRACE_RECORD_DROPPED);
+#else
+		UNREFERENCED_PARAMETER(binaryBatch);
+		textBatch += std::format("[trace] ring full, dropped {} lines\r\n", dropped);
+#endif
+	}
+
+	// Single consumer: the writer thread, or the detaching thread once no writer can run.
+	void DrainRing(std::string& textBatch, std::string& binaryBatch)
+	{
+		g_ring.Drain([&](const TraceSlot& slot)
+		{
+			(slot.kind == TraceSlotKind::Binary ? binaryBatch : textBatch).append(slot.text, slot.length);
+		});
+		AppendDroppedNotice(textBatch, binaryBatch);
+	}
+
+	void WriteBatch(const std::string& batch)
+	{
+		if (g_file == INVALID_HANDLE_VALUE)
+		{
+			g_file = CreateFileW(
+				kTraceFilePath,
+				FILE_APPEND_DATA,
+				FILE_SHARE_READ | FILE_SHARE_WRITE,
+				nullptr,
+				OPEN_ALWAYS,
+				FILE_ATTRIBUTE_NORMAL,
+				nullptr);
+		}
+
+		DWORD written = 0;
+		if (g_file != INVALID_HANDLE_VALUE &&
+			(!WriteFile(g_file, batch.data(), static_cast<DWORD>(batch.size()), &written, nullptr) || written != batch.size()))
+		{
+			// Reopen on the next batch (file deleted, volume hiccup, ...).
+			CloseHandle(g_file);
+			g_file = INVALID_HANDLE_VALUE;
+		}
+		(void)TcpKickForwardLogUtf8(batch.data(), batch.size());
+	}
+
+	// Events are written after the records that give them meaning: the process, its clock (once
+	// per opened file) and any format strings registered since the last batch.
+	void WriteBinaryBatch(const std::string& events)
+	{
+		std::string batch;
+		if (g_binaryFile == INVALID_HANDLE_VALUE)
+		{
+			g_binaryFile = CreateFileW(
+				kBinaryTraceFilePath,
+				FILE_APPEND_DATA,
+				FILE_SHARE_READ | FILE_SHARE_WRITE,
+				nullptr,
+				OPEN_ALWAYS,
+				FILE_ATTRIBUTE_NORMAL,
+				nullptr);
+			if (g_binaryFile == INVALID_HANDLE_VALUE)
+			{
+				return;
+			}
+
+			VCamTraceSessionRecord session{};
+			LARGE_INTEGER frequency{};
+			LARGE_INTEGER counter{};
+			FILETIME now{};
+			QueryPerformanceFrequency(&frequency);
+			QueryPerformanceCounter(&counter);
+			GetSystemTimePreciseAsFileTime(&now);
+			session.processId = GetCurrentProcessId();
+			session.qpcFrequency = static_cast<uint64_t>(frequency.QuadPart);
+			session.qpcBase = static_cast<uint64_t>(counter.QuadPart);
+			session.fileTimeBase = (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+			AppendRecord(batch, session, VCAM_TRACE_RECORD_SESSION);
+			g_sitesWritten = 0;
+		}
+
+		VCamTraceBatchRecord header{};
+		header.processId = GetCurrentProcessId();
+		AppendRecord(batch, header, VCAM_TRACE_RECORD_BATCH);
+		{
+			std::lock_guard<std::mutex> lock(g_siteLock);
+			for (; g_sitesWritten < g_sites.size(); g_sitesWritten++)
+			{
+				const auto& format = g_sites[g_sitesWritten];
+				VCamTraceSiteRecord site{};
+				site.siteId = static_cast<uint32_t>(g_sitesWritten + 1);
+				AppendRecord(batch, site, VCAM_TRACE_RECORD_SITE, format.data(), format.size());
+			}
+		}
+		batch += events;
+
+		DWORD written = 0;
+		if (!WriteFile(g_binaryFile, batch.data(), static_cast<DWORD>(batch.size()), &written, nullptr) || written != batch.size())
+		{
+			CloseHandle(g_binaryFile);
+			g_binaryFile = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	void CloseFile()
+	{
+		if (g_file != INVALID_HANDLE_VALUE)
+		{
+			FlushFileBuffers(g_file);
+			CloseHandle(g_file);
+			g_file = INVALID_HANDLE_VALUE;
+		}
+		if (g_binaryFile != INVALID_HANDLE_VALUE)
+		{
+			FlushFileBuffers(g_binaryFile);
+			CloseHandle(g_binaryFile);
+			g_binaryFile = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	void FlushFiles()
+	{
+		if (g_file != INVALID_HANDLE_VALUE)
+		{
+			FlushFileBuffers(g_file);
+		}
+		if (g_binaryFile != INVALID_HANDLE_VALUE)
+		{
+			FlushFileBuffers(g_binaryFile);
+		}
+	}
+
+	// Returns false when there was nothing to write.
+	bool WriteBatches(std::string& textBatch, std::string& binaryBatch)
+	{
+		textBatch.clear();
+		binaryBatch.clear();
+		DrainRing(textBatch, binaryBatch);
+		if (!textBatch.empty())
+		{
+			WriteBatch(textBatch);
+		}
+		if (!binaryBatch.empty())
+		{
+			WriteBinaryBatch(binaryBatch);
+		}
+		return !textBatch.empty() || !binaryBatch.empty();
+	}
+
+	void WriteSynchronously()
+	{
+		std::string textBatch;
+		std::string binaryBatch;
+		WriteBatches(textBatch, binaryBatch);
+	}
+
+	DWORD WINAPI WriterThread(LPVOID parameter)
+	{
+		std::string textBatch;
+		std::string binaryBatch;
+		textBatch.reserve(64 * 1024);
+		binaryBatch.reserve(64 * 1024);
+		auto lastFlush = GetTickCount64();
+		auto lastLine = lastFlush;
+		bool dirty = false;
+		for (;;)
+		{
+			if (g_writerWake)
+			{
+				WaitForSingleObject(g_writerWake.get(), kWriterIntervalMs);
+			}
+			else
+			{
+				Sleep(kWriterIntervalMs);
+			}
+
+			const auto now = GetTickCount64();
+			if (WriteBatches(textBatch, binaryBatch))
+			{
+				dirty = true;
+				lastLine = now;
+			}
+
+			if (dirty && now - lastFlush >= kFlushIntervalMs)
+			{
+				FlushFiles();
+				dirty = false;
+				lastFlush = now;
+			}
+
+			if (now - lastLine < kWriterIdleExitMs)
+			{
+				continue;
+			}
+
+			// Hand the ring back, then take it again if a line slipped in meanwhile and no new
+			// writer was started for it.
+			CloseFile();
+			g_writerState.store(0, std::memory_order_release);
+			LONG expected = 0;
+			if (g_ring.IsEmpty() || !g_writerState.compare_exchange_strong(expected, 1))
+			{
+				break;
+			}
+			lastLine = now;
+		}
+
+		FreeLibraryAndExitThread(static_cast<HMODULE>(parameter), 0);
+	}
+
+	bool IsTraceEnabled()
+	{
+		return g_traceEnabled.load(std::memory_order_relaxed);
+	}
+
+	// WIL reports every failed RETURN_IF_*/LOG_* through here, in all builds.
+	void __stdcall LogWilFailure(wil::FailureInfo const& failure) noexcept
+	{
+		if (!WinTraceIsOn(WINTRACE_LEVEL_ERROR, WINTRACE_KEYWORD_FAILURES) || !IsTraceEnabled())
 		{
 			return;
 		}
+
+		WCHAR buffer[2048]{};
+		wil::GetFailureLogString(buffer, _countof(buffer), failure);
+		EmitLine(buffer);
+	}
+
+	uint32_t RegisterSite(std::atomic<uint32_t>& site, std::string format)
+	{
+		std::lock_guard<std::mutex> lock(g_siteLock);
+		auto siteId = site.load(std::memory_order_relaxed);
+		if (!siteId)
+		{
+			g_sites.push_back(std::move(format));
+			siteId = static_cast<uint32_t>(g_sites.size());
+			site.store(siteId, std::memory_order_release);
+		}
+		return siteId;
+	}
+}
+
+bool WinTraceIsEnabled()
+{
+	return IsTraceEnabled();
+}
+
+uint32_t WinTraceRegisterSite(std::atomic<uint32_t>& site, PCWSTR format)
+{
+	std::string utf8;
+	const auto bytes = WideCharToMultiByte(CP_UTF8, 0, format, -1, nullptr, 0, nullptr, nullptr);
+	if (bytes > 1)
+	{
+		utf8.resize(static_cast<size_t>(bytes));
+		WideCharToMultiByte(CP_UTF8, 0, format, -1, utf8.data(), bytes, nullptr, nullptr);
 		utf8.pop_back(); // drop terminal null
-		utf8 += "\r\n";
+	}
+	return RegisterSite(site, std::move(utf8));
+}
+
+uint32_t WinTraceRegisterSite(std::atomic<uint32_t>& site, PCSTR format)
+{
+	return RegisterSite(site, format);
+}
+
+void WinTraceWriteEvent(uint32_t siteId, const BYTE* arguments, size_t size)
+{
+	if (sizeof(VCamTraceEventRecord) + size > kSlotBytes)
+	{
+		return;
+	}
+
+	LARGE_INTEGER counter{};
+	QueryPerformanceCounter(&counter);
+	uint64_t position = 0;
+	auto slot = g_ring.Reserve(&position);
+	if (!slot)
+	{
+		return;
+	}
+
+	VCamTraceEventRecord record{};
+	record.header.type = VCAM_TRACE_RECORD_EVENT;
+	record.header.size = static_cast<uint16_t>(sizeof(record) + size);
+	record.siteId = siteId;
+	record.threadId = GetCurrentThreadId();
+	record.qpc = static_cast<uint64_t>(counter.QuadPart);
+	memcpy(slot->text, &record, sizeof(record));
+	if (size)
+	{
+		memcpy(slot->text + sizeof(record), arguments, size);
+	}
+	slot->kind = TraceSlotKind::Binary;
+	slot->length = static_cast<uint32_t>(sizeof(record) + size);
+	PublishSlot(position);
+}
+
+void WinTraceLoadSettings()
+{
+	DWORD level = WINTRACE_DEFAULT_LEVEL;
+	ULONGLONG keywords = WINTRACE_DEFAULT_KEYWORDS;
+
+	const auto path = VCamCameraConfigPath(0);
+	DWORD value = 0;
+	DWORD size = sizeof(value);
+	if (RegGetValueW(HKEY_LOCAL_MACHINE, path.c_str(), kTraceLevelValueName, RRF_RT_REG_DWORD, nullptr, &value, &size) == ERROR_SUCCESS)
+	{
+		level = (std::min)(value, static_cast<DWORD>(WINTRACE_LEVEL_VERBOSE));
+	}
+
+	// A DWORD fills the low half of the zeroed mask.
+	ULONGLONG mask = 0;
+	size = sizeof(mask);
+	if (RegGetValueW(HKEY_LOCAL_MACHINE, path.c_str(), kTraceKeywordsValueName, RRF_RT_REG_DWORD | RRF_RT_REG_QWORD, nullptr, &mask, &size) == ERROR_SUCCESS)
+	{
+		keywords = mask;
+	}
 
-		std::lock_guard<std::mutex> lock(g_traceLock);
-		WriteUtf8LineToFileAndFlush(utf8);
-		(void)TcpKickSendLogUtf8(utf8.data(), utf8.size());
+	for (UINT i = 1; i < _countof(g_winTraceKeywordsByLevel); i++)
+	{
+		g_winTraceKeywordsByLevel[i].store(i <= level ? keywords : 0, std::memory_order_relaxed);
+	}
+	// Written whatever the new level is, so a change always leaves a mark in the log.
+	if (IsTraceEnabled())
+	{
+		EmitLine(std::format(L"Trace level:{} keywords:0x{:X}", level, keywords));
 	}
 }
 
@@ -93,33 +549,38 @@ HRESULT GetTraceId(GUID* pGuid)
 
 ULONG WinTraceRegister()
 {
-	std::lock_guard<std::mutex> lock(g_traceLock);
-	g_traceEnabled = true;
+	if (!g_writerWake)
+	{
+		(void)g_writerWake.create(wil::EventOptions::None);
+	}
+	g_traceEnabled.store(true);
+	wil::SetResultLoggingCallback(LogWilFailure);
 	return ERROR_SUCCESS;
 }
 
-void WinTraceUnregister()
+void WinTraceDetach()
 {
-	std::lock_guard<std::mutex> lock(g_traceLock);
-	g_traceEnabled = false;
+	// A writer thread pins the DLL, so at detach either none exists or the process is exiting
+	// and it is gone; from here on the calling thread is the only consumer.
+	g_detaching.store(true);
+	WriteSynchronously();
 }
 
-void WinTraceFormat(UCHAR level, ULONGLONG keyword, PCWSTR format, ...)
+void WinTraceUnregister()
 {
-	UNREFERENCED_PARAMETER(level);
-	UNREFERENCED_PARAMETER(keyword);
-
-	if (!format)
+	g_traceEnabled.store(false);
+	if (g_detaching.load())
 	{
-		return;
+		WriteSynchronously();
+		CloseFile();
 	}
+}
 
+void WinTraceFormat(UCHAR level, ULONGLONG keyword, PCWSTR format, ...)
+{
+	if (!format || !WinTraceIsOn(level, keyword) || !IsTraceEnabled())
 	{
-		std::lock_guard<std::mutex> lock(g_traceLock);
-		if (!g_traceEnabled)
-		{
-			return;
-		}
+		return;
 	}
 
 	WCHAR buffer[2048]{};
@@ -133,22 +594,11 @@ void WinTraceFormat(UCHAR level, ULONGLONG keyword, PCWSTR format, ...)
 
 void WinTraceFormat(UCHAR level, ULONGLONG keyword, PCSTR format, ...)
 {
-	UNREFERENCED_PARAMETER(level);
-	UNREFERENCED_PARAMETER(keyword);
-
-	if (!format)
+	if (!format || !WinTraceIsOn(level, keyword) || !IsTraceEnabled())
 	{
 		return;
 	}
 
-	{
-		std::lock_guard<std::mutex> lock(g_traceLock);
-		if (!g_traceEnabled)
-		{
-			return;
-		}
-	}
-
 	CHAR buffer[2048]{};
 	va_list args;
 	va_start(args, format);
@@ -160,42 +610,20 @@ void WinTraceFormat(UCHAR level, ULONGLONG keyword, PCSTR format, ...)
 
 void WinTrace(UCHAR level, ULONGLONG keyword, PCWSTR string)
 {
-	UNREFERENCED_PARAMETER(level);
-	UNREFERENCED_PARAMETER(keyword);
-
-	if (!string)
+	if (!string || !WinTraceIsOn(level, keyword) || !IsTraceEnabled())
 	{
 		return;
 	}
 
-	{
-		std::lock_guard<std::mutex> lock(g_traceLock);
-		if (!g_traceEnabled)
-		{
-			return;
-		}
-	}
-
 	EmitLine(string);
 }
 
 void WinTrace(UCHAR level, ULONGLONG keyword, PCSTR string)
 {
-	UNREFERENCED_PARAMETER(level);
-	UNREFERENCED_PARAMETER(keyword);
-
-	if (!string)
+	if (!string || !WinTraceIsOn(level, keyword) || !IsTraceEnabled())
 	{
 		return;
 	}
 
-	{
-		std::lock_guard<std::mutex> lock(g_traceLock);
-		if (!g_traceEnabled)
-		{
-			return;
-		}
-	}
-
 	EmitLine(to_wstring(string));
 }
@@ -1,18 +1,249 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "BinaryTrace.h"
+
+// Levels have the TRACE_LEVEL_* values of evntrace.h; a line is written when its level is at or
+// below the configured level and its keyword is in the configured mask. Both come from
+// TraceLevel/TraceKeywords under the main config key and can be changed at runtime.
+#define WINTRACE_LEVEL_ERROR 2
+#define WINTRACE_LEVEL_WARNING 3
+#define WINTRACE_LEVEL_INFORMATION 4
+#define WINTRACE_LEVEL_VERBOSE 5
+
+#define WINTRACE_KEYWORD_LIFECYCLE 0x1ull  // activation, start/stop, configuration
+#define WINTRACE_KEYWORD_FAILURES 0x2ull   // WIL failures and pipeline errors
+#define WINTRACE_KEYWORD_FRAMES 0x4ull     // per-frame and periodic hot-path lines
+#define WINTRACE_KEYWORD_ATTRIBUTES 0x8ull // CBaseAttributes getters
+
+// Per level, the keywords enabled at that level; index 0 and unused levels stay zero.
+extern std::atomic<ULONGLONG> g_winTraceKeywordsByLevel[8];
+
+inline bool WinTraceIsOn(UCHAR level, ULONGLONG keyword)
+{
+	return (g_winTraceKeywordsByLevel[level & 7].load(std::memory_order_relaxed) & keyword) != 0;
+}
+
+// Re-reads TraceLevel/TraceKeywords; unset values fall back to the build defaults.
+void WinTraceLoadSettings();
+
 HRESULT GetTraceId(GUID* pGuid);
 
 ULONG WinTraceRegister();
-void WinTraceUnregister();
-
-void WinTrace(UCHAR Level, ULONGLONG Keyword, PCWSTR String);
-void WinTraceFormat(UCHAR Level, ULONGLONG Keyword, PCWSTR pszFormat, ...);
-
+void WinTraceUnregister();
+// Process detach: stops handing lines to the background writer; later lines are written by the caller.
+void WinTraceDetach();
+
+void WinTrace(UCHAR Level, ULONGLONG Keyword, PCWSTR String);
+void WinTraceFormat(UCHAR Level, ULONGLONG Keyword, PCWSTR pszFormat, ...);
+
 void WinTrace(UCHAR Level, ULONGLONG Keyword, PCSTR String);
 void WinTraceFormat(UCHAR Level, ULONGLONG Keyword, PCSTR pszFormat, ...);
 
-#ifdef _DEBUG
-#define WINTRACE(...) WinTraceFormat(0, 0, __VA_ARGS__)
+// Binary tracing (see BinaryTrace.h): formatting is deferred to the offline decoder.
+bool WinTraceIsEnabled();
+uint32_t WinTraceRegisterSite(std::atomic<uint32_t>& site, PCWSTR format);
+uint32_t WinTraceRegisterSite(std::atomic<uint32_t>& site, PCSTR format);
+void WinTraceWriteEvent(uint32_t siteId, const BYTE* arguments, size_t size);
+
+class WinTraceArgumentWriter
+{
+public:
+	static constexpr size_t Capacity = 1024;
+
+	const BYTE* Data() const { return _buffer; }
+	size_t Size() const { return _size; }
+
+	template<typename T>
+	void Add(const T& value)
+	{
+		using Type = std::decay_t<T>;
+		if constexpr (std::is_same_v<Type, const wchar_t*> || std::is_same_v<Type, wchar_t*>)
+		{
+			AddString(VCAM_TRACE_ARG_WSTRING, value, value ? wcslen(value) * sizeof(wchar_t) : 0);
+		}
+		else if constexpr (std::is_same_v<Type, const char*> || std::is_same_v<Type, char*>)
+		{
+			AddString(VCAM_TRACE_ARG_STRING, value, value ? strlen(value) : 0);
+		}
+		else if constexpr (std::is_floating_point_v<Type>)
+		{
+			AddValue(VCAM_TRACE_ARG_DOUBLE, static_cast<double>(value));
+		}
+		else if constexpr (std::is_enum_v<Type>)
+		{
+			Add(static_cast<std::underlying_type_t<Type>>(value));
+		}
+		else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>)
+		{
+			AddValue(VCAM_TRACE_ARG_INT64, static_cast<int64_t>(value));
+		}
+		else if constexpr (std::is_integral_v<Type>)
+		{
+			AddValue(VCAM_TRACE_ARG_UINT64, static_cast<uint64_t>(value));
+		}
+		else if constexpr (std::is_null_pointer_v<Type>)
+		{
+			AddValue(VCAM_TRACE_ARG_POINTER, uint64_t{ 0 });
+		}
+		else if constexpr (std::is_pointer_v<Type>)
+		{
+			AddValue(VCAM_TRACE_ARG_POINTER, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+		}
+		else
+		{
+			static_assert(std::is_pointer_v<Type>, "Unsupported WINTRACE argument type");
+		}
+	}
+
+private:
+	template<typename V>
+	void AddValue(BYTE tag, V value)
+	{
+		if (_size + 1 + sizeof(value) > Capacity)
+		{
+			return;
+		}
+		_buffer[_size++] = tag;
+		memcpy(_buffer + _size, &value, sizeof(value));
+		_size += sizeof(value);
+	}
+
+	void AddString(BYTE tag, const void* text, size_t bytes)
+	{
+		if (_size + 3 > Capacity)
+		{
+			return;
+		}
+		// Truncated to what fits; UTF-16 keeps whole code units.
+		bytes = (std::min)(bytes, Capacity - _size - 3);
+		if (tag == VCAM_TRACE_ARG_WSTRING)
+		{
+			bytes &= ~static_cast<size_t>(1);
+		}
+		const auto length = static_cast<uint16_t>(bytes);
+		_buffer[_size++] = tag;
+		memcpy(_buffer + _size, &length, sizeof(length));
+		_size += sizeof(length);
+		if (bytes)
+		{
+			memcpy(_buffer + _size, text, bytes);
+		}
+		_size += bytes;
+	}
+
+	BYTE _buffer[Capacity];
+	size_t _size = 0;
+};
+
+template<typename Char, typename... Args>
+void WinTraceBinary(std::atomic<uint32_t>& site, const Char* format, const Args&... args)
+{
+	if (!format || !WinTraceIsEnabled())
+	{
+		return;
+	}
+
+	auto siteId = site.load(std::memory_order_acquire);
+	if (!siteId)
+	{
+		siteId = WinTraceRegisterSite(site, format);
+	}
+
+	WinTraceArgumentWriter writer;
+	(writer.Add(args), ...);
+	WinTraceWriteEvent(siteId, writer.Data(), writer.Size());
+}
+
+// Per call site limit for repeating lines, kept in a function-local static: a GCRA token bucket
+// allowing bursts of `burst` lines and then one line per `intervalMs`, in one atomic word.
+// Lines refused are counted and handed to the next line allowed through.
+class WinTraceRateLimit
+{
+public:
+	bool TryAcquire(ULONGLONG intervalMs, UINT burst, ULONGLONG* suppressed = nullptr)
+	{
+		// GetTickCount64 reads the shared user data page: no syscall, monotonic, 10-16 ms steps.
+		const auto now = GetTickCount64();
+		const auto tolerance = intervalMs * ((std::max)(burst, 1u) - 1);
+		auto expected = _theoreticalArrival.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if (expected > now + tolerance)
+			{
+				_suppressed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			if (_theoreticalArrival.compare_exchange_weak(expected, (std::max)(expected, now) + intervalMs, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+
+		const auto count = _suppressed.exchange(0, std::memory_order_relaxed);
+		if (suppressed)
+		{
+			*suppressed = count;
+		}
+		return true;
+	}
+
+private:
+	std::atomic<ULONGLONG> _theoreticalArrival = 0;
+	std::atomic<ULONGLONG> _suppressed = 0;
+};
+
+// One line through the text or binary writer; callers have already checked the level.
+#if defined(VCAM_BINARY_TRACE)
+#define WINTRACE_EMIT(level, keyword, ...) do { static std::atomic<uint32_t> _winTraceSite; WinTraceBinary(_winTraceSite, __VA_ARGS__); } while (0)
 #else
-#define WINTRACE __noop
+#define WINTRACE_EMIT(level, keyword, ...) WinTraceFormat(level, keyword, __VA_ARGS__)
 #endif
+
+// Arguments are only evaluated when the level and keyword are enabled.
+#define WINTRACE_EX(level, keyword, ...) do { if (WinTraceIsOn(level, keyword)) { WINTRACE_EMIT(level, keyword, __VA_ARGS__); } } while (0)
+
+// At most `burst` lines at once, then one per `intervalMs`; the following line reports how
+// many were suppressed in between.
+#define WINTRACE_EX_LIMITED(level, keyword, intervalMs, burst, ...) \
+	do \
+	{ \
+		if (WinTraceIsOn(level, keyword)) \
+		{ \
+			static WinTraceRateLimit _winTraceLimit; \
+			ULONGLONG _winTraceSuppressed = 0; \
+			if (_winTraceLimit.TryAcquire(intervalMs, burst, &_winTraceSuppressed)) \
+			{ \
+				WINTRACE_EMIT(level, keyword, __VA_ARGS__); \
+				if (_winTraceSuppressed) \
+				{ \
+					WINTRACE_EMIT(level, keyword, L"  (%llu similar lines suppressed before this one)", _winTraceSuppressed); \
+				} \
+			} \
+		} \
+	} while (0)
+
+// Every `everyN`th call, starting with the first.
+#define WINTRACE_EX_SAMPLED(level, keyword, everyN, ...) \
+	do \
+	{ \
+		if (WinTraceIsOn(level, keyword)) \
+		{ \
+			static std::atomic<ULONGLONG> _winTraceCalls; \
+			if (_winTraceCalls.fetch_add(1, std::memory_order_relaxed) % (everyN) == 0) \
+			{ \
+				WINTRACE_EMIT(level, keyword, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+#define WINTRACE(...) WINTRACE_EX(WINTRACE_LEVEL_INFORMATION, WINTRACE_KEYWORD_LIFECYCLE, __VA_ARGS__)
+#define WINTRACE_ERROR(...) WINTRACE_EX(WINTRACE_LEVEL_ERROR, WINTRACE_KEYWORD_FAILURES, __VA_ARGS__)
+#define WINTRACE_WARNING(...) WINTRACE_EX(WINTRACE_LEVEL_WARNING, WINTRACE_KEYWORD_FAILURES, __VA_ARGS__)
+#define WINTRACE_FRAMES(...) WINTRACE_EX(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_FRAMES, __VA_ARGS__)
+#define WINTRACE_ATTRIBUTES(...) WINTRACE_EX(WINTRACE_LEVEL_VERBOSE, WINTRACE_KEYWORD_ATTRIBUTES, __VA_ARGS__)
@@ -2,14 +2,18 @@
 #include "Undocumented.h"
 #include "Tools.h"
 #include "EnumNames.h"
+#include "Cameras.h"
 #include "Activator.h"
+#include "ConfigWatcher.h"
+#include "ActivationCache.h"
+#include "TcpKick.h"
 #include <cwctype>
+#include <mutex>
 
 // 3cad447d-f283-4af4-a3b2-6f5363309f52
 GUID CLSID_VCam = { 0x3cad447d,0xf283,0x4af4,{0xa3,0xb2,0x6f,0x53,0x63,0x30,0x9f,0x52} };
 HMODULE _hModule;
 using registry_key = winrt::handle_type<registry_traits>;
-constexpr PCWSTR kVirtualCameraName = L"VCamSample";
 constexpr PCWSTR kGstConfigPath = L"SOFTWARE\\VCamSample\\GStreamer";
 constexpr PCWSTR kPipelineValueName = L"Pipeline";
 constexpr PCWSTR kWidthValueName = L"Width";
@@ -264,16 +268,17 @@ HRESULT EnsurePipelineRegistry(PCWSTR pipelineOverride)
 	return S_OK;
 }
 
-HRESULT ConfigureVirtualCameraRegistration(bool install)
+HRESULT ConfigureVirtualCameraRegistration(bool install, UINT camera)
 {
 	wil::com_ptr_nothrow<IMFVirtualCamera> vcam;
-	const auto clsid = GUID_ToStringW(CLSID_VCam, false);
+	const auto clsid = GUID_ToStringW(VCamCameraClsid(camera), false);
+	const auto name = VCamCameraName(camera);
 
 	RETURN_IF_FAILED_MSG(MFCreateVirtualCamera(
 		MFVirtualCameraType_SoftwareCameraSource,
 		MFVirtualCameraLifetime_System,
 		MFVirtualCameraAccess_CurrentUser,
-		kVirtualCameraName,
+		name.c_str(),
 		clsid.c_str(),
 		nullptr,
 		0,
@@ -283,18 +288,18 @@ HRESULT ConfigureVirtualCameraRegistration(bool install)
 	if (install)
 	{
 		RETURN_IF_FAILED_MSG(vcam->Start(nullptr), "IMFVirtualCamera::Start failed");
-		WINTRACE(L"DllInstall virtual camera provisioned clsid:%s", clsid.c_str());
+		WINTRACE(L"DllInstall virtual camera provisioned camera:%u clsid:%s", camera, clsid.c_str());
 		return S_OK;
 	}
 
 	const auto hr = vcam->Remove();
 	if (SUCCEEDED(hr))
 	{
-		WINTRACE(L"DllInstall virtual camera removed clsid:%s", clsid.c_str());
+		WINTRACE(L"DllInstall virtual camera removed camera:%u clsid:%s", camera, clsid.c_str());
 	}
 	else
 	{
-		WINTRACE(L"DllInstall virtual camera remove failed hr:0x%08X clsid:%s", hr, clsid.c_str());
+		WINTRACE(L"DllInstall virtual camera remove failed camera:%u hr:0x%08X clsid:%s", camera, hr, clsid.c_str());
 	}
 	return hr;
 }
@@ -332,7 +337,22 @@ HRESULT RunVirtualCameraProvisioning(bool install, PCWSTR pipelineOverride)
 		}
 	}
 
-	hr = ConfigureVirtualCameraRegistration(install);
+	// Every camera is attempted; the first failure is reported. Removal covers every possible
+	// camera, since CameraCount may have been lowered after they were provisioned.
+	const auto configured = VCamCameraCount();
+	const auto count = install ? configured : VCamMaxCameras;
+	for (UINT camera = 0; camera < count; camera++)
+	{
+		const auto cameraHr = ConfigureVirtualCameraRegistration(install, camera);
+		// Cameras beyond the configured count may never have been provisioned.
+		if (camera >= configured)
+			continue;
+
+		if (SUCCEEDED(hr))
+		{
+			hr = cameraHr;
+		}
+	}
 
 Cleanup:
 	if (shouldShutdownMf)
@@ -346,6 +366,30 @@ Cleanup:
 	return hr;
 }
 
+// TraceLevel/TraceKeywords are read when the first class object is handed out (not in DllMain)
+// and re-read on change until the DLL can be unloaded.
+std::mutex _traceSettingsLock;
+RegistryConfigWatcher _traceSettingsWatcher;
+bool _traceSettingsWatched = false;
+
+void StartTraceSettingsWatcher()
+{
+	std::lock_guard<std::mutex> lock(_traceSettingsLock);
+	if (_traceSettingsWatched)
+		return;
+
+	WinTraceLoadSettings();
+	_traceSettingsWatched = true;
+	LOG_IF_FAILED(_traceSettingsWatcher.Start(VCamCameraConfigPath(0), WinTraceLoadSettings));
+}
+
+void StopTraceSettingsWatcher()
+{
+	std::lock_guard<std::mutex> lock(_traceSettingsLock);
+	_traceSettingsWatcher.Stop();
+	_traceSettingsWatched = false;
+}
+
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD dwReason, LPVOID lpReserved)
 {
 	switch (dwReason)
@@ -358,6 +402,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD dwReason, LPVOID lpReserved)
 		break;
 
 	case DLL_PROCESS_DETACH:
+		WinTraceDetach();
 		WINTRACE(L"DllMain DLL_PROCESS_DETACH '%s'", GetCommandLine());
 		WinTraceUnregister();
 		break;
@@ -367,6 +412,11 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD dwReason, LPVOID lpReserved)
 
 struct ClassFactory : winrt::implements<ClassFactory, IClassFactory>
 {
+	explicit ClassFactory(UINT camera) :
+		_camera(camera)
+	{
+	}
+
 	STDMETHODIMP CreateInstance(IUnknown* outer, GUID const& riid, void** result) noexcept final
 	{
 		RETURN_HR_IF_NULL(E_POINTER, result);
@@ -375,7 +425,7 @@ struct ClassFactory : winrt::implements<ClassFactory, IClassFactory>
 			RETURN_HR(CLASS_E_NOAGGREGATION);
 
 		auto vcam = winrt::make_self<Activator>();
-		RETURN_IF_FAILED(vcam->Initialize());
+		RETURN_IF_FAILED(vcam->Initialize(_camera));
 		auto hr = vcam->QueryInterface(riid, result);
 		if (FAILED(hr))
 		{
@@ -389,6 +439,9 @@ struct ClassFactory : winrt::implements<ClassFactory, IClassFactory>
 	{
 		return S_OK;
 	}
+
+private:
+	UINT _camera;
 };
 
 __control_entrypoint(DllExport)
@@ -401,6 +454,9 @@ STDAPI DllCanUnloadNow()
 	}
 
 	winrt::clear_factory_cache();
+	ActivationCacheClear();
+	TcpKickShutdown();
+	StopTraceSettingsWatcher();
 	WINTRACE(L"DllCanUnloadNow S_OK");
 	return S_OK;
 }
@@ -408,12 +464,14 @@ STDAPI DllCanUnloadNow()
 _Check_return_
 STDAPI DllGetClassObject(_In_ REFCLSID rclsid, _In_ REFIID riid, _Outptr_ LPVOID FAR* ppv)
 {
-	WINTRACE(L"DllGetClassObject rclsid:%s riid:%s", GUID_ToStringW(rclsid).c_str(), GUID_ToStringW(riid).c_str());
+	WINTRACE(L"DllGetClassObject rclsid:%s riid:%s", GUID_ToName(rclsid).c_str(), GUID_ToName(riid).c_str());
 	RETURN_HR_IF_NULL(E_POINTER, ppv);
 	*ppv = nullptr;
+	StartTraceSettingsWatcher();
 
-	if (rclsid == CLSID_VCam)
-		return winrt::make_self<ClassFactory>()->QueryInterface(riid, ppv);
+	UINT camera = 0;
+	if (VCamTryGetCamera(rclsid, &camera))
+		return winrt::make_self<ClassFactory>(camera)->QueryInterface(riid, ppv);
 
 	RETURN_HR(E_NOINTERFACE);
 }
@@ -421,16 +479,19 @@ STDAPI DllGetClassObject(_In_ REFCLSID rclsid, _In_ REFIID riid, _Outptr_ LPVOID
 STDAPI DllRegisterServer()
 {
 	std::wstring exePath = wil::GetModuleFileNameW(_hModule).get();
-	WINTRACE(L"DllRegisterServer '%s'", exePath.c_str());
-	auto clsid = GUID_ToStringW(CLSID_VCam, false);
-	std::wstring path = L"Software\\Classes\\CLSID\\" + clsid + L"\\InprocServer32";
+	WINTRACE(L"DllRegisterServer '%s'", exePath.c_str());
+	for (UINT camera = 0; camera < VCamCameraCount(); camera++)
+	{
+		auto clsid = GUID_ToStringW(VCamCameraClsid(camera), false);
+		std::wstring path = L"Software\\Classes\\CLSID\\" + clsid + L"\\InprocServer32";
 
-	// note: a vcam *must* be registered in HKEY_LOCAL_MACHINE
-	// for the frame server to be able to talk with it.
-	registry_key key;
-	RETURN_IF_WIN32_ERROR(RegWriteKey(HKEY_LOCAL_MACHINE, path.c_str(), key.put()));
-	RETURN_IF_WIN32_ERROR(RegWriteValue(key.get(), nullptr, exePath));
-	RETURN_IF_WIN32_ERROR(RegWriteValue(key.get(), L"ThreadingModel", L"Both"));
+		// note: a vcam *must* be registered in HKEY_LOCAL_MACHINE
+		// for the frame server to be able to talk with it.
+		registry_key key;
+		RETURN_IF_WIN32_ERROR(RegWriteKey(HKEY_LOCAL_MACHINE, path.c_str(), key.put()));
+		RETURN_IF_WIN32_ERROR(RegWriteValue(key.get(), nullptr, exePath));
+		RETURN_IF_WIN32_ERROR(RegWriteValue(key.get(), L"ThreadingModel", L"Both"));
+	}
 	RETURN_IF_FAILED_MSG(RunVirtualCameraProvisioning(true, nullptr), "Virtual camera provisioning failed during DllRegisterServer");
 	return S_OK;
 }
@@ -444,9 +505,17 @@ STDAPI DllUnregisterServer()
 	{
 		WINTRACE(L"Virtual camera remove during DllUnregisterServer failed hr:0x%08X", removeHr);
 	}
-	auto clsid = GUID_ToStringW(CLSID_VCam, false);
-	std::wstring path = L"Software\\Classes\\CLSID\\" + clsid;
-	RETURN_IF_WIN32_ERROR(RegDeleteTree(HKEY_LOCAL_MACHINE, path.c_str()));
+	for (UINT camera = 0; camera < VCamMaxCameras; camera++)
+	{
+		auto clsid = GUID_ToStringW(VCamCameraClsid(camera), false);
+		std::wstring path = L"Software\\Classes\\CLSID\\" + clsid;
+		const auto status = RegDeleteTree(HKEY_LOCAL_MACHINE, path.c_str());
+		// Cameras beyond the configured count may never have been registered.
+		if (status != ERROR_FILE_NOT_FOUND || !camera)
+		{
+			RETURN_IF_WIN32_ERROR(status);
+		}
+	}
 	return S_OK;
 }
 
@@ -0,0 +1,123 @@
+#include "TestHarness.h"
+#include "CadenceEstimator.h"
+
+#include <cstdlib>
+
+namespace
+{
+	constexpr int64_t kNominal = 333333; // 30 fps in 100ns units
+
+	// Deterministic jitter in [-amplitude, amplitude].
+	class Jitter
+	{
+	public:
+		explicit Jitter(int64_t amplitude) :
+			_amplitude(amplitude)
+		{
+		}
+
+		int64_t Next()
+		{
+			_state = _state * 6364136223846793005ull + 1442695040888963407ull;
+			return static_cast<int64_t>((_state >> 33) % (2 * _amplitude + 1)) - _amplitude;
+		}
+
+	private:
+		int64_t _amplitude;
+		uint64_t _state = 42;
+	};
+}
+
+TEST_CASE(LoopConvergesOnAnOffNominalPeriod)
+{
+	// A producer running 1% fast with +-0.2 ms of scheduling jitter.
+	const int64_t actual = 330000;
+	CadenceEstimator estimator;
+	estimator.Reset(kNominal);
+	Jitter jitter(2000);
+	int64_t time = 10000000;
+	for (int i = 0; i < 400; i++)
+	{
+		estimator.OnEvent(time + jitter.Next());
+		time += actual;
+	}
+
+	CHECK(estimator.IsLocked());
+	CHECK(std::llabs(estimator.GetPeriod() - actual) < 500);
+	CHECK(estimator.GetJitter() < 2000);
+
+	// The prediction lands within the jitter of the next true event.
+	CHECK(std::llabs(estimator.PredictNext(time - actual / 2) - time) < 3000);
+}
+
+TEST_CASE(SkippedEventsDoNotHalveThePeriod)
+{
+	CadenceEstimator estimator;
+	estimator.Reset(kNominal);
+	int64_t time = 10000000;
+	for (int i = 0; i < 300; i++)
+	{
+		// Every third event is lost, as with latest-only frame handoff.
+		if (i % 3 != 2)
+		{
+			estimator.OnEvent(time);
+		}
+		time += kNominal;
+	}
+
+	CHECK(estimator.IsLocked());
+	CHECK(std::llabs(estimator.GetPeriod() - kNominal) < 100);
+}
+
+TEST_CASE(LongGapReacquires)
+{
+	CadenceEstimator estimator;
+	estimator.Reset(kNominal);
+	int64_t time = 10000000;
+	for (int i = 0; i < 50; i++)
+	{
+		estimator.OnEvent(time);
+		time += kNominal;
+	}
+	CHECK(estimator.IsLocked());
+
+	// A pause of many periods is a discontinuity, not a frequency change.
+	time += 100 * kNominal;
+	estimator.OnEvent(time);
+	CHECK(!estimator.IsLocked());
+	CHECK(std::llabs(estimator.GetPeriod() - kNominal) < 100);
+	CHECK_EQ(time, estimator.GetLastEventTime());
+}
+
+TEST_CASE(PhaseLockHoldsOnlyForAnImminentFrame)
+{
+	FramePhaseLock phaseLock;
+	phaseLock.Reset(kNominal);
+	int64_t frameTime = 10000000;
+	for (int i = 0; i < 20; i++)
+	{
+		phaseLock.OnFrameTime(frameTime);
+		phaseLock.OnRequest(frameTime + kNominal / 2, true);
+		frameTime += kNominal;
+	}
+	CHECK(phaseLock.Producer().IsLocked());
+	CHECK(phaseLock.Consumer().IsLocked());
+
+	// frameTime is the next frame. Just before it, hold; half a period before it, don't.
+	const auto justBefore = frameTime - 20000;
+	const auto hold = phaseLock.HoldTime(justBefore);
+	CHECK(hold >= 20000);
+	CHECK(hold <= kNominal / 4);
+	CHECK_EQ(0, phaseLock.HoldTime(frameTime - kNominal / 2));
+	CHECK(std::llabs(phaseLock.ExpectedArrival(justBefore) - frameTime) < 100);
+}
+
+TEST_CASE(UnlockedPhaseLockNeverHolds)
+{
+	FramePhaseLock phaseLock;
+	phaseLock.Reset(kNominal);
+	CHECK_EQ(0, phaseLock.ExpectedArrival(1000));
+	phaseLock.OnFrameTime(5000000);
+	CHECK_EQ(5000000 + kNominal, phaseLock.ExpectedArrival(5000000));
+	CHECK_EQ(0, phaseLock.HoldTime(5000000 + kNominal - 1000));
+}
@@ -0,0 +1,173 @@
+#include "TestHarness.h"
+#include "ServiceWorker.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Several cameras in one FrameServer process share the pipeline worker (ServiceWorker) while each
+// keeps its own streaming thread, like GstPipelineSource with its appsink callbacks. These check
+// that one camera stopping, or stuck in a state change, never stalls another.
+namespace
+{
+	using namespace std::chrono_literals;
+
+	class FakeCamera
+	{
+	public:
+		explicit FakeCamera(ServiceWorker<FakeCamera>& worker) :
+			_worker(worker)
+		{
+		}
+
+		~FakeCamera()
+		{
+			Stop();
+		}
+
+		void Start()
+		{
+			std::lock_guard<std::mutex> lock(_stateLock);
+			_running.store(true);
+			_streaming = std::thread([this]
+			{
+				// The streaming thread publishes a frame per millisecond.
+				while (_running.load())
+				{
+					_frames.fetch_add(1);
+					std::this_thread::sleep_for(1ms);
+				}
+			});
+			_worker.Add(this);
+		}
+
+		// As GstPipelineSource::StopPipeline_NoLock: leave the worker under the state lock, then
+		// stop streaming.
+		void Stop()
+		{
+			std::lock_guard<std::mutex> lock(_stateLock);
+			if (!_running.load())
+				return;
+
+			_worker.Remove(this);
+			_running.store(false);
+			_streaming.join();
+		}
+
+		// Called on the worker thread; skips a pass while Start/Stop owns the camera.
+		void Service()
+		{
+			std::unique_lock<std::mutex> lock(_stateLock, std::try_to_lock);
+			if (!lock.owns_lock() || !_running.load())
+				return;
+
+			_services.fetch_add(1);
+			const auto stall = _serviceStall.exchange(0ms);
+			if (stall > 0ms)
+			{
+				_inService.store(true);
+				lock.unlock();
+				std::this_thread::sleep_for(stall);
+				_inService.store(false);
+			}
+		}
+
+		uint64_t Frames() const { return _frames.load(); }
+		uint64_t Services() const { return _services.load(); }
+		bool InService() const { return _inService.load(); }
+		void StallNextService(std::chrono::milliseconds stall) { _serviceStall.store(stall); }
+
+	private:
+		ServiceWorker<FakeCamera>& _worker;
+		std::mutex _stateLock;
+		std::atomic<bool> _running = false;
+		std::thread _streaming;
+		std::atomic<uint64_t> _frames = 0;
+		std::atomic<uint64_t> _services = 0;
+		std::atomic<std::chrono::milliseconds> _serviceStall = 0ms;
+		std::atomic<bool> _inService = false;
+	};
+
+	ServiceWorker<FakeCamera>& Worker()
+	{
+		static ServiceWorker<FakeCamera> worker(5ms);
+		return worker;
+	}
+
+	template <typename Predicate>
+	bool WaitFor(Predicate predicate, std::chrono::milliseconds timeout = 2s)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!predicate())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+				return false;
+
+			std::this_thread::sleep_for(1ms);
+		}
+		return true;
+	}
+}
+
+TEST_CASE(StoppingOneCameraLeavesTheOtherDelivering)
+{
+	FakeCamera first(Worker());
+	FakeCamera second(Worker());
+	first.Start();
+	second.Start();
+	CHECK(WaitFor([&] { return first.Services() > 2 && second.Services() > 2 && first.Frames() > 10 && second.Frames() > 10; }));
+
+	first.Stop();
+	const auto firstFrames = first.Frames();
+	const auto firstServices = first.Services();
+	const auto secondFrames = second.Frames();
+	const auto secondServices = second.Services();
+	std::this_thread::sleep_for(100ms);
+
+	// The stopped camera is left alone; the other keeps streaming and being serviced.
+	CHECK_EQ(firstFrames, first.Frames());
+	CHECK_EQ(firstServices, first.Services());
+	CHECK(second.Frames() > secondFrames + 20);
+	CHECK(second.Services() > secondServices + 5);
+	second.Stop();
+}
+
+TEST_CASE(StuckStateChangeDoesNotHoldUpAnotherCamera)
+{
+	FakeCamera stuck(Worker());
+	FakeCamera other(Worker());
+	stuck.Start();
+	other.Start();
+
+	// One camera's Service takes 300 ms, as a pipeline blocking in a state change would.
+	stuck.StallNextService(300ms);
+	CHECK(WaitFor([&] { return stuck.InService(); }));
+
+	// The other camera still streams, and stops (leaving the worker) without waiting on it.
+	const auto frames = other.Frames();
+	std::this_thread::sleep_for(50ms);
+	CHECK(other.Frames() > frames + 10);
+	const auto stopStart = std::chrono::steady_clock::now();
+	other.Stop();
+	CHECK(std::chrono::steady_clock::now() - stopStart < 100ms);
+	CHECK(stuck.InService());
+
+	stuck.Stop();
+}
+
+TEST_CASE(WorkerExitsWithTheLastCameraAndRestarts)
+{
+	{
+		FakeCamera camera(Worker());
+		camera.Start();
+		CHECK(WaitFor([&] { return camera.Services() > 0; }));
+	}
+	CHECK(WaitFor([] { return !Worker().IsRunning(); }));
+
+	FakeCamera camera(Worker());
+	camera.Start();
+	CHECK(Worker().IsRunning());
+	CHECK(WaitFor([&] { return camera.Services() > 2 && camera.Frames() > 10; }));
+	camera.Stop();
+}
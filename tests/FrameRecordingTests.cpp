@@ -0,0 +1,170 @@
+#include "TestHarness.h"
+#include "FrameRecording.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	// An in-memory recording written the way FrameRecorder lays out its file.
+	struct Recording
+	{
+		std::vector<uint8_t> bytes;
+
+		VCamRecordingHeader* Header()
+		{
+			return reinterpret_cast<VCamRecordingHeader*>(bytes.data());
+		}
+
+		VCamRecordingIndexEntry* Index()
+		{
+			return reinterpret_cast<VCamRecordingIndexEntry*>(bytes.data() + Header()->indexOffset);
+		}
+
+		void Append(uint64_t arrivalTime, uint8_t fill)
+		{
+			const auto count = Header()->frameCount;
+			const auto offset = VCamRecordingFrameOffset(Header(), count);
+			memset(bytes.data() + offset, fill, Header()->frameSize);
+			Index()[count].arrivalTime = arrivalTime;
+			Index()[count].dataOffset = offset;
+			Header()->frameCount = count + 1;
+		}
+	};
+
+	Recording Record(uint32_t width, uint32_t height, uint32_t capacity, uint32_t frames)
+	{
+		VCamRecordingHeader header{};
+		const auto fileSize = VCamRecordingInitHeader(&header, width, height, 30, 1, capacity);
+		Recording recording;
+		recording.bytes.resize(fileSize);
+		memcpy(recording.bytes.data(), &header, sizeof(header));
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			recording.Append(i * 333333ull, static_cast<uint8_t>(i + 1));
+		}
+		return recording;
+	}
+
+	bool Accepts(Recording& recording, uint64_t fileSize)
+	{
+		VCamRecordingLayout layout{};
+		return VCamRecordingReadLayout(recording.Header(), fileSize, &layout) &&
+			VCamRecordingCountFrames(recording.Index(), &layout, fileSize) == layout.frameCount;
+	}
+}
+
+TEST_CASE(WriterLayoutIsAligned)
+{
+	VCamRecordingHeader header{};
+	const auto fileSize = VCamRecordingInitHeader(&header, 64, 32, 30, 1, 10);
+	CHECK_EQ(VCAM_RECORDING_MAGIC, header.magic);
+	CHECK_EQ(3072u, header.frameSize);
+	CHECK_EQ(sizeof(VCamRecordingHeader), header.indexOffset);
+	CHECK_EQ(VCAM_RECORDING_ALIGNMENT, header.dataOffset);
+	CHECK_EQ(0u, header.frameCount);
+	CHECK_EQ(VCAM_RECORDING_ALIGNMENT * 11, fileSize);
+	CHECK_EQ(VCAM_RECORDING_ALIGNMENT * 3, VCamRecordingFrameOffset(&header, 2));
+
+	// Odd, empty or overflowing geometry is refused rather than written.
+	CHECK_EQ(0u, VCamRecordingInitHeader(&header, 63, 32, 30, 1, 10));
+	CHECK_EQ(0u, VCamRecordingInitHeader(&header, 64, 0, 30, 1, 10));
+	CHECK_EQ(0u, VCamRecordingInitHeader(&header, 64, 32, 30, 1, 0));
+	CHECK_EQ(0u, VCamRecordingInitHeader(&header, 0xFFFFFFFEu, 0xFFFFFFFEu, 30, 1, 1));
+	CHECK_EQ(0u, VCamRecordingInitHeader(&header, 1u << 20, 1u << 20, 30, 1, 0xFFFFFFFFu));
+}
+
+TEST_CASE(RecordedFramesReadBack)
+{
+	auto recording = Record(64, 32, 10, 4);
+	const auto fileSize = recording.bytes.size();
+	VCamRecordingLayout layout{};
+	CHECK(VCamRecordingReadLayout(recording.Header(), fileSize, &layout));
+	CHECK_EQ(64u, layout.width);
+	CHECK_EQ(32u, layout.height);
+	CHECK_EQ(30u, layout.fpsNumerator);
+	CHECK_EQ(1u, layout.fpsDenominator);
+	CHECK_EQ(4u, layout.frameCount);
+	CHECK_EQ(4u, VCamRecordingCountFrames(recording.Index(), &layout, fileSize));
+
+	for (uint32_t i = 0; i < layout.frameCount; i++)
+	{
+		const auto& entry = recording.Index()[i];
+		CHECK_EQ(i * 333333ull, entry.arrivalTime);
+		CHECK_EQ(i + 1u, recording.bytes[entry.dataOffset]);
+		CHECK_EQ(i + 1u, recording.bytes[entry.dataOffset + layout.frameSize - 1]);
+	}
+}
+
+TEST_CASE(TruncatedFileKeepsItsCompleteFrames)
+{
+	// A crash after three published frames; the file ends partway into the third.
+	auto recording = Record(64, 32, 10, 3);
+	const auto cut = recording.Index()[2].dataOffset + 100;
+	VCamRecordingLayout layout{};
+	CHECK(VCamRecordingReadLayout(recording.Header(), cut, &layout));
+	CHECK_EQ(2u, VCamRecordingCountFrames(recording.Index(), &layout, cut));
+	CHECK(!Accepts(recording, cut));
+
+	// Frames reserved but never published are not required to be present.
+	CHECK(Accepts(recording, recording.Index()[2].dataOffset + layout.frameSize));
+}
+
+TEST_CASE(RejectsForeignOrInconsistentHeaders)
+{
+	auto recording = Record(64, 32, 10, 2);
+	const auto fileSize = recording.bytes.size();
+	CHECK(Accepts(recording, fileSize));
+	CHECK(!Accepts(recording, sizeof(VCamRecordingHeader) - 1));
+
+	auto header = recording.Header();
+	const auto original = *header;
+	auto restore = [&]() { memcpy(header, &original, sizeof(original)); };
+
+	header->magic = 0;
+	CHECK(!Accepts(recording, fileSize));
+	restore();
+	header->version = VCAM_RECORDING_VERSION + 1;
+	CHECK(!Accepts(recording, fileSize));
+	restore();
+	header->width = 63;
+	CHECK(!Accepts(recording, fileSize));
+	restore();
+	header->frameCount = 0;
+	CHECK(!Accepts(recording, fileSize));
+	restore();
+	header->frameCount = header->frameCapacity + 1;
+	CHECK(!Accepts(recording, fileSize));
+	restore();
+	header->frameSize--;
+	CHECK(!Accepts(recording, fileSize));
+	restore();
+	CHECK(Accepts(recording, fileSize));
+}
+
+TEST_CASE(HostileOffsetsDoNotOverflow)
+{
+	auto recording = Record(64, 32, 10, 2);
+	const auto fileSize = recording.bytes.size();
+	auto header = recording.Header();
+
+	// indexOffset + entries wraps around to a small value.
+	header->indexOffset = std::numeric_limits<uint64_t>::max() - 8;
+	CHECK(!Accepts(recording, fileSize));
+	header->indexOffset = sizeof(VCamRecordingHeader);
+
+	// A frame offset whose end wraps past zero.
+	recording.Index()[1].dataOffset = std::numeric_limits<uint64_t>::max() - 100;
+	VCamRecordingLayout layout{};
+	CHECK(VCamRecordingReadLayout(header, fileSize, &layout));
+	CHECK_EQ(1u, VCamRecordingCountFrames(recording.Index(), &layout, fileSize));
+
+	// width * height * 3 / 2 wraps; the frame size cannot cover the pixels it claims.
+	header->width = 0xFFFFFFFEu;
+	header->height = 0xAAAAAAACu;
+	header->frameSize = 8;
+	CHECK(!VCamRecordingReadLayout(header, std::numeric_limits<uint64_t>::max(), &layout));
+	header->frameSize = static_cast<uint64_t>(header->width) * header->height;
+	CHECK(!VCamRecordingReadLayout(header, std::numeric_limits<uint64_t>::max(), &layout));
+}
@@ -0,0 +1,309 @@
+#include "TestHarness.h"
+#include "FrameScaler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+	// Tightly packed NV12 image: Y plane followed by the interleaved UV plane, stride == width.
+	struct NV12Image
+	{
+		NV12Image(uint32_t width, uint32_t height) :
+			width(width),
+			height(height),
+			pixels(static_cast<size_t>(width) * height * 3 / 2)
+		{
+		}
+
+		uint8_t* Y() { return pixels.data(); }
+		uint8_t* UV() { return pixels.data() + static_cast<size_t>(width) * height; }
+		uint8_t& Luma(uint32_t x, uint32_t y) { return Y()[static_cast<size_t>(y) * width + x]; }
+		uint8_t& Chroma(uint32_t x, uint32_t y, uint32_t c) { return UV()[static_cast<size_t>(y) * width + 2 * x + c]; }
+
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;
+	};
+
+	// Horizontal luma ramp and constant chroma, so a correct resample keeps every row identical
+	// and the ramp monotonic whatever the scale factor.
+	NV12Image MakeRamp(uint32_t width, uint32_t height)
+	{
+		NV12Image image(width, height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				image.Luma(x, y) = static_cast<uint8_t>(16 + x * 219 / (width - 1));
+			}
+		}
+		for (uint32_t y = 0; y < height / 2; y++)
+		{
+			for (uint32_t x = 0; x < width / 2; x++)
+			{
+				image.Chroma(x, y, 0) = 90;
+				image.Chroma(x, y, 1) = 200;
+			}
+		}
+		return image;
+	}
+
+	void Scale(NV12Scaler& scaler, NV12Image& source, NV12Image& output)
+	{
+		scaler.Copy(source.Y(), source.width, source.UV(), source.width, source.width, source.height, output.Y(), output.width);
+	}
+
+	bool IsRamp(NV12Image& image, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height)
+	{
+		for (uint32_t y = y0; y < y0 + height; y++)
+		{
+			for (uint32_t x = x0; x < x0 + width; x++)
+			{
+				if (image.Luma(x, y) != image.Luma(x, y0) || (x > x0 && image.Luma(x, y) < image.Luma(x - 1, y)))
+					return false;
+			}
+		}
+		for (uint32_t y = y0 / 2; y < (y0 + height) / 2; y++)
+		{
+			for (uint32_t x = x0 / 2; x < (x0 + width) / 2; x++)
+			{
+				if (image.Chroma(x, y, 0) != 90 || image.Chroma(x, y, 1) != 200)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE(SameSizeIsAnExactCopy)
+{
+	auto source = MakeRamp(64, 48);
+	NV12Image output(64, 48);
+	NV12Scaler scaler;
+	scaler.SetOutputSize(64, 48);
+	CHECK(!scaler.IsScaling(64, 48));
+	Scale(scaler, source, output);
+	CHECK(output.pixels == source.pixels);
+	CHECK_EQ(0u, scaler.GetLayoutVersion());
+}
+
+TEST_CASE(TapsAreOnlyRebuiltWhenTheSourceSizeChanges)
+{
+	auto source = MakeRamp(320, 240);
+	auto other = MakeRamp(160, 120);
+	NV12Image output(128, 96);
+	NV12Scaler scaler;
+	scaler.SetOutputSize(128, 96);
+	for (int i = 0; i < 3; i++)
+	{
+		Scale(scaler, source, output);
+	}
+	CHECK_EQ(1u, scaler.GetLayoutVersion());
+	Scale(scaler, other, output);
+	CHECK_EQ(2u, scaler.GetLayoutVersion());
+	CHECK_EQ(160u, scaler.GetSourceWidth());
+	CHECK_EQ(120u, scaler.GetSourceHeight());
+}
+
+// One pipeline frame is copied into every stream of the camera, each with its own scaler, the
+// way MediaStream::RequestSample does for the capture and preview pins.
+TEST_CASE(FanOutToEveryStreamSize)
+{
+	struct Stream
+	{
+		uint32_t width;
+		uint32_t height;
+		bool letterbox;
+	};
+	const Stream streams[] = {
+		{ 1920, 1080, false },
+		{ 1280, 720, false },
+		{ 640, 360, false },
+		{ 640, 480, true },
+	};
+
+	auto source = MakeRamp(1920, 1080);
+	std::vector<NV12Scaler> scalers(std::size(streams));
+	std::vector<NV12Image> outputs;
+	for (size_t i = 0; i < std::size(streams); i++)
+	{
+		scalers[i].SetOutputSize(streams[i].width, streams[i].height);
+		scalers[i].SetLetterbox(streams[i].letterbox);
+		outputs.emplace_back(streams[i].width, streams[i].height);
+	}
+
+	constexpr int frames = 30;
+	std::vector<double> perStreamMs(std::size(streams));
+	const auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (size_t i = 0; i < std::size(streams); i++)
+		{
+			const auto streamStart = std::chrono::steady_clock::now();
+			Scale(scalers[i], source, outputs[i]);
+			perStreamMs[i] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - streamStart).count();
+		}
+	}
+	const auto totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("  fan-out 1920x1080 -> %zu streams: %.3f ms/frame\n", std::size(streams), totalMs / frames);
+	for (size_t i = 0; i < std::size(streams); i++)
+	{
+		std::printf(
+			"    %4ux%-4u%s %.3f ms/frame\n",
+			streams[i].width,
+			streams[i].height,
+			streams[i].letterbox ? " letterbox" : "          ",
+			perStreamMs[i] / frames);
+	}
+
+	CHECK(outputs[0].pixels == source.pixels);
+	for (size_t i = 1; i < std::size(streams); i++)
+	{
+		auto& scaler = scalers[i];
+		CHECK_EQ(1u, scaler.GetLayoutVersion());
+		CHECK(IsRamp(outputs[i], scaler.GetContentX(), scaler.GetContentY(), scaler.GetContentWidth(), scaler.GetContentHeight()));
+	}
+}
+
+TEST_CASE(UpscaleInterpolatesBetweenSourcePixels)
+{
+	NV12Image source(4, 4);
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			source.Luma(x, y) = static_cast<uint8_t>(16 + 64 * x);
+		}
+	}
+	for (uint32_t y = 0; y < 2; y++)
+	{
+		for (uint32_t x = 0; x < 2; x++)
+		{
+			source.Chroma(x, y, 0) = 90;
+			source.Chroma(x, y, 1) = 200;
+		}
+	}
+	NV12Image output(8, 8);
+	NV12Scaler scaler;
+	scaler.SetOutputSize(8, 8);
+	Scale(scaler, source, output);
+
+	// Center-aligned taps: the edges clamp to the edge pixels, output pixel 1 sits a quarter of
+	// the way from source pixel 0 to 1.
+	CHECK_EQ(16, output.Luma(0, 0));
+	CHECK_EQ(32, output.Luma(1, 0));
+	CHECK_EQ(208, output.Luma(7, 0));
+	CHECK(IsRamp(output, 0, 0, 8, 8));
+}
+
+TEST_CASE(DownscaleAveragesNeighbouringPixels)
+{
+	NV12Image source(8, 8);
+	for (uint32_t y = 0; y < 8; y++)
+	{
+		for (uint32_t x = 0; x < 8; x++)
+		{
+			source.Luma(x, y) = static_cast<uint8_t>(16 + 16 * x);
+		}
+	}
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			source.Chroma(x, y, 0) = 90;
+			source.Chroma(x, y, 1) = 200;
+		}
+	}
+	NV12Image output(4, 4);
+	NV12Scaler scaler;
+	scaler.SetOutputSize(4, 4);
+	Scale(scaler, source, output);
+
+	// A 2:1 reduction samples halfway between each pair of source pixels.
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			CHECK_EQ(24 + 32 * x, output.Luma(x, y));
+		}
+	}
+	CHECK(IsRamp(output, 0, 0, 4, 4));
+}
+
+TEST_CASE(LetterboxKeepsTheAspectRatioWithBlackBorders)
+{
+	struct Case
+	{
+		uint32_t sourceWidth;
+		uint32_t sourceHeight;
+		uint32_t outputWidth;
+		uint32_t outputHeight;
+		uint32_t contentX;
+		uint32_t contentY;
+		uint32_t contentWidth;
+		uint32_t contentHeight;
+	};
+	const Case cases[] = {
+		// Wider source: bars above and below.
+		{ 1920, 1080, 640, 480, 0, 60, 640, 360 },
+		// Narrower source: bars left and right.
+		{ 640, 480, 1280, 720, 160, 0, 960, 720 },
+	};
+
+	for (const auto& c : cases)
+	{
+		auto source = MakeRamp(c.sourceWidth, c.sourceHeight);
+		NV12Image output(c.outputWidth, c.outputHeight);
+		NV12Scaler scaler;
+		scaler.SetOutputSize(c.outputWidth, c.outputHeight);
+		scaler.SetLetterbox(true);
+		Scale(scaler, source, output);
+		CHECK_EQ(c.contentX, scaler.GetContentX());
+		CHECK_EQ(c.contentY, scaler.GetContentY());
+		CHECK_EQ(c.contentWidth, scaler.GetContentWidth());
+		CHECK_EQ(c.contentHeight, scaler.GetContentHeight());
+		CHECK(IsRamp(output, c.contentX, c.contentY, c.contentWidth, c.contentHeight));
+
+		uint64_t borderErrors = 0;
+		for (uint32_t y = 0; y < c.outputHeight; y++)
+		{
+			for (uint32_t x = 0; x < c.outputWidth; x++)
+			{
+				const auto inside = x >= c.contentX && x < c.contentX + c.contentWidth && y >= c.contentY && y < c.contentY + c.contentHeight;
+				if (!inside && (output.Luma(x, y) != 16 || output.Chroma(x / 2, y / 2, 0) != 128 || output.Chroma(x / 2, y / 2, 1) != 128))
+				{
+					borderErrors++;
+				}
+			}
+		}
+		CHECK_EQ(0u, borderErrors);
+	}
+}
+
+// The appsink accepts any NV12 size, so upstream can renegotiate between frames; the same
+// scaler then switches from upscaling to downscaling without reconfiguration.
+TEST_CASE(SourceSizeChangesBetweenFrames)
+{
+	NV12Image output(640, 360);
+	NV12Scaler scaler;
+	scaler.SetOutputSize(640, 360);
+
+	auto small = MakeRamp(320, 180);
+	Scale(scaler, small, output);
+	CHECK(IsRamp(output, 0, 0, 640, 360));
+	CHECK_EQ(16, output.Luma(0, 0));
+	CHECK_EQ(235, output.Luma(639, 0));
+
+	auto large = MakeRamp(1280, 720);
+	Scale(scaler, large, output);
+	CHECK(IsRamp(output, 0, 0, 640, 360));
+	CHECK_EQ(2u, scaler.GetLayoutVersion());
+
+	auto same = MakeRamp(640, 360);
+	Scale(scaler, same, output);
+	CHECK(output.pixels == same.pixels);
+}
@@ -0,0 +1,212 @@
+#include "TestHarness.h"
+#include "MpscRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct Record
+	{
+		uint32_t producer;
+		uint32_t index;
+	};
+
+	bool Push(MpscRing<Record, 8>& ring, uint32_t producer, uint32_t index)
+	{
+		uint64_t position = 0;
+		auto record = ring.Reserve(&position);
+		if (!record)
+			return false;
+
+		*record = { producer, index };
+		ring.Publish(position);
+		return true;
+	}
+
+	// Runs producers against a concurrently draining consumer and checks that every record that
+	// was not reported dropped arrives exactly once and in each producer's order.
+	template <uint32_t SlotCount>
+	void RunProducers(uint32_t producers, uint32_t perProducer, bool yieldInConsumer)
+	{
+		auto ring = std::make_unique<MpscRing<Record, SlotCount>>();
+		std::atomic<uint32_t> running = producers;
+		std::vector<std::vector<uint32_t>> received(producers);
+		uint64_t dropped = 0;
+		std::vector<uint32_t> accepted(producers);
+
+		std::vector<std::thread> threads;
+		for (uint32_t p = 0; p < producers; p++)
+		{
+			threads.emplace_back([&, p]
+			{
+				for (uint32_t i = 0; i < perProducer; i++)
+				{
+					uint64_t position = 0;
+					if (auto record = ring->Reserve(&position))
+					{
+						*record = { p, i };
+						ring->Publish(position);
+						accepted[p]++;
+					}
+				}
+				running.fetch_sub(1);
+			});
+		}
+
+		const auto consume = [&](const Record& record)
+		{
+			received[record.producer].push_back(record.index);
+		};
+		while (running.load())
+		{
+			ring->Drain(consume);
+			dropped += ring->TakeDropped();
+			if (yieldInConsumer)
+			{
+				std::this_thread::yield();
+			}
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		ring->Drain(consume);
+		dropped += ring->TakeDropped();
+		CHECK(ring->IsEmpty());
+
+		uint64_t total = 0;
+		uint64_t duplicatesOrReordered = 0;
+		for (uint32_t p = 0; p < producers; p++)
+		{
+			const auto& indices = received[p];
+			CHECK_EQ(accepted[p], indices.size());
+			duplicatesOrReordered += std::adjacent_find(indices.begin(), indices.end(), [](uint32_t a, uint32_t b) { return a >= b; }) != indices.end() ? 1 : 0;
+			total += indices.size();
+		}
+		std::printf(
+			"  %u producers x %u into %u slots: received %llu dropped %llu\n",
+			producers,
+			perProducer,
+			SlotCount,
+			static_cast<unsigned long long>(total),
+			static_cast<unsigned long long>(dropped));
+		CHECK_EQ(0u, duplicatesOrReordered);
+		CHECK_EQ(static_cast<uint64_t>(producers) * perProducer, total + dropped);
+	}
+}
+
+TEST_CASE(DeliversInOrderAndCountsDropsWhenFull)
+{
+	MpscRing<Record, 8> ring;
+	CHECK(ring.IsEmpty());
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		CHECK(Push(ring, 0, i));
+	}
+
+	// Full: the next records are dropped and counted, nothing already queued is lost.
+	CHECK(!Push(ring, 0, 8));
+	CHECK(!Push(ring, 0, 9));
+	CHECK_EQ(2u, ring.TakeDropped());
+	CHECK_EQ(0u, ring.TakeDropped());
+
+	std::vector<uint32_t> indices;
+	CHECK_EQ(8u, ring.Drain([&](const Record& record) { indices.push_back(record.index); }));
+	CHECK((indices == std::vector<uint32_t>{ 0, 1, 2, 3, 4, 5, 6, 7 }));
+	CHECK(ring.IsEmpty());
+
+	// Slots are reused after the drain, across the wrap.
+	for (uint32_t i = 10; i < 15; i++)
+	{
+		CHECK(Push(ring, 0, i));
+	}
+	indices.clear();
+	ring.Drain([&](const Record& record) { indices.push_back(record.index); });
+	CHECK((indices == std::vector<uint32_t>{ 10, 11, 12, 13, 14 }));
+}
+
+TEST_CASE(DrainStopsAtAnUnpublishedSlot)
+{
+	MpscRing<Record, 8> ring;
+	uint64_t first = 0;
+	uint64_t second = 0;
+	auto a = ring.Reserve(&first);
+	auto b = ring.Reserve(&second);
+	*b = { 0, 2 };
+	CHECK_EQ(2u, ring.Publish(second));
+
+	// The older reservation is still being filled; the consumer must not skip past it.
+	CHECK_EQ(0u, ring.Drain([](const Record&) {}));
+	*a = { 0, 1 };
+	ring.Publish(first);
+	std::vector<uint32_t> indices;
+	CHECK_EQ(2u, ring.Drain([&](const Record& record) { indices.push_back(record.index); }));
+	CHECK((indices == std::vector<uint32_t>{ 1, 2 }));
+}
+
+TEST_CASE(ConcurrentProducersLoseNothingButCountedDrops)
+{
+	// Large enough that nothing is dropped while the consumer keeps up...
+	RunProducers<1 << 16>(4, 10000, false);
+	// ...and small enough to overflow constantly.
+	RunProducers<16>(4, 20000, true);
+}
+
+// Cost of one Reserve + Publish as seen by a tracing thread, alone and with contention.
+TEST_CASE(ReservePublishBenchmark)
+{
+	constexpr uint32_t calls = 200000;
+	for (const uint32_t producers : { 1u, 4u })
+	{
+		auto ring = std::make_unique<MpscRing<Record, 1024>>();
+		std::atomic<bool> done = false;
+		std::thread consumer([&]
+		{
+			while (!done.load())
+			{
+				ring->Drain([](const Record&) {});
+				std::this_thread::yield();
+			}
+		});
+
+		std::vector<double> perCallNs(producers);
+		std::vector<std::thread> threads;
+		for (uint32_t p = 0; p < producers; p++)
+		{
+			threads.emplace_back([&, p]
+			{
+				const auto start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0; i < calls; i++)
+				{
+					uint64_t position = 0;
+					if (auto record = ring->Reserve(&position))
+					{
+						*record = { p, i };
+						ring->Publish(position);
+					}
+				}
+				perCallNs[p] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		done.store(true);
+		consumer.join();
+
+		double mean = 0;
+		for (const auto ns : perCallNs)
+		{
+			mean += ns / producers;
+		}
+		std::printf("  %u producer(s): %.1f ns per record, %llu dropped\n", producers, mean, static_cast<unsigned long long>(ring->TakeDropped()));
+		CHECK(mean > 0);
+	}
+}
@@ -0,0 +1,232 @@
+#include "TestHarness.h"
+#include "PipelineConfig.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	// A camera config key exported as a .reg file, the way it is deployed. Only the REG_SZ and
+	// REG_DWORD lines of the key are read; strings are ASCII here.
+	class ConfigFile
+	{
+	public:
+		explicit ConfigFile(const char* name) :
+			_path(std::filesystem::temp_directory_path() / name)
+		{
+		}
+
+		~ConfigFile()
+		{
+			std::error_code error;
+			std::filesystem::remove(_path, error);
+		}
+
+		void Write(const std::string& values) const
+		{
+			std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+			file << "Windows Registry Editor Version 5.00\r\n\r\n";
+			file << "[HKEY_LOCAL_MACHINE\\SOFTWARE\\GstVCam\\Camera0]\r\n";
+			file << values;
+		}
+
+		// Mirrors LoadPipelineConfigFromRegistry: defaults first, then every value present.
+		VCamPipelineConfig Load(uint32_t camera) const
+		{
+			VCamPipelineConfig config;
+			config.camera = camera;
+			config.pipeline = L"<default>";
+
+			std::ifstream file(_path, std::ios::binary);
+			std::string line;
+			while (std::getline(file, line))
+			{
+				if (!line.empty() && line.back() == '\r')
+				{
+					line.pop_back();
+				}
+				if (line.size() < 2 || line[0] != '"')
+				{
+					continue;
+				}
+
+				const auto nameEnd = line.find("\"=", 1);
+				if (nameEnd == std::string::npos)
+				{
+					continue;
+				}
+
+				const auto name = Widen(line.substr(1, nameEnd - 1));
+				const auto data = line.substr(nameEnd + 2);
+				if (data.rfind("dword:", 0) == 0)
+				{
+					ApplyPipelineConfigDword(&config, name, static_cast<uint32_t>(std::stoul(data.substr(6), nullptr, 16)));
+				}
+				else if (data.size() >= 2 && data.front() == '"' && data.back() == '"')
+				{
+					ApplyPipelineConfigString(&config, name, Unescape(data.substr(1, data.size() - 2)));
+				}
+			}
+			return config;
+		}
+
+	private:
+		static std::wstring Widen(const std::string& text)
+		{
+			return std::wstring(text.begin(), text.end());
+		}
+
+		static std::wstring Unescape(const std::string& text)
+		{
+			std::wstring value;
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				if (text[i] == '\\' && i + 1 < text.size())
+				{
+					i++;
+				}
+				value += static_cast<wchar_t>(text[i]);
+			}
+			return value;
+		}
+
+		std::filesystem::path _path;
+	};
+
+	// What MediaSource::ReloadPipelineConfig does once the watcher reports a settled change.
+	struct ReloadingSource
+	{
+		VCamPipelineConfig current;
+		int reloads = 0;
+
+		bool OnConfigChanged(const ConfigFile& file, bool reloadSucceeds = true)
+		{
+			const auto config = file.Load(current.camera);
+			if (!PipelineConfigChangesSource(current, config))
+				return false;
+
+			reloads++;
+			if (reloadSucceeds)
+			{
+				current = config;
+			}
+			return true;
+		}
+	};
+
+	const std::string kBase =
+		"\"Pipeline\"=\"videotestsrc ! appsink name=vcamsink\"\r\n"
+		"\"Width\"=dword:00000780\r\n"
+		"\"Height\"=dword:00000438\r\n"
+		"\"FpsNumerator\"=dword:0000003c\r\n"
+		"\"FpsDenominator\"=dword:00000001\r\n";
+}
+
+TEST_CASE(DeployedFileIsRead)
+{
+	ConfigFile file("vcam-config-read.reg");
+	file.Write(
+		kBase +
+		"\"SampleAllocator\"=dword:00000000\r\n"
+		"\"sampleMemoryBudgetMB\"=dword:00000080\r\n"
+		"\"ScaleMode\"=dword:00000001\r\n"
+		"\"ShmName\"=\"Global\\\\VCamFrames\"\r\n"
+		"\"RecordDirectory\"=\"C:\\\\vcam\\\\rec\"\r\n"
+		"\"RecordMaxFrames\"=dword:00000064\r\n"
+		"\"ReplayPath\"=\"C:\\\\vcam\\\\a.vcrec\"\r\n"
+		"\"ReplaySpeedPercent\"=dword:000000c8\r\n"
+		"\"LogEndpoint\"=\"127.0.0.1:5555\"\r\n");
+
+	const auto config = file.Load(2);
+	CHECK_EQ(2u, config.camera);
+	CHECK(config.pipeline == L"videotestsrc ! appsink name=vcamsink");
+	CHECK_EQ(1920u, config.width);
+	CHECK_EQ(1080u, config.height);
+	CHECK_EQ(60u, config.fpsNumerator);
+	CHECK_EQ(1u, config.fpsDenominator);
+	CHECK(config.sampleAllocator == VCamSampleAllocatorMode::Provided);
+	CHECK_EQ(128u, config.sampleMemoryBudgetMB);
+	CHECK(config.scaleMode == VCamScaleMode::Letterbox);
+	CHECK(config.shmName == L"Global\\VCamFrames");
+	CHECK(config.recordDirectory == L"C:\\vcam\\rec");
+	CHECK_EQ(100u, config.recordMaxFrames);
+	CHECK(config.replayPath == L"C:\\vcam\\a.vcrec");
+	CHECK_EQ(200u, config.replaySpeedPercent);
+}
+
+TEST_CASE(InvalidValuesKeepTheDefaults)
+{
+	ConfigFile file("vcam-config-invalid.reg");
+	file.Write(
+		"\"Width\"=dword:00000000\r\n"
+		"\"FpsDenominator\"=dword:00000000\r\n"
+		"\"SampleAllocator\"=dword:00000003\r\n"
+		"\"ScaleMode\"=dword:00000002\r\n"
+		"\"ReplaySpeedPercent\"=dword:00000000\r\n");
+
+	const auto config = file.Load(0);
+	const VCamPipelineConfig defaults;
+	CHECK(config.pipeline == L"<default>");
+	CHECK_EQ(defaults.width, config.width);
+	CHECK_EQ(1u, config.fpsDenominator);
+	CHECK(config.sampleAllocator == defaults.sampleAllocator);
+	CHECK(config.scaleMode == defaults.scaleMode);
+	CHECK_EQ(defaults.replaySpeedPercent, config.replaySpeedPercent);
+}
+
+TEST_CASE(OnlySourceEditsReloadLive)
+{
+	ConfigFile file("vcam-config-reload.reg");
+	file.Write(kBase);
+	ReloadingSource source;
+	source.current = file.Load(0);
+
+	// A rewrite with the same values (the watcher fires on any write) does nothing.
+	file.Write(kBase);
+	CHECK(!source.OnConfigChanged(file));
+
+	// Values applied when the camera is next opened do not restart the source.
+	file.Write(kBase + "\"ScaleMode\"=dword:00000001\r\n\"RecordDirectory\"=\"C:\\\\rec\"\r\n\"SampleMemoryBudgetMB\"=dword:00000010\r\n");
+	CHECK(!source.OnConfigChanged(file));
+
+	file.Write(
+		"\"Pipeline\"=\"videotestsrc pattern=ball ! appsink name=vcamsink\"\r\n"
+		"\"Width\"=dword:00000780\r\n\"Height\"=dword:00000438\r\n\"FpsNumerator\"=dword:0000003c\r\n");
+	CHECK(source.OnConfigChanged(file));
+	CHECK(source.current.pipeline == L"videotestsrc pattern=ball ! appsink name=vcamsink");
+
+	file.Write(kBase + "\"ShmName\"=\"Global\\\\VCamFrames\"\r\n");
+	CHECK(source.OnConfigChanged(file));
+	CHECK(source.current.shmName == L"Global\\VCamFrames");
+
+	// Removing a value reverts it to its default, which is a change too.
+	file.Write(kBase);
+	CHECK(source.OnConfigChanged(file));
+	CHECK(source.current.shmName.empty());
+
+	file.Write(kBase + "\"ReplayPath\"=\"C:\\\\a.vcrec\"\r\n\"ReplaySpeedPercent\"=dword:00000032\r\n");
+	CHECK(source.OnConfigChanged(file));
+	CHECK_EQ(50u, source.current.replaySpeedPercent);
+	CHECK_EQ(4, source.reloads);
+}
+
+TEST_CASE(FailedReloadIsRetriedOnTheNextChange)
+{
+	ConfigFile file("vcam-config-retry.reg");
+	file.Write(kBase);
+	ReloadingSource source;
+	source.current = file.Load(0);
+
+	// The new source never produced a frame (or the reload was cancelled): the config is not
+	// taken, so the next notification, even for an unrelated value, tries again.
+	file.Write(kBase + "\"Height\"=dword:000002d0\r\n");
+	CHECK(source.OnConfigChanged(file, false));
+	CHECK_EQ(1080u, source.current.height);
+
+	file.Write(kBase + "\"Height\"=dword:000002d0\r\n\"ScaleMode\"=dword:00000001\r\n");
+	CHECK(source.OnConfigChanged(file));
+	CHECK_EQ(720u, source.current.height);
+	CHECK(!source.OnConfigChanged(file));
+	CHECK_EQ(2, source.reloads);
+}
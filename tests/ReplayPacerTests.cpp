@@ -0,0 +1,175 @@
+#include "TestHarness.h"
+#include "ReplayPacer.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t kWidth = 16;
+	constexpr uint32_t kHeight = 8;
+	constexpr int64_t kFrameDuration = 333333; // 30 fps in 100ns units
+
+	// Arrival times on the recorder's clock; the first frame did not arrive at 0 and the gaps
+	// jitter around the nominal 33.3ms.
+	const int64_t kArrivals[] = { 7000000, 7333333, 7700000, 8000000, 8400000 };
+	constexpr uint32_t kFrames = sizeof(kArrivals) / sizeof(kArrivals[0]);
+
+	// A recording written through VCamRecordingAppendFrame the way FrameRecorder::Append does:
+	// source rows are padded to a wider stride and arrival times are made relative to the first.
+	struct Recording
+	{
+		explicit Recording(uint32_t capacity)
+		{
+			VCamRecordingHeader header{};
+			bytes.resize(VCamRecordingInitHeader(&header, kWidth, kHeight, 30, 1, capacity));
+			memcpy(bytes.data(), &header, sizeof(header));
+		}
+
+		VCamRecordingHeader* Header() { return reinterpret_cast<VCamRecordingHeader*>(bytes.data()); }
+
+		bool Append(int64_t arrivalTime, uint8_t fill)
+		{
+			constexpr ptrdiff_t stride = kWidth + 8;
+			std::vector<uint8_t> frame(stride * kHeight * 3 / 2, 0xEE);
+			for (uint32_t row = 0; row < kHeight * 3 / 2; row++)
+			{
+				memset(frame.data() + row * stride, fill, kWidth);
+			}
+
+			if (!Header()->frameCount)
+			{
+				firstArrivalTime = arrivalTime;
+			}
+			return VCamRecordingAppendFrame(Header(), bytes.data(), frame.data(), stride, static_cast<uint64_t>(arrivalTime - firstArrivalTime)) != 0;
+		}
+
+		std::vector<uint8_t> bytes;
+		int64_t firstArrivalTime = 0;
+	};
+
+	// What ReplayFrameSource reads back: the validated layout and the index.
+	struct Replay
+	{
+		explicit Replay(Recording& recording)
+		{
+			valid = VCamRecordingReadLayout(recording.Header(), recording.bytes.size(), &layout) != 0;
+			index = reinterpret_cast<const VCamRecordingIndexEntry*>(recording.bytes.data() + layout.indexOffset);
+			valid = valid && VCamRecordingCountFrames(index, &layout, recording.bytes.size()) == layout.frameCount;
+			base = recording.bytes.data();
+		}
+
+		// Whether every pixel of the recorded frame is fill (the stride padding was not copied).
+		bool FrameIs(uint32_t frame, uint8_t fill) const
+		{
+			const auto pixels = base + index[frame].dataOffset;
+			for (uint64_t i = 0; i < layout.frameSize; i++)
+			{
+				if (pixels[i] != fill)
+					return false;
+			}
+			return true;
+		}
+
+		VCamRecordingLayout layout{};
+		const VCamRecordingIndexEntry* index = nullptr;
+		const uint8_t* base = nullptr;
+		bool valid = false;
+	};
+
+	Recording RecordAll()
+	{
+		Recording recording(8);
+		for (uint32_t i = 0; i < kFrames; i++)
+		{
+			recording.Append(kArrivals[i], static_cast<uint8_t>(0x10 + i));
+		}
+		return recording;
+	}
+}
+
+// Record, then replay three loops on a simulated clock that publishes each frame when it is due:
+// every frame comes back with its own pixels at its recorded offset from the loop start, and each
+// loop starts one nominal frame after the previous one ended.
+TEST_CASE(RecordedTimestampsReplayAtTheirOffsets)
+{
+	auto recording = RecordAll();
+	Replay replay(recording);
+	CHECK(replay.valid);
+	CHECK_EQ(kFrames, replay.layout.frameCount);
+
+	constexpr int64_t start = 50000000;
+	ReplayPacer pacer(replay.index, replay.layout, 100);
+	pacer.Start(start);
+	auto loopStart = start;
+	for (uint64_t loop = 0; loop < 3; loop++)
+	{
+		int64_t now = 0;
+		for (uint32_t i = 0; i < kFrames; i++)
+		{
+			CHECK_EQ(i, pacer.GetFrame());
+			now = pacer.GetDueTime();
+			CHECK_EQ(kArrivals[i] - kArrivals[0], now - loopStart);
+			CHECK(replay.FrameIs(pacer.GetFrame(), static_cast<uint8_t>(0x10 + i)));
+			CHECK_EQ(i + 1 == kFrames, pacer.Advance(now));
+		}
+		CHECK_EQ(loop + 1, pacer.GetLoops());
+		loopStart = now + kFrameDuration;
+	}
+	CHECK_EQ(0u, pacer.GetFrame());
+	CHECK_EQ(loopStart, pacer.GetDueTime());
+}
+
+TEST_CASE(SpeedScalesTheSchedule)
+{
+	auto recording = RecordAll();
+	Replay replay(recording);
+
+	ReplayPacer twice(replay.index, replay.layout, 200);
+	twice.Start(0);
+	int64_t now = 0;
+	for (uint32_t i = 0; i < kFrames; i++)
+	{
+		now = twice.GetDueTime();
+		CHECK_EQ((kArrivals[i] - kArrivals[0]) / 2, now);
+		twice.Advance(now);
+	}
+	CHECK_EQ(now + kFrameDuration / 2, twice.GetDueTime());
+
+	// 0 is the original timing.
+	ReplayPacer unset(replay.index, replay.layout, 0);
+	unset.Start(0);
+	unset.Advance(0);
+	CHECK_EQ(kArrivals[1] - kArrivals[0], unset.GetDueTime());
+}
+
+// A frame published late does not push the rest of the loop back: the frames after it are due at
+// their recorded offsets, so the replay catches up.
+TEST_CASE(LatePublishIsCaughtUp)
+{
+	auto recording = RecordAll();
+	Replay replay(recording);
+	ReplayPacer pacer(replay.index, replay.layout, 100);
+	pacer.Start(0);
+	pacer.Advance(pacer.GetDueTime());
+
+	const auto late = pacer.GetDueTime() + 500000;
+	pacer.Advance(late);
+	CHECK_EQ(2u, pacer.GetFrame());
+	CHECK_EQ(kArrivals[2] - kArrivals[0], pacer.GetDueTime());
+	CHECK(pacer.GetDueTime() < late);
+}
+
+TEST_CASE(RecordingStopsAtItsCapacity)
+{
+	Recording recording(2);
+	CHECK(recording.Append(kArrivals[0], 1));
+	CHECK(recording.Append(kArrivals[1], 2));
+	CHECK(!recording.Append(kArrivals[2], 3));
+	CHECK_EQ(2u, recording.Header()->frameCount);
+
+	Replay replay(recording);
+	CHECK(replay.valid);
+	CHECK_EQ(static_cast<uint64_t>(kArrivals[1] - kArrivals[0]), replay.index[1].arrivalTime);
+	CHECK(replay.FrameIs(1, 2));
+}
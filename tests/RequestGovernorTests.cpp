@@ -0,0 +1,95 @@
+#include "TestHarness.h"
+#include "RequestGovernor.h"
+
+namespace
+{
+	constexpr int64_t kFrame = 333333; // 30 fps in 100ns units
+	constexpr int64_t kOneMs = 10000;
+}
+
+TEST_CASE(MissesEscalateFromSpinToWait)
+{
+	RequestGovernor governor;
+	governor.Reset(kFrame);
+	const int64_t now = 1000000;
+	const auto arrival = now + 10 * kOneMs;
+
+	uint32_t waitMs = 99;
+	for (uint32_t miss = 1; miss <= RequestGovernor::SpinMisses; miss++)
+	{
+		CHECK(governor.OnMiss(now, arrival, &waitMs) == RequestBackoff::Spin);
+		CHECK_EQ(0u, waitMs);
+	}
+	for (uint32_t miss = RequestGovernor::SpinMisses + 1; miss <= RequestGovernor::YieldMisses; miss++)
+	{
+		CHECK(governor.OnMiss(now, arrival, &waitMs) == RequestBackoff::Yield);
+	}
+	for (uint32_t miss = RequestGovernor::YieldMisses + 1; miss <= RequestGovernor::SleepMisses; miss++)
+	{
+		CHECK(governor.OnMiss(now, arrival, &waitMs) == RequestBackoff::Sleep);
+		CHECK_EQ(1u, waitMs);
+	}
+
+	// Past the sleep stage the wait is keyed to the expected arrival, rounded up to a millisecond.
+	CHECK(governor.OnMiss(now, arrival, &waitMs) == RequestBackoff::Wait);
+	CHECK_EQ(10u, waitMs);
+	CHECK(governor.OnMiss(now, now + 10 * kOneMs + 1, &waitMs) == RequestBackoff::Wait);
+	CHECK_EQ(11u, waitMs);
+
+	const auto stats = governor.GetStats();
+	CHECK_EQ(RequestGovernor::SleepMisses + 2, stats.misses);
+	CHECK_EQ(RequestGovernor::SpinMisses, stats.spins);
+	CHECK_EQ(2u, stats.waits);
+	CHECK_EQ(RequestGovernor::SleepMisses + 2, stats.maxConsecutiveMisses);
+}
+
+TEST_CASE(ImminentFrameYieldsInsteadOfSleeping)
+{
+	RequestGovernor governor;
+	governor.Reset(kFrame);
+	const int64_t now = 1000000;
+	uint32_t waitMs = 0;
+	for (uint32_t miss = 1; miss <= RequestGovernor::YieldMisses; miss++)
+	{
+		governor.OnMiss(now, now + kFrame, &waitMs);
+	}
+
+	// A frame due in under a millisecond would arrive while sleeping.
+	CHECK(governor.OnMiss(now, now + kOneMs / 2, &waitMs) == RequestBackoff::Yield);
+	CHECK_EQ(0u, waitMs);
+}
+
+TEST_CASE(OverdueFrameWaitsAtMostOneInterval)
+{
+	RequestGovernor governor;
+	governor.Reset(kFrame);
+	const int64_t now = 1000000;
+	uint32_t waitMs = 0;
+	for (uint32_t miss = 1; miss <= RequestGovernor::SleepMisses; miss++)
+	{
+		governor.OnMiss(now, 0, &waitMs);
+	}
+
+	// Stalled producer: the expected arrival is in the past.
+	CHECK(governor.OnMiss(now, now - 5 * kFrame, &waitMs) == RequestBackoff::Wait);
+	CHECK_EQ(34u, waitMs);
+	// Far-future estimates are clamped to one interval too.
+	CHECK(governor.OnMiss(now, now + 100 * kFrame, &waitMs) == RequestBackoff::Wait);
+	CHECK_EQ(34u, waitMs);
+}
+
+TEST_CASE(DeliveryResetsTheEscalation)
+{
+	RequestGovernor governor;
+	governor.Reset(kFrame);
+	uint32_t waitMs = 0;
+	for (uint32_t miss = 1; miss <= RequestGovernor::YieldMisses; miss++)
+	{
+		governor.OnMiss(0, kFrame, &waitMs);
+	}
+
+	governor.OnFrameDelivered();
+	CHECK(governor.OnMiss(0, kFrame, &waitMs) == RequestBackoff::Spin);
+	CHECK_EQ(1u, governor.GetStats().consecutiveMisses);
+	CHECK_EQ(RequestGovernor::YieldMisses, governor.GetStats().maxConsecutiveMisses);
+}
@@ -0,0 +1,262 @@
+#include "TestHarness.h"
+#include "RequestGovernor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Replays the FrameServer request pattern against RequestGovernor in virtual time and measures
+// what MediaStream::RequestSample would cost: CPU spent answering requests and the latency from
+// a frame being published to it being delivered. FrameServer re-requests as soon as a request
+// returns without a sample and again shortly after each sample it receives.
+namespace
+{
+	constexpr int64_t kOneUs = 10;
+	constexpr int64_t kOneMs = 10000;
+	constexpr int64_t kFrame = 333333; // 30 fps in 100ns units
+
+	// Costs of the request thread, in 100ns units. Only busy time counts as CPU.
+	struct RequestCosts
+	{
+		int64_t request = 2 * kOneUs;   // a RequestSample call that finds nothing
+		int64_t yield = 1 * kOneUs;     // std::this_thread::yield with nothing else runnable
+		int64_t timerSlack = 500 * kOneUs;
+		int64_t deliver = 300 * kOneUs; // allocate, copy and queue a sample
+		int64_t consume = 2 * kOneMs;   // FrameServer's processing before its next request
+	};
+
+	struct Producer
+	{
+		int64_t start = 10 * kOneMs;
+		int64_t jitter = 1 * kOneMs;
+		// Frames in [stallFrom, stallTo) are never published, as when the guest stalls.
+		int64_t stallFrom = 0;
+		int64_t stallTo = 0;
+	};
+
+	struct SimulationResult
+	{
+		uint64_t frames = 0;
+		uint64_t requests = 0;
+		uint64_t misses = 0;
+		int64_t busy = 0;
+		int64_t elapsed = 0;
+		int64_t maxLatency = 0;
+		int64_t totalLatency = 0;
+		std::vector<int64_t> latencies;
+
+		double CpuPercent() const { return 100.0 * static_cast<double>(busy) / static_cast<double>(elapsed); }
+		int64_t MeanLatency() const { return frames ? totalLatency / static_cast<int64_t>(frames) : 0; }
+
+		int64_t Percentile(double fraction) const
+		{
+			if (latencies.empty())
+				return 0;
+
+			auto sorted = latencies;
+			std::sort(sorted.begin(), sorted.end());
+			return sorted[static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1))];
+		}
+	};
+
+	class Simulation
+	{
+	public:
+		Simulation(const Producer& producer, const RequestCosts& costs) :
+			_costs(costs)
+		{
+			uint64_t random = 7;
+			for (int64_t nominal = producer.start; nominal < producer.start + 600 * kFrame; nominal += kFrame)
+			{
+				if (nominal >= producer.stallFrom && nominal < producer.stallTo)
+					continue;
+
+				random = random * 6364136223846793005ull + 1442695040888963407ull;
+				const auto offset = static_cast<int64_t>((random >> 33) % static_cast<uint64_t>(2 * producer.jitter + 1)) - producer.jitter;
+				_published.push_back(nominal + offset);
+			}
+		}
+
+		// governor == nullptr replays the original behaviour: yield and return on every miss.
+		SimulationResult Run(RequestGovernor* governor)
+		{
+			SimulationResult result;
+			int64_t now = 0;
+			size_t delivered = 0;
+			const auto end = _published.back() + kFrame;
+			if (governor)
+			{
+				governor->Reset(kFrame);
+			}
+
+			while (now < end && delivered < _published.size())
+			{
+				result.requests++;
+				Busy(result, now, _costs.request);
+
+				auto available = Latest(now) > delivered;
+				if (!available)
+				{
+					result.misses++;
+					available = governor ? Backoff(*governor, result, now, delivered) : YieldOnce(result, now, delivered);
+				}
+
+				if (!available)
+					continue;
+
+				// Latest-only handoff: frames published since the last request are skipped.
+				delivered = Latest(now);
+				const auto latency = now - _published[delivered - 1];
+				result.frames++;
+				result.latencies.push_back(latency);
+				result.totalLatency += latency;
+				result.maxLatency = (std::max)(result.maxLatency, latency);
+				Busy(result, now, _costs.deliver);
+				if (governor)
+				{
+					governor->OnFrameDelivered();
+				}
+				now += _costs.consume;
+			}
+
+			result.elapsed = now;
+			return result;
+		}
+
+	private:
+		// Number of frames published at or before time.
+		size_t Latest(int64_t time) const
+		{
+			return static_cast<size_t>(std::upper_bound(_published.begin(), _published.end(), time) - _published.begin());
+		}
+
+		int64_t NextPublish(size_t delivered) const
+		{
+			return delivered < _published.size() ? _published[delivered] : INT64_MAX;
+		}
+
+		static void Busy(SimulationResult& result, int64_t& now, int64_t duration)
+		{
+			result.busy += duration;
+			now += duration;
+		}
+
+		bool YieldOnce(SimulationResult& result, int64_t& now, size_t delivered)
+		{
+			Busy(result, now, _costs.yield);
+			return Latest(now) > delivered;
+		}
+
+		// Mirrors MediaStream::BackoffUntilNewFrame, with the expected arrival taken from the last
+		// published frame the way the stream derives it from the source's latest frame time.
+		bool Backoff(RequestGovernor& governor, SimulationResult& result, int64_t& now, size_t delivered)
+		{
+			const auto latest = Latest(now);
+			const auto expectedArrival = latest ? _published[latest - 1] + kFrame : 0;
+			uint32_t waitMs = 0;
+			switch (governor.OnMiss(now, expectedArrival, &waitMs))
+			{
+			case RequestBackoff::Spin:
+				return false;
+
+			case RequestBackoff::Yield:
+				Busy(result, now, _costs.yield);
+				break;
+
+			case RequestBackoff::Sleep:
+				now += waitMs * kOneMs + _costs.timerSlack;
+				break;
+
+			case RequestBackoff::Wait:
+				// The publish wakes the wait; otherwise it times out.
+				now = (std::min)(now + waitMs * kOneMs + _costs.timerSlack, (std::max)(now, NextPublish(delivered)));
+				break;
+			}
+			return Latest(now) > delivered;
+		}
+
+		RequestCosts _costs;
+		std::vector<int64_t> _published;
+	};
+
+	void Report(const char* name, const SimulationResult& result)
+	{
+		std::printf(
+			"  %-10s frames:%llu requests:%llu (%.1f/frame) cpu:%.3f%% latency mean:%.3fms p99:%.3fms max:%.3fms\n",
+			name,
+			static_cast<unsigned long long>(result.frames),
+			static_cast<unsigned long long>(result.requests),
+			static_cast<double>(result.requests) / static_cast<double>(result.frames ? result.frames : 1),
+			result.CpuPercent(),
+			static_cast<double>(result.MeanLatency()) / kOneMs,
+			static_cast<double>(result.Percentile(0.99)) / kOneMs,
+			static_cast<double>(result.maxLatency) / kOneMs);
+	}
+}
+
+TEST_CASE(GovernorCutsRequestStormCpuWithoutAddingLatency)
+{
+	Simulation simulation(Producer{}, RequestCosts{});
+	const auto baseline = simulation.Run(nullptr);
+	RequestGovernor governor;
+	const auto governed = simulation.Run(&governor);
+	Report("yield-only", baseline);
+	Report("governor", governed);
+
+	// Both deliver every frame; FrameServer never falls behind a 30 fps producer.
+	CHECK(baseline.frames >= 590);
+	CHECK(governed.frames >= 590);
+
+	// The original loop burns a core re-requesting; the governor parks after SleepMisses.
+	CHECK(baseline.CpuPercent() > 50.0);
+	CHECK(governed.CpuPercent() < 2.0);
+	CHECK(governed.requests * 100 < baseline.requests);
+	CHECK(governed.requests < governed.frames * (RequestGovernor::SleepMisses + 4));
+
+	// The wait is keyed to the expected arrival and woken by the publish, so delivery stays
+	// prompt: at worst a frame lands during a 1 ms sleep.
+	CHECK(governed.MeanLatency() < kOneMs / 2);
+	CHECK(governed.Percentile(0.99) <= kOneMs + RequestCosts{}.timerSlack);
+
+	const auto stats = governor.GetStats();
+	CHECK_EQ(governed.misses, stats.misses);
+	CHECK(stats.waits > 0);
+	CHECK(stats.maxConsecutiveMisses < RequestGovernor::SleepMisses + 4);
+}
+
+TEST_CASE(StalledProducerWaitsOneIntervalPerRequest)
+{
+	// The guest stops for two seconds; nothing is published in between.
+	Producer producer;
+	producer.stallFrom = producer.start + 100 * kFrame;
+	producer.stallTo = producer.stallFrom + 2 * 10000000;
+	Simulation simulation(producer, RequestCosts{});
+	RequestGovernor governor;
+	const auto governed = simulation.Run(&governor);
+	Report("stalled", governed);
+
+	// Two seconds of overdue frames cost about one request per frame interval, not a storm.
+	const auto stats = governor.GetStats();
+	CHECK(stats.maxConsecutiveMisses < RequestGovernor::SleepMisses + 2 * 10000000 / kFrame + 8);
+	CHECK(governed.CpuPercent() < 2.0);
+
+	// The first frame after the stall wakes the waiting request at once.
+	CHECK(governed.maxLatency <= kOneMs + RequestCosts{}.timerSlack);
+}
+
+TEST_CASE(SlowConsumerOnlyMissesBeforeTheFirstFrame)
+{
+	// FrameServer takes longer than a frame interval per sample: once frames flow, every request
+	// finds one and the governor is never consulted.
+	RequestCosts costs;
+	costs.consume = kFrame + 5 * kOneMs;
+	Simulation simulation(Producer{}, costs);
+	RequestGovernor governor;
+	const auto governed = simulation.Run(&governor);
+	Report("slow", governed);
+
+	const auto stats = governor.GetStats();
+	CHECK_EQ(governed.misses, stats.misses);
+	CHECK(stats.misses <= RequestGovernor::SleepMisses + 2);
+	CHECK_EQ(stats.misses, stats.maxConsecutiveMisses);
+}
@@ -0,0 +1,80 @@
+#include "TestHarness.h"
+#include "SampleDepth.h"
+#include "SamplePoolCore.h"
+
+namespace
+{
+	constexpr uint64_t kMB = 1024 * 1024;
+}
+
+TEST_CASE(BudgetIsCountedAtThePaddedFrameSize)
+{
+	// 4K NV12 padded to a 64-byte pitch: 3840 is already aligned, 12441600 bytes per frame.
+	SampleDepthController depth;
+	depth.Reset(Nv12BufferLayout::Aligned(3840, 2160, 64).PitchedLength(), 64 * kMB);
+	CHECK_EQ(5u, depth.GetMaxDepth());
+	CHECK_EQ(5u, depth.GetDepth());
+
+	// 720 wide pads to 768: 40 MB fits 72 padded frames (76 unpadded), both above MaxDepth.
+	depth.Reset(Nv12BufferLayout::Aligned(720, 480, 64).PitchedLength(), 40 * kMB);
+	CHECK_EQ(SampleDepthController::MaxDepth, depth.GetMaxDepth());
+	CHECK_EQ(SampleDepthController::InitialDepth, depth.GetDepth());
+
+	// Never below MinDepth, whatever the budget.
+	depth.Reset(Nv12BufferLayout::Aligned(3840, 2160, 64).PitchedLength(), 1 * kMB);
+	CHECK_EQ(SampleDepthController::MinDepth, depth.GetDepth());
+}
+
+TEST_CASE(GrowsWhenThePoolRunsDry)
+{
+	SampleDepthController depth;
+	depth.Reset(1, 1024);
+	CHECK_EQ(SampleDepthController::InitialDepth, depth.GetDepth());
+	CHECK_EQ(8u, depth.OnPoolEmpty(6));
+	CHECK_EQ(10u, depth.OnPoolEmpty(8));
+	while (depth.OnPoolEmpty(depth.GetDepth()))
+	{
+	}
+	CHECK_EQ(SampleDepthController::MaxDepth, depth.GetDepth());
+	CHECK_EQ(0u, depth.OnPoolEmpty(SampleDepthController::MaxDepth));
+	CHECK_EQ(SampleDepthController::MaxDepth, depth.GetHighWaterMark());
+}
+
+TEST_CASE(ShrinksAfterAQuietWindow)
+{
+	SampleDepthController depth;
+	depth.Reset(1, 1024);
+	depth.OnPoolEmpty(6);
+	depth.OnPoolEmpty(8);
+	CHECK_EQ(10u, depth.GetDepth());
+
+	// The window that saw the pool run dry at 8 outstanding keeps the depth.
+	uint32_t resized = 0;
+	for (uint32_t i = 0; i < SampleDepthController::ShrinkWindow; i++)
+	{
+		resized |= depth.OnDelivered(2);
+	}
+	CHECK_EQ(0u, resized);
+
+	// A full window at 2 outstanding shrinks to that plus headroom.
+	for (uint32_t i = 0; i < SampleDepthController::ShrinkWindow; i++)
+	{
+		resized |= depth.OnDelivered(2);
+	}
+	CHECK_EQ(4u, resized);
+	CHECK_EQ(4u, depth.GetDepth());
+	CHECK_EQ(8u, depth.GetHighWaterMark());
+}
+
+TEST_CASE(ProvidedAllocatorOnlyGrows)
+{
+	SampleDepthController depth;
+	depth.Reset(1, 1024);
+	depth.SetShrinkEnabled(false);
+	depth.OnPoolEmpty(6);
+	for (uint32_t i = 0; i < 3 * SampleDepthController::ShrinkWindow; i++)
+	{
+		CHECK_EQ(0u, depth.OnDelivered(1));
+	}
+	CHECK_EQ(8u, depth.GetDepth());
+}
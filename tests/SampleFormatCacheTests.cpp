@@ -0,0 +1,159 @@
+#include "TestHarness.h"
+#include "SampleFormatCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+namespace
+{
+	struct Format
+	{
+		SampleFormatStatus status = SampleFormatStatus::Ok;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	// Stands in for caps objects: the address is the key, the contents what parsing reads.
+	struct Caps
+	{
+		bool nv12 = true;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	struct Parser
+	{
+		int calls = 0;
+
+		std::shared_ptr<const Format> operator()(const void* key)
+		{
+			calls++;
+			const auto caps = static_cast<const Caps*>(key);
+			auto format = std::make_shared<Format>();
+			format->width = caps->width;
+			format->height = caps->height;
+			format->status = CheckNV12SampleFormat(caps->nv12, caps->width, caps->height);
+			return format;
+		}
+	};
+}
+
+TEST_CASE(ChecksNV12Dimensions)
+{
+	CHECK(CheckNV12SampleFormat(true, 1280, 720) == SampleFormatStatus::Ok);
+	CHECK(CheckNV12SampleFormat(false, 1280, 720) == SampleFormatStatus::NotNV12);
+	CHECK(CheckNV12SampleFormat(true, 0, 720) == SampleFormatStatus::BadSize);
+	CHECK(CheckNV12SampleFormat(true, 1280, 0) == SampleFormatStatus::BadSize);
+	CHECK(CheckNV12SampleFormat(true, 1279, 720) == SampleFormatStatus::BadSize);
+	CHECK(CheckNV12SampleFormat(true, 1280, 719) == SampleFormatStatus::BadSize);
+}
+
+TEST_CASE(SameCapsAreParsedOnce)
+{
+	Caps caps{ true, 1280, 720 };
+	SampleFormatCache<Format> cache;
+	Parser parser;
+	const auto first = cache.Get(&caps, std::ref(parser));
+	CHECK(first.parsed);
+	CHECK(!first.resized);
+	for (int i = 0; i < 10; i++)
+	{
+		const auto lookup = cache.Get(&caps, std::ref(parser));
+		CHECK(!lookup.parsed);
+		CHECK(lookup.format == first.format);
+	}
+	CHECK_EQ(1, parser.calls);
+	CHECK_EQ(10u, cache.GetHits());
+	CHECK_EQ(1u, cache.GetParses());
+}
+
+TEST_CASE(RenegotiationIsReportedOnlyBetweenValidSizes)
+{
+	Caps small{ true, 640, 360 };
+	Caps sameSize{ true, 640, 360 };
+	Caps large{ true, 1920, 1080 };
+	Caps odd{ true, 641, 360 };
+	SampleFormatCache<Format> cache;
+	Parser parser;
+	CHECK(!cache.Get(&small, std::ref(parser)).resized);
+
+	// New caps object with the same size: parsed, not a resize.
+	auto lookup = cache.Get(&sameSize, std::ref(parser));
+	CHECK(lookup.parsed);
+	CHECK(!lookup.resized);
+
+	lookup = cache.Get(&large, std::ref(parser));
+	CHECK(lookup.resized);
+	CHECK_EQ(640u, lookup.previousWidth);
+	CHECK_EQ(360u, lookup.previousHeight);
+	CHECK_EQ(1920u, lookup.format->width);
+
+	// A rejected format is no size change, and neither is recovering from it.
+	lookup = cache.Get(&odd, std::ref(parser));
+	CHECK(lookup.format->status == SampleFormatStatus::BadSize);
+	CHECK(!lookup.resized);
+	lookup = cache.Get(&small, std::ref(parser));
+	CHECK(lookup.parsed);
+	CHECK(!lookup.resized);
+	CHECK_EQ(5, parser.calls);
+}
+
+TEST_CASE(RejectedCapsAreNotReparsed)
+{
+	Caps wrong{ false, 1280, 720 };
+	SampleFormatCache<Format> cache;
+	Parser parser;
+	for (int i = 0; i < 5; i++)
+	{
+		CHECK(cache.Get(&wrong, std::ref(parser)).format->status == SampleFormatStatus::NotNV12);
+	}
+	CHECK_EQ(1, parser.calls);
+}
+
+TEST_CASE(ResetForgetsTheCachedCaps)
+{
+	Caps caps{ true, 1280, 720 };
+	Caps other{ true, 640, 480 };
+	SampleFormatCache<Format> cache;
+	Parser parser;
+	cache.Get(&caps, std::ref(parser));
+	cache.Reset();
+
+	// After a restart the same address may be a different caps object, and the first format of
+	// the new pipeline is no renegotiation.
+	CHECK(cache.Get(&caps, std::ref(parser)).parsed);
+	cache.Reset();
+	CHECK(!cache.Get(&other, std::ref(parser)).resized);
+	CHECK_EQ(3, parser.calls);
+}
+
+// Per-sample cost on the streaming thread with the cache against parsing every sample, which is
+// what the appsink callback did before. The parse here is only the allocation and validation;
+// gst_video_info_from_caps adds its structure walk on top.
+TEST_CASE(CachedLookupBenchmark)
+{
+	constexpr int samples = 1000000;
+	Caps caps{ true, 1920, 1080 };
+	SampleFormatCache<Format> cache;
+	Parser parser;
+	uint64_t checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < samples; i++)
+	{
+		checksum += cache.Get(&caps, std::ref(parser)).format->width;
+	}
+	const auto cachedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < samples; i++)
+	{
+		checksum += parser(&caps)->width;
+	}
+	const auto parsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples;
+
+	std::printf("  per sample: cached %.1f ns, parsed %.1f ns (checksum %llu)\n", cachedNs, parsedNs, static_cast<unsigned long long>(checksum));
+	CHECK_EQ(1u + samples, static_cast<uint64_t>(parser.calls));
+	CHECK_EQ(static_cast<uint64_t>(samples - 1), cache.GetHits());
+}
@@ -0,0 +1,99 @@
+#include "TestHarness.h"
+#include "SamplePoolCore.h"
+
+#include <vector>
+
+TEST_CASE(LayoutPadsPitchToAlignment)
+{
+	const auto layout = Nv12BufferLayout::Aligned(720, 480, 64);
+	CHECK_EQ(768u, layout.pitch);
+	CHECK_EQ(720u, layout.Rows());
+	CHECK_EQ(768u * 720u, layout.PitchedLength());
+	CHECK_EQ(720u * 720u, layout.ContiguousLength());
+	CHECK(!layout.IsContiguous());
+	CHECK(Nv12BufferLayout::Aligned(1280, 720, 64).IsContiguous());
+}
+
+TEST_CASE(PackedRowsStartAtMultiplesOfWidth)
+{
+	// The skew a 1D Lock showed at 720 or 800 wide: row r must start at r * width, not r * pitch.
+	const auto layout = Nv12BufferLayout::Aligned(800, 600, 64);
+	std::vector<uint8_t> pitched(layout.PitchedLength(), 0xEE);
+	for (uint32_t row = 0; row < layout.Rows(); row++)
+	{
+		for (uint32_t x = 0; x < layout.width; x++)
+		{
+			pitched[static_cast<size_t>(row) * layout.pitch + x] = static_cast<uint8_t>(row + x);
+		}
+	}
+
+	std::vector<uint8_t> packed(layout.ContiguousLength());
+	layout.Pack(pitched.data(), packed.data());
+	auto matches = true;
+	for (uint32_t row = 0; row < layout.Rows(); row++)
+	{
+		for (uint32_t x = 0; x < layout.width; x++)
+		{
+			matches = matches && packed[static_cast<size_t>(row) * layout.width + x] == static_cast<uint8_t>(row + x);
+		}
+	}
+	CHECK(matches);
+}
+
+TEST_CASE(UnpackRoundTripsAndKeepsPadding)
+{
+	const auto layout = Nv12BufferLayout::Aligned(720, 480, 64);
+	std::vector<uint8_t> packed(layout.ContiguousLength());
+	for (size_t i = 0; i < packed.size(); i++)
+	{
+		packed[i] = static_cast<uint8_t>(i * 7);
+	}
+
+	std::vector<uint8_t> pitched(layout.PitchedLength(), 0xEE);
+	layout.Unpack(packed.data(), pitched.data());
+	CHECK_EQ(0xEE, pitched[layout.width]);
+	CHECK_EQ(packed[layout.width], pitched[layout.pitch]);
+
+	std::vector<uint8_t> repacked(layout.ContiguousLength());
+	layout.Pack(pitched.data(), repacked.data());
+	CHECK(repacked == packed);
+}
+
+TEST_CASE(LedgerGrowsAndTrimsFreeSamplesOnly)
+{
+	SamplePoolLedger ledger;
+	ledger.Reset(0);
+	CHECK_EQ(4, ledger.Resize(4, 0));
+
+	// Three handed out, one free: shrinking to two can only trim the free one.
+	ledger.OnAcquired();
+	ledger.OnAcquired();
+	ledger.OnAcquired();
+	CHECK_EQ(-1, ledger.Resize(2, 1));
+	CHECK_EQ(2u, ledger.Target());
+
+	// Owning three against a target of two: the first return is dropped, the rest recycle.
+	CHECK(!ledger.OnReturned(ledger.Generation(), 0));
+	CHECK(ledger.OnReturned(ledger.Generation(), 0));
+	CHECK(ledger.OnReturned(ledger.Generation(), 1));
+	CHECK_EQ(0u, ledger.Outstanding());
+
+	CHECK_EQ(2, ledger.Resize(4, 2));
+}
+
+TEST_CASE(LedgerDropsSamplesFromAnOlderGeneration)
+{
+	SamplePoolLedger ledger;
+	ledger.Reset(3);
+	ledger.OnAcquired();
+	const auto stale = ledger.Generation();
+
+	ledger.Reset(3);
+	CHECK(stale != ledger.Generation());
+	CHECK(!ledger.OnReturned(stale, 0));
+	CHECK_EQ(0u, ledger.Outstanding());
+
+	ledger.Clear();
+	CHECK(!ledger.IsInitialized());
+	CHECK(!ledger.OnReturned(ledger.Generation(), 0));
+}
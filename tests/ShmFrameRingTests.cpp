@@ -0,0 +1,487 @@
+#include "TestHarness.h"
+#include "ShmFrameRing.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// A 64x32 ring of three slots, laid out the way a well-behaved producer writes it.
+	VCamShmRingHeader ValidHeader()
+	{
+		VCamShmRingHeader header{};
+		header.magic = VCAM_SHM_RING_MAGIC;
+		header.version = VCAM_SHM_RING_VERSION;
+		header.width = 64;
+		header.height = 32;
+		header.stride = 64;
+		header.slotCount = 3;
+		header.fpsNumerator = 30;
+		header.fpsDenominator = 1;
+		header.slotSize = sizeof(VCamShmSlotHeader) + 64 * 32 * 3 / 2;
+		header.dataOffset = sizeof(VCamShmRingHeader);
+		return header;
+	}
+
+	uint64_t ViewSize(const VCamShmRingHeader& header)
+	{
+		return header.dataOffset + header.slotSize * header.slotCount;
+	}
+
+	bool Accepts(const VCamShmRingHeader& header, uint64_t viewSize)
+	{
+		VCamShmRingGeometry geometry{};
+		return VCamShmRingReadGeometry(&header, viewSize, &geometry) != 0;
+	}
+}
+
+TEST_CASE(ValidRingIsCopiedOut)
+{
+	const auto header = ValidHeader();
+	VCamShmRingGeometry geometry{};
+	CHECK(VCamShmRingReadGeometry(&header, ViewSize(header), &geometry));
+	CHECK_EQ(64u, geometry.width);
+	CHECK_EQ(32u, geometry.height);
+	CHECK_EQ(64u, geometry.stride);
+	CHECK_EQ(3u, geometry.slotCount);
+	CHECK_EQ(30u, geometry.fpsNumerator);
+	CHECK_EQ(1u, geometry.fpsDenominator);
+	CHECK_EQ(header.slotSize, geometry.slotSize);
+	CHECK_EQ(header.dataOffset, geometry.dataOffset);
+
+	// Padded strides, slots and data offsets are all fine.
+	auto padded = ValidHeader();
+	padded.stride = 128;
+	padded.slotSize = 4 * 4096;
+	padded.dataOffset = 4096;
+	CHECK(Accepts(padded, ViewSize(padded)));
+}
+
+TEST_CASE(RejectsForeignOrTruncatedHeaders)
+{
+	auto header = ValidHeader();
+	CHECK(!Accepts(header, sizeof(VCamShmRingHeader) - 1));
+
+	header.magic = 0;
+	CHECK(!Accepts(header, ViewSize(header)));
+
+	header = ValidHeader();
+	header.version = VCAM_SHM_RING_VERSION + 1;
+	CHECK(!Accepts(header, ViewSize(header)));
+}
+
+TEST_CASE(RejectsBadFrameGeometry)
+{
+	const auto viewSize = ViewSize(ValidHeader());
+	auto header = ValidHeader();
+	header.width = 0;
+	CHECK(!Accepts(header, viewSize));
+
+	header = ValidHeader();
+	header.height = 0;
+	CHECK(!Accepts(header, viewSize));
+
+	// NV12 needs even dimensions for its 2x2 chroma.
+	header = ValidHeader();
+	header.width = 63;
+	CHECK(!Accepts(header, viewSize));
+
+	header = ValidHeader();
+	header.height = 31;
+	CHECK(!Accepts(header, viewSize));
+
+	header = ValidHeader();
+	header.stride = 62;
+	CHECK(!Accepts(header, viewSize));
+
+	header = ValidHeader();
+	header.slotCount = 0;
+	CHECK(!Accepts(header, viewSize));
+}
+
+TEST_CASE(RejectsSlotsThatDoNotFit)
+{
+	// A slot too small for its own header plus one frame.
+	auto header = ValidHeader();
+	header.slotSize--;
+	CHECK(!Accepts(header, ViewSize(ValidHeader())));
+
+	// Data overlapping the header, or starting past the view.
+	header = ValidHeader();
+	header.dataOffset = sizeof(VCamShmRingHeader) - 8;
+	CHECK(!Accepts(header, ViewSize(ValidHeader())));
+
+	header = ValidHeader();
+	header.dataOffset = ViewSize(header) + 1;
+	CHECK(!Accepts(header, ViewSize(ValidHeader())));
+
+	// The last slot one byte short of the view.
+	header = ValidHeader();
+	CHECK(!Accepts(header, ViewSize(header) - 1));
+
+	// More slots than the view holds.
+	header.slotCount++;
+	CHECK(!Accepts(header, ViewSize(ValidHeader())));
+}
+
+TEST_CASE(HostileSizesDoNotOverflow)
+{
+	// slotSize * slotCount wraps to a small number; the view is far too small for either.
+	auto header = ValidHeader();
+	header.slotSize = 1ull << 32;
+	header.slotCount = 1u << 31;
+	CHECK(!Accepts(header, 1 << 20));
+
+	header = ValidHeader();
+	header.slotSize = std::numeric_limits<uint64_t>::max();
+	CHECK(!Accepts(header, std::numeric_limits<uint64_t>::max()));
+
+	// stride * height * 3 wraps to 6 * 2^32 - 16 here, which a matching slotSize and view would
+	// otherwise satisfy while the Y plane alone is near 2^64 bytes.
+	header = ValidHeader();
+	header.width = 0xFFFFFFFEu;
+	header.stride = 0xFFFFFFFEu;
+	header.height = 1431655768u;
+	header.slotCount = 1;
+	header.slotSize = sizeof(VCamShmSlotHeader) + (6ull << 32) / 2;
+	CHECK(!Accepts(header, ViewSize(header)));
+}
+
+#ifndef _WIN32
+namespace
+{
+	// A POSIX shared-memory mapping, as a producer on the host creates it and a reader maps it.
+	class ShmMapping
+	{
+	public:
+		ShmMapping(const std::string& name, size_t size, bool producer) :
+			_size(size)
+		{
+			const auto fd = shm_open(name.c_str(), producer ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+			if (fd < 0)
+				return;
+
+			if (!producer || ftruncate(fd, static_cast<off_t>(size)) == 0)
+			{
+				const auto view = mmap(nullptr, size, producer ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+				_view = view != MAP_FAILED ? static_cast<uint8_t*>(view) : nullptr;
+			}
+			close(fd);
+		}
+
+		~ShmMapping()
+		{
+			if (_view)
+			{
+				munmap(_view, _size);
+			}
+		}
+
+		ShmMapping(const ShmMapping&) = delete;
+		ShmMapping& operator=(const ShmMapping&) = delete;
+
+		uint8_t* View() const { return _view; }
+
+	private:
+		uint8_t* _view = nullptr;
+		size_t _size;
+	};
+
+	// Writes frames with the seqlock protocol documented in ShmFrameRing.h. Every pixel of a frame
+	// is its frame number's low byte, so a copy mixing two frames is easy to spot.
+	class ShmProducer
+	{
+	public:
+		ShmProducer(const std::string& name, uint32_t width, uint32_t height, uint32_t slotCount) :
+			_name(name),
+			_frameBytes(static_cast<uint64_t>(width) * height * 3 / 2),
+			_slotSize(sizeof(VCamShmSlotHeader) + _frameBytes),
+			_viewSize(sizeof(VCamShmRingHeader) + _slotSize * slotCount),
+			_mapping(name, _viewSize, true)
+		{
+			if (!_mapping.View())
+				return;
+
+			auto header = Header();
+			header->width = width;
+			header->height = height;
+			header->stride = width;
+			header->slotCount = slotCount;
+			header->fpsNumerator = 30;
+			header->fpsDenominator = 1;
+			header->slotSize = _slotSize;
+			header->dataOffset = sizeof(VCamShmRingHeader);
+			header->latestFrame = 0;
+			header->version = VCAM_SHM_RING_VERSION;
+			std::atomic_thread_fence(std::memory_order_release);
+			header->magic = VCAM_SHM_RING_MAGIC;
+		}
+
+		~ShmProducer()
+		{
+			shm_unlink(_name.c_str());
+		}
+
+		bool IsMapped() const { return _mapping.View() != nullptr; }
+		uint64_t ViewSize() const { return _viewSize; }
+
+		void BeginWrite(uint64_t frame)
+		{
+			auto slot = Slot(frame);
+			slot->sequence = slot->sequence + 1;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		void Fill(uint64_t frame)
+		{
+			auto slot = Slot(frame);
+			std::memset(const_cast<VCamShmSlotHeader*>(slot) + 1, static_cast<int>(frame & 0xFF), _frameBytes);
+			slot->frameNumber = frame;
+			slot->timestampNs = frame * 33333333;
+		}
+
+		void EndWrite(uint64_t frame)
+		{
+			auto slot = Slot(frame);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot->sequence = slot->sequence + 1;
+		}
+
+		void Publish(uint64_t frame)
+		{
+			std::atomic_thread_fence(std::memory_order_release);
+			Header()->latestFrame = frame;
+		}
+
+		void Write(uint64_t frame)
+		{
+			BeginWrite(frame);
+			Fill(frame);
+			EndWrite(frame);
+			Publish(frame);
+		}
+
+	private:
+		VCamShmRingHeader* Header() const { return reinterpret_cast<VCamShmRingHeader*>(_mapping.View()); }
+
+		volatile VCamShmSlotHeader* Slot(uint64_t frame) const
+		{
+			const auto header = Header();
+			return reinterpret_cast<volatile VCamShmSlotHeader*>(_mapping.View() + header->dataOffset + (frame % header->slotCount) * header->slotSize);
+		}
+
+		std::string _name;
+		uint64_t _frameBytes;
+		uint64_t _slotSize;
+		uint64_t _viewSize;
+		ShmMapping _mapping;
+	};
+
+	// The reader side: its own read-only mapping and the geometry validated once, like
+	// ShmFrameSource.
+	struct ShmReader
+	{
+		ShmReader(const std::string& name, uint64_t viewSize) :
+			mapping(name, viewSize, false)
+		{
+			valid = mapping.View() && VCamShmRingReadGeometry(reinterpret_cast<const VCamShmRingHeader*>(mapping.View()), viewSize, &geometry);
+			frame.resize(static_cast<size_t>(geometry.stride) * geometry.height * 3 / 2);
+		}
+
+		uint64_t Read(int maxAttempts, uint32_t* tornCopies)
+		{
+			copies = 0;
+			return VCamShmRingReadLatest(
+				mapping.View(),
+				&geometry,
+				maxAttempts,
+				[](void* context, const uint8_t* y, const uint8_t* uv, const VCamShmRingGeometry* ring)
+				{
+					auto reader = static_cast<ShmReader*>(context);
+					const auto lumaBytes = static_cast<size_t>(ring->stride) * ring->height;
+					std::memcpy(reader->frame.data(), y, lumaBytes);
+					std::memcpy(reader->frame.data() + lumaBytes, uv, lumaBytes / 2);
+					reader->copies++;
+					if (reader->onCopy)
+					{
+						reader->onCopy();
+					}
+				},
+				this,
+				tornCopies);
+		}
+
+		// Whether every copied byte belongs to the given frame.
+		bool Holds(uint64_t frameNumber) const
+		{
+			for (const auto value : frame)
+			{
+				if (value != (frameNumber & 0xFF))
+					return false;
+			}
+			return true;
+		}
+
+		ShmMapping mapping;
+		VCamShmRingGeometry geometry{};
+		bool valid = false;
+		std::vector<uint8_t> frame;
+		int copies = 0;
+		// Runs inside the copy, where a producer lapping the reader is detected.
+		std::function<void()> onCopy;
+	};
+
+	std::string ShmName(const char* test)
+	{
+		return "/vcam-test-" + std::to_string(getpid()) + "-" + test;
+	}
+}
+
+TEST_CASE(EmptyRingHasNoFrame)
+{
+	const auto name = ShmName("empty");
+	ShmProducer producer(name, 64, 32, 2);
+	CHECK(producer.IsMapped());
+	ShmReader reader(name, producer.ViewSize());
+	CHECK(reader.valid);
+
+	uint32_t torn = 0;
+	CHECK_EQ(0u, reader.Read(3, &torn));
+	CHECK_EQ(0, reader.copies);
+	CHECK_EQ(0u, torn);
+}
+
+TEST_CASE(SlotBeingRewrittenIsNotCopied)
+{
+	const auto name = ShmName("rewrite");
+	ShmProducer producer(name, 64, 32, 2);
+	ShmReader reader(name, producer.ViewSize());
+	CHECK(reader.valid);
+	producer.Write(1);
+	uint32_t torn = 0;
+	CHECK_EQ(1u, reader.Read(3, &torn));
+	CHECK(reader.Holds(1));
+
+	// Frame 3 goes into the slot of the still-latest frame 1: odd sequence, nothing is copied.
+	producer.BeginWrite(3);
+	producer.Fill(3);
+	CHECK_EQ(0u, reader.Read(3, &torn));
+	CHECK_EQ(0, reader.copies);
+
+	// Complete but not yet published: the slot no longer holds the latest frame.
+	producer.EndWrite(3);
+	CHECK_EQ(0u, reader.Read(3, &torn));
+	CHECK_EQ(0, reader.copies);
+	CHECK_EQ(0u, torn);
+
+	producer.Publish(3);
+	CHECK_EQ(3u, reader.Read(3, &torn));
+	CHECK(reader.Holds(3));
+}
+
+TEST_CASE(TornCopyIsDiscardedAndRetried)
+{
+	const auto name = ShmName("torn");
+	ShmProducer producer(name, 64, 32, 2);
+	ShmReader reader(name, producer.ViewSize());
+	CHECK(reader.valid);
+	producer.Write(1);
+	producer.Write(2);
+
+	// While the reader copies frame 2 the producer writes 3 and 4; 4 reuses frame 2's slot.
+	auto lapped = false;
+	reader.onCopy = [&]
+	{
+		if (!lapped)
+		{
+			lapped = true;
+			producer.Write(3);
+			producer.Write(4);
+		}
+	};
+	uint32_t torn = 0;
+	CHECK_EQ(4u, reader.Read(3, &torn));
+	CHECK_EQ(1u, torn);
+	CHECK_EQ(2, reader.copies);
+	CHECK(reader.Holds(4));
+
+	// Lapped on every attempt: nothing is returned and every copy counts as torn.
+	torn = 0;
+	uint64_t next = 5;
+	reader.onCopy = [&]
+	{
+		producer.Write(next++);
+		producer.Write(next++);
+	};
+	CHECK_EQ(0u, reader.Read(3, &torn));
+	CHECK_EQ(3u, torn);
+}
+
+TEST_CASE(ConcurrentProducerNeverDeliversATornFrame)
+{
+	const auto name = ShmName("concurrent");
+	ShmProducer producer(name, 320, 240, 3);
+	ShmReader reader(name, producer.ViewSize());
+	CHECK(reader.valid);
+
+	std::atomic<bool> done = false;
+	std::thread writer([&]
+	{
+		for (uint64_t frame = 1; !done.load(); frame++)
+		{
+			producer.Write(frame);
+		}
+	});
+
+	// Reads start once the producer is running, so every miss below is contention.
+	while (!reinterpret_cast<const VCamShmRingHeader*>(reader.mapping.View())->latestFrame)
+	{
+		std::this_thread::yield();
+	}
+
+	uint32_t torn = 0;
+	uint64_t delivered = 0;
+	uint64_t missed = 0;
+	uint64_t previous = 0;
+	uint64_t mixed = 0;
+	uint64_t backwards = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		const auto frame = reader.Read(3, &torn);
+		if (!frame)
+		{
+			missed++;
+			continue;
+		}
+
+		delivered++;
+		mixed += reader.Holds(frame) ? 0 : 1;
+		backwards += frame < previous ? 1 : 0;
+		previous = frame;
+	}
+	done.store(true);
+	writer.join();
+
+	std::printf(
+		"  delivered:%llu missed:%llu torn copies:%u last frame:%llu\n",
+		static_cast<unsigned long long>(delivered),
+		static_cast<unsigned long long>(missed),
+		torn,
+		static_cast<unsigned long long>(previous));
+	CHECK(delivered > 0);
+	CHECK_EQ(0u, mixed);
+	CHECK_EQ(0u, backwards);
+}
+#endif
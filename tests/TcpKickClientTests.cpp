@@ -0,0 +1,611 @@
+#include "TestHarness.h"
+#include "TcpKickClient.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	const TcpKickCameraFormat k720p{ 1280, 720, 30, 1 };
+	const TcpKickCameraFormat k1080p{ 1920, 1080, 60000, 1001 };
+
+	sockaddr_in Loopback(uint16_t port)
+	{
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		return address;
+	}
+
+	// Polls fd for events until timeoutMs passes; returns the revents (0 on timeout).
+	short PollFor(int fd, short events, int timeoutMs)
+	{
+		pollfd entry{ fd, events, 0 };
+		return ::poll(&entry, 1, timeoutMs) > 0 ? entry.revents : 0;
+	}
+
+	// The host side: a loopback listener that can stop listening (connections get refused), come
+	// back on the same port and drop the connection it accepted. A non-zero receiveBufferBytes
+	// shrinks the window of accepted connections, for a sink that falls behind.
+	class Listener
+	{
+	public:
+		explicit Listener(int receiveBufferBytes = 0) :
+			_receiveBufferBytes(receiveBufferBytes)
+		{
+			Listen(0);
+			sockaddr_in address{};
+			socklen_t size = sizeof(address);
+			::getsockname(_fd, reinterpret_cast<sockaddr*>(&address), &size);
+			_port = ntohs(address.sin_port);
+		}
+
+		~Listener()
+		{
+			Drop();
+			StopListening();
+		}
+
+		uint16_t Port() const { return _port; }
+
+		void StopListening()
+		{
+			if (_fd >= 0)
+			{
+				::close(_fd);
+				_fd = -1;
+			}
+		}
+
+		void Resume()
+		{
+			Listen(_port);
+		}
+
+		// Accepts the next connection, dropping the previous one.
+		bool Accept(int timeoutMs)
+		{
+			Drop();
+			if (!(PollFor(_fd, POLLIN, timeoutMs) & POLLIN))
+				return false;
+
+			_connection = ::accept(_fd, nullptr, nullptr);
+			_received.clear();
+			return _connection >= 0;
+		}
+
+		// Closes the accepted connection; the client sees its connection drop.
+		void Drop()
+		{
+			if (_connection >= 0)
+			{
+				::close(_connection);
+				_connection = -1;
+			}
+		}
+
+		// Reads until done(bytes received on this connection) holds or timeoutMs passes.
+		template <typename Done>
+		bool ReadUntil(Done&& done, int timeoutMs)
+		{
+			const auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+			while (!done(static_cast<const std::string&>(_received)))
+			{
+				if (Clock::now() >= deadline)
+					return false;
+
+				if (!(PollFor(_connection, POLLIN, 20) & (POLLIN | POLLHUP)))
+					continue;
+
+				char buffer[4096];
+				const auto result = ::recv(_connection, buffer, sizeof(buffer), 0);
+				if (result <= 0)
+					return false;
+				_received.append(buffer, static_cast<size_t>(result));
+			}
+			return true;
+		}
+
+		// Reads until the stream holds at least frameCount frames or timeoutMs passes.
+		std::string ReadFrames(size_t frameCount, int timeoutMs)
+		{
+			ReadUntil([frameCount](const std::string& bytes) { return CountFrames(bytes) >= frameCount; }, timeoutMs);
+			return Describe(_received);
+		}
+
+		// Drops what was read so far; ReadUntil starts over.
+		void ClearReceived()
+		{
+			_received.clear();
+		}
+
+		static size_t CountFrames(const std::string& bytes)
+		{
+			size_t count = 0;
+			size_t offset = 0;
+			while (offset + sizeof(VCamKickFrameHeader) <= bytes.size())
+			{
+				VCamKickFrameHeader header{};
+				memcpy(&header, bytes.data() + offset, sizeof(header));
+				if (offset + sizeof(header) + header.size > bytes.size())
+					break;
+				offset += sizeof(header) + header.size;
+				count++;
+			}
+			return count;
+		}
+
+		// One line per control frame, e.g. "HELLO" or "START 0 1280x720"; the process id and frame
+		// rates are covered by TcpKickSessionTests.
+		static std::string Describe(const std::string& bytes)
+		{
+			std::string text;
+			size_t offset = 0;
+			while (offset + sizeof(VCamKickFrameHeader) <= bytes.size())
+			{
+				VCamKickFrameHeader header{};
+				memcpy(&header, bytes.data() + offset, sizeof(header));
+				if (header.magic != VCAM_KICK_MAGIC || offset + sizeof(header) + header.size > bytes.size())
+					break;
+
+				const auto payload = bytes.data() + offset + sizeof(header);
+				offset += sizeof(header) + header.size;
+				if (header.type == VCAM_KICK_HELLO)
+				{
+					text += "HELLO\n";
+					continue;
+				}
+
+				const char* name = header.type == VCAM_KICK_PREWARM ? "PREWARM" : header.type == VCAM_KICK_START ? "START" : header.type == VCAM_KICK_STOP ? "STOP" : nullptr;
+				if (!name || header.size != sizeof(VCamKickCameraPayload))
+				{
+					text += "<type " + std::to_string(header.type) + ">\n";
+					continue;
+				}
+
+				VCamKickCameraPayload camera{};
+				memcpy(&camera, payload, sizeof(camera));
+				text += std::string(name) + " " + std::to_string(camera.camera) + " " + std::to_string(camera.width) + "x" + std::to_string(camera.height) + "\n";
+			}
+			return text;
+		}
+
+	private:
+		void Listen(uint16_t port)
+		{
+			_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+			const int reuse = 1;
+			::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+			if (_receiveBufferBytes)
+			{
+				::setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &_receiveBufferBytes, sizeof(_receiveBufferBytes));
+			}
+			const auto address = Loopback(port);
+			::bind(_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+			::listen(_fd, 4);
+		}
+
+		const int _receiveBufferBytes;
+		int _fd = -1;
+		int _connection = -1;
+		uint16_t _port = 0;
+		std::string _received;
+	};
+
+	// TcpKickClient's Transport over non-blocking POSIX sockets, mirroring WinsockKickTransport:
+	// Wait polls the socket and a wake pipe the way the Windows one waits on its two events.
+	class LoopbackTransport
+	{
+	public:
+		explicit LoopbackTransport(uint16_t port) :
+			_port(port)
+		{
+			if (::pipe(_wake) == 0)
+			{
+				::fcntl(_wake[0], F_SETFL, O_NONBLOCK);
+				::fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+			}
+		}
+
+		~LoopbackTransport()
+		{
+			Join();
+			::close(_wake[0]);
+			::close(_wake[1]);
+		}
+
+		void Attach(TcpKickClient<LoopbackTransport>* client)
+		{
+			_client = client;
+		}
+
+		// Joins the session thread and queued starts; call after TcpKickClient::Shutdown.
+		void Join()
+		{
+			std::vector<std::thread> threads;
+			{
+				std::lock_guard<std::mutex> lock(_threadsLock);
+				threads.swap(_threads);
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		int64_t StartSessionThread()
+		{
+			std::lock_guard<std::mutex> lock(_threadsLock);
+			_threads.emplace_back([this] { _client->Run(); });
+			return 0;
+		}
+
+		bool QueueSessionStart()
+		{
+			std::lock_guard<std::mutex> lock(_threadsLock);
+			_threads.emplace_back([this] { _client->StartQueuedSession(); });
+			return true;
+		}
+
+		int64_t Connect()
+		{
+			_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+			if (_socket < 0)
+				return -errno;
+
+			::fcntl(_socket, F_SETFL, O_NONBLOCK);
+			if (sendBufferBytes)
+			{
+				::setsockopt(_socket, SOL_SOCKET, SO_SNDBUF, &sendBufferBytes, sizeof(sendBufferBytes));
+			}
+			const auto address = Loopback(_port);
+			auto error = 0;
+			if (::connect(_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+			{
+				error = errno;
+				if (error == EINPROGRESS)
+				{
+					error = ETIMEDOUT;
+					if (PollFor(_socket, POLLOUT, 1000))
+					{
+						socklen_t size = sizeof(error);
+						::getsockopt(_socket, SOL_SOCKET, SO_ERROR, &error, &size);
+					}
+				}
+			}
+
+			if (error)
+			{
+				Close();
+				return -error;
+			}
+			return 0;
+		}
+
+		int64_t Send(const char* data, size_t size)
+		{
+			const auto result = ::send(_socket, data, size, MSG_NOSIGNAL);
+			if (result >= 0)
+				return result;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return -errno;
+			blockedSends++;
+			return 0;
+		}
+
+		bool Wait(bool writeBlocked, uint64_t timeoutMs)
+		{
+			pollfd entries[] = { { _socket, static_cast<short>(POLLIN | (writeBlocked ? POLLOUT : 0)), 0 }, { _wake[0], POLLIN, 0 } };
+			const auto timeout = timeoutMs == UINT64_MAX ? -1 : static_cast<int>(timeoutMs < 60000 ? timeoutMs : 60000);
+			if (::poll(entries, 2, timeout) <= 0)
+				return true;
+
+			if (entries[1].revents & POLLIN)
+			{
+				char drain[64];
+				while (::read(_wake[0], drain, sizeof(drain)) > 0)
+				{
+				}
+			}
+
+			if (entries[0].revents & (POLLERR | POLLHUP))
+				return false;
+
+			if (entries[0].revents & POLLIN)
+			{
+				// The host never sends; readable means it closed or reset the connection.
+				char byte;
+				const auto result = ::recv(_socket, &byte, 1, MSG_DONTWAIT);
+				if (result == 0 || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+					return false;
+			}
+			return true;
+		}
+
+		void Wake()
+		{
+			const char byte = 1;
+			(void)!::write(_wake[1], &byte, 1);
+		}
+
+		void Close()
+		{
+			if (_socket >= 0)
+			{
+				::close(_socket);
+				_socket = -1;
+			}
+		}
+
+		std::string Stats()
+		{
+			return {};
+		}
+
+		void OnSent(size_t bytes)
+		{
+			sentBytes += bytes;
+		}
+
+		void OnConnected()
+		{
+			connects++;
+		}
+
+		void OnDisconnected(uint64_t)
+		{
+			disconnects++;
+		}
+
+		void OnConnectFailed(int64_t error, uint64_t)
+		{
+			connectFailures++;
+			lastError = error;
+		}
+
+		// Set before the session connects; 0 keeps the system default.
+		int sendBufferBytes = 0;
+		std::atomic<uint64_t> sentBytes = 0;
+		std::atomic<uint64_t> blockedSends = 0;
+		std::atomic<uint32_t> connects = 0;
+		std::atomic<uint32_t> disconnects = 0;
+		std::atomic<uint32_t> connectFailures = 0;
+		std::atomic<int64_t> lastError = 0;
+
+	private:
+		const uint16_t _port;
+		TcpKickClient<LoopbackTransport>* _client = nullptr;
+		int _socket = -1;
+		int _wake[2] = { -1, -1 };
+		std::mutex _threadsLock;
+		std::vector<std::thread> _threads;
+	};
+
+	// A client wired to its transport; shuts the session down and joins its threads on exit.
+	struct KickHarness
+	{
+		explicit KickHarness(uint16_t port, size_t logQueueBytes = 64 * 1024) :
+			transport(port),
+			client(transport, logQueueBytes, 1234)
+		{
+			transport.Attach(&client);
+		}
+
+		~KickHarness()
+		{
+			client.Shutdown();
+			transport.Join();
+		}
+
+		template <typename Predicate>
+		static bool WaitFor(Predicate&& predicate, int timeoutMs)
+		{
+			const auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+			while (!predicate())
+			{
+				if (Clock::now() >= deadline)
+					return false;
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+			return true;
+		}
+
+		LoopbackTransport transport;
+		TcpKickClient<LoopbackTransport> client;
+	};
+}
+
+TEST_CASE(RefusedConnectionFailsTheStart)
+{
+	Listener listener;
+	listener.StopListening();
+	KickHarness harness(listener.Port());
+
+	const auto result = harness.client.StartStream(0, 2000);
+	CHECK(result.status == TcpKickStartStatus::Failed);
+	CHECK_EQ(-ECONNREFUSED, result.error);
+	CHECK(harness.client.IsSessionRunning());
+	CHECK(!harness.client.IsConnected());
+	CHECK_EQ(TcpKickLogStatus::NotConnected, harness.client.ForwardLog("x\r\n", 3, nullptr));
+	CHECK(KickHarness::WaitFor([&] { return harness.transport.connectFailures == 1; }, 1000));
+}
+
+// The first attempt is refused and the session backs off; a host that starts listening later is
+// picked up by the next stream start, which cuts the backoff short instead of waiting it out.
+TEST_CASE(LateListenerIsPickedUpByTheNextStart)
+{
+	Listener listener;
+	listener.StopListening();
+	KickHarness harness(listener.Port());
+	harness.client.OnActivated(1, k1080p);
+	CHECK(harness.client.StartStream(0, 2000).status == TcpKickStartStatus::Failed);
+
+	listener.Resume();
+	harness.client.OnActivated(0, k720p);
+	const auto start = Clock::now();
+	const auto result = harness.client.StartStream(0, 2000);
+	const auto waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+	CHECK(result.status == TcpKickStartStatus::Connected);
+	CHECK(waitedMs < static_cast<long long>(TcpKickReconnectPolicy::InitialDelayMs));
+
+	CHECK(listener.Accept(1000));
+	CHECK(listener.ReadFrames(3, 1000) == "HELLO\nSTART 0 1280x720\nPREWARM 1 1920x1080\n");
+	CHECK_EQ(1u, harness.transport.connects.load());
+}
+
+// With waitMs 0 a start does not wait for the host; its START goes out once the session connects.
+TEST_CASE(OptimisticStartIsSentOnceConnected)
+{
+	Listener listener;
+	KickHarness harness(listener.Port());
+	CHECK(harness.client.StartStream(0, 0).status == TcpKickStartStatus::Pending);
+	CHECK(listener.Accept(2000));
+	CHECK(listener.ReadFrames(2, 1000) == "HELLO\nSTART 0 0x0\n");
+}
+
+// The host drops the connection: the session notices, reconnects after the backoff and brings the
+// new connection up to date with every camera that is still activated or streaming.
+TEST_CASE(DroppedConnectionIsResynchronized)
+{
+	Listener listener;
+	KickHarness harness(listener.Port());
+	harness.client.OnActivated(0, k720p);
+	harness.client.OnActivated(1, k1080p);
+	CHECK(harness.client.StartStream(0, 2000).status == TcpKickStartStatus::Connected);
+	CHECK(listener.Accept(1000));
+	CHECK(listener.ReadFrames(3, 1000) == "HELLO\nSTART 0 1280x720\nPREWARM 1 1920x1080\n");
+
+	listener.Drop();
+	CHECK(KickHarness::WaitFor([&] { return harness.transport.disconnects == 1; }, 2000));
+	CHECK(!harness.client.IsConnected());
+	CHECK_EQ(TcpKickLogStatus::NotConnected, harness.client.ForwardLog("x\r\n", 3, nullptr));
+	harness.client.OnReleased(1);
+
+	CHECK(listener.Accept(static_cast<int>(TcpKickReconnectPolicy::InitialDelayMs) + 2000));
+	CHECK(listener.ReadFrames(2, 1000) == "HELLO\nSTART 0 1280x720\n");
+	CHECK(harness.client.IsConnected());
+	CHECK_EQ(2u, harness.transport.connects.load());
+}
+
+// The host stops reading and the socket buffers fill up: the session thread waits for the
+// connection to drain while the producers (the stream and trace threads) keep queueing. Their
+// calls return at once; whatever does not fit in the log queue is dropped and counted, and the
+// count reaches the host ahead of the logs that follow once it catches up.
+TEST_CASE(SlowSinkNeverBlocksTheProducersAndCountsTheDrops)
+{
+	constexpr size_t kLogQueueBytes = 16 * 1024;
+	constexpr int kBatches = 4000;
+	Listener listener(4096);
+	KickHarness harness(listener.Port(), kLogQueueBytes);
+	harness.transport.sendBufferBytes = 4096;
+	CHECK(harness.client.StartStream(0, 2000).status == TcpKickStartStatus::Connected);
+	CHECK(listener.Accept(1000));
+	CHECK(listener.ReadFrames(2, 1000) == "HELLO\nSTART 0 0x0\n");
+	listener.ClearReceived();
+
+	// Nothing is read from here on. Trickle logs in until the session thread's send would block.
+	const std::string batch(256, 'x');
+	uint64_t forwarded = 0;
+	uint64_t queued = 0;
+	uint64_t dropped = 0;
+	const auto forward = [&]
+	{
+		const auto status = harness.client.ForwardLog(batch.data(), batch.size(), nullptr);
+		CHECK(status != TcpKickLogStatus::NotConnected);
+		(status == TcpKickLogStatus::Queued ? queued : dropped)++;
+		forwarded++;
+	};
+	CHECK(KickHarness::WaitFor(
+		[&]
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				forward();
+			}
+			return harness.transport.blockedSends > 0;
+		},
+		5000));
+
+	// With the session thread stuck on the connection, a producer that had to wait for the sink
+	// would never finish.
+	double slowestMs = 0;
+	const auto start = Clock::now();
+	for (int i = 0; i < kBatches; i++)
+	{
+		const auto callStart = Clock::now();
+		forward();
+		slowestMs = std::max(slowestMs, std::chrono::duration<double, std::milli>(Clock::now() - callStart).count());
+	}
+	const auto totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	std::printf("  %d log batches into a stalled sink: %.3f ms total, slowest call %.3f ms, %llu dropped\n", kBatches, totalMs, slowestMs, static_cast<unsigned long long>(dropped));
+
+	CHECK(dropped > 0);
+	CHECK(slowestMs < 100);
+	CHECK(harness.client.DroppedLogBatches() > 0);
+
+	// The sink catches up: every queued batch arrives intact and the notices add up to the drops.
+	uint64_t delivered = 0;
+	uint64_t reported = 0;
+	auto corrupt = false;
+	const auto caughtUp = listener.ReadUntil(
+		[&](const std::string& bytes)
+		{
+			delivered = reported = 0;
+			size_t offset = 0;
+			while (offset + sizeof(VCamKickFrameHeader) <= bytes.size())
+			{
+				VCamKickFrameHeader header{};
+				memcpy(&header, bytes.data() + offset, sizeof(header));
+				if (offset + sizeof(header) + header.size > bytes.size())
+					break;
+
+				const auto payload = bytes.substr(offset + sizeof(header), header.size);
+				offset += sizeof(header) + header.size;
+				if (header.type != VCAM_KICK_LOG)
+					continue;
+
+				const std::string notice = "[kick] log queue full, dropped ";
+				if (payload.rfind(notice, 0) == 0)
+				{
+					reported += std::stoull(payload.substr(notice.size()));
+				}
+				else if (payload == batch)
+				{
+					delivered++;
+				}
+				else
+				{
+					corrupt = true;
+				}
+			}
+			return delivered + reported >= forwarded;
+		},
+		10000);
+	CHECK(caughtUp);
+	CHECK(!corrupt);
+	CHECK_EQ(queued, delivered);
+	CHECK_EQ(dropped, reported);
+	CHECK_EQ(0u, harness.client.DroppedLogBatches());
+	CHECK(harness.client.IsConnected());
+}
+#endif
@@ -0,0 +1,268 @@
+#include "TestHarness.h"
+#include "TcpKickSession.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	struct Frame
+	{
+		uint8_t type = 0;
+		std::string payload;
+	};
+
+	// Splits a byte stream the way tools/kick_host.py does; a bad header ends the parse.
+	std::vector<Frame> ParseFrames(const std::string& bytes, bool* outValid = nullptr)
+	{
+		std::vector<Frame> frames;
+		size_t offset = 0;
+		auto valid = true;
+		while (offset + sizeof(VCamKickFrameHeader) <= bytes.size())
+		{
+			VCamKickFrameHeader header{};
+			memcpy(&header, bytes.data() + offset, sizeof(header));
+			if (header.magic != VCAM_KICK_MAGIC || header.version != VCAM_KICK_VERSION || offset + sizeof(header) + header.size > bytes.size())
+			{
+				valid = false;
+				break;
+			}
+
+			Frame frame;
+			frame.type = header.type;
+			frame.payload = bytes.substr(offset + sizeof(header), header.size);
+			frames.push_back(frame);
+			offset += sizeof(header) + header.size;
+		}
+
+		if (outValid)
+		{
+			*outValid = valid && offset == bytes.size();
+		}
+		return frames;
+	}
+
+	// One line per frame, e.g. "HELLO 1234" or "START 0 1280x720@30/1", for comparing sequences.
+	std::string Describe(const std::string& bytes)
+	{
+		bool valid = false;
+		const auto frames = ParseFrames(bytes, &valid);
+		std::string text = valid ? "" : "<invalid>\n";
+		for (const auto& frame : frames)
+		{
+			if (frame.type == VCAM_KICK_HELLO && frame.payload.size() == sizeof(VCamKickHelloPayload))
+			{
+				VCamKickHelloPayload hello{};
+				memcpy(&hello, frame.payload.data(), sizeof(hello));
+				text += "HELLO " + std::to_string(hello.processId) + "\n";
+				continue;
+			}
+
+			const char* name = frame.type == VCAM_KICK_PREWARM ? "PREWARM" : frame.type == VCAM_KICK_START ? "START" : frame.type == VCAM_KICK_STOP ? "STOP" : nullptr;
+			if (!name || frame.payload.size() != sizeof(VCamKickCameraPayload))
+			{
+				text += "<type " + std::to_string(frame.type) + " size " + std::to_string(frame.payload.size()) + ">\n";
+				continue;
+			}
+
+			VCamKickCameraPayload camera{};
+			memcpy(&camera, frame.payload.data(), sizeof(camera));
+			text += std::string(name) + " " + std::to_string(camera.camera) + " " + std::to_string(camera.width) + "x" + std::to_string(camera.height) + "@" +
+				std::to_string(camera.fpsNumerator) + "/" + std::to_string(camera.fpsDenominator) + "\n";
+		}
+		return text;
+	}
+
+	const TcpKickCameraFormat k720p{ 1280, 720, 30, 1 };
+	const TcpKickCameraFormat k1080p{ 1920, 1080, 60000, 1001 };
+}
+
+TEST_CASE(FramesAreLittleEndianWithAFixedHeader)
+{
+	std::string bytes;
+	TcpKickSession session;
+	session.OnConnected(0x01020304, bytes);
+	CHECK_EQ(sizeof(VCamKickFrameHeader) + sizeof(VCamKickHelloPayload), bytes.size());
+	const uint8_t expected[] = { 0x56, 0x4B, VCAM_KICK_VERSION, VCAM_KICK_HELLO, 4, 0, 0, 0, 0x04, 0x03, 0x02, 0x01 };
+	CHECK(memcmp(bytes.data(), expected, sizeof(expected)) == 0);
+
+	bytes.clear();
+	session.OnActivated(1, k720p, bytes);
+	CHECK_EQ(sizeof(VCamKickFrameHeader) + 5 * sizeof(uint32_t), bytes.size());
+}
+
+TEST_CASE(CameraLifecycleSequence)
+{
+	TcpKickSession session;
+	std::string bytes;
+	session.OnConnected(42, bytes);
+	CHECK(Describe(bytes) == "HELLO 42\n");
+
+	bytes.clear();
+	session.OnActivated(0, k720p, bytes);
+	CHECK(Describe(bytes) == "PREWARM 0 1280x720@30/1\n");
+
+	// Only the first stream starts the camera and only the last one stops it.
+	bytes.clear();
+	session.OnStreamStarted(0, bytes);
+	CHECK(Describe(bytes) == "START 0 1280x720@30/1\n");
+	bytes.clear();
+	session.OnStreamStarted(0, bytes);
+	session.OnStreamStopped(0, bytes);
+	CHECK(bytes.empty());
+
+	// The camera stays activated, so STOP is followed by PREWARM.
+	session.OnStreamStopped(0, bytes);
+	CHECK(Describe(bytes) == "STOP 0 1280x720@30/1\nPREWARM 0 1280x720@30/1\n");
+
+	bytes.clear();
+	session.OnReleased(0, bytes);
+	CHECK(Describe(bytes) == "STOP 0 1280x720@30/1\n");
+
+	// Unbalanced calls and unknown cameras send nothing.
+	bytes.clear();
+	session.OnReleased(0, bytes);
+	session.OnStreamStopped(0, bytes);
+	session.OnActivated(TcpKickSession::MaxCameras, k720p, bytes);
+	session.OnStreamStarted(TcpKickSession::MaxCameras, bytes);
+	CHECK(bytes.empty());
+}
+
+TEST_CASE(StreamWithoutPrewarmStartsDirectly)
+{
+	TcpKickSession session;
+	std::string bytes;
+	session.OnConnected(1, bytes);
+	bytes.clear();
+	session.OnStreamStarted(3, bytes);
+	session.OnStreamStopped(3, bytes);
+	CHECK(Describe(bytes) == "START 3 0x0@0/0\nSTOP 3 0x0@0/0\n");
+}
+
+TEST_CASE(ReconnectResynchronizesTheHost)
+{
+	TcpKickSession session;
+	std::string bytes;
+
+	// Nothing is sent while disconnected, but the state is kept.
+	session.OnActivated(0, k720p, bytes);
+	session.OnStreamStarted(0, bytes);
+	session.OnActivated(2, k1080p, bytes);
+	CHECK(bytes.empty());
+	CHECK(!session.IsConnected());
+
+	session.OnConnected(7, bytes);
+	CHECK(session.IsConnected());
+	CHECK(Describe(bytes) == "HELLO 7\nSTART 0 1280x720@30/1\nPREWARM 2 1920x1080@60000/1001\n");
+
+	// Changes during an outage are folded into the resync, not replayed.
+	session.OnDisconnected();
+	bytes.clear();
+	session.OnStreamStopped(0, bytes);
+	session.OnReleased(0, bytes);
+	session.OnStreamStarted(2, bytes);
+	CHECK(bytes.empty());
+
+	session.OnConnected(8, bytes);
+	CHECK(Describe(bytes) == "HELLO 8\nSTART 2 1920x1080@60000/1001\n");
+	CHECK_EQ(0u, session.Streams(0));
+	CHECK_EQ(1u, session.Streams(2));
+}
+
+TEST_CASE(ReconnectBacksOffAndResetsOnConnect)
+{
+	TcpKickReconnectPolicy policy;
+	CHECK(policy.GetState() == TcpKickReconnectPolicy::State::Connecting);
+
+	const uint64_t expected[] = { 1000, 2000, 4000, 8000, 16000, 30000, 30000 };
+	for (auto delay : expected)
+	{
+		policy.OnAttemptStarted();
+		CHECK_EQ(delay, policy.OnAttemptFailed());
+		CHECK(policy.GetState() == TcpKickReconnectPolicy::State::Waiting);
+	}
+
+	policy.OnAttemptStarted();
+	policy.OnConnected();
+	CHECK(policy.GetState() == TcpKickReconnectPolicy::State::Connected);
+
+	// A dropped connection is retried promptly, and backoff starts over.
+	CHECK_EQ(TcpKickReconnectPolicy::InitialDelayMs, policy.OnDisconnected());
+	CHECK(policy.GetState() == TcpKickReconnectPolicy::State::Waiting);
+	policy.OnAttemptStarted();
+	CHECK(policy.GetState() == TcpKickReconnectPolicy::State::Connecting);
+	CHECK_EQ(1000u, policy.OnAttemptFailed());
+	CHECK_EQ(2000u, policy.OnAttemptFailed());
+}
+
+TEST_CASE(SlowSinkFillsTheLogQueueAndDropsWholeBatches)
+{
+	constexpr size_t kCapacity = 4096;
+	const std::string batch(200, 'x');
+	TcpKickLogQueue queue(kCapacity);
+
+	// The producer queues 10 batches per tick; the sink drains only every 4th tick.
+	uint64_t accepted = 0;
+	uint64_t dropped = 0;
+	uint64_t delivered = 0;
+	auto sawNotice = false;
+	for (int tick = 1; tick <= 40; tick++)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			(queue.Append(batch.data(), batch.size()) ? accepted : dropped)++;
+			CHECK(queue.QueuedBytes() <= kCapacity);
+		}
+
+		if (tick % 4 == 0)
+		{
+			const auto droppedBefore = queue.DroppedBatches();
+			std::string sending;
+			queue.Take(sending);
+			bool valid = false;
+			const auto frames = ParseFrames(sending, &valid);
+			CHECK(valid);
+			CHECK(!frames.empty());
+			CHECK_EQ(0u, queue.QueuedBytes());
+			CHECK_EQ(0u, queue.DroppedBatches());
+
+			// The gap is reported ahead of the logs that follow it.
+			size_t first = 0;
+			if (droppedBefore)
+			{
+				CHECK(frames[0].payload.rfind("[kick] log queue full, dropped " + std::to_string(droppedBefore) + " batches", 0) == 0);
+				sawNotice = true;
+				first = 1;
+			}
+			for (size_t i = first; i < frames.size(); i++)
+			{
+				CHECK_EQ(VCAM_KICK_LOG, frames[i].type);
+				CHECK(frames[i].payload == batch);
+				delivered++;
+			}
+		}
+	}
+
+	CHECK(sawNotice);
+	CHECK(dropped > 0);
+	CHECK_EQ(accepted, delivered);
+	CHECK_EQ(400u, accepted + dropped);
+}
+
+TEST_CASE(OversizedBatchIsDroppedAndCleared)
+{
+	TcpKickLogQueue queue(64);
+	const std::string tooBig(100, 'y');
+	CHECK(!queue.Append(tooBig.data(), tooBig.size()));
+	CHECK(queue.Append("ok\r\n", 4));
+
+	// A disconnect discards queued logs but keeps the drop count for the next connection.
+	queue.Clear();
+	CHECK_EQ(0u, queue.QueuedBytes());
+	CHECK_EQ(1u, queue.DroppedBatches());
+	std::string sending;
+	queue.Take(sending);
+	const auto frames = ParseFrames(sending);
+	CHECK_EQ(1u, frames.size());
+	CHECK(frames[0].payload.find("100 bytes") != std::string::npos);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Minimal self-registering test runner, so the portable cores can be checked on any host
+// without third-party dependencies. Every suite links TestMain.cpp into its own executable.
+struct TestCase
+{
+	const char* name;
+	void (*run)();
+};
+
+inline std::vector<TestCase>& TestCases()
+{
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+inline int& TestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+struct TestRegistrar
+{
+	TestRegistrar(const char* name, void (*run)())
+	{
+		TestCases().push_back({ name, run });
+	}
+};
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do \
+	{ \
+		if (!(expression)) \
+		{ \
+			std::fprintf(stderr, "%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #expression); \
+			TestFailures()++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(expected, actual) \
+	do \
+	{ \
+		const auto checkExpected = (expected); \
+		const auto checkActual = (actual); \
+		if (!(checkExpected == checkActual)) \
+		{ \
+			std::fprintf(stderr, "%s(%d): CHECK_EQ failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #expected, #actual, static_cast<long long>(checkExpected), static_cast<long long>(checkActual)); \
+			TestFailures()++; \
+		} \
+	} while (0)
@@ -0,0 +1,13 @@
+#include "TestHarness.h"
+
+int main()
+{
+	for (const auto& test : TestCases())
+	{
+		const auto failuresBefore = TestFailures();
+		test.run();
+		std::printf("%s %s\n", TestFailures() == failuresBefore ? "PASS" : "FAIL", test.name);
+	}
+	std::printf("%zu tests, %d failed checks\n", TestCases().size(), TestFailures());
+	return TestFailures() ? 1 : 0;
+}
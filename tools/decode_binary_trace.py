@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Decodes a binary VCam trace (C:\\gstvcam_trace.bin) into the text log format.
+
+The record layout is described in VCamSampleSource/BinaryTrace.h. Usage:
+
+    python decode_binary_trace.py gstvcam_trace.bin [output.txt]
+"""
+
+import datetime
+import re
+import struct
+import sys
+
+RECORD_SESSION = 1
+RECORD_BATCH = 2
+RECORD_SITE = 3
+RECORD_EVENT = 4
+RECORD_DROPPED = 5
+
+ARG_INT64 = 1
+ARG_UINT64 = 2
+ARG_DOUBLE = 3
+ARG_POINTER = 4
+ARG_STRING = 5
+ARG_WSTRING = 6
+
+# printf conversion: flags, width, precision, length modifier (MSVC and C99), type.
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|I64|I32|I|z|j|t|L|w)?([diuoxXcsSpeEfgGaAZ%])")
+
+FILETIME_EPOCH = datetime.datetime(1601, 1, 1, tzinfo=datetime.timezone.utc)
+
+
+def decode_arguments(data):
+    arguments = []
+    offset = 0
+    while offset < len(data):
+        tag = data[offset]
+        offset += 1
+        if tag == ARG_INT64:
+            arguments.append(struct.unpack_from("<q", data, offset)[0])
+            offset += 8
+        elif tag in (ARG_UINT64, ARG_POINTER):
+            value = struct.unpack_from("<Q", data, offset)[0]
+            arguments.append(value if tag == ARG_UINT64 else ("pointer", value))
+            offset += 8
+        elif tag == ARG_DOUBLE:
+            arguments.append(struct.unpack_from("<d", data, offset)[0])
+            offset += 8
+        elif tag in (ARG_STRING, ARG_WSTRING):
+            length = struct.unpack_from("<H", data, offset)[0]
+            offset += 2
+            raw = data[offset:offset + length]
+            offset += length
+            arguments.append(raw.decode("utf-16-le" if tag == ARG_WSTRING else "utf-8", errors="replace"))
+        else:
+            break
+    return arguments
+
+
+def format_message(fmt, arguments):
+    remaining = list(arguments)
+
+    def take():
+        return remaining.pop(0) if remaining else None
+
+    def replace(match):
+        flags, width, precision, length, kind = match.groups()
+        if kind == "%":
+            return "%"
+        if width == "*":
+            width = str(take())
+        if precision == "*":
+            precision = str(take())
+        value = take()
+        if isinstance(value, tuple):
+            value = value[1]
+        spec = "%" + flags + (width or "") + ("." + precision if precision is not None else "")
+
+        if kind in "sSZ":
+            return (spec + "s") % ("(null)" if value is None else value)
+        if kind == "p":
+            return "%016X" % (value or 0)
+        if value is None:
+            return match.group(0)
+        if kind == "c":
+            return (spec + "c") % chr(value)
+        if kind in "eEfgGaA":
+            return (spec + ("f" if kind in "aA" else kind)) % float(value)
+        if kind in "uxXo":
+            # Sign-extended values print like the original unsigned conversion.
+            bits = 64 if length in ("ll", "I64", "j") or (length in ("I", "z", "t")) else 32
+            value &= (1 << bits) - 1
+            return (spec + ("d" if kind == "u" else kind)) % value
+        return (spec + "d") % value
+
+    return CONVERSION.sub(replace, fmt)
+
+
+def decode(data, output):
+    processes = {}
+    current = None
+    offset = 0
+    while offset + 4 <= len(data):
+        record_type, size = struct.unpack_from("<HH", data, offset)
+        if size < 4 or offset + size > len(data):
+            output.write("[decoder] truncated record at offset %d\n" % offset)
+            break
+        body = data[offset + 4:offset + size]
+        offset += size
+
+        if record_type == RECORD_SESSION:
+            pid, frequency, qpc_base, filetime_base = struct.unpack_from("<IQQQ", body)
+            processes[pid] = {"frequency": frequency, "qpc": qpc_base, "filetime": filetime_base, "sites": {}}
+            current = processes[pid]
+        elif record_type == RECORD_BATCH:
+            current = processes.get(struct.unpack_from("<I", body)[0])
+        elif current is None:
+            continue
+        elif record_type == RECORD_SITE:
+            site_id = struct.unpack_from("<I", body)[0]
+            current["sites"][site_id] = body[4:].decode("utf-8", errors="replace")
+        elif record_type == RECORD_EVENT:
+            site_id, thread_id, qpc = struct.unpack_from("<IIQ", body)
+            fmt = current["sites"].get(site_id, "<unknown site %d>" % site_id)
+            ticks = (qpc - current["qpc"]) * 10_000_000 // current["frequency"]
+            when = FILETIME_EPOCH + datetime.timedelta(microseconds=(current["filetime"] + ticks) // 10)
+            stamp = when.astimezone().strftime("%Y-%m-%d %H:%M:%S.%f")[:-3]
+            message = format_message(fmt, decode_arguments(body[16:])).rstrip("\r\n")
+            output.write("[%s][%u]%s\n" % (stamp, thread_id, message))
+        elif record_type == RECORD_DROPPED:
+            output.write("[trace] ring full, dropped %d lines\n" % struct.unpack_from("<Q", body)[0])
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as source:
+        data = source.read()
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], "w", encoding="utf-8") as output:
+            decode(data, output)
+    else:
+        decode(data, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Stand-in for the host side of the VCam kick channel (LogEndpoint).
+
+Accepts connections from the virtual camera, decodes the frames described in
+VCamSampleSource/TcpKickProtocol.h and prints one line per lifecycle message. Log
+batches go to stdout, or to a file with --log. --read-delay-ms makes the host a slow
+sink, to watch the source drop log batches instead of stalling. Usage:
+
+    python kick_host.py [--bind 0.0.0.0] [--port 5555] [--log kick.log] [--read-delay-ms 0]
+"""
+
+import argparse
+import datetime
+import socket
+import struct
+import sys
+import threading
+import time
+
+MAGIC = 0x4B56
+VERSION = 1
+
+HELLO = 1
+PREWARM = 2
+START = 3
+STOP = 4
+STATS = 5
+LOG = 6
+
+HEADER = struct.Struct("<HBBI")
+HELLO_PAYLOAD = struct.Struct("<I")
+CAMERA_PAYLOAD = struct.Struct("<IIIII")
+
+CAMERA_MESSAGES = {PREWARM: "PREWARM", START: "START", STOP: "STOP"}
+
+
+def describe(kind, payload):
+    if kind == HELLO:
+        return "HELLO pid=%d" % HELLO_PAYLOAD.unpack_from(payload)[0]
+    if kind in CAMERA_MESSAGES:
+        camera, width, height, numerator, denominator = CAMERA_PAYLOAD.unpack_from(payload)
+        return "%s camera=%d %dx%d@%d/%d" % (CAMERA_MESSAGES[kind], camera, width, height, numerator, denominator)
+    if kind == STATS:
+        return "STATS " + payload.decode("utf-8", errors="replace")
+    return "type %d (%d bytes)" % (kind, len(payload))
+
+
+class Connection:
+    def __init__(self, sock, peer, log, read_delay):
+        self.sock = sock
+        self.peer = peer
+        self.log = log
+        self.read_delay = read_delay
+        self.buffer = b""
+
+    def event(self, text):
+        stamp = datetime.datetime.now().strftime("%H:%M:%S.%f")[:-3]
+        print("[%s][%s:%d] %s" % (stamp, self.peer[0], self.peer[1], text), flush=True)
+
+    def frames(self):
+        while len(self.buffer) >= HEADER.size:
+            magic, version, kind, size = HEADER.unpack_from(self.buffer)
+            if magic != MAGIC or version != VERSION:
+                raise ValueError("bad frame header magic=0x%04X version=%d" % (magic, version))
+            if len(self.buffer) < HEADER.size + size:
+                break
+            payload = self.buffer[HEADER.size:HEADER.size + size]
+            self.buffer = self.buffer[HEADER.size + size:]
+            yield kind, payload
+
+    def run(self):
+        self.event("connected")
+        try:
+            while True:
+                data = self.sock.recv(4096 if self.read_delay else 65536)
+                if not data:
+                    break
+                self.buffer += data
+                for kind, payload in self.frames():
+                    if kind == LOG:
+                        self.log.write(payload.decode("utf-8", errors="replace").replace("\r\n", "\n"))
+                        self.log.flush()
+                    else:
+                        self.event(describe(kind, payload))
+                if self.read_delay:
+                    time.sleep(self.read_delay)
+        except (OSError, ValueError) as error:
+            self.event("error: %s" % error)
+        finally:
+            self.sock.close()
+            self.event("disconnected")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=5555)
+    parser.add_argument("--log", help="write forwarded log lines to this file instead of stdout")
+    parser.add_argument("--read-delay-ms", type=int, default=0, help="sleep after every 4 KB read")
+    arguments = parser.parse_args()
+
+    log = open(arguments.log, "a", encoding="utf-8") if arguments.log else sys.stdout
+    family = socket.AF_INET6 if ":" in arguments.bind else socket.AF_INET
+    with socket.socket(family, socket.SOCK_STREAM) as server:
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind((arguments.bind, arguments.port))
+        server.listen()
+        print("listening on %s:%d" % (arguments.bind, arguments.port), flush=True)
+        while True:
+            sock, peer = server.accept()
+            connection = Connection(sock, peer, log, arguments.read_delay_ms / 1000.0)
+            threading.Thread(target=connection.run, daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()